@@ -23,6 +23,42 @@ public class CameraModel {
      */
     public static native int GetDeviceCount();
 
+    /**
+     * Record where the native resources are acquired. Disabled by default
+     * because it costs a lock for each acquire/release
+     */
+    public static native void TrackResourceSites(boolean enable);
+
+    /**
+     * Live resources grouped by the acquisition site. The largest bytes first
+     *
+     * @return lines of "file:line type device live bytes". The type follows
+     *         {@link Device#RESOURCE_IMAGE} ~ {@link Device#RESOURCE_FRAME_BUFFER}
+     */
+    public static native String[] GetResourceSites();
+
+    /**
+     * Reopen the device and restore its repeating request when it is
+     * disconnected or has an error. Disabled by default
+     */
+    public static native void SetRecovery(boolean enable);
+
+    /**
+     * Measure the stages of the library(session setup, capture callbacks,
+     * image analysis, conversion) with the hardware counters of the CPU.
+     * Enabling again clears the previous measurement. Disabled by default
+     */
+    public static native void SetProfiling(boolean enable);
+
+    /**
+     * Summary of the stages since {@link #SetProfiling}. The counters are
+     * omitted if the device doesn't allow them(perf_event_paranoid)
+     *
+     * @return JSON. {"stages":[{"name", "count", "wall_time_avg", "wall_time_max",
+     *         "counted", "cycles", "instructions", "cache_misses", "branch_misses", "ipc"}]}
+     */
+    public static native String GetProfile();
+
     /**
      * @param devices SetDeviceData will provide appropriate internal library id
      */
@@ -20,6 +20,63 @@ public class Device {
     /** library internal identifier */
     public short id = -1;
 
+    /**
+     * Indices of {@link Device#timing()}. Each element is a time point of
+     * steady clock in nanosecond. 0 if the step is not reached
+     */
+    public static final int TIMING_OPEN_BEGIN = 0;
+    public static final int TIMING_OPEN_END = 1;
+    public static final int TIMING_REQUEST_BEGIN = 2;
+    public static final int TIMING_REQUEST_END = 3;
+    public static final int TIMING_SURFACE_BEGIN = 4;
+    public static final int TIMING_SESSION_END = 5;
+    public static final int TIMING_REPEAT_END = 6;
+    public static final int TIMING_FIRST_FRAME = 7;
+
+    /**
+     * Resource types of {@link Device#resources(int)}
+     */
+    public static final int RESOURCE_IMAGE = 0;
+    public static final int RESOURCE_HARDWARE_BUFFER = 1;
+    public static final int RESOURCE_CAPTURE_REQUEST = 2;
+    public static final int RESOURCE_CAPTURE_SESSION = 3;
+    public static final int RESOURCE_FRAME_BUFFER = 4;
+
+    /**
+     * Indices of {@link Device#resources(int)}
+     */
+    public static final int STAT_LIVE = 0;
+    public static final int STAT_BYTES = 1;
+    public static final int STAT_PEAK_LIVE = 2;
+    public static final int STAT_PEAK_BYTES = 3;
+    public static final int STAT_TOTAL = 4;
+
+    /**
+     * Fields of each incident in {@link Device#incidents()}
+     */
+    public static final int INCIDENT_ERROR = 0; // 0 for the disconnect
+    public static final int INCIDENT_ATTEMPTS = 1;
+    public static final int INCIDENT_BEGIN = 2;
+    public static final int INCIDENT_END = 3; // 0 if not recovered
+    public static final int INCIDENT_FATAL = 4; // 1 if fatal
+    public static final int INCIDENT_RECOVERED = 5; // 1 if recovered
+    public static final int INCIDENT_FIELD_COUNT = 6;
+
+    /**
+     * Fields of each requirement in {@link Device#planStreams(long[])}
+     */
+    public static final int STREAM_FORMAT = 0; // ImageFormat
+    public static final int STREAM_MIN_WIDTH = 1;
+    public static final int STREAM_MIN_HEIGHT = 2;
+    public static final int STREAM_MAX_FRAME_DURATION = 3; // 0 if any
+    public static final int STREAM_FLAGS = 4;
+    public static final int STREAM_FIELD_COUNT = 5;
+    /**
+     * Flags of the requirement
+     */
+    public static final int STREAM_REPEATING = 1; // false for the still captures
+    public static final int STREAM_LARGEST = 2; // the largest size instead of the smallest
+
     /**
      * Only {@link CameraModel} will access to this
      */
@@ -50,6 +107,60 @@ public class Device {
      */
     public native void close();
 
+    /**
+     * Open the device and prepare a preview request before the Surface is
+     * ready. This is a blocking call. Invoke it in a background thread while
+     * the UI is inflating so that {@link Device#repeat(Surface)} only has to
+     * create the session.
+     *
+     * @see Device#repeat(Surface)
+     */
+    public native void prewarm() throws RuntimeException;
+
+    /**
+     * Time-to-first-frame breakdown of the last repeating request
+     *
+     * @return time points. Use {@link Device#TIMING_OPEN_BEGIN} ~
+     *         {@link Device#TIMING_FIRST_FRAME} for index
+     */
+    public native long[] timing();
+
+    /**
+     * Accounting of the native resources which are created or handed out for
+     * this device
+     *
+     * @param type {@link Device#RESOURCE_IMAGE} ~
+     *             {@link Device#RESOURCE_FRAME_BUFFER}
+     * @return counters. Use {@link Device#STAT_LIVE} ~
+     *         {@link Device#STAT_TOTAL} for index
+     */
+    public native long[] resources(int type) throws IllegalArgumentException;
+
+    /**
+     * Disconnects and errors of this device and their recovery. Requires
+     * {@link CameraModel#SetRecovery(boolean)}. The oldest first
+     *
+     * @return {@link Device#INCIDENT_FIELD_COUNT} values for each incident.
+     *         The downtime is {@link Device#INCIDENT_END} -
+     *         {@link Device#INCIDENT_BEGIN} in nanosecond
+     */
+    public native long[] incidents();
+
+    /**
+     * Choose the output sizes which can run together with the min frame
+     * durations, stall durations and the stream combinations of the device's
+     * hardware level. For the repeating streams, the frame duration limits the
+     * repeating request. For the others, it limits the still request with the
+     * stall.
+     *
+     * @param requirements {@link Device#STREAM_FIELD_COUNT} values for each
+     *                     output
+     * @return width and height of each output in the same order, and then the
+     *         frame durations of the repeating and the still requests
+     * @throws IllegalArgumentException with the reason if there is no plan
+     */
+    public native long[] planStreams(long[] requirements) throws IllegalArgumentException;
+
     /**
      * User of the Camera 2 API must provide valid Surface.
      *
@@ -57,7 +168,7 @@ public class Device {
      * @param surface output surface for Camera 2 API
      */
     public void repeat(Surface surface) throws RuntimeException {
-        // ensure the camera is opened
+        // ensure the camera is opened. no-op if prewarmed
         this.open();
         // Create a session with repeating capture request
         startRepeat(surface);
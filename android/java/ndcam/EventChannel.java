@@ -0,0 +1,141 @@
+package ndcam;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Capture events of all devices in a ring buffer which is shared with the
+ * native library. Camera callbacks write the records and Java drains them in
+ * batch, so there is no JNI upcall for each frame.
+ *
+ * Only 1 thread can drain the channel. Close it after the devices are stopped
+ *
+ * @author luncliff@gmail.com
+ */
+public final class EventChannel implements AutoCloseable {
+    static {
+        System.loadLibrary("c++_shared");
+        System.loadLibrary("ndk_camera");
+    }
+
+    /** {@link android.hardware.camera2.CameraCaptureSession.CaptureCallback} */
+    public static final short TYPE_STARTED = 1;
+    public static final short TYPE_COMPLETED = 2;
+    public static final short TYPE_FAILED = 3;
+    public static final short TYPE_BUFFER_LOST = 4;
+
+    // layout of the buffer. see `event_channel_t` and `capture_event_t`
+    static final int OFFSET_CAPACITY = 4;
+    static final int OFFSET_DROPPED = 8;
+    static final int HEADER_SIZE = 128;
+    static final int RECORD_SIZE = 48;
+    static final int OFFSET_TYPE = 0;
+    static final int OFFSET_DEVICE = 2;
+    static final int OFFSET_SEQUENCE = 4;
+    static final int OFFSET_FRAME_NUMBER = 8;
+    static final int OFFSET_TIMESTAMP = 16;
+    static final int OFFSET_EXPOSURE_TIME = 24;
+    static final int OFFSET_FRAME_DURATION = 32;
+    static final int OFFSET_SENSITIVITY = 40;
+    static final int OFFSET_REASON = 44;
+    static final int OFFSET_CAPTURED = 46;
+
+    /**
+     * A record of the channel. The instance is reused for each event, so
+     * copy the fields to keep them
+     */
+    public static final class Event {
+        public short type;
+        /** {@link Device#id} */
+        public short device;
+        public int sequence;
+        public long frameNumber;
+        /** sensor timestamp. start of the exposure for {@link #TYPE_STARTED} */
+        public long timestamp;
+        public long exposureTime;
+        public long frameDuration;
+        public int sensitivity;
+        /** {@link android.hardware.camera2.CaptureFailure#getReason()} */
+        public short reason;
+        public boolean imageCaptured;
+    }
+
+    public interface Listener {
+        void onEvent(Event event);
+    }
+
+    private long handle;
+    private final ByteBuffer buffer;
+    private final int capacity;
+    private final Event event = new Event();
+    private int tail = 0;
+    // released with the next poll
+    private int consumed = 0;
+
+    /**
+     * Create a channel and attach it to the library. The previous channel is
+     * detached
+     *
+     * @param capacity number of records. rounded up to power of 2
+     */
+    public EventChannel(int capacity) throws RuntimeException {
+        handle = create(capacity);
+        buffer = buffer(handle).order(ByteOrder.nativeOrder());
+        this.capacity = buffer.getInt(OFFSET_CAPACITY);
+        attach(handle);
+    }
+
+    /**
+     * Invoke the listener with the events written after the last drain
+     *
+     * @return number of the events
+     */
+    public int drain(Listener listener) {
+        final int count = poll(handle, consumed);
+        tail += consumed;
+        for (int i = 0; i < count; ++i) {
+            final int offset = HEADER_SIZE + ((tail + i) & (capacity - 1)) * RECORD_SIZE;
+            event.type = buffer.getShort(offset + OFFSET_TYPE);
+            event.device = buffer.getShort(offset + OFFSET_DEVICE);
+            event.sequence = buffer.getInt(offset + OFFSET_SEQUENCE);
+            event.frameNumber = buffer.getLong(offset + OFFSET_FRAME_NUMBER);
+            event.timestamp = buffer.getLong(offset + OFFSET_TIMESTAMP);
+            event.exposureTime = buffer.getLong(offset + OFFSET_EXPOSURE_TIME);
+            event.frameDuration = buffer.getLong(offset + OFFSET_FRAME_DURATION);
+            event.sensitivity = buffer.getInt(offset + OFFSET_SENSITIVITY);
+            event.reason = buffer.getShort(offset + OFFSET_REASON);
+            event.imageCaptured = buffer.getShort(offset + OFFSET_CAPTURED) != 0;
+            listener.onEvent(event);
+        }
+        consumed = count;
+        return count;
+    }
+
+    /**
+     * @return number of the events dropped because the ring was full
+     */
+    public int dropped() {
+        return buffer.getInt(OFFSET_DROPPED);
+    }
+
+    /**
+     * Detach from the library and release the ring
+     */
+    @Override
+    public void close() {
+        if (handle == 0)
+            return;
+        destroy(handle);
+        handle = 0;
+    }
+
+    private static native long create(int capacity) throws RuntimeException;
+
+    private static native ByteBuffer buffer(long handle);
+
+    private static native int poll(long handle, int consumed);
+
+    private static native void attach(long handle);
+
+    private static native void destroy(long handle);
+}
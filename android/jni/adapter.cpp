@@ -3,7 +3,12 @@
 //      luncliff@gmail.com
 //
 #include <ndk_camera.h>
+#include <ndk_camera_event.h>
 #include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_recovery.h>
+#include <ndk_camera_resource.h>
+#include <ndk_camera_stream.h>
 
 #include <gsl/gsl>
 #include <spdlog/sinks/android_sink.h>
@@ -26,7 +31,8 @@ __attribute__((constructor)) void jni_on_load(void) noexcept {
 }
 
 // - Note
-//      Group of java native type variables
+//      Group of java native type variables. The classes are global references
+//      and the IDs are cached in `Init` so the operations don't look up them
 // - Reference
 //      https://programming.guide/java/list-of-java-exceptions.html
 struct _HIDDEN_ java_type_set_t final {
@@ -38,131 +44,31 @@ struct _HIDDEN_ java_type_set_t final {
 
     jclass device_t{};
     jfieldID device_id_f{};
+
+    jclass string_t{};
 };
 java_type_set_t java{};
 
-// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
-// device callbacks
-
-void context_on_device_disconnected(camera_group_t& context,
-                                    ACameraDevice* device) noexcept {
-    const char* id = ACameraDevice_getId(device);
-    logger->error("on_device_disconnect: {}", id);
-    return;
-}
-
-void context_on_device_error(camera_group_t& context, ACameraDevice* device,
-                             int error) noexcept {
-    const char* id = ACameraDevice_getId(device);
-    logger->error("on_device_error: {} {}", id, error);
-    return;
-}
-
-// session state callbacks
-
-void context_on_session_active(camera_group_t& context,
-                               ACameraCaptureSession* session) noexcept {
-    logger->info("on_session_active");
-    return;
-}
-
-void context_on_session_closed(camera_group_t& context,
-                               ACameraCaptureSession* session) noexcept {
-    logger->warn("on_session_closed");
-    return;
-}
-
-void context_on_session_ready(camera_group_t& context,
-                              ACameraCaptureSession* session) noexcept {
-    logger->info("on_session_ready");
-    return;
-}
-
-// capture callbacks
-
-void context_on_capture_started(camera_group_t& context,
-                                ACameraCaptureSession* session,
-                                const ACaptureRequest* request,
-                                uint64_t time_point) noexcept {
-    logger->debug("context_on_capture_started  : {}", time_point);
-    return;
-}
-
-void context_on_capture_progressed(camera_group_t& context,
-                                   ACameraCaptureSession* session,
-                                   ACaptureRequest* request,
-                                   const ACameraMetadata* result) noexcept {
-    camera_status_t status = ACAMERA_OK;
-    ACameraMetadata_const_entry entry{};
-    uint64_t time_point = 0;
-    // ACAMERA_SENSOR_TIMESTAMP
-    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE
-    // ACAMERA_SENSOR_FRAME_DURATION
-    status =
-        ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_TIMESTAMP, &entry);
-    if (status == ACAMERA_OK)
-        time_point = static_cast<uint64_t>(*(entry.data.i64));
-
-    logger->debug("context_on_capture_progressed: {}", time_point);
-    return;
-}
-
-void context_on_capture_completed(camera_group_t& context,
-                                  ACameraCaptureSession* session,
-                                  ACaptureRequest* request,
-                                  const ACameraMetadata* result) noexcept {
-    camera_status_t status = ACAMERA_OK;
-    ACameraMetadata_const_entry entry{};
-    uint64_t time_point = 0;
-    // ACAMERA_SENSOR_TIMESTAMP
-    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE
-    // ACAMERA_SENSOR_FRAME_DURATION
-    status =
-        ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_TIMESTAMP, &entry);
-    if (status == ACAMERA_OK)
-        time_point = static_cast<uint64_t>(*(entry.data.i64));
-
-    logger->debug("context_on_capture_completed: {}", time_point);
-    return;
-}
-
-void context_on_capture_failed(camera_group_t& context,
-                               ACameraCaptureSession* session,
-                               ACaptureRequest* request,
-                               ACameraCaptureFailure* failure) noexcept {
-    logger->error("context_on_capture_failed {} {} {} {}", failure->frameNumber,
-                  failure->reason, failure->sequenceId,
-                  failure->wasImageCaptured);
-    return;
-}
-
-void context_on_capture_buffer_lost(camera_group_t& context,
-                                    ACameraCaptureSession* session,
-                                    ACaptureRequest* request,
-                                    ANativeWindow* window,
-                                    int64_t frameNumber) noexcept {
-    logger->error("context_on_capture_buffer_lost");
-    return;
-}
-
-void context_on_capture_sequence_abort(camera_group_t& context,
-                                       ACameraCaptureSession* session,
-                                       int sequenceId) noexcept {
-    logger->error("context_on_capture_sequence_abort");
-    return;
-}
-
-void context_on_capture_sequence_complete(camera_group_t& context,
-                                          ACameraCaptureSession* session,
-                                          int sequenceId,
-                                          int64_t frameNumber) noexcept {
-    logger->debug("context_on_capture_sequence_complete");
-    return;
-}
-
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 
 camera_group_t context{};
+resource_tracker_t resources{};
+// created by `SetRecovery`. never deleted since the device callbacks may
+// still refer to it after the detach
+recovery_engine_t* recovery = nullptr;
+// created by `SetProfiling`. never deleted since the scopes in the other
+// threads may still refer to it after the detach
+perf_profiler_t* profiler = nullptr;
+
+// `FindClass` returns a local reference. It can't be used after the return
+static jclass find_class(JNIEnv* env, const char* name) noexcept {
+    jclass local = env->FindClass(name);
+    if (local == nullptr)
+        return nullptr;
+    auto type = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return type;
+}
 
 void Java_ndcam_CameraModel_Init(JNIEnv* env, jclass type) noexcept {
     uint16_t num_camera = 0;
@@ -175,15 +81,15 @@ void Java_ndcam_CameraModel_Init(JNIEnv* env, jclass type) noexcept {
     assert(logger != nullptr);
 
     // Find exception class information (type info)
-    java.runtime_exception = env->FindClass("java/lang/RuntimeException");
+    java.runtime_exception = find_class(env, "java/lang/RuntimeException");
     java.illegal_argument_exception =
-        env->FindClass("java/lang/IllegalArgumentException");
+        find_class(env, "java/lang/IllegalArgumentException");
     java.illegal_state_exception =
-        env->FindClass("java/lang/IllegalStateException");
+        find_class(env, "java/lang/IllegalStateException");
     java.unsupported_operation_exception =
-        env->FindClass("java/lang/UnsupportedOperationException");
+        find_class(env, "java/lang/UnsupportedOperationException");
     java.index_out_of_bounds_exception =
-        env->FindClass("java/lang/IndexOutOfBoundsException");
+        find_class(env, "java/lang/IndexOutOfBoundsException");
 
     // !!! Since we can't throw if this info is null, call assert !!!
     assert(java.runtime_exception != nullptr);
@@ -192,7 +98,15 @@ void Java_ndcam_CameraModel_Init(JNIEnv* env, jclass type) noexcept {
     assert(java.unsupported_operation_exception != nullptr);
     assert(java.index_out_of_bounds_exception != nullptr);
 
+    java.device_t = find_class(env, "ndcam/Device");
+    assert(java.device_t != nullptr);
+    java.device_id_f = env->GetFieldID(java.device_t, "id", "S"); // short
+    assert(java.device_id_f != nullptr);
+    java.string_t = find_class(env, "java/lang/String");
+    assert(java.string_t != nullptr);
+
     context.release();
+    context.resources = addressof(resources);
 
     context.manager = ACameraManager_create();
     assert(context.manager != nullptr);
@@ -236,48 +150,24 @@ void Java_ndcam_CameraModel_SetDeviceData(JNIEnv* env, jclass type,
     if (context.manager == nullptr) // not initialized
         return;
 
-    java.device_t = env->FindClass("ndcam/Device");
-    assert(java.device_t != nullptr);
-
     const auto count = context.id_list->numCameras;
     assert(count == env->GetArrayLength(devices));
 
     // https://developer.android.com/ndk/reference/group/camera
     for (short index = 0; index < count; ++index) {
-        ACameraMetadata_const_entry entry{};
-        ACameraMetadata_getConstEntry(
-            context.metadata_set[index],
-            ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS, &entry);
-        for (auto i = 0u; i < entry.count; i += 4) {
-            const int32_t direction = entry.data.i32[i + 3];
-            if (direction ==
-                ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_INPUT)
-                ;
-            if (direction ==
-                ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT)
-                ;
-
-            const int32_t format = entry.data.i32[i + 0];
-            const int32_t width = entry.data.i32[i + 1];
-            const int32_t height = entry.data.i32[i + 2];
-
-            if (format == AIMAGE_FORMAT_PRIVATE)
-                logger->debug("Private: {} {} ", width, height);
-            if (format == AIMAGE_FORMAT_YUV_420_888)
-                logger->debug("YUV_420_888: {} {} ", width, height);
-            if (format == AIMAGE_FORMAT_JPEG)
-                logger->debug("JPEG: {} {} ", width, height);
-            if (format == AIMAGE_FORMAT_RAW16)
-                logger->debug("Raw16: {} {} ", width, height);
-        }
+        stream_capability_t capability{};
+        read_stream_capability(context.metadata_set[index], capability);
+        for (const auto& output : capability.outputs)
+            logger->debug("{}: {} {} min {} stall {}",
+                          get_format_name(output.format), output.size.width,
+                          output.size.height, output.min_frame_duration,
+                          output.stall_duration);
 
         jobject device = env->GetObjectArrayElement(devices, index);
         assert(device != nullptr);
 
-        java.device_id_f = env->GetFieldID(java.device_t, "id", "S"); // short
-        assert(java.device_id_f != nullptr);
-
         env->SetShortField(device, java.device_id_f, index);
+        env->DeleteLocalRef(device);
     }
 }
 
@@ -294,6 +184,17 @@ jbyte Java_ndcam_Device_facing(JNIEnv* env, jobject instance) noexcept {
     return static_cast<jbyte>(facing);
 }
 
+static auto make_device_callbacks() noexcept
+    -> ACameraDevice_StateCallbacks {
+    ACameraDevice_StateCallbacks callbacks{};
+    callbacks.context = addressof(context);
+    callbacks.onDisconnected = reinterpret_cast<ACameraDevice_StateCallback>(
+        context_on_device_disconnected);
+    callbacks.onError = reinterpret_cast<ACameraDevice_ErrorStateCallback>(
+        context_on_device_error);
+    return callbacks;
+}
+
 void Java_ndcam_Device_open(JNIEnv* env, jobject instance) noexcept {
     camera_status_t status = ACAMERA_OK;
     if (context.manager == nullptr) // not initialized
@@ -302,13 +203,15 @@ void Java_ndcam_Device_open(JNIEnv* env, jobject instance) noexcept {
     const auto id = env->GetShortField(instance, java.device_id_f);
     assert(id != -1);
 
-    ACameraDevice_StateCallbacks callbacks{};
-    callbacks.context = addressof(context);
-    callbacks.onDisconnected = reinterpret_cast<ACameraDevice_StateCallback>(
-        context_on_device_disconnected);
-    callbacks.onError = reinterpret_cast<ACameraDevice_ErrorStateCallback>(
-        context_on_device_error);
+    // `prewarm` might be running in the other thread. wait for it
+    unique_lock lck{context.operation_mtx_set[id]};
+    // opened without session(e.g. `prewarm`). reopening only delays the
+    // first frame
+    if (context.device_set[id] != nullptr &&
+        context.session_set[id] == nullptr)
+        return;
 
+    auto callbacks = make_device_callbacks();
     context.close_device(id);
     status = context.open_device(id, callbacks);
 
@@ -320,6 +223,49 @@ void Java_ndcam_Device_open(JNIEnv* env, jobject instance) noexcept {
                   fmt::format("ACameraManager_openCamera: {}", status).c_str());
 }
 
+void Java_ndcam_Device_prewarm(JNIEnv* env, jobject instance) noexcept {
+    camera_status_t status = ACAMERA_OK;
+    if (context.manager == nullptr) // not initialized
+        return;
+
+    const auto id = env->GetShortField(instance, java.device_id_f);
+    assert(id != -1);
+
+    // a live session means the device is already streaming
+    unique_lock lck{context.operation_mtx_set[id]};
+    if (context.session_set[id] != nullptr)
+        return;
+
+    auto callbacks = make_device_callbacks();
+    status = context.prewarm(id, callbacks);
+    if (status == ACAMERA_OK)
+        return;
+
+    env->ThrowNew(java.runtime_exception, camera_error_message(status));
+}
+
+jlongArray Java_ndcam_Device_timing(JNIEnv* env, jobject instance) noexcept {
+    if (context.manager == nullptr) // not initialized
+        return nullptr;
+
+    const auto id = env->GetShortField(instance, java.device_id_f);
+    assert(id != -1);
+
+    // follow the order of `Device.TIMING_*`
+    const auto& timing = context.timing_set[id];
+    const array<jlong, 8> points{
+        timing.open_begin,    timing.open_end,
+        timing.request_begin, timing.request_end,
+        timing.surface_begin, timing.session_end,
+        timing.repeat_end,    timing.first_frame.load(),
+    };
+    jlongArray result = env->NewLongArray(points.size());
+    if (result == nullptr) // OutOfMemoryError is pending
+        return nullptr;
+    env->SetLongArrayRegion(result, 0, points.size(), points.data());
+    return result;
+}
+
 void Java_ndcam_Device_close(JNIEnv* env, jobject instance) noexcept {
     if (context.manager == nullptr) // not initialized
         return;
@@ -384,7 +330,10 @@ void Java_ndcam_Device_startRepeat(JNIEnv* env, jobject instance,
 
     status = context.start_repeat(id, window.get(), on_state_changed,
                                   on_capture_event);
-    assert(status == ACAMERA_OK);
+    if (status == ACAMERA_OK)
+        return;
+
+    env->ThrowNew(java.runtime_exception, camera_error_message(status));
 }
 
 void Java_ndcam_Device_stopRepeat(JNIEnv* env, jobject instance) noexcept {
@@ -464,6 +413,206 @@ void Java_ndcam_Device_stopCapture(JNIEnv* env, jobject instance) noexcept {
     context.stop_capture(id);
 }
 
+jlongArray Java_ndcam_Device_resources(JNIEnv* env, jobject instance,
+                                       jint type) noexcept {
+    if (type < 0 || type >= static_cast<jint>(resource_type_count)) {
+        env->ThrowNew(java.illegal_argument_exception, "unknown resource");
+        return nullptr;
+    }
+    const auto id = env->GetShortField(instance, java.device_id_f);
+    assert(id != -1);
+
+    // follow the order of `Device.STAT_*`
+    const auto stats =
+        resources.get_stats(static_cast<resource_type_t>(type), id);
+    const array<jlong, 5> values{
+        stats.live,       stats.bytes, stats.peak_live,
+        stats.peak_bytes, stats.total,
+    };
+    jlongArray result = env->NewLongArray(values.size());
+    if (result == nullptr) // OutOfMemoryError is pending
+        return nullptr;
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
+void Java_ndcam_CameraModel_TrackResourceSites(JNIEnv* env, jclass type,
+                                               jboolean enable) noexcept {
+    resources.enable_sites(enable == JNI_TRUE);
+}
+
+jobjectArray Java_ndcam_CameraModel_GetResourceSites(JNIEnv* env,
+                                                     jclass type) noexcept {
+    vector<resource_site_stats_t> sites{};
+    resources.get_sites(sites);
+
+    jobjectArray result =
+        env->NewObjectArray(sites.size(), java.string_t, nullptr);
+    if (result == nullptr) // OutOfMemoryError is pending
+        return nullptr;
+    for (auto i = 0u; i < sites.size(); ++i) {
+        const auto& item = sites[i];
+        // file:line type device live bytes
+        const auto line = fmt::format(
+            "{}:{} {} {} {} {}", item.site.file ? item.site.file : "?",
+            item.site.line, static_cast<uint16_t>(item.type), item.id,
+            item.live, item.bytes);
+        jstring text = env->NewStringUTF(line.c_str());
+        if (text == nullptr)
+            return nullptr;
+        env->SetObjectArrayElement(result, i, text);
+        env->DeleteLocalRef(text);
+    }
+    return result;
+}
+
+void Java_ndcam_CameraModel_SetRecovery(JNIEnv* env, jclass type,
+                                        jboolean enable) noexcept {
+    if (context.manager == nullptr) // not initialized
+        return;
+    if (recovery == nullptr)
+        recovery = new (nothrow) recovery_engine_t{context, {}};
+    // the devices opened before this won't be recovered
+    context.recovery = enable == JNI_TRUE ? recovery : nullptr;
+}
+
+void Java_ndcam_CameraModel_SetProfiling(JNIEnv* env, jclass type,
+                                         jboolean enable) noexcept {
+    if (profiler == nullptr)
+        profiler = new (nothrow) perf_profiler_t{{}};
+    else if (enable == JNI_TRUE) // new session of the measurement
+        profiler->reset();
+    set_perf_profiler(enable == JNI_TRUE ? profiler : nullptr);
+}
+
+jstring Java_ndcam_CameraModel_GetProfile(JNIEnv* env, jclass type) noexcept {
+    if (profiler == nullptr)
+        return env->NewStringUTF("{\"stages\":[]}");
+    return env->NewStringUTF(profiler->to_json().c_str());
+}
+
+jlongArray Java_ndcam_Device_incidents(JNIEnv* env,
+                                       jobject instance) noexcept {
+    const auto id = env->GetShortField(instance, java.device_id_f);
+    assert(id != -1);
+
+    vector<recovery_incident_t> incidents{};
+    if (recovery)
+        recovery->get_incidents(id, incidents);
+    // follow the order of `Device.INCIDENT_*`
+    vector<jlong> values{};
+    values.reserve(incidents.size() * 6);
+    for (const auto& incident : incidents) {
+        values.emplace_back(incident.error);
+        values.emplace_back(incident.attempts);
+        values.emplace_back(incident.begin);
+        values.emplace_back(incident.end);
+        values.emplace_back(incident.fatal);
+        values.emplace_back(incident.recovered);
+    }
+    jlongArray result = env->NewLongArray(values.size());
+    if (result == nullptr) // OutOfMemoryError is pending
+        return nullptr;
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
+jlongArray Java_ndcam_Device_planStreams(JNIEnv* env, jobject instance,
+                                         jlongArray requirements) noexcept {
+    const auto id = env->GetShortField(instance, java.device_id_f);
+    assert(id != -1);
+
+    // follow the order of `Device.STREAM_*`
+    const auto length = requirements ? env->GetArrayLength(requirements) : 0;
+    if (length % 5) {
+        env->ThrowNew(java.illegal_argument_exception,
+                      "requires STREAM_FIELD_COUNT values for each stream");
+        return nullptr;
+    }
+    vector<jlong> values(length);
+    env->GetLongArrayRegion(requirements, 0, length, values.data());
+    vector<stream_requirement_t> streams{};
+    for (auto i = 0; i < length; i += 5) {
+        stream_requirement_t stream{};
+        stream.format = static_cast<int32_t>(values[i]);
+        stream.min_size.width = static_cast<uint32_t>(values[i + 1]);
+        stream.min_size.height = static_cast<uint32_t>(values[i + 2]);
+        stream.max_frame_duration = values[i + 3];
+        stream.repeating = values[i + 4] & 1;
+        stream.largest = values[i + 4] & 2;
+        streams.emplace_back(stream);
+    }
+
+    stream_capability_t capability{};
+    stream_plan_t plan{};
+    read_stream_capability(context.metadata_set[id], capability);
+    if (plan_streams(capability, streams, plan) == false) {
+        env->ThrowNew(java.illegal_argument_exception, plan.reason.c_str());
+        return nullptr;
+    }
+    vector<jlong> sizes{};
+    for (const auto& stream : plan.streams) {
+        sizes.emplace_back(stream.size.width);
+        sizes.emplace_back(stream.size.height);
+    }
+    sizes.emplace_back(plan.frame_duration);
+    sizes.emplace_back(plan.still_duration);
+    jlongArray result = env->NewLongArray(sizes.size());
+    if (result == nullptr) // OutOfMemoryError is pending
+        return nullptr;
+    env->SetLongArrayRegion(result, 0, sizes.size(), sizes.data());
+    return result;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+
+// - Note
+//      Java holds the channel with an opaque handle(pointer)
+static auto to_channel(jlong handle) noexcept -> event_channel_t* {
+    return reinterpret_cast<event_channel_t*>(handle);
+}
+
+jlong Java_ndcam_EventChannel_create(JNIEnv* env, jclass type,
+                                     jint capacity) noexcept {
+    if (capacity <= 0) {
+        env->ThrowNew(java.illegal_argument_exception, "capacity <= 0");
+        return 0;
+    }
+    const auto count = static_cast<uint32_t>(capacity);
+    auto channel = make_unique<event_channel_t>(count);
+    if (channel->size() == 0) {
+        env->ThrowNew(java.runtime_exception, "failed to allocate the ring");
+        return 0;
+    }
+    return reinterpret_cast<jlong>(channel.release());
+}
+
+jobject Java_ndcam_EventChannel_buffer(JNIEnv* env, jclass type,
+                                       jlong handle) noexcept {
+    auto channel = to_channel(handle);
+    return env->NewDirectByteBuffer(channel->data(),
+                                    static_cast<jlong>(channel->size()));
+}
+
+jint Java_ndcam_EventChannel_poll(JNIEnv* env, jclass type, jlong handle,
+                                  jint consumed) noexcept {
+    return static_cast<jint>(
+        to_channel(handle)->poll(static_cast<uint32_t>(consumed)));
+}
+
+void Java_ndcam_EventChannel_attach(JNIEnv* env, jclass type,
+                                    jlong handle) noexcept {
+    context.event_channel = to_channel(handle);
+}
+
+void Java_ndcam_EventChannel_destroy(JNIEnv* env, jclass type,
+                                     jlong handle) noexcept {
+    auto channel = to_channel(handle);
+    // the callbacks may be pushing to it
+    detach_event_channel(context, channel);
+    delete channel;
+}
+
 // ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
 
 // - References
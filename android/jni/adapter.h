@@ -30,6 +30,12 @@ Java_ndcam_Device_open(JNIEnv* env, jobject instance) noexcept;
 _C_INTERFACE_ void JNICALL //
 Java_ndcam_Device_close(JNIEnv* env, jobject instance) noexcept;
 
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_Device_prewarm(JNIEnv* env, jobject instance) noexcept;
+
+_C_INTERFACE_ jlongArray JNICALL //
+Java_ndcam_Device_timing(JNIEnv* env, jobject instance) noexcept;
+
 _C_INTERFACE_ void JNICALL //
 Java_ndcam_Device_startRepeat(JNIEnv* env, jobject instance,
                               jobject surface) noexcept;
@@ -42,4 +48,41 @@ Java_ndcam_Device_startCapture(JNIEnv* env, jobject instance,
 _C_INTERFACE_ void JNICALL //
 Java_ndcam_Device_stopCapture(JNIEnv* env, jobject instance) noexcept;
 
+_C_INTERFACE_ jlongArray JNICALL //
+Java_ndcam_Device_resources(JNIEnv* env, jobject instance, jint type) noexcept;
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_CameraModel_TrackResourceSites(JNIEnv* env, jclass type,
+                                          jboolean enable) noexcept;
+_C_INTERFACE_ jobjectArray JNICALL //
+Java_ndcam_CameraModel_GetResourceSites(JNIEnv* env, jclass type) noexcept;
+
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_CameraModel_SetRecovery(JNIEnv* env, jclass type,
+                                   jboolean enable) noexcept;
+_C_INTERFACE_ jlongArray JNICALL //
+Java_ndcam_Device_incidents(JNIEnv* env, jobject instance) noexcept;
+_C_INTERFACE_ jlongArray JNICALL //
+Java_ndcam_Device_planStreams(JNIEnv* env, jobject instance,
+                              jlongArray requirements) noexcept;
+
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_CameraModel_SetProfiling(JNIEnv* env, jclass type,
+                                    jboolean enable) noexcept;
+_C_INTERFACE_ jstring JNICALL //
+Java_ndcam_CameraModel_GetProfile(JNIEnv* env, jclass type) noexcept;
+
+_C_INTERFACE_ jlong JNICALL //
+Java_ndcam_EventChannel_create(JNIEnv* env, jclass type,
+                               jint capacity) noexcept;
+_C_INTERFACE_ jobject JNICALL //
+Java_ndcam_EventChannel_buffer(JNIEnv* env, jclass type, jlong handle) noexcept;
+_C_INTERFACE_ jint JNICALL //
+Java_ndcam_EventChannel_poll(JNIEnv* env, jclass type, jlong handle,
+                             jint consumed) noexcept;
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_EventChannel_attach(JNIEnv* env, jclass type, jlong handle) noexcept;
+_C_INTERFACE_ void JNICALL //
+Java_ndcam_EventChannel_destroy(JNIEnv* env, jclass type,
+                                jlong handle) noexcept;
+
 #endif // JNI_ADAPTER_H
@@ -0,0 +1,81 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.media.Image;
+import android.media.ImageReader;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.Timeout;
+import org.junit.runner.RunWith;
+
+import java.util.concurrent.TimeUnit;
+
+/**
+ * The recovery engine must not disturb the normal operations of the device.
+ * Disconnects can't be injected on the device. See test/recovery_test.cpp
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class DeviceRecoveryTest extends CameraModelTest {
+    @Rule
+    public Timeout timeout = new Timeout(30, TimeUnit.SECONDS);
+
+    ImageReader reader;
+    Device camera;
+
+    @Before
+    public void CreateImageReader() {
+        reader = ImageReader.newInstance(1280, 720, ImageFormat.YUV_420_888, 4);
+        Assert.assertNotNull(reader);
+    }
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        CameraModel.SetRecovery(true);
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+    }
+
+    @After
+    public void CloseReaderAndDevice() throws Exception {
+        camera.close();
+        CameraModel.SetRecovery(false);
+        reader.close();
+        // wait for camera framework to stop completely
+        Thread.sleep(500);
+    }
+
+    @Test
+    public void NoIncidentForNormalOperations() throws Exception {
+        final int count = camera.incidents().length;
+        Assert.assertEquals(0, count % Device.INCIDENT_FIELD_COUNT);
+
+        camera.repeat(reader.getSurface());
+        Thread.sleep(300);
+        Image image = null;
+        while ((image = reader.acquireNextImage()) != null)
+            image.close();
+        camera.stopRepeat();
+        camera.close();
+
+        long[] incidents = camera.incidents();
+        for (int i = 0; i < incidents.length; i += Device.INCIDENT_FIELD_COUNT)
+            Log.i("ndk_camera", "incident error " + incidents[i + Device.INCIDENT_ERROR]
+                    + " attempts " + incidents[i + Device.INCIDENT_ATTEMPTS]);
+        Assert.assertEquals(count, incidents.length);
+    }
+}
@@ -0,0 +1,100 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.media.Image;
+import android.media.ImageReader;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.Timeout;
+import org.junit.runner.RunWith;
+
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Drain the capture events of a repeating request in batch
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class EventChannelTest extends CameraModelTest {
+    @Rule
+    public Timeout timeout = new Timeout(30, TimeUnit.SECONDS);
+
+    ImageReader reader;
+    Device camera;
+    EventChannel channel;
+
+    @Before
+    public void CreateImageReader() {
+        reader = ImageReader.newInstance(1280, 720, ImageFormat.YUV_420_888, 4);
+        Assert.assertNotNull(reader);
+    }
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+        channel = new EventChannel(256);
+    }
+
+    @After
+    public void CloseReaderAndDevice() throws Exception {
+        camera.close();
+        reader.close();
+        // wait for camera framework to stop completely
+        Thread.sleep(500);
+        channel.close();
+    }
+
+    void DrainReader() {
+        Image image = null;
+        while ((image = reader.acquireNextImage()) != null)
+            image.close();
+    }
+
+    @Test
+    public void DrainRepeatingEvents() throws Exception {
+        final long[] counts = new long[5];
+        final long[] lastTimestamp = {0};
+        EventChannel.Listener listener = (EventChannel.Event event) -> {
+            Assert.assertEquals(camera.id, event.device);
+            counts[event.type] += 1;
+            if (event.type != EventChannel.TYPE_COMPLETED)
+                return;
+            // completed in order for a single repeating request
+            Assert.assertTrue(event.timestamp > lastTimestamp[0]);
+            lastTimestamp[0] = event.timestamp;
+        };
+
+        camera.repeat(reader.getSurface());
+        int batches = 0;
+        for (int i = 0; i < 100; ++i) {
+            Thread.sleep(20);
+            DrainReader();
+            if (channel.drain(listener) > 0)
+                batches += 1;
+        }
+        camera.stopRepeat();
+        DrainReader();
+
+        Log.i("ndk_camera", String.format("batches %d started %d completed %d failed %d lost %d dropped %d",
+                batches, counts[EventChannel.TYPE_STARTED], counts[EventChannel.TYPE_COMPLETED],
+                counts[EventChannel.TYPE_FAILED], counts[EventChannel.TYPE_BUFFER_LOST], channel.dropped()));
+        Assert.assertTrue(counts[EventChannel.TYPE_COMPLETED] > 0);
+        Assert.assertTrue(counts[EventChannel.TYPE_STARTED] >= counts[EventChannel.TYPE_COMPLETED]);
+        Assert.assertEquals(0, channel.dropped());
+    }
+}
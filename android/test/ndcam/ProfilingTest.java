@@ -0,0 +1,78 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.media.Image;
+import android.media.ImageReader;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.Timeout;
+import org.junit.runner.RunWith;
+
+import java.util.concurrent.TimeUnit;
+
+/**
+ * The stages of the device must be in the profile. The hardware counters may
+ * not be allowed on the device. See test/perf_test.cpp
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class ProfilingTest extends CameraModelTest {
+    @Rule
+    public Timeout timeout = new Timeout(30, TimeUnit.SECONDS);
+
+    ImageReader reader;
+    Device camera;
+
+    @Before
+    public void CreateImageReader() {
+        reader = ImageReader.newInstance(1280, 720, ImageFormat.YUV_420_888, 4);
+        Assert.assertNotNull(reader);
+    }
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        CameraModel.SetProfiling(true);
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+    }
+
+    @After
+    public void CloseReaderAndDevice() throws Exception {
+        camera.close();
+        CameraModel.SetProfiling(false);
+        reader.close();
+        // wait for camera framework to stop completely
+        Thread.sleep(500);
+    }
+
+    @Test
+    public void StagesOfRepeat() throws Exception {
+        camera.repeat(reader.getSurface());
+        Thread.sleep(300);
+        Image image = null;
+        while ((image = reader.acquireNextImage()) != null)
+            image.close();
+        camera.stopRepeat();
+
+        String profile = CameraModel.GetProfile();
+        Log.i("ndk_camera", profile);
+        Assert.assertTrue(profile.startsWith("{\"stages\":["));
+        Assert.assertTrue(profile.contains("\"name\":\"open_device\""));
+        Assert.assertTrue(profile.contains("\"name\":\"start_repeat\""));
+        Assert.assertTrue(profile.contains("\"name\":\"capture_completed\""));
+    }
+}
@@ -0,0 +1,112 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.media.Image;
+import android.media.ImageReader;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.Timeout;
+import org.junit.runner.RunWith;
+
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Requests and sessions must be released after each operation of the device
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class ResourceAccountingTest extends CameraModelTest {
+    @Rule
+    public Timeout timeout = new Timeout(30, TimeUnit.SECONDS);
+
+    ImageReader reader;
+    Device camera;
+
+    @Before
+    public void CreateImageReader() {
+        reader = ImageReader.newInstance(1280, 720, ImageFormat.YUV_420_888, 4);
+        Assert.assertNotNull(reader);
+    }
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+        CameraModel.TrackResourceSites(true);
+    }
+
+    @After
+    public void CloseReaderAndDevice() throws Exception {
+        CameraModel.TrackResourceSites(false);
+        camera.close();
+        reader.close();
+        // wait for camera framework to stop completely
+        Thread.sleep(500);
+    }
+
+    void DrainReader() {
+        Image image = null;
+        while ((image = reader.acquireNextImage()) != null)
+            image.close();
+    }
+
+    @Test
+    public void RepeatAndCaptureReleaseAll() throws Exception {
+        final long requests = camera.resources(Device.RESOURCE_CAPTURE_REQUEST)[Device.STAT_TOTAL];
+        final long sessions = camera.resources(Device.RESOURCE_CAPTURE_SESSION)[Device.STAT_TOTAL];
+
+        camera.prewarm();
+        // the preview request belongs to the device
+        Assert.assertEquals(1, camera.resources(Device.RESOURCE_CAPTURE_REQUEST)[Device.STAT_LIVE]);
+        Assert.assertTrue(CameraModel.GetResourceSites().length > 0);
+
+        camera.repeat(reader.getSurface());
+        Thread.sleep(300);
+        DrainReader();
+        Assert.assertEquals(1, camera.resources(Device.RESOURCE_CAPTURE_SESSION)[Device.STAT_LIVE]);
+        camera.stopRepeat();
+        DrainReader();
+        Assert.assertEquals(0, camera.resources(Device.RESOURCE_CAPTURE_SESSION)[Device.STAT_LIVE]);
+
+        camera.capture(reader.getSurface());
+        Thread.sleep(300);
+        DrainReader();
+        camera.stopCapture();
+        camera.close();
+
+        for (String site : CameraModel.GetResourceSites())
+            Log.i("ndk_camera", site);
+        long[] request = camera.resources(Device.RESOURCE_CAPTURE_REQUEST);
+        long[] session = camera.resources(Device.RESOURCE_CAPTURE_SESSION);
+        Assert.assertEquals(0, request[Device.STAT_LIVE]);
+        Assert.assertEquals(0, session[Device.STAT_LIVE]);
+        // preview + still capture
+        Assert.assertEquals(requests + 2, request[Device.STAT_TOTAL]);
+        Assert.assertEquals(sessions + 2, session[Device.STAT_TOTAL]);
+        Assert.assertTrue(session[Device.STAT_PEAK_LIVE] >= 1);
+    }
+
+    @Test
+    public void UnknownResourceType() {
+        try {
+            camera.resources(-1);
+            Assert.fail("IllegalArgumentException is expected");
+        } catch (IllegalArgumentException e) {
+            Assert.assertNotNull(e.getMessage());
+        }
+    }
+}
@@ -0,0 +1,151 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.media.Image;
+import android.media.ImageReader;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.Timeout;
+import org.junit.runner.RunWith;
+
+import java.util.Arrays;
+import java.util.concurrent.TimeUnit;
+
+/**
+ * Time-to-first-frame benchmark. Compare cold start with prewarmed start and
+ * print each step of {@link Device#timing()}
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class StartupLatencyTest extends CameraModelTest {
+    @Rule
+    public Timeout timeout = new Timeout(120, TimeUnit.SECONDS);
+
+    static final int iteration = 5;
+
+    ImageReader reader;
+    Device camera;
+
+    @Before
+    public void CreateImageReader() {
+        reader = ImageReader.newInstance(1920, 1080, ImageFormat.YUV_420_888, 4);
+        Assert.assertNotNull(reader);
+    }
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+    }
+
+    @After
+    public void CloseReaderAndDevice() throws Exception {
+        camera.close();
+        reader.close();
+        // wait for camera framework to stop completely
+        Thread.sleep(500);
+    }
+
+    /**
+     * @return time points after the first frame. null if timeout
+     */
+    long[] WaitForFirstFrame() throws Exception {
+        for (int i = 0; i < 2000; ++i) {
+            long[] timing = camera.timing();
+            Assert.assertNotNull(timing);
+            if (timing[Device.TIMING_FIRST_FRAME] != 0)
+                return timing;
+            Thread.sleep(1);
+        }
+        return null;
+    }
+
+    /**
+     * Release images of the last iteration. Otherwise the reader can't accept
+     * the next frame
+     */
+    void DrainReader() {
+        Image image = null;
+        while ((image = reader.acquireNextImage()) != null)
+            image.close();
+    }
+
+    static long Millis(long begin, long end) {
+        return TimeUnit.NANOSECONDS.toMillis(end - begin);
+    }
+
+    /**
+     * @return milliseconds from the surface to the first frame
+     */
+    static long Report(String label, long[] t) {
+        // if prewarmed, the request is ready before the surface
+        long sessionBegin = Math.max(t[Device.TIMING_SURFACE_BEGIN], t[Device.TIMING_REQUEST_END]);
+        Log.i("ndk_camera", String.format("%s open %d request %d session %d repeat %d first-frame %d (surface->frame %d)",
+                label, Millis(t[Device.TIMING_OPEN_BEGIN], t[Device.TIMING_OPEN_END]),
+                Millis(t[Device.TIMING_REQUEST_BEGIN], t[Device.TIMING_REQUEST_END]),
+                Millis(sessionBegin, t[Device.TIMING_SESSION_END]),
+                Millis(t[Device.TIMING_SESSION_END], t[Device.TIMING_REPEAT_END]),
+                Millis(t[Device.TIMING_REPEAT_END], t[Device.TIMING_FIRST_FRAME]),
+                Millis(t[Device.TIMING_SURFACE_BEGIN], t[Device.TIMING_FIRST_FRAME])));
+        return Millis(t[Device.TIMING_SURFACE_BEGIN], t[Device.TIMING_FIRST_FRAME]);
+    }
+
+    static long Median(long[] values) {
+        long[] sorted = values.clone();
+        Arrays.sort(sorted);
+        return sorted[sorted.length / 2];
+    }
+
+    @Test
+    public void ColdStart() throws Exception {
+        long[] latency = new long[iteration];
+        for (int i = 0; i < iteration; ++i) {
+            camera.close();
+            camera.repeat(reader.getSurface());
+
+            long[] timing = WaitForFirstFrame();
+            Assert.assertNotNull(timing);
+            camera.stopRepeat();
+            DrainReader();
+
+            latency[i] = Report("cold", timing);
+        }
+        Log.i("ndk_camera", String.format("cold surface->frame median %d ms", Median(latency)));
+    }
+
+    @Test
+    public void PrewarmedStart() throws Exception {
+        long[] latency = new long[iteration];
+        for (int i = 0; i < iteration; ++i) {
+            camera.close();
+            camera.prewarm();
+            // UI is inflating ...
+            Thread.sleep(300);
+            camera.repeat(reader.getSurface());
+
+            long[] timing = WaitForFirstFrame();
+            Assert.assertNotNull(timing);
+            camera.stopRepeat();
+            DrainReader();
+
+            // open and request must be done before the surface
+            Assert.assertTrue(timing[Device.TIMING_REQUEST_END] <= timing[Device.TIMING_SURFACE_BEGIN]);
+            latency[i] = Report("prewarm", timing);
+        }
+        Log.i("ndk_camera", String.format("prewarm surface->frame median %d ms", Median(latency)));
+    }
+}
@@ -0,0 +1,63 @@
+package ndcam;
+
+import android.graphics.ImageFormat;
+import android.hardware.camera2.CameraCharacteristics;
+import android.support.test.runner.AndroidJUnit4;
+import android.util.Log;
+
+import junit.framework.Assert;
+
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * The plan must follow the requirements or explain why it can't.
+ * See test/stream_test.cpp for the combinations of each hardware level
+ *
+ * @author luncliff@gmail.com
+ */
+@RunWith(AndroidJUnit4.class)
+public class StreamPlanTest extends CameraModelTest {
+    Device camera;
+
+    @Before
+    public void AcquireDevice() {
+        CameraModel.Init();
+        camera = null;
+        for (Device device : CameraModel.GetDevices())
+            if (device.facing() == CameraCharacteristics.LENS_FACING_BACK)
+                camera = device;
+
+        Assert.assertNotNull(camera);
+    }
+
+    @Test
+    public void PreviewAnalysisStill() {
+        long[] requirements = {
+                ImageFormat.PRIVATE, 1280, 720, 0, Device.STREAM_REPEATING,
+                ImageFormat.YUV_420_888, 640, 480, 0, Device.STREAM_REPEATING,
+                ImageFormat.JPEG, 0, 0, 0, Device.STREAM_LARGEST,
+        };
+        long[] plan = camera.planStreams(requirements);
+        Assert.assertEquals(3 * 2 + 2, plan.length);
+        Assert.assertTrue(plan[0] >= 1280 && plan[1] >= 720);
+        Assert.assertTrue(plan[2] >= 640 && plan[3] >= 480);
+        Log.i("ndk_camera", "JPEG " + plan[4] + "x" + plan[5] + " frame " + plan[6] + " still " + plan[7]);
+        Assert.assertTrue(plan[7] >= plan[6]);
+    }
+
+    @Test
+    public void TooLargeIsExplained() {
+        long[] requirements = {
+                ImageFormat.YUV_420_888, 100000, 100000, 0, Device.STREAM_REPEATING,
+        };
+        try {
+            camera.planStreams(requirements);
+            Assert.fail("no size is that large");
+        } catch (IllegalArgumentException e) {
+            Log.i("ndk_camera", e.getMessage());
+            Assert.assertTrue(e.getMessage().contains("stream 0"));
+        }
+    }
+}
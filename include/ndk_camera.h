@@ -8,6 +8,10 @@
 
 #include <gsl/gsl>
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
 #include <android/hardware_buffer.h>
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
@@ -36,6 +40,86 @@ using capture_request_ptr =
 using camera_output_target_ptr =
     std::unique_ptr<ACameraOutputTarget, void (*)(ACameraOutputTarget*)>;
 
+class frame_synchronizer_t; // <ndk_camera_sync.h>
+class motion_gate_t;        // <ndk_camera_motion.h>
+class frame_statistics_t;   // <ndk_camera_stats.h>
+class event_channel_t;      // <ndk_camera_event.h>
+class resource_tracker_t;   // <ndk_camera_resource.h>
+class recovery_engine_t;    // <ndk_camera_recovery.h>
+class preevent_ring_t;      // <ndk_camera_preevent.h>
+class frame_publisher_t;    // <ndk_camera_share.h>
+class camera_executor_t;    // <ndk_camera_executor.h>
+class clock_model_t;        // <ndk_camera_clock.h>
+
+/**
+ * Time points of the steps before the first frame of `start_repeat`.
+ * The unit is nanosecond of steady clock. Zero if the step is not reached.
+ *
+ * If the device is prepared with `prewarm`, the open/request steps are done
+ * before `surface_begin`
+ */
+struct startup_timing_t final {
+    int64_t open_begin = 0; // ACameraManager_openCamera
+    int64_t open_end = 0;
+    int64_t request_begin = 0; // ACameraDevice_createCaptureRequest
+    int64_t request_end = 0;
+    int64_t surface_begin = 0; // `start_repeat` with the output surface
+    int64_t session_end = 0;   // ACameraDevice_createCaptureSession
+    int64_t repeat_end = 0;    // ACameraCaptureSession_setRepeatingRequest
+    // written by the camera's callback thread (onCaptureStarted)
+    std::atomic<int64_t> first_frame{};
+
+  public:
+    static int64_t now() noexcept {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(
+                   steady_clock::now().time_since_epoch())
+            .count();
+    }
+    void reset() noexcept {
+        open_begin = open_end = 0;
+        request_begin = request_end = 0;
+        surface_begin = session_end = repeat_end = 0;
+        first_frame = 0;
+    }
+};
+
+/**
+ * Key metadata of `onCaptureCompleted`. Zero if the entry is not in the result
+ */
+struct capture_result_t final {
+    uint16_t id;
+    int64_t timestamp;      // ACAMERA_SENSOR_TIMESTAMP
+    int64_t exposure_time;  // ACAMERA_SENSOR_EXPOSURE_TIME
+    int64_t frame_duration; // ACAMERA_SENSOR_FRAME_DURATION
+    int32_t sensitivity;    // ACAMERA_SENSOR_SENSITIVITY
+    // the timestamp in the domain of `camera_group_t::clock_set`. its
+    // confidence is 0 without the clock model
+    int64_t mapped_timestamp;
+    float confidence;
+};
+
+/**
+ * Result of the library's analysis for an image of the analysis reader
+ */
+struct frame_info_t final {
+    uint16_t id;
+    int64_t timestamp; // AImage_getTimestamp
+    bool motion;       // false if the motion gate considers it as static
+    // the timestamp in the domain of `camera_group_t::clock_set`. its
+    // confidence is 0 without the clock model
+    int64_t mapped_timestamp;
+    float confidence;
+};
+
+/**
+ * Receives the image from the analysis reader.
+ * The consumer owns the image and must free it with `release_image`
+ * (<ndk_camera_resource.h>)
+ */
+using image_consumer_t = void (*)(void* context, AImage* image,
+                                  const frame_info_t& info);
+
 /**
  * Library context. Supports auto releasing and facade for features
  *
@@ -62,14 +146,84 @@ struct camera_group_t final {
     // device, we will consider multiple camera are working concurrently.
     //
     // if element is nullptr, it means the device is not open.
-    std::array<ACameraDevice*, max_camera_count> device_set{};
+    // the callbacks find the device with the handle(`get_id`) while the
+    // operations replace it, so the slots are atomic
+    std::array<std::atomic<ACameraDevice*>, max_camera_count> device_set{};
 
     // if there is no session, session pointer will be null
-    std::array<ACameraCaptureSession*, max_camera_count> session_set{};
+    std::array<std::atomic<ACameraCaptureSession*>, max_camera_count>
+        session_set{};
 
     // sequence number from capture session
     std::array<int, max_camera_count> seq_id_set{};
 
+    // preview request prepared before the session. see `prewarm`
+    // if element is nullptr, `start_repeat` will create a new one
+    std::array<ACaptureRequest*, max_camera_count> repeat_request_set{};
+
+    // time-to-first-frame breakdown of the last `start_repeat`
+    std::array<startup_timing_t, max_camera_count> timing_set{};
+
+    // serializes the operations of each device. the operations call each
+    // other(`prewarm` -> `open_device`), so it's recursive. hold it to make a
+    // sequence of them atomic
+    std::array<std::recursive_mutex, max_camera_count> operation_mtx_set{};
+
+    // if not null, completed captures are paired across the devices.
+    // the context doesn't own the synchronizer
+    frame_synchronizer_t* synchronizer = nullptr;
+
+    // if not null, capture events of all devices are pushed to the channel.
+    // the context doesn't own the channel. see `detach_event_channel`
+    std::atomic<event_channel_t*> event_channel{};
+    // callbacks which are pushing to the channel. counted in 2 epochs so the
+    // new pushers don't delay the detach
+    std::atomic<uint32_t> event_epoch{};
+    std::array<std::atomic<uint32_t>, 2> event_pushers{};
+
+    // analysis output of `start_repeat`. see `open_reader`
+    // if element is nullptr, only the given window is used
+    std::array<std::atomic<AImageReader*>, max_camera_count> reader_set{};
+    // image listeners which are using the reader. `close_reader` waits for
+    // them after it clears the slot
+    std::array<std::atomic<uint32_t>, max_camera_count> listener_set{};
+
+    // if not null, the images of the analysis reader are gated with motion.
+    // the context doesn't own the gates
+    std::array<motion_gate_t*, max_camera_count> motion_gate_set{};
+
+    // if not null, statistics of the analysis images are computed and
+    // published with the capture results. the frames dropped by the motion
+    // gate are computed too. the context doesn't own them
+    std::array<frame_statistics_t*, max_camera_count> statistics_set{};
+    // if not null, the analysis images are compressed into the ring for the
+    // retroactive recording. the context doesn't own them
+    std::array<preevent_ring_t*, max_camera_count> preevent_set{};
+    // if not null, the analysis images and their capture results are
+    // published to the other processes. the context doesn't own them
+    std::array<frame_publisher_t*, max_camera_count> publisher_set{};
+
+    // if not null, the sensor timestamps are mapped to its clock domain with
+    // the arrival of the capture callbacks. the context doesn't own them
+    std::array<clock_model_t*, max_camera_count> clock_set{};
+
+    // if not null, the images, requests and sessions are accounted for each
+    // device. the context doesn't own the tracker
+    resource_tracker_t* resources = nullptr;
+
+    // if not null, the devices are reopened after the disconnect/error and
+    // their repeating requests are restored. the context doesn't own it
+    recovery_engine_t* recovery = nullptr;
+
+    // if not null, the analysis and the consumer of the images run in its
+    // dispatch lane instead of the image listener thread. the lane must have
+    // 1 thread to keep the order. the context doesn't own the executor
+    camera_executor_t* executor = nullptr;
+
+    // if null, the images are released after the analysis
+    image_consumer_t image_consumer = nullptr;
+    void* image_consumer_context = nullptr;
+
   public:
     camera_group_t() noexcept = default;
     // copy-move is disabled
@@ -92,6 +246,13 @@ struct camera_group_t final {
     // Notice that this routine doesn't free metadata
     void close_device(uint16_t id) noexcept;
 
+    // Open the device(if not opened) and prepare the preview request so that
+    // `start_repeat` only has to create the session when the surface is ready.
+    // It can run in the other thread. `start_repeat` waits for it
+    auto prewarm(uint16_t id, ACameraDevice_StateCallbacks& callbacks) noexcept
+        -> camera_status_t;
+    auto prepare_repeat(uint16_t id) noexcept -> camera_status_t;
+
     auto start_repeat(
         uint16_t id, ANativeWindow* window,
         ACameraCaptureSession_stateCallbacks& on_session_changed,
@@ -106,10 +267,28 @@ struct camera_group_t final {
         -> camera_status_t;
     void stop_capture(uint16_t id) noexcept;
 
+    // Create an image reader which will be added to the repeating request.
+    // Its images are delivered to `context_on_image_available`. The previous
+    // reader is closed like `close_reader`
+    auto open_reader(uint16_t id, int32_t width, int32_t height, int32_t format,
+                     int32_t max_images) noexcept -> media_status_t;
+    // Stop the listener and free the reader after the images in the dispatch
+    // lane are consumed. Refused in the dispatch lane since it can't wait for
+    // itself
+    void close_reader(uint16_t id) noexcept;
+
     // ACAMERA_LENS_FACING_FRONT
     // ACAMERA_LENS_FACING_BACK
     // ACAMERA_LENS_FACING_EXTERNAL
     uint16_t get_facing(uint16_t id) noexcept;
+    // ACAMERA_SENSOR_ORIENTATION. 0, 90, 180, 270
+    int32_t get_sensor_orientation(uint16_t id) noexcept;
+
+    // find the device which owns the session.
+    // returns `max_camera_count` if there is no such device
+    uint16_t get_id(const ACameraDevice* device) const noexcept;
+    uint16_t get_id(const ACameraCaptureSession* session) const noexcept;
+    uint16_t get_id(const AImageReader* reader) const noexcept;
 };
 
 // device callbacks
@@ -168,6 +347,16 @@ void context_on_capture_sequence_complete(camera_group_t& context,
                                           int sequence_id,
                                           int64_t frame_number) noexcept;
 
+// image reader callbacks
+
+void context_on_image_available(camera_group_t& context,
+                                AImageReader* reader) noexcept;
+
+// metadata - ACAMERA_SENSOR_TIMESTAMP is required. the others are optional
+
+auto read_capture_result(uint16_t id, const ACameraMetadata* result,
+                         capture_result_t& output) noexcept -> camera_status_t;
+
 // status - error code to string
 
 auto camera_error_message(camera_status_t status) noexcept -> const char*;
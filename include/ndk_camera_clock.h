@@ -0,0 +1,129 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_CLOCK_H_
+#define _NDCAM_INCLUDE_CLOCK_H_
+
+#include <ndk_camera.h>
+
+#include <mutex>
+
+enum class clock_domain_t : uint8_t {
+    monotonic = 0, // CLOCK_MONOTONIC. std::chrono::steady_clock
+    boottime = 1,  // CLOCK_BOOTTIME. SystemClock.elapsedRealtimeNanos
+};
+
+// nanosecond of the clock
+auto get_clock_time(clock_domain_t domain) noexcept -> int64_t;
+
+struct clock_model_config_t final {
+    clock_domain_t domain = clock_domain_t::monotonic;
+    // callbacks for a point of the regression. the one with the least delay
+    // is taken, so the others' latency is filtered out
+    uint32_t block = 8;
+    // points of the regression. up to `clock_model_t::max_point_count`.
+    // more points give the longer baseline to the drift
+    uint32_t points = 16;
+    // nanosecond. jitter of the points which makes the confidence 0.5.
+    // the points off the line by 16 times of it reset the model
+    int64_t tolerance = 1'000'000;
+};
+
+struct clock_state_t final {
+    uint8_t source;    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_*
+    int64_t offset;    // domain - sensor at the reference
+    int64_t reference; // sensor timestamp of the last point
+    double drift;      // nanosecond of the domain per sensor's, minus 1
+    int64_t residual;  // RMS of the points from the line
+    int64_t latency;   // average delay of the callbacks from the line
+    uint32_t points;   // in the regression
+    uint64_t observed; // `update` since the reset
+    uint32_t resets;   // by the clock jump or the timestamp going back
+    float confidence;  // 0 ~ 1
+};
+
+/**
+ * Maps the sensor timestamps of a device into the clock domain.
+ *
+ * `ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME` is CLOCK_BOOTTIME, so the
+ * mapping is exact. For `UNKNOWN` the offset and the drift are estimated with
+ * the arrival of the callbacks. A callback arrives after the sensor
+ * timestamp with some delay, so the least delay of each block makes a point
+ * of the lower envelope, and the least squares line of the points is the
+ * model. The least delay of the callbacks remains in the offset, so it is the
+ * earliest time the frame could be known.
+ *
+ * Set the model as `camera_group_t::clock_set` to update it with the capture
+ * callbacks. Then the frames have the mapped timestamp and the confidence.
+ * For `frame_synchronizer_t`, `set_offset` with the offset of the models
+ * aligns the `UNKNOWN` streams.
+ */
+class clock_model_t final {
+  public:
+    static constexpr auto max_point_count = 32;
+
+  private:
+    struct point_t final {
+        int64_t sensor;
+        int64_t delay; // arrival - sensor
+    };
+
+    clock_model_config_t config;
+    mutable std::mutex mtx{};
+    uint8_t source = ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN;
+    // the block in progress
+    point_t least{};
+    uint32_t count = 0;
+    int64_t delay_sum = 0;
+    int64_t last_sensor = 0;
+    // blocks above the line in a row. a stall or the clock jump
+    uint32_t outliers = 0;
+    // ring of the points. ordered by the sensor timestamp
+    std::array<point_t, max_point_count> points{};
+    uint32_t head = 0;
+    uint32_t point_count = 0;
+    clock_state_t state{};
+
+  public:
+    explicit clock_model_t(const clock_model_config_t& config) noexcept;
+    clock_model_t(const clock_model_t&) = delete;
+    clock_model_t(clock_model_t&&) = delete;
+    clock_model_t& operator=(const clock_model_t&) = delete;
+    clock_model_t& operator=(clock_model_t&&) = delete;
+    ~clock_model_t() noexcept = default;
+
+  public:
+    // `ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE` in the characteristics
+    auto set_source(const ACameraMetadata* characteristics) noexcept
+        -> camera_status_t;
+    void set_source(uint8_t source) noexcept;
+
+    // a callback with the timestamp arrived now
+    void update(int64_t sensor_timestamp) noexcept;
+    // `arrival` is the time of the domain
+    void update(int64_t sensor_timestamp, int64_t arrival) noexcept;
+
+    /**
+     * The timestamp in the domain.
+     * @param confidence 0 if there is no estimation yet. Then the timestamp
+     *                   is returned as it is
+     */
+    auto map(int64_t sensor_timestamp, float& confidence) const noexcept
+        -> int64_t;
+
+    // drop the points. the source is kept
+    void reset() noexcept;
+    auto get_state() const noexcept -> clock_state_t;
+    auto get_config() const noexcept -> const clock_model_config_t& {
+        return config;
+    }
+
+  private:
+    void clear() noexcept;
+    void add_block() noexcept;
+    void fit() noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_CLOCK_H_
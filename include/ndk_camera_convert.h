@@ -0,0 +1,101 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_CONVERT_H_
+#define _NDCAM_INCLUDE_CONVERT_H_
+
+#include <ndk_camera_frame.h>
+
+/**
+ * Planes of YUV_420_888. The chroma planes can be planar(pixel stride 1) or
+ * interleaved(pixel stride 2, NV12/NV21)
+ */
+struct yuv_planes_t final {
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    uint32_t y_row_stride;
+    uint32_t uv_row_stride;
+    uint32_t uv_pixel_stride;
+    uint32_t width, height;
+};
+
+// fill the planes with YUV_420_888 image
+auto get_yuv_planes(const AImage* image, yuv_planes_t& planes) noexcept
+    -> media_status_t;
+/**
+ * The luma of the frame must be packed.
+ * Use the `frame_view_t` overloads below for the subsampled frames
+ */
+auto get_yuv_planes(const frame_view_t& frame, yuv_planes_t& planes) noexcept
+    -> media_status_t;
+
+/**
+ * Clockwise rotation, and then horizontal mirroring which makes the image
+ * upright for the viewer
+ */
+struct frame_orientation_t final {
+    uint16_t rotation; // 0, 90, 180, 270
+    bool mirror;
+};
+
+/**
+ * @param facing             ACAMERA_LENS_FACING_*
+ * @param sensor_orientation ACAMERA_SENSOR_ORIENTATION
+ * @param device_orientation clockwise degree of the device from its natural
+ *                           orientation. rounded to 90
+ * @see https://developer.android.com/reference/android/hardware/camera2/CaptureRequest#JPEG_ORIENTATION
+ */
+auto get_orientation(uint16_t facing, int32_t sensor_orientation,
+                     int32_t device_orientation) noexcept
+    -> frame_orientation_t;
+auto get_orientation(camera_group_t& context, uint16_t id,
+                     int32_t device_orientation) noexcept
+    -> frame_orientation_t;
+
+// size of the image after the rotation
+void get_oriented_size(uint32_t width, uint32_t height,
+                       frame_orientation_t orientation, uint32_t& out_width,
+                       uint32_t& out_height) noexcept;
+
+/**
+ * YUV(BT.601 full range) to RGBA with the rotation/mirroring in the same pass.
+ * 90/270 rotations are done with 32x32 tiles so the destination lines are
+ * written in the cache.
+ * `dst` must be large enough for `get_oriented_size`.
+ * `dst_row_stride` is in bytes and a multiple of 4
+ */
+void convert_yuv_to_rgba(const yuv_planes_t& src, uint8_t* dst,
+                         uint32_t dst_row_stride,
+                         frame_orientation_t orientation) noexcept;
+// the packed frame uses the tiled conversion. the others are sampled 1 by 1
+void convert_yuv_to_rgba(const frame_view_t& src, uint8_t* dst,
+                         uint32_t dst_row_stride,
+                         frame_orientation_t orientation) noexcept;
+
+/**
+ * Nearest-neighbor resize of YUV to RGBA with the rotation/mirroring.
+ * `dst_width` and `dst_height` are the size after the rotation
+ */
+void resize_yuv_to_rgba(const yuv_planes_t& src, uint8_t* dst,
+                        uint32_t dst_width, uint32_t dst_height,
+                        uint32_t dst_row_stride,
+                        frame_orientation_t orientation) noexcept;
+void resize_yuv_to_rgba(const frame_view_t& src, uint8_t* dst,
+                        uint32_t dst_width, uint32_t dst_height,
+                        uint32_t dst_row_stride,
+                        frame_orientation_t orientation) noexcept;
+
+// Nearest-neighbor resize of 1 channel plane with the rotation/mirroring
+void resize_plane(const uint8_t* src, uint32_t src_row_stride,
+                  uint32_t src_width, uint32_t src_height, uint8_t* dst,
+                  uint32_t dst_width, uint32_t dst_height,
+                  uint32_t dst_row_stride,
+                  frame_orientation_t orientation) noexcept;
+void resize_plane(const plane_view_t& src, uint8_t* dst, uint32_t dst_width,
+                  uint32_t dst_height, uint32_t dst_row_stride,
+                  frame_orientation_t orientation) noexcept;
+
+#endif // _NDCAM_INCLUDE_CONVERT_H_
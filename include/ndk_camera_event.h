@@ -0,0 +1,119 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_EVENT_H_
+#define _NDCAM_INCLUDE_EVENT_H_
+
+#include <ndk_camera.h>
+
+#include <mutex>
+
+// follow `EventChannel.TYPE_*`
+enum class capture_event_type_t : uint16_t {
+    started = 1,     // onCaptureStarted
+    completed = 2,   // onCaptureCompleted
+    failed = 3,      // onCaptureFailed
+    buffer_lost = 4, // onCaptureBufferLost
+};
+
+/**
+ * Fixed size record of the event channel. Java reads it with the same offsets
+ * (`EventChannel.OFFSET_*`) in the native byte order
+ */
+struct capture_event_t final {
+    uint16_t type; // capture_event_type_t
+    uint16_t id;
+    int32_t sequence; // sequence id of the failure
+    int64_t frame_number;
+    // ACAMERA_SENSOR_TIMESTAMP. start of the exposure for `started`
+    int64_t timestamp;
+    int64_t exposure_time;
+    int64_t frame_duration;
+    int32_t sensitivity;
+    int16_t reason;   // ACameraCaptureFailure::reason
+    int16_t captured; // ACameraCaptureFailure::wasImageCaptured
+};
+static_assert(sizeof(capture_event_t) == 48, "layout is shared with Java");
+
+/**
+ * Ring buffer of capture events which can be wrapped with direct ByteBuffer.
+ * Camera callbacks push the records and 1 consumer drains them in batch.
+ * If the ring is full, the event is dropped and counted.
+ *
+ * Layout of the buffer
+ *  - [0, 4)     head. written by the producers
+ *  - [4, 8)     capacity. power of 2
+ *  - [8, 12)    number of dropped events
+ *  - [64, 68)   tail. written by the consumer
+ *  - [128, ...) records
+ */
+class event_channel_t final {
+  public:
+    static constexpr size_t header_size = 128;
+
+  private:
+    struct header_t final {
+        std::atomic<uint32_t> head;
+        uint32_t capacity;
+        std::atomic<uint32_t> dropped;
+        uint8_t padding[52];
+        std::atomic<uint32_t> tail;
+    };
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "");
+
+    std::unique_ptr<uint8_t[]> storage;
+    size_t length;
+    header_t* header;
+    capture_event_t* records;
+    std::mutex mtx{}; // between the producers
+
+  public:
+    // capacity is rounded up to power of 2 in [16, 65536].
+    // `size` is 0 if the allocation failed
+    explicit event_channel_t(uint32_t capacity) noexcept;
+    event_channel_t(const event_channel_t&) = delete;
+    event_channel_t(event_channel_t&&) = delete;
+    event_channel_t& operator=(const event_channel_t&) = delete;
+    event_channel_t& operator=(event_channel_t&&) = delete;
+    ~event_channel_t() noexcept = default;
+
+  public:
+    // false if the ring is full
+    bool push(const capture_event_t& event) noexcept;
+
+    /**
+     * Release `consumed` records from the tail, and then count the records
+     * which can be read from the new tail.
+     * Only 1 consumer can use this
+     */
+    uint32_t poll(uint32_t consumed) noexcept;
+    // copy and release the records. for the native consumer
+    uint32_t drain(gsl::span<capture_event_t> events) noexcept;
+
+    auto data() noexcept -> uint8_t* {
+        return storage.get();
+    }
+    auto size() const noexcept -> size_t {
+        return length;
+    }
+    uint32_t get_capacity() const noexcept;
+    uint32_t get_dropped() const noexcept;
+};
+
+/**
+ * Push the event to the channel of the context if there is one.
+ * For the camera callbacks
+ */
+void push_capture_event(camera_group_t& context,
+                        const capture_event_t& event) noexcept;
+
+/**
+ * Detach the channel if it's attached to the context. Returns after the
+ * callbacks stop pushing to it, so it can be deleted
+ */
+void detach_event_channel(camera_group_t& context,
+                          const event_channel_t* channel) noexcept;
+
+#endif // _NDCAM_INCLUDE_EVENT_H_
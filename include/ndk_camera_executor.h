@@ -0,0 +1,166 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_EXECUTOR_H_
+#define _NDCAM_INCLUDE_EXECUTOR_H_
+
+#include <ndk_camera.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// `little` is the slowest cluster. the others are `big`
+enum class core_class_t : uint8_t {
+    any = 0,
+    little = 1,
+    big = 2,
+};
+
+struct cpu_info_t final {
+    uint32_t cpu;
+    uint32_t max_freq; // kHz. cpufreq/cpuinfo_max_freq. 0 if unknown
+    core_class_t type;
+};
+
+struct cpu_topology_t final {
+    std::vector<cpu_info_t> cpus{};
+
+  public:
+    // CPUs of the class. all CPUs if there is no such one(same frequencies)
+    uint64_t get_mask(core_class_t type) const noexcept;
+};
+
+/**
+ * Read the present CPUs and their max frequency under `root`
+ * ("/sys/devices/system/cpu" on the device).
+ * @return false if the CPU list can't be read
+ */
+bool read_cpu_topology(const char* root, cpu_topology_t& topology) noexcept;
+
+enum class executor_lane_t : uint8_t {
+    dispatch = 0, // image consumer. see `camera_group_t::executor`
+    convert = 1,  // conversion and the analysis of the app
+    io = 2,       // file and network
+};
+static constexpr auto executor_lane_count = 3;
+
+struct executor_lane_config_t final {
+    // thread name is "{name}:{index}". truncated to 15 characters
+    const char* name;
+    // 0 to run the tasks in the thread of `submit`
+    uint32_t threads;
+    core_class_t cores;
+    uint64_t cpu_mask; // if not 0, overrides `cores`
+    int32_t nice;      // -20(highest) ~ 19. same with android.os.Process
+};
+
+struct executor_config_t final {
+    std::array<executor_lane_config_t, executor_lane_count> lanes{
+        executor_lane_config_t{"ndcam-disp", 1, core_class_t::big, 0, -4},
+        executor_lane_config_t{"ndcam-conv", 2, core_class_t::big, 0, -2},
+        executor_lane_config_t{"ndcam-io", 1, core_class_t::little, 0, 10},
+    };
+    const char* sysfs = "/sys/devices/system/cpu";
+};
+
+/**
+ * Per lane statistics. The times are nanosecond
+ */
+struct executor_stats_t final {
+    uint64_t tasks;  // finished
+    uint64_t queued; // waiting now
+    int64_t queue_delay_avg; // from `submit` to the start of the task
+    int64_t queue_delay_max;
+    // CPU changes of the threads between their tasks
+    uint64_t migrations;
+    // tasks started on the little cores
+    uint64_t little_tasks;
+    // sum of the threads. /proc/self/task/{tid}/schedstat
+    int64_t cpu_time;  // on the CPU
+    int64_t run_delay; // runnable but waiting in the kernel's run queue
+};
+
+using executor_task_t = std::function<void()>;
+
+/**
+ * Threads owned by the library. Each lane has its own queue and threads, which
+ * are pinned to the CPUs of its class with the priority.
+ *
+ * The threads apply their affinity/priority by themselves. If it fails(not
+ * permitted, offline CPU), the lane still works and the error is logged
+ */
+class camera_executor_t final {
+    struct worker_t final {
+        std::thread thread;
+        std::atomic<int32_t> tid{};
+        uint32_t last_cpu = UINT32_MAX; // used only by the thread
+    };
+    struct task_t final {
+        executor_task_t function;
+        int64_t submitted; // steady clock
+    };
+    struct lane_t final {
+        executor_lane_config_t config{};
+        uint64_t mask = 0; // CPU set of the threads. 0 for no affinity
+        std::mutex mtx{};
+        std::condition_variable cv{}, idle_cv{};
+        std::deque<task_t> tasks{};
+        uint32_t running = 0;
+        bool stopping = false;
+        std::vector<std::unique_ptr<worker_t>> workers{};
+        // with `mtx`
+        uint64_t finished = 0;
+        int64_t delay_sum = 0, delay_max = 0;
+        uint64_t migrations = 0, little_tasks = 0;
+    };
+
+    cpu_topology_t topology{};
+    uint64_t little_mask = 0;
+    std::array<lane_t, executor_lane_count> lanes{};
+
+  public:
+    explicit camera_executor_t(const executor_config_t& config) noexcept;
+    camera_executor_t(const camera_executor_t&) = delete;
+    camera_executor_t(camera_executor_t&&) = delete;
+    camera_executor_t& operator=(const camera_executor_t&) = delete;
+    camera_executor_t& operator=(camera_executor_t&&) = delete;
+    // the queued tasks are finished before the threads exit
+    ~camera_executor_t() noexcept;
+
+  public:
+    // false if the lane is stopping. then the task is not invoked
+    bool submit(executor_lane_t lane, executor_task_t task) noexcept;
+    // wait until the queue is empty and no task is running.
+    // the tasks of the lane must not call this for it
+    void drain(executor_lane_t lane) noexcept;
+    // true if the calling thread is a worker of the lane
+    bool is_current(executor_lane_t lane) const noexcept;
+
+    auto get_stats(executor_lane_t lane) noexcept -> executor_stats_t;
+    // CPU set of the lane's threads. 0 if they are not pinned
+    uint64_t get_mask(executor_lane_t lane) const noexcept;
+    auto get_topology() const noexcept -> const cpu_topology_t& {
+        return topology;
+    }
+
+  private:
+    void run(lane_t& lane, worker_t& worker, uint32_t index) noexcept;
+    void setup(lane_t& lane, worker_t& worker, uint32_t index) noexcept;
+};
+
+/**
+ * Call `task` with 0 ~ `count - 1` in the convert lane of the executor. If it
+ * is nullptr, a shared one with (CPU count - 1) threads is created in the
+ * first call. The calling thread takes the indices too, so it never waits for
+ * a task which is not started. Returns after all of them are done
+ */
+void parallel_for(camera_executor_t* executor, uint32_t count,
+                  const std::function<void(uint32_t)>& task) noexcept;
+
+#endif // _NDCAM_INCLUDE_EXECUTOR_H_
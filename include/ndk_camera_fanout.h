@@ -0,0 +1,131 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_FANOUT_H_
+#define _NDCAM_INCLUDE_FANOUT_H_
+
+#include <ndk_camera.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+struct fanout_subscriber_config_t final {
+    const char* name = "";
+    // bit N for the camera N
+    uint32_t camera_mask = UINT32_MAX;
+    // take 1 of N frames. 1 for all
+    uint32_t decimation = 1;
+    // nanosecond between the timestamps of the taken frames. 0 for no limit.
+    // 200'000'000 for 5 fps. a frame up to 1/4 of it early is taken, and the
+    // average rate is kept
+    int64_t min_interval = 0;
+    // frames waiting for `acquire`. the oldest is dropped for the new one.
+    // 1 for the latest only
+    uint32_t depth = 1;
+};
+
+/**
+ * The frame shared by the subscribers. The image is not copied and it is
+ * returned to the camera when the last subscriber releases it
+ */
+struct fanout_frame_t final {
+    AImage* image;
+    frame_info_t info;
+    int64_t arrival; // steady clock when the hub received it
+    std::atomic<uint32_t> references;
+};
+
+// per subscriber accounting. the times are nanosecond
+struct fanout_stats_t final {
+    uint64_t offered;   // frames of its cameras
+    uint64_t decimated; // skipped by the decimation and the interval
+    uint64_t delivered; // acquired
+    uint64_t dropped;   // replaced by the newer ones before `acquire`
+    uint32_t pending;   // waiting for `acquire`
+    uint32_t holding;   // acquired but not released
+    // from the arrival to `acquire`
+    int64_t lag_avg;
+    int64_t lag_max;
+};
+
+/**
+ * Share each analysis image among the native consumers with their own rates.
+ * Set `consume` and the hub as the `camera_group_t::image_consumer`.
+ *
+ * Each subscriber has a queue of `depth` frames. A frame which none of them
+ * takes is released immediately, so the hub holds at most the sum of the
+ * depths and the acquired ones. Keep it under the `maxImages` of the reader.
+ */
+class fanout_hub_t final {
+  public:
+    static constexpr auto max_subscriber_count = 8;
+    static constexpr auto invalid_subscriber = UINT32_MAX;
+
+  private:
+    struct subscriber_t final {
+        bool active = false;
+        fanout_subscriber_config_t config{};
+        uint64_t seen = 0;
+        int64_t due = 0; // timestamp of the next frame to take
+        std::deque<fanout_frame_t*> queue{};
+        std::condition_variable cv{};
+        fanout_stats_t stats{};
+        int64_t lag_sum = 0;
+    };
+
+    camera_group_t& context;
+    mutable std::mutex mtx{};
+    bool closed = false;
+    std::array<subscriber_t, max_subscriber_count> subscribers{};
+    std::atomic<uint32_t> held{};
+
+  public:
+    explicit fanout_hub_t(camera_group_t& context) noexcept;
+    fanout_hub_t(const fanout_hub_t&) = delete;
+    fanout_hub_t(fanout_hub_t&&) = delete;
+    fanout_hub_t& operator=(const fanout_hub_t&) = delete;
+    fanout_hub_t& operator=(fanout_hub_t&&) = delete;
+    // the pending frames are released. the acquired ones must be released
+    // before this
+    ~fanout_hub_t() noexcept;
+
+  public:
+    // `image_consumer_t` of the hub
+    static void consume(void* hub, AImage* image,
+                        const frame_info_t& info) noexcept;
+    // take the image. it is released with `release_image` of the context
+    void push(AImage* image, const frame_info_t& info) noexcept;
+
+    // @return `invalid_subscriber` if there are `max_subscriber_count` already
+    auto subscribe(const fanout_subscriber_config_t& config) noexcept
+        -> uint32_t;
+    // the pending frames are dropped. the acquired ones are still valid
+    void unsubscribe(uint32_t subscriber) noexcept;
+
+    /**
+     * The oldest pending frame of the subscriber. Wait if there is none.
+     * @return nullptr if the timeout expired, or the hub is closed and there
+     *         is no pending frame
+     */
+    auto acquire(uint32_t subscriber,
+                 std::chrono::milliseconds timeout) noexcept
+        -> fanout_frame_t*;
+    void release(uint32_t subscriber, fanout_frame_t* frame) noexcept;
+    // wake the waiting subscribers. no more frames are taken
+    void close() noexcept;
+
+    auto get_stats(uint32_t subscriber) const noexcept -> fanout_stats_t;
+    // images which are not returned to the camera
+    uint32_t get_held() const noexcept {
+        return held;
+    }
+
+  private:
+    bool take(subscriber_t& subscriber, const frame_info_t& info) noexcept;
+    void unref(fanout_frame_t* frame) noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_FANOUT_H_
@@ -0,0 +1,142 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_FRAME_H_
+#define _NDCAM_INCLUDE_FRAME_H_
+
+#include <ndk_camera.h>
+
+#include <iterator>
+
+/**
+ * Region of the plane. If the width or height is 0, the whole plane is used
+ */
+struct image_roi_t final {
+    uint32_t x, y;
+    uint32_t width, height;
+};
+
+// the region in the plane. the whole plane if the region is empty
+auto clamp_roi(image_roi_t roi, uint32_t width, uint32_t height) noexcept
+    -> image_roi_t;
+
+/**
+ * Strided view of 1 plane. The memory is not owned.
+ * `crop` and `subsample` only adjust the pointer and the strides
+ */
+struct plane_view_t final {
+    // from the first pixel to the last byte of the last pixel
+    gsl::span<const uint8_t> data{};
+    uint32_t width = 0, height = 0;
+    uint32_t row_stride = 0;   // bytes between rows
+    uint32_t pixel_stride = 0; // bytes between pixels of a row
+
+  public:
+    /**
+     * Rows of the plane. The span of the row is from its first pixel to the
+     * last one, so the pixels between are included if `pixel_stride > 1`
+     */
+    class row_iterator_t final {
+        const plane_view_t* plane;
+        uint32_t y;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = gsl::span<const uint8_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+      public:
+        row_iterator_t(const plane_view_t* _plane, uint32_t _y) noexcept
+            : plane{_plane}, y{_y} {
+        }
+        auto operator*() const noexcept -> value_type {
+            return plane->row(y);
+        }
+        auto operator++() noexcept -> row_iterator_t& {
+            ++y;
+            return *this;
+        }
+        bool operator==(const row_iterator_t& rhs) const noexcept {
+            return y == rhs.y;
+        }
+        bool operator!=(const row_iterator_t& rhs) const noexcept {
+            return y != rhs.y;
+        }
+    };
+
+  public:
+    bool empty() const noexcept {
+        return width == 0 || height == 0;
+    }
+    // the pixels of a row are adjacent. most kernels require this
+    bool is_packed() const noexcept {
+        return pixel_stride == 1;
+    }
+
+    auto row(uint32_t y) const noexcept -> gsl::span<const uint8_t>;
+    auto at(uint32_t x, uint32_t y) const noexcept -> uint8_t {
+        return data.data()[static_cast<size_t>(y) * row_stride +
+                           static_cast<size_t>(x) * pixel_stride];
+    }
+    auto begin() const noexcept -> row_iterator_t {
+        return row_iterator_t{this, 0};
+    }
+    auto end() const noexcept -> row_iterator_t {
+        return row_iterator_t{this, height};
+    }
+
+    // the region is clamped to the plane
+    auto crop(const image_roi_t& roi) const noexcept -> plane_view_t;
+    // every `step`-th pixel of both axis
+    auto subsample(uint32_t step) const noexcept -> plane_view_t;
+};
+
+// view of the memory which is described with the pointer and strides
+auto make_plane_view(const uint8_t* data, uint32_t row_stride, uint32_t width,
+                     uint32_t height, uint32_t pixel_stride = 1) noexcept
+    -> plane_view_t;
+
+/**
+ * Planes of an image without copy.
+ * For YUV_420_888, the chroma planes(1, 2) are half of the luma in both axis
+ * and follow the crop/subsample of the luma
+ */
+struct frame_view_t final {
+    static constexpr auto max_plane_count = 3;
+
+    int32_t format = 0; // AIMAGE_FORMAT_*
+    uint32_t width = 0, height = 0;
+    int64_t timestamp = 0;
+    uint32_t plane_count = 0;
+    std::array<plane_view_t, max_plane_count> planes{};
+
+  public:
+    bool empty() const noexcept {
+        return plane_count == 0 || width == 0 || height == 0;
+    }
+
+    /**
+     * The region is clamped to the frame.
+     * For YUV_420_888, the origin is aligned down to even numbers so the
+     * chroma samples stay with their luma
+     */
+    auto crop(const image_roi_t& roi) const noexcept -> frame_view_t;
+    /**
+     * For YUV_420_888, the result is 4:2:0 too. Each 2x2 block of the
+     * subsampled luma uses the chroma of its top-left pixel
+     */
+    auto subsample(uint32_t step) const noexcept -> frame_view_t;
+};
+
+/**
+ * Describe the planes of the image. Only the pointers and strides are read.
+ * The view is valid until the image is deleted
+ */
+auto get_frame_view(const AImage* image, frame_view_t& view) noexcept
+    -> media_status_t;
+
+#endif // _NDCAM_INCLUDE_FRAME_H_
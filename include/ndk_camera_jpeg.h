@@ -0,0 +1,98 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_JPEG_H_
+#define _NDCAM_INCLUDE_JPEG_H_
+
+#include <ndk_camera_convert.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+class camera_executor_t;
+class resource_tracker_t;
+struct jpeg_source_t;
+
+struct jpeg_config_t final {
+    // 1 ~ 100. the tables of the JPEG spec(Annex K) scaled like libjpeg
+    uint32_t quality = 90;
+    // restart intervals which are encoded in parallel. 0 for the number of
+    // CPUs. each has 1 or more rows of 16x16 MCUs
+    uint32_t slices = 0;
+    // run the slices in its convert lane. nullptr for the shared threads of
+    // `parallel_for`
+    camera_executor_t* executor = nullptr;
+    // output buffers kept by `recycle`
+    uint32_t pool_size = 4;
+    // if not null, the buffers in the pool are accounted as the
+    // `resource_type_t::frame_buffer` of the device
+    resource_tracker_t* resources = nullptr;
+    uint16_t id = camera_group_t::max_camera_count; // shared
+};
+
+/**
+ * Baseline JPEG(JFIF, 4:2:0) of the YUV frames. The frame is already YCbCr of
+ * BT.601 full range, so the samples are used without the color conversion.
+ *
+ * The level shift, DCT and quantization run on 4 lanes of NEON/SSE2. The
+ * Huffman coding uses the standard tables. The frame is split into the
+ * restart intervals(DRI/RSTn) and each is encoded by a thread into its own
+ * buffer, then they are joined.
+ *
+ * `encode` is not for the concurrent calls. Use 1 encoder per stream
+ */
+class jpeg_encoder_t final {
+    jpeg_config_t config;
+    // zigzag order for DQT
+    std::array<std::array<uint8_t, 64>, 2> quant_tables{};
+    // multipliers of the scaled DCT output in the DCT's layout
+    std::array<std::array<float, 64>, 2> divisors{};
+    // code and size of the symbols. luma DC, luma AC, chroma DC, chroma AC
+    std::array<std::array<uint16_t, 256>, 4> codes{};
+    std::array<std::array<uint8_t, 256>, 4> sizes{};
+
+    std::vector<std::vector<uint8_t>> slices{};
+    std::mutex mtx{};
+    std::vector<std::vector<uint8_t>> pool{};
+
+  public:
+    explicit jpeg_encoder_t(const jpeg_config_t& config) noexcept;
+    jpeg_encoder_t(const jpeg_encoder_t&) = delete;
+    jpeg_encoder_t(jpeg_encoder_t&&) = delete;
+    jpeg_encoder_t& operator=(const jpeg_encoder_t&) = delete;
+    jpeg_encoder_t& operator=(jpeg_encoder_t&&) = delete;
+    ~jpeg_encoder_t() noexcept;
+
+  public:
+    /**
+     * Replace the content of `output` with the JPEG file. The capacity of it
+     * is reused.
+     * @return AMEDIA_ERROR_INVALID_PARAMETER if the size is 0 or larger than
+     *         65535
+     */
+    auto encode(const yuv_planes_t& src, std::vector<uint8_t>& output) noexcept
+        -> media_status_t;
+    /**
+     * The crops and the subsampled frames(thumbnails) of YUV_420_888.
+     * @return AMEDIA_ERROR_INVALID_PARAMETER if the frame is not YUV_420_888
+     */
+    auto encode(const frame_view_t& src, std::vector<uint8_t>& output) noexcept
+        -> media_status_t;
+
+    // a buffer of the pool, or a new one. give it to `encode`
+    auto acquire() noexcept -> std::vector<uint8_t>;
+    // return the buffer to the pool. dropped if the pool is full
+    void recycle(std::vector<uint8_t>&& buffer) noexcept;
+
+    auto get_config() const noexcept -> const jpeg_config_t& {
+        return config;
+    }
+
+  private:
+    void write(const jpeg_source_t& src, std::vector<uint8_t>& output) noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_JPEG_H_
@@ -0,0 +1,107 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_MOTION_H_
+#define _NDCAM_INCLUDE_MOTION_H_
+
+#include <ndk_camera_frame.h>
+
+#include <mutex>
+#include <vector>
+
+/**
+ * Pick every `step`-th pixel of the plane into `dst`.
+ * `dst` must hold (width / step) * (height / step) bytes
+ */
+void subsample_plane(const uint8_t* src, uint32_t row_stride, uint32_t width,
+                     uint32_t height, uint32_t step, uint8_t* dst) noexcept;
+void subsample_plane(const plane_view_t& src, uint32_t step,
+                     uint8_t* dst) noexcept;
+
+/**
+ * Mean absolute difference of each `block` x `block` region between 2 packed
+ * planes. The right/bottom blocks can be partial.
+ * `diffs` must hold ceil(width / block) * ceil(height / block) elements
+ */
+void block_difference(const uint8_t* lhs, const uint8_t* rhs, uint32_t width,
+                      uint32_t height, uint32_t block,
+                      uint8_t* diffs) noexcept;
+
+struct motion_config_t final {
+    uint32_t step = 4;  // subsample step of the Y plane
+    uint32_t block = 16; // block size in subsampled pixels
+    // a block is moving if its mean absolute difference is larger than this
+    uint8_t block_threshold = 12;
+    // a frame is moving if the number of moving blocks is not less than this
+    uint32_t min_blocks = 2;
+    // static frames are compared with the same reference. refresh it after
+    // this number of frames to follow the slow change of the scene (light)
+    uint32_t refresh_interval = 30;
+    // if true, static frames are released before the image consumer
+    bool drop_static = true;
+};
+
+struct motion_stats_t final {
+    uint64_t frames;
+    uint64_t moving; // frames with motion
+};
+
+/**
+ * Block-wise motion detection with the subsampled Y plane.
+ * `update` is expected to be called in 1 thread (image listener). The motion
+ * map can be read from the others
+ */
+class motion_gate_t final {
+    motion_config_t config;
+    uint32_t since_refresh = 0;
+    std::vector<uint8_t> reference{}, current{};
+    std::vector<uint8_t> next_map{};
+
+    mutable std::mutex mtx{};
+    uint32_t width = 0, height = 0; // subsampled size
+    uint32_t blocks_x = 0, blocks_y = 0;
+    std::vector<uint8_t> motion_map{}; // difference of each block
+    int64_t map_timestamp = 0;
+    motion_stats_t stats{};
+
+  public:
+    explicit motion_gate_t(const motion_config_t& config) noexcept;
+    motion_gate_t(const motion_gate_t&) = delete;
+    motion_gate_t(motion_gate_t&&) = delete;
+    motion_gate_t& operator=(const motion_gate_t&) = delete;
+    motion_gate_t& operator=(motion_gate_t&&) = delete;
+    ~motion_gate_t() noexcept = default;
+
+  public:
+    /**
+     * @param y the luma plane
+     * @return true if the frame has motion
+     */
+    bool update(const uint8_t* y, uint32_t row_stride, uint32_t width,
+                uint32_t height, int64_t timestamp) noexcept;
+    bool update(const plane_view_t& y, int64_t timestamp) noexcept;
+    // update with the Y plane of YUV_420_888 image
+    auto update(const AImage* image, bool& moving) noexcept -> media_status_t;
+
+    // next frame will become the reference.
+    // call in the thread of `update`
+    void reset() noexcept;
+
+    auto get_config() const noexcept -> const motion_config_t& {
+        return config;
+    }
+    auto get_stats() const noexcept -> motion_stats_t;
+    // blocks_x * blocks_y
+    void get_map_size(uint32_t& blocks_x, uint32_t& blocks_y) const noexcept;
+    /**
+     * Copy the latest motion map. Each element is the mean absolute
+     * difference of the block. row-major
+     *
+     * @return timestamp of the map. 0 if `dst` is too small or no map
+     */
+    int64_t read_map(gsl::span<uint8_t> dst) const noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_MOTION_H_
@@ -0,0 +1,152 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_PERF_H_
+#define _NDCAM_INCLUDE_PERF_H_
+
+#include <ndk_camera.h>
+
+#include <string>
+
+// the hot paths of the library. see `perf_scope_t`
+enum class perf_stage_t : uint8_t {
+    open_device = 0,       // camera_group_t::open_device
+    start_repeat = 1,      // camera_group_t::start_repeat
+    start_capture = 2,     // camera_group_t::start_capture
+    capture_started = 3,   // context_on_capture_started
+    capture_completed = 4, // context_on_capture_completed
+    image_available = 5,   // context_on_image_available. with the others below
+    motion = 6,            // motion_gate_t::update of the image
+    statistics = 7,        // frame_statistics_t::update of the image
+    preevent = 8,          // preevent_ring_t::push
+    publish = 9,           // frame_publisher_t::publish
+    consume = 10,          // camera_group_t::image_consumer
+    convert = 11,          // convert_yuv_to_rgba
+    resize = 12,           // resize_yuv_to_rgba, resize_plane
+    develop_raw = 13,      // develop_raw16
+    encode_jpeg = 14,      // jpeg_encoder_t
+};
+static constexpr auto perf_stage_count = 15;
+
+auto get_perf_stage_name(perf_stage_t stage) noexcept -> const char*;
+
+// hardware events of `perf_event_open`. user space only
+enum class perf_counter_t : uint8_t {
+    cycles = 0,
+    instructions = 1,
+    cache_misses = 2,
+    branch_misses = 3,
+};
+static constexpr auto perf_counter_count = 4;
+
+auto get_perf_counter_name(perf_counter_t counter) noexcept -> const char*;
+
+/**
+ * Counters which can be opened in the calling thread. Bit N is
+ * `perf_counter_t` N. 0 if the kernel doesn't allow them
+ * (perf_event_paranoid, seccomp) or the CPU has no PMU for the process
+ */
+uint32_t get_perf_counters() noexcept;
+
+struct perf_config_t final {
+    // false to measure the wall time only. no system call in the scopes
+    bool counters = true;
+};
+
+/**
+ * Sum of the scopes of a stage. The times are nanosecond
+ */
+struct perf_summary_t final {
+    uint64_t count; // scopes
+    int64_t wall_time;
+    int64_t wall_time_max;
+    // scopes with the counters. the others were not scheduled on the PMU for
+    // their whole time(multiplexed) or had no counter
+    uint64_t counted;
+    uint32_t counter_mask; // `perf_counter_t` seen in the counted scopes
+    std::array<uint64_t, perf_counter_count> counters; // sum of the counted
+};
+
+/**
+ * Per stage summaries of `perf_scope_t`. The scopes of any thread can add
+ * without the lock.
+ *
+ * The scopes are inclusive. `image_available` contains the analysis stages
+ * and the consumer if there is no executor
+ */
+class perf_profiler_t final {
+    struct stage_t final {
+        std::atomic<uint64_t> count{}, counted{};
+        std::atomic<int64_t> wall_time{}, wall_time_max{};
+        std::atomic<uint32_t> counter_mask{};
+        std::array<std::atomic<uint64_t>, perf_counter_count> counters{};
+    };
+
+    perf_config_t config;
+    std::array<stage_t, perf_stage_count> stages{};
+
+  public:
+    explicit perf_profiler_t(const perf_config_t& config) noexcept;
+    perf_profiler_t(const perf_profiler_t&) = delete;
+    perf_profiler_t(perf_profiler_t&&) = delete;
+    perf_profiler_t& operator=(const perf_profiler_t&) = delete;
+    perf_profiler_t& operator=(perf_profiler_t&&) = delete;
+    ~perf_profiler_t() noexcept = default;
+
+  public:
+    // `counters` is nullptr if the scope couldn't count. `mask` is the valid
+    // ones of them
+    void add(perf_stage_t stage, int64_t wall_time, const uint64_t* counters,
+             uint32_t mask) noexcept;
+    void reset() noexcept;
+
+    auto get_summary(perf_stage_t stage) const noexcept -> perf_summary_t;
+    auto get_config() const noexcept -> const perf_config_t& {
+        return config;
+    }
+    /**
+     * The stages which have a scope, with the averages per scope.
+     * {"stages":[{"name":"convert","count":30,"wall_time_avg":812345,
+     *   "wall_time_max":934567,"counted":30,"cycles":...,"ipc":1.52}]}
+     * The counters are averages of the counted scopes and they are omitted if
+     * there was none
+     */
+    auto to_json() const noexcept -> std::string;
+};
+
+/**
+ * Attach the profiler to the library. nullptr to detach.
+ * The conversion kernels have no context, so the profiler is process-wide.
+ * The profiler must outlive the scopes which are running. Detach and stop the
+ * devices before it is destroyed
+ */
+void set_perf_profiler(perf_profiler_t* profiler) noexcept;
+auto get_perf_profiler() noexcept -> perf_profiler_t*;
+
+/**
+ * Measure the stage until the end of the scope and add it to the attached
+ * profiler. Nothing happens if there is no profiler.
+ *
+ * The counters are opened for each thread at its first scope and read with
+ * 1 `read` at the begin and the end
+ */
+class perf_scope_t final {
+    perf_profiler_t* profiler;
+    perf_stage_t stage;
+    bool counted = false;
+    int64_t begin = 0;
+    uint64_t enabled = 0, running = 0;
+    std::array<uint64_t, perf_counter_count> counters{};
+
+  public:
+    explicit perf_scope_t(perf_stage_t stage) noexcept;
+    perf_scope_t(const perf_scope_t&) = delete;
+    perf_scope_t(perf_scope_t&&) = delete;
+    perf_scope_t& operator=(const perf_scope_t&) = delete;
+    perf_scope_t& operator=(perf_scope_t&&) = delete;
+    ~perf_scope_t() noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_PERF_H_
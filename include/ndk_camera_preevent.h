@@ -0,0 +1,153 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_PREEVENT_H_
+#define _NDCAM_INCLUDE_PREEVENT_H_
+
+#include <ndk_camera_frame.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class resource_tracker_t;
+
+/**
+ * Lossless compressed YUV_420_888 frame.
+ * The planes are split into tiles of rows. Each tile is predicted from its
+ * neighbor pixels and the residuals are coded with rANS, so the tiles can be
+ * encoded/decoded independently
+ */
+struct encoded_frame_t final {
+    int64_t timestamp;
+    uint32_t width, height;
+    uint32_t tile_rows; // luma rows of a tile. the chroma tile is the half
+    // tiles of Y, U, V in order. `offsets[i]` is the beginning of tile `i`
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> data;
+};
+
+// bytes of the decoded frame. planar(I420) layout
+size_t get_decoded_size(const encoded_frame_t& frame) noexcept;
+// number of tiles for the frame size. Y, U, V planes
+uint32_t get_tile_count(uint32_t height, uint32_t tile_rows) noexcept;
+
+/**
+ * Encode 1 tile of the frame. See `get_tile_count` for the index.
+ * `output` is cleared before the encoding
+ */
+void encode_tile(const frame_view_t& frame, uint32_t tile_rows,
+                 uint32_t index, std::vector<uint8_t>& output) noexcept;
+/**
+ * Decode the frame into `dst` with planar(I420) layout.
+ * @return false if `dst` is too small or the data is broken
+ */
+bool decode_frame(const encoded_frame_t& frame,
+                  gsl::span<uint8_t> dst) noexcept;
+
+struct preevent_config_t final {
+    // frames older than this (from the latest one) are evicted
+    std::chrono::milliseconds max_duration{3'000};
+    size_t max_bytes = 64 << 20; // compressed bytes
+    uint32_t tile_rows = 64;
+    // helpers of the image listener thread. 0 to encode only in the listener
+    uint32_t threads = 2;
+    // if not null, the frames in the ring are accounted as the
+    // `resource_type_t::frame_buffer` of the device
+    resource_tracker_t* resources = nullptr;
+    uint16_t id = camera_group_t::max_camera_count; // shared
+};
+
+struct preevent_stats_t final {
+    uint32_t frames;     // frames in the ring
+    uint64_t bytes;      // compressed bytes in the ring
+    uint64_t raw_bytes;  // decoded size of the frames in the ring
+    uint64_t pushed;     // total frames
+    uint64_t evicted;    // by the duration or the bytes
+    int64_t encode_time; // nanosecond of the last `push`
+};
+
+using encoded_frame_ptr = std::shared_ptr<const encoded_frame_t>;
+
+/**
+ * Invoked for each frame of the window. The oldest first.
+ * The frame stays valid while the reference is alive
+ */
+using preevent_consumer_t = void (*)(void* context,
+                                     const encoded_frame_ptr& frame);
+
+/**
+ * The last frames of the analysis stream in compressed form.
+ * `push` is called by the image listener. The window can be taken at any time
+ * without stopping it because the encoded frames are immutable and shared
+ */
+class preevent_ring_t final {
+    preevent_config_t config;
+
+    // fork-join of the tiles in `push`
+    std::mutex job_mtx{};
+    std::condition_variable job_cv{}, done_cv{};
+    const frame_view_t* job = nullptr;
+    uint32_t job_tiles = 0;
+    std::atomic<uint32_t> next_tile{};
+    uint32_t done_tiles = 0;
+    uint32_t active = 0; // workers in the current job
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::vector<std::vector<uint8_t>> tiles{};
+    std::vector<std::thread> workers{};
+
+    mutable std::mutex mtx{};
+    std::deque<encoded_frame_ptr> frames{};
+    preevent_stats_t stats{};
+
+  public:
+    explicit preevent_ring_t(const preevent_config_t& config) noexcept;
+    preevent_ring_t(const preevent_ring_t&) = delete;
+    preevent_ring_t(preevent_ring_t&&) = delete;
+    preevent_ring_t& operator=(const preevent_ring_t&) = delete;
+    preevent_ring_t& operator=(preevent_ring_t&&) = delete;
+    ~preevent_ring_t() noexcept;
+
+  public:
+    // compress and append the frame. evict the old frames
+    auto push(const frame_view_t& frame) noexcept -> media_status_t;
+    // YUV_420_888 image
+    auto push(const AImage* image) noexcept -> media_status_t;
+
+    // frames in the ring. the oldest first
+    void snapshot(std::vector<encoded_frame_ptr>& output) const noexcept;
+    // invoke the consumer with the snapshot in the caller's thread
+    void flush(preevent_consumer_t consumer, void* context) const noexcept;
+    /**
+     * Write the snapshot to the file. See `save_encoded_frames`
+     * @return 0 or errno
+     */
+    int save(const char* path) const noexcept;
+    void clear() noexcept;
+
+    auto get_stats() const noexcept -> preevent_stats_t;
+
+  private:
+    void run() noexcept;
+    // encode the tiles of the current job until they are exhausted
+    void work(const frame_view_t& frame, uint32_t count) noexcept;
+};
+
+/**
+ * File layout(native byte order)
+ *  - "NDPE", version(1), frame count
+ *  - for each frame: timestamp(8), width, height, tile rows, tile count,
+ *    data size, tile offsets(4 x tile count), data
+ *
+ * @return 0 or errno
+ */
+int save_encoded_frames(const char* path,
+                        const std::vector<encoded_frame_ptr>& frames) noexcept;
+
+#endif // _NDCAM_INCLUDE_PREEVENT_H_
@@ -0,0 +1,105 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_RAW_H_
+#define _NDCAM_INCLUDE_RAW_H_
+
+#include <ndk_camera_frame.h>
+
+#include <vector>
+
+class camera_executor_t;
+
+// ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT. colors of the top-left 2x2
+enum class bayer_pattern_t : uint8_t {
+    rggb = 0,
+    grbg = 1,
+    gbrg = 2,
+    bggr = 3,
+};
+
+/**
+ * Values to develop the RAW16 of a device. The arrays of the channels are in
+ * the order of the metadata: R, G_even(green of the even rows), G_odd, B
+ */
+struct raw_params_t final {
+    bayer_pattern_t pattern = bayer_pattern_t::rggb;
+    // 2x2 block in row-major. same with ACAMERA_SENSOR_BLACK_LEVEL_PATTERN
+    std::array<float, 4> black_level{};
+    float white_level = 1023;
+    // ACAMERA_COLOR_CORRECTION_GAINS of the result. per channel
+    std::array<float, 4> gains{1, 1, 1, 1};
+    /**
+     * ACAMERA_STATISTICS_LENS_SHADING_MAP of the result. The grid spans the
+     * image and each point has the gains of 4 channels. Empty if the request
+     * didn't turn on ACAMERA_STATISTICS_LENS_SHADING_MAP_MODE
+     */
+    uint32_t shading_width = 0, shading_height = 0;
+    std::vector<float> shading_map{};
+};
+
+/**
+ * The pattern, black level and white level of the characteristics. If the
+ * result is not nullptr, its dynamic black/white levels, color correction
+ * gains and lens shading map override them.
+ * @return ACAMERA_ERROR_METADATA_NOT_FOUND if the device has no RAW sensor
+ *         info. ACAMERA_ERROR_INVALID_PARAMETER for the non-Bayer sensors
+ */
+auto read_raw_params(const ACameraMetadata* characteristics,
+                     const ACameraMetadata* result,
+                     raw_params_t& params) noexcept -> camera_status_t;
+
+enum class raw_demosaic_t : uint8_t {
+    bilinear = 0,
+    // green along the smaller gradient, then the color differences.
+    // no zipper on the horizontal/vertical edges
+    edge_aware = 1,
+};
+
+struct raw_config_t final {
+    raw_demosaic_t demosaic = raw_demosaic_t::edge_aware;
+    // false runs the scalar kernels only. the result is the same
+    bool vectorize = true;
+    // row bands which are developed in parallel. 0 for the number of CPUs
+    uint32_t bands = 0;
+    // run the bands in its convert lane. nullptr for the shared threads of
+    // `parallel_for`
+    camera_executor_t* executor = nullptr;
+};
+
+/**
+ * RAW16 to RGB. The black level is subtracted, the lens shading and color
+ * gains are applied, and the range to the white level is scaled to the
+ * output. Then the mosaic is interpolated.
+ *
+ * The bands run in the threads of the config and the calling thread. Each
+ * band reads 4 rows above/below it, so the bands are independent.
+ *
+ * `src_row_stride` and `dst_row_stride` are in bytes. The width and height
+ * must be 2 or larger.
+ * The 16 bit RGB is linear. The 8 bit RGB is encoded with the sRGB curve
+ */
+void develop_raw16(const uint16_t* src, uint32_t src_row_stride,
+                   uint32_t width, uint32_t height, const raw_params_t& params,
+                   const raw_config_t& config, uint16_t* dst,
+                   uint32_t dst_row_stride) noexcept;
+void develop_raw16(const uint16_t* src, uint32_t src_row_stride,
+                   uint32_t width, uint32_t height, const raw_params_t& params,
+                   const raw_config_t& config, uint8_t* dst,
+                   uint32_t dst_row_stride) noexcept;
+
+/**
+ * The origin of the cropped frame must be even, or the pattern is shifted.
+ * @return AMEDIA_ERROR_INVALID_PARAMETER if the frame is not RAW16.
+ *         AMEDIA_ERROR_UNSUPPORTED if it is subsampled
+ */
+auto develop_raw16(const frame_view_t& src, const raw_params_t& params,
+                   const raw_config_t& config, uint16_t* dst,
+                   uint32_t dst_row_stride) noexcept -> media_status_t;
+auto develop_raw16(const frame_view_t& src, const raw_params_t& params,
+                   const raw_config_t& config, uint8_t* dst,
+                   uint32_t dst_row_stride) noexcept -> media_status_t;
+
+#endif // _NDCAM_INCLUDE_RAW_H_
@@ -0,0 +1,141 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_RECOVERY_H_
+#define _NDCAM_INCLUDE_RECOVERY_H_
+
+#include <ndk_camera.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct recovery_config_t final {
+    // delay of the n-th retry is `initial_delay * multiplier^(n-1)`.
+    // the first attempt starts immediately
+    std::chrono::milliseconds initial_delay{100};
+    std::chrono::milliseconds max_delay{5'000};
+    uint32_t multiplier = 2;
+    // give up after this number of attempts. 0 for no limit
+    uint32_t max_attempts = 10;
+};
+
+/**
+ * A disconnect or an error of the device and its recovery.
+ * The downtime is `end - begin`
+ */
+struct recovery_incident_t final {
+    uint16_t id;
+    int32_t error;     // ERROR_CAMERA_*. 0 for the disconnect
+    uint32_t attempts; // reopen attempts
+    int64_t begin;     // steady clock nanosecond of the report
+    int64_t end;       // when the repeating request is restored. 0 if failed
+    bool fatal;        // not recoverable by reopening. no attempt
+    bool recovered;
+};
+
+/**
+ * Invoked in the engine's thread when the incident is finished
+ * (recovered, failed or fatal)
+ */
+using recovery_listener_t = void (*)(void* context,
+                                     const recovery_incident_t& incident);
+
+// ERROR_CAMERA_DISABLED is fatal. the others can be recovered by reopening
+bool is_fatal_device_error(int error) noexcept;
+
+/**
+ * Reopen the device and restore its repeating request after the device is
+ * disconnected or has an error. The retries are delayed with exponential
+ * backoff.
+ *
+ * The context reports the operations of the app (`on_open`, `on_repeat`, ...)
+ * so the engine knows what to restore. The reports of its own thread are
+ * ignored. The reopen holds `camera_group_t::operation_mtx_set` of the device,
+ * so the app's operations of the device wait while the engine is reopening it
+ */
+class recovery_engine_t final {
+    struct target_t final {
+        // the app opened the device. the callbacks to reopen it
+        bool opened = false;
+        ACameraDevice_StateCallbacks device_callbacks{};
+        // the app started the repeating request. the engine holds a
+        // reference of the window
+        ANativeWindow* window = nullptr;
+        ACameraCaptureSession_stateCallbacks session_callbacks{};
+        ACameraCaptureSession_captureCallbacks capture_callbacks{};
+
+        bool pending = false; // incident in progress
+        recovery_incident_t incident{};
+        std::chrono::steady_clock::time_point due{};
+    };
+
+    camera_group_t& context;
+    recovery_config_t config;
+    recovery_listener_t listener = nullptr;
+    void* listener_context = nullptr;
+
+    // guards the below. device callbacks only use this
+    mutable std::mutex mtx{};
+    std::condition_variable cv{};
+    bool stopping = false;
+    std::array<target_t, camera_group_t::max_camera_count> targets{};
+    std::deque<recovery_incident_t> history{};
+    std::thread worker;
+
+  public:
+    static constexpr size_t max_history = 64;
+
+  public:
+    recovery_engine_t(camera_group_t& context,
+                      const recovery_config_t& config) noexcept;
+    recovery_engine_t(const recovery_engine_t&) = delete;
+    recovery_engine_t(recovery_engine_t&&) = delete;
+    recovery_engine_t& operator=(const recovery_engine_t&) = delete;
+    recovery_engine_t& operator=(recovery_engine_t&&) = delete;
+    // detach from the context before this
+    ~recovery_engine_t() noexcept;
+
+  public:
+    void set_listener(recovery_listener_t listener, void* context) noexcept;
+
+    // operations of the app. see `camera_group_t::recovery`.
+    // the context invokes them with the operation lock of the device
+    void on_open(uint16_t id,
+                 const ACameraDevice_StateCallbacks& callbacks) noexcept;
+    // the pending attempt restores this one, and it's due now
+    void on_repeat(uint16_t id, ANativeWindow* window,
+                   const ACameraCaptureSession_stateCallbacks& on_session,
+                   const ACameraCaptureSession_captureCallbacks& on_capture)
+        noexcept;
+    // the repeating request won't be restored. the pending attempt only
+    // reopens the device
+    void on_stop(uint16_t id) noexcept;
+    // the device won't be reopened. the incident in progress is cancelled
+    void on_close(uint16_t id) noexcept;
+
+    // device callbacks
+    void on_disconnected(uint16_t id) noexcept;
+    void on_error(uint16_t id, int error) noexcept;
+
+    bool is_recovering(uint16_t id) const noexcept;
+    // finished incidents of the device. the oldest first
+    void get_incidents(uint16_t id,
+                       std::vector<recovery_incident_t>& output) const noexcept;
+
+  private:
+    bool is_worker() const noexcept;
+    void report(uint16_t id, int error) noexcept;
+    void run() noexcept;
+    void attempt(uint16_t id) noexcept;
+    // with `mtx`
+    void finish(target_t& target) noexcept;
+    auto get_backoff(uint32_t attempts) const noexcept
+        -> std::chrono::milliseconds;
+};
+
+#endif // _NDCAM_INCLUDE_RECOVERY_H_
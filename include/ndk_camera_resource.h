@@ -0,0 +1,176 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_RESOURCE_H_
+#define _NDCAM_INCLUDE_RESOURCE_H_
+
+#include <ndk_camera.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// follow `Device.RESOURCE_*`
+enum class resource_type_t : uint16_t {
+    image = 0,           // AImage of the analysis reader
+    hardware_buffer = 1, // AHardwareBuffer of the image. API 26+
+    capture_request = 2, // ACaptureRequest
+    capture_session = 3, // ACameraCaptureSession
+    frame_buffer = 4,    // JPEG output pool and pre-event ring. see config
+};
+static constexpr auto resource_type_count = 5u;
+
+// follow `Device.STAT_*`
+struct resource_stats_t final {
+    int64_t live;  // acquired, but not released yet
+    int64_t bytes; // bytes of the live ones
+    int64_t peak_live;
+    int64_t peak_bytes;
+    int64_t total; // number of the acquisitions
+};
+
+// where the resource is acquired. see `NDCAM_RESOURCE_SITE`
+struct resource_site_t final {
+    const char* file = nullptr;
+    uint32_t line = 0;
+};
+#define NDCAM_RESOURCE_SITE (resource_site_t{__FILE__, __LINE__})
+
+struct resource_site_stats_t final {
+    resource_site_t site;
+    resource_type_t type;
+    uint16_t id;
+    int64_t live;
+    int64_t bytes;
+};
+
+/**
+ * Live counts, bytes and peaks of the resources for each device.
+ * `acquire`/`release` can be invoked in any thread.
+ *
+ * Per-site accounting is disabled by default since it needs a lock and a
+ * lookup for each call. Enable it to find who holds the resources
+ */
+class resource_tracker_t final {
+  public:
+    // for the resources which don't belong to a device
+    static constexpr uint16_t shared_id = camera_group_t::max_camera_count;
+
+  private:
+    struct counter_t final {
+        std::atomic<int64_t> live{}, bytes{};
+        std::atomic<int64_t> peak_live{}, peak_bytes{};
+        std::atomic<int64_t> total{};
+    };
+    struct record_t final {
+        resource_site_t site;
+        resource_type_t type;
+        uint16_t id;
+        int64_t bytes;
+    };
+
+    std::array<std::array<counter_t, resource_type_count>,
+               camera_group_t::max_camera_count + 1>
+        counters{};
+    std::atomic<bool> site_enabled{false};
+    mutable std::mutex mtx{};
+    std::unordered_map<const void*, record_t> records{};
+
+  public:
+    resource_tracker_t() noexcept = default;
+    resource_tracker_t(const resource_tracker_t&) = delete;
+    resource_tracker_t(resource_tracker_t&&) = delete;
+    resource_tracker_t& operator=(const resource_tracker_t&) = delete;
+    resource_tracker_t& operator=(resource_tracker_t&&) = delete;
+    ~resource_tracker_t() noexcept = default;
+
+  public:
+    // `id` larger than `shared_id` is considered as `shared_id`
+    void acquire(resource_type_t type, uint16_t id, const void* handle,
+                 int64_t bytes, resource_site_t site = {}) noexcept;
+    // `bytes` must be same with the `acquire`
+    void release(resource_type_t type, uint16_t id, const void* handle,
+                 int64_t bytes) noexcept;
+
+    auto get_stats(resource_type_t type, uint16_t id) const noexcept
+        -> resource_stats_t;
+    // sum of all devices. the peaks are the sum of each device's peak
+    auto get_stats(resource_type_t type) const noexcept -> resource_stats_t;
+    // the peaks restart from the current values
+    void reset_peaks() noexcept;
+
+    // the records are cleared when disabled
+    void enable_sites(bool enable) noexcept;
+    bool is_site_enabled() const noexcept {
+        return site_enabled.load();
+    }
+    // live resources grouped by (site, type, id). the largest bytes first
+    void get_sites(std::vector<resource_site_stats_t>& output) const noexcept;
+};
+
+/**
+ * Deleter for the RAII aliases. Releases the resource from the tracker before
+ * freeing it. The tracker can be null
+ */
+template <typename T, resource_type_t Type>
+struct tracked_deleter_t final {
+    void (*free)(T*);
+    resource_tracker_t* tracker = nullptr;
+    uint16_t id = resource_tracker_t::shared_id;
+    int64_t bytes = 0;
+
+  public:
+    void operator()(T* ptr) const noexcept {
+        if (ptr == nullptr)
+            return;
+        if (tracker)
+            tracker->release(Type, id, ptr, bytes);
+        free(ptr);
+    }
+};
+
+// `capture_request_ptr` with accounting
+using tracked_request_ptr =
+    std::unique_ptr<ACaptureRequest,
+                    tracked_deleter_t<ACaptureRequest,
+                                      resource_type_t::capture_request>>;
+using tracked_image_ptr =
+    std::unique_ptr<AImage, tracked_deleter_t<AImage, resource_type_t::image>>;
+
+// Acquire the resource from the tracker and wrap it with the RAII type
+template <resource_type_t Type, typename T>
+auto make_tracked(T* ptr, void (*free)(T*), resource_tracker_t* tracker,
+                  uint16_t id, int64_t bytes,
+                  resource_site_t site = {}) noexcept
+    -> std::unique_ptr<T, tracked_deleter_t<T, Type>> {
+    if (ptr && tracker)
+        tracker->acquire(Type, id, ptr, bytes, site);
+    return {ptr, tracked_deleter_t<T, Type>{free, tracker, id, bytes}};
+}
+
+// sum of the plane lengths
+auto get_image_bytes(const AImage* image) noexcept -> int64_t;
+
+/**
+ * Free the image from `image_consumer_t`. The consumer must use this instead
+ * of `AImage_delete` so the context can account the images it handed out
+ */
+void release_image(camera_group_t& context, uint16_t id,
+                   AImage* image) noexcept;
+
+#if __ANDROID_API__ >= 26
+/**
+ * Acquire the hardware buffer of the image. The buffer can outlive the image.
+ * Release it with `release_hardware_buffer`
+ */
+auto acquire_hardware_buffer(camera_group_t& context, uint16_t id,
+                             AImage* image, AHardwareBuffer** buffer,
+                             resource_site_t site = {}) noexcept
+    -> media_status_t;
+void release_hardware_buffer(camera_group_t& context, uint16_t id,
+                             AHardwareBuffer* buffer) noexcept;
+#endif
+
+#endif // _NDCAM_INCLUDE_RESOURCE_H_
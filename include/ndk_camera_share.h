@@ -0,0 +1,186 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_SHARE_H_
+#define _NDCAM_INCLUDE_SHARE_H_
+
+#include <ndk_camera_frame.h>
+
+#include <mutex>
+#include <vector>
+
+/**
+ * Layout of the shared memory. The processes must be built with the same
+ * version of this header
+ *
+ *  - share_header_t. subscriber table at its end
+ *  - slots. `slot_size` bytes each: share_slot_t and then the planes
+ */
+struct share_subscriber_t final {
+    std::atomic<int32_t> pid;       // 0 if the entry is free
+    std::atomic<uint64_t> cursor;   // next frame number to read
+    std::atomic<uint64_t> received; // frames released without the overwrite
+    // frames skipped by the lag or overwritten while they were read
+    std::atomic<uint64_t> dropped;
+    uint8_t padding[32];
+};
+static_assert(sizeof(share_subscriber_t) == 64, "1 cache line for each");
+
+struct share_header_t final {
+    static constexpr uint32_t magic_value = 0x4e445348; // "NDSH"
+    // increase when the layout changes.
+    // 2: the mapped timestamp in capture_result_t of the slot
+    static constexpr uint32_t version_value = 2;
+    static constexpr auto max_subscribers = 8;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    std::atomic<uint64_t> head;     // number of the published frames
+    std::atomic<uint32_t> notify;   // futex word. increased for each frame
+    std::atomic<uint32_t> waiters;  // subscribers in the futex wait
+    std::atomic<uint64_t> rejected; // frames larger than the slot
+    uint8_t padding[24];
+    share_subscriber_t subscribers[max_subscribers];
+};
+
+struct share_slot_t final {
+    // frame number + 1. 0 while the publisher writes the slot
+    std::atomic<uint64_t> stamp;
+    // the capture result is written after the frame if it arrives late
+    std::atomic<uint32_t> has_result;
+    int32_t format;
+    int64_t timestamp;
+    uint32_t width, height, plane_count;
+    // packed planes(pixel stride 1) from the end of this struct
+    uint32_t offsets[frame_view_t::max_plane_count];
+    uint32_t plane_widths[frame_view_t::max_plane_count];
+    uint32_t plane_heights[frame_view_t::max_plane_count];
+    capture_result_t result;
+};
+
+struct share_config_t final {
+    uint32_t slot_count = 4;
+    // the largest frame. 1080p YUV_420_888 by default
+    uint32_t max_frame_bytes = 1920 * 1080 * 3 / 2;
+};
+
+// per subscriber accounting. see `share_subscriber_t`
+struct share_subscriber_stats_t final {
+    int32_t pid;
+    uint64_t lag; // published but not read yet
+    uint64_t received;
+    uint64_t dropped;
+};
+
+/**
+ * Publish the analysis frames to the other processes through the shared
+ * memory(memfd, ashmem for the old kernels).
+ *
+ * The frame is copied once into a slot of the ring and the subscribers read it
+ * in place. The publisher never waits for the subscribers. A slow subscriber
+ * loses the frames which are overwritten and they are counted as dropped.
+ * Send `get_fd` to the other process(fork, binder, SCM_RIGHTS) to subscribe
+ */
+class frame_publisher_t final {
+  public:
+    // capture results waiting for their image
+    static constexpr auto pending_capacity = 8;
+
+  private:
+    share_config_t config;
+    int fd;
+    size_t length;
+    share_header_t* header;
+
+    std::mutex mtx{};
+    std::array<capture_result_t, pending_capacity> pending{};
+    uint32_t next = 0;
+
+  public:
+    // `get_fd` is -1 if the shared memory can't be created
+    explicit frame_publisher_t(const share_config_t& config) noexcept;
+    frame_publisher_t(const frame_publisher_t&) = delete;
+    frame_publisher_t(frame_publisher_t&&) = delete;
+    frame_publisher_t& operator=(const frame_publisher_t&) = delete;
+    frame_publisher_t& operator=(frame_publisher_t&&) = delete;
+    ~frame_publisher_t() noexcept;
+
+  public:
+    // copy the frame into the next slot and wake the subscribers
+    auto publish(const frame_view_t& frame) noexcept -> media_status_t;
+    auto publish(const AImage* image) noexcept -> media_status_t;
+    // attach the result to the frame of the same timestamp
+    void update(const capture_result_t& result) noexcept;
+
+    int get_fd() const noexcept {
+        return fd;
+    }
+    uint64_t get_published() const noexcept;
+    uint64_t get_rejected() const noexcept;
+    // the entries of the dead processes are freed
+    void get_subscribers(
+        std::vector<share_subscriber_stats_t>& output) noexcept;
+
+  private:
+    auto get_slot(uint64_t number) noexcept -> share_slot_t*;
+};
+
+/**
+ * The frame in the shared memory. `view` is valid until `release`
+ */
+struct shared_frame_t final {
+    uint64_t number; // frame number of the publisher
+    frame_view_t view;
+    bool has_result;
+    capture_result_t result;
+};
+
+/**
+ * Map the publisher's memory and read its frames without copy.
+ * Only 1 thread can use the subscriber
+ */
+class frame_subscriber_t final {
+    int fd;
+    size_t length;
+    share_header_t* header;
+    share_subscriber_t* entry;
+    const share_slot_t* current;
+    uint64_t current_stamp;
+
+  public:
+    // `fd` is duplicated. `is_valid` is false if the memory is not a ring or
+    // there is no free entry for the subscriber
+    explicit frame_subscriber_t(int fd) noexcept;
+    frame_subscriber_t(const frame_subscriber_t&) = delete;
+    frame_subscriber_t(frame_subscriber_t&&) = delete;
+    frame_subscriber_t& operator=(const frame_subscriber_t&) = delete;
+    frame_subscriber_t& operator=(frame_subscriber_t&&) = delete;
+    ~frame_subscriber_t() noexcept;
+
+  public:
+    bool is_valid() const noexcept {
+        return entry != nullptr;
+    }
+    // wait for a frame which is not read yet. false if the timeout expired
+    bool wait(std::chrono::milliseconds timeout) noexcept;
+    /**
+     * Take the next frame. If the subscriber is lagging behind the ring, it
+     * skips to the latest frame and the others are counted as dropped.
+     * @return false if there is no new frame
+     */
+    bool acquire(shared_frame_t& frame) noexcept;
+    /**
+     * Finish the frame of `acquire`.
+     * @return false if the publisher overwrote the frame while it was read.
+     *         the frame is counted as dropped and its content must be ignored
+     */
+    bool release() noexcept;
+
+    auto get_stats() const noexcept -> share_subscriber_stats_t;
+};
+
+#endif // _NDCAM_INCLUDE_SHARE_H_
@@ -0,0 +1,111 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_STATS_H_
+#define _NDCAM_INCLUDE_STATS_H_
+
+#include <ndk_camera_frame.h>
+
+#include <mutex>
+#include <vector>
+
+struct stats_config_t final {
+    image_roi_t roi{};
+    uint32_t step = 2; // subsample step for both axis
+    bool histogram = true;
+    bool sharpness = true;
+};
+
+struct frame_stats_t final {
+    int64_t timestamp;
+    uint32_t count; // number of sampled pixels
+    std::array<uint32_t, 256> histogram;
+    float mean;
+    float variance;
+    // variance of the Laplacian. larger if the image is in focus
+    float sharpness;
+};
+
+// size of the scratch buffer for `compute_frame_stats`
+auto get_stats_scratch_size(const stats_config_t& config,
+                            uint32_t width) noexcept -> size_t;
+// the rows are gathered if the pixels of the plane are not adjacent
+auto get_stats_scratch_size(const stats_config_t& config,
+                            const plane_view_t& plane) noexcept -> size_t;
+
+/**
+ * Histogram, mean/variance and sharpness of the luma plane in 1 pass.
+ * Sampled rows are gathered into `scratch` if the step is larger than 1
+ */
+void compute_frame_stats(const uint8_t* plane, uint32_t row_stride,
+                         uint32_t width, uint32_t height,
+                         const stats_config_t& config,
+                         gsl::span<uint8_t> scratch,
+                         frame_stats_t& stats) noexcept;
+// the region of the config is in the plane's pixels
+void compute_frame_stats(const plane_view_t& plane,
+                         const stats_config_t& config,
+                         gsl::span<uint8_t> scratch,
+                         frame_stats_t& stats) noexcept;
+
+/**
+ * Invoked when both of the capture result and the statistics of the frame
+ * are ready. They are matched with `ACAMERA_SENSOR_TIMESTAMP`
+ */
+using stats_callback_t = void (*)(void* context, const capture_result_t& result,
+                                  const frame_stats_t& stats);
+
+/**
+ * Compute the statistics of the analysis images and publish them with the
+ * capture result of the same frame.
+ * The image and the result can arrive in any order.
+ */
+class frame_statistics_t final {
+  public:
+    // frames waiting for the other half
+    static constexpr auto capacity = 8;
+
+  private:
+    struct entry_t final {
+        int64_t timestamp;
+        bool has_result, has_stats;
+        capture_result_t result;
+        frame_stats_t stats;
+    };
+
+    stats_config_t config;
+    stats_callback_t callback;
+    void* user_context;
+    // used only by the image listener thread
+    std::vector<uint8_t> scratch{};
+    frame_stats_t working{};
+
+    mutable std::mutex mtx{};
+    std::array<entry_t, capacity> entries{};
+    uint32_t next = 0;
+    frame_stats_t latest{};
+
+  public:
+    frame_statistics_t(const stats_config_t& config, stats_callback_t callback,
+                       void* context) noexcept;
+    frame_statistics_t(const frame_statistics_t&) = delete;
+    frame_statistics_t(frame_statistics_t&&) = delete;
+    frame_statistics_t& operator=(const frame_statistics_t&) = delete;
+    frame_statistics_t& operator=(frame_statistics_t&&) = delete;
+    ~frame_statistics_t() noexcept = default;
+
+  public:
+    // compute with the Y plane of YUV_420_888 image
+    auto update(const AImage* image) noexcept -> media_status_t;
+    void update(const capture_result_t& result) noexcept;
+
+    auto get_latest() const noexcept -> frame_stats_t;
+
+  private:
+    auto find(int64_t timestamp) noexcept -> entry_t&;
+    void publish(const entry_t& entry) noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_STATS_H_
@@ -0,0 +1,106 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_STREAM_H_
+#define _NDCAM_INCLUDE_STREAM_H_
+
+#include <ndk_camera.h>
+
+#include <string>
+#include <vector>
+
+struct stream_size_t final {
+    uint32_t width;
+    uint32_t height;
+};
+
+// an output of ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS. nanosecond
+struct stream_config_t final {
+    int32_t format; // AIMAGE_FORMAT_*
+    stream_size_t size;
+    int64_t min_frame_duration; // 0 if the device didn't report
+    int64_t stall_duration;     // 0 for the non-stalling ones
+};
+
+struct stream_capability_t final {
+    uint8_t hardware_level; // ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_*
+    bool raw;               // ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_RAW
+    std::vector<stream_config_t> outputs;
+};
+
+/**
+ * Output sizes with their min frame/stall durations, hardware level and RAW
+ * capability of the characteristics
+ * @return ACAMERA_ERROR_METADATA_NOT_FOUND if there is no stream configuration
+ */
+auto read_stream_capability(const ACameraMetadata* metadata,
+                            stream_capability_t& capability) noexcept
+    -> camera_status_t;
+
+/**
+ * An output the app wants. The planner picks its size and the other outputs'
+ * so they can run in 1 session
+ */
+struct stream_requirement_t final {
+    int32_t format;
+    // the size must be larger or equal in both axis
+    stream_size_t min_size;
+    // 0 if any. the limit of the repeating request for the repeating stream
+    // (33'333'333 for 30 fps), and the limit of the still request with the
+    // stall for the others
+    int64_t max_frame_duration;
+    // in the repeating request. false for the still captures(JPEG)
+    bool repeating;
+    // the largest size which keeps the frame rate. the smallest if false
+    bool largest;
+};
+
+enum class stream_plan_error_t : uint8_t {
+    none = 0,
+    no_size = 1,     // no output of the format is large enough
+    too_slow = 2,    // no size meets the frame duration
+    combination = 3, // not a guaranteed combination of the hardware level
+};
+
+struct stream_plan_t final {
+    // same order with the requirements
+    std::vector<stream_config_t> streams;
+    // the repeating request. the max of its streams' min frame durations
+    // and stall durations
+    int64_t frame_duration;
+    // the request with the still streams. the preview is paused for this
+    int64_t still_duration;
+
+    stream_plan_error_t error;
+    uint32_t culprit; // index of the requirement which fails
+    std::string reason;
+};
+
+/**
+ * Choose the sizes of the outputs. The plan is feasible if the outputs are a
+ * guaranteed stream combination of the hardware level(see
+ * `CameraDevice#createCaptureSession`) and each requirement's frame duration
+ * is met.
+ *
+ * Among the feasible ones, the planner prefers
+ *  1. the larger sizes of the `largest` requirements
+ *  2. the shortest frame duration of the repeating request
+ *  3. the shortest still capture(the smaller stall)
+ *  4. the smaller sizes of the others
+ *
+ * The PREVIEW size of the combination table is 1920x1080 and RECORD is
+ * 3840x2160. The real ones depend on the display and the camcorder profiles
+ * which are not visible to the NDK.
+ *
+ * @return false if there is no feasible plan. `plan.reason` explains it
+ */
+bool plan_streams(const stream_capability_t& capability,
+                  gsl::span<const stream_requirement_t> requirements,
+                  stream_plan_t& plan) noexcept;
+
+// "YUV_420_888", "JPEG" ... the hex number for the others
+auto get_format_name(int32_t format) noexcept -> std::string;
+
+#endif // _NDCAM_INCLUDE_STREAM_H_
@@ -0,0 +1,118 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#pragma once
+#ifndef _NDCAM_INCLUDE_SYNC_H_
+#define _NDCAM_INCLUDE_SYNC_H_
+
+#include <ndk_camera.h>
+
+#include <mutex>
+
+/**
+ * A frame reported by `onCaptureCompleted`. `sequence` is counted by the
+ * synchronizer for each device
+ */
+struct sync_frame_t final {
+    uint16_t id;
+    int64_t timestamp; // ACAMERA_SENSOR_TIMESTAMP + offset of the stream
+    uint64_t sequence;
+};
+
+/**
+ * Invoked with one frame for each registered device.
+ * Frames are ordered by device id.
+ *
+ * !!! The callback is invoked under the synchronizer's lock. Keep it short !!!
+ */
+using sync_callback_t = void (*)(void* context, const sync_frame_t* frames,
+                                 uint16_t count);
+
+struct sync_stats_t final {
+    uint64_t matched;
+    // frames which can't have a pair in tolerance
+    std::array<uint64_t, camera_group_t::max_camera_count> unmatched;
+    // frames which stayed longer than the window (or overflowed)
+    std::array<uint64_t, camera_group_t::max_camera_count> expired;
+};
+
+/**
+ * Pair the frames from multiple devices with `ACAMERA_SENSOR_TIMESTAMP`.
+ *
+ * A set is emitted as soon as every device has a frame within the tolerance,
+ * so the latency is the arrival gap between devices (bounded by the window).
+ * Frames are kept in fixed rings. No allocation happens per frame.
+ *
+ * `ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME` devices share the same time
+ * base. For `UNKNOWN` sources the timestamps are not comparable with the
+ * others, so the stream must be aligned with `set_offset` before pairing.
+ * The tolerance should be less than half of the frame duration.
+ */
+class frame_synchronizer_t final {
+  public:
+    // frames to keep for each device
+    static constexpr auto capacity = 16;
+
+  private:
+    struct stream_t final {
+        bool enabled = false;
+        bool aligned = false; // comparable with the other streams
+        uint8_t source = ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN;
+        int64_t offset = 0;
+        uint64_t sequence = 0;
+        // ring of pending frames. ordered by timestamp
+        std::array<sync_frame_t, capacity> frames{};
+        uint32_t head = 0;
+        uint32_t count = 0;
+    };
+
+    mutable std::mutex mtx{};
+    std::array<stream_t, camera_group_t::max_camera_count> streams{};
+    uint16_t num_stream = 0;
+    uint8_t reference_source = ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN;
+    int64_t tolerance;
+    int64_t window;
+    sync_callback_t callback;
+    void* user_context;
+    sync_stats_t stats{};
+
+  public:
+    /**
+     * @param tolerance max difference(nanosecond) of timestamps in a set
+     * @param window    max time(nanosecond) for a frame to wait its pairs
+     */
+    frame_synchronizer_t(int64_t tolerance, int64_t window,
+                         sync_callback_t callback, void* context) noexcept;
+    frame_synchronizer_t(const frame_synchronizer_t&) = delete;
+    frame_synchronizer_t(frame_synchronizer_t&&) = delete;
+    frame_synchronizer_t& operator=(const frame_synchronizer_t&) = delete;
+    frame_synchronizer_t& operator=(frame_synchronizer_t&&) = delete;
+    ~frame_synchronizer_t() noexcept = default;
+
+  public:
+    // register the device with `ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE` in its
+    // characteristics
+    auto add_stream(uint16_t id,
+                    const ACameraMetadata* characteristics) noexcept
+        -> camera_status_t;
+    // align the stream's timestamp to the others. (`timestamp + offset`)
+    void set_offset(uint16_t id, int64_t offset) noexcept;
+
+    /**
+     * @return ACAMERA_ERROR_INVALID_PARAMETER if the device is not registered,
+     *         ACAMERA_ERROR_INVALID_OPERATION if the stream is not aligned
+     */
+    auto push(uint16_t id, int64_t timestamp) noexcept -> camera_status_t;
+
+    // drop all pending frames
+    void clear() noexcept;
+    auto get_stats() const noexcept -> sync_stats_t;
+
+  private:
+    void pop_front(stream_t& stream) noexcept;
+    void expire(int64_t newest) noexcept;
+    void match() noexcept;
+};
+
+#endif // _NDCAM_INCLUDE_SYNC_H_
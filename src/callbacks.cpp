@@ -0,0 +1,288 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera.h>
+#include <ndk_camera_clock.h>
+#include <ndk_camera_event.h>
+#include <ndk_camera_executor.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_motion.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_preevent.h>
+#include <ndk_camera_recovery.h>
+#include <ndk_camera_resource.h>
+#include <ndk_camera_share.h>
+#include <ndk_camera_stats.h>
+#include <ndk_camera_sync.h>
+
+using namespace std;
+
+// - Note
+//      The callbacks don't depend on JNI. `adapter.cpp` and the host tests use
+//      the same code
+extern shared_ptr<spdlog::logger> logger;
+
+// device callbacks
+
+void context_on_device_disconnected(camera_group_t& context,
+                                    ACameraDevice* device) noexcept {
+    const char* id = ACameraDevice_getId(device);
+    logger->error("on_device_disconnect: {}", id);
+    if (context.recovery)
+        context.recovery->on_disconnected(context.get_id(device));
+}
+
+void context_on_device_error(camera_group_t& context, ACameraDevice* device,
+                             int error) noexcept {
+    const char* id = ACameraDevice_getId(device);
+    logger->error("on_device_error: {} {}", id, error);
+    if (context.recovery)
+        context.recovery->on_error(context.get_id(device), error);
+}
+
+// session state callbacks
+
+void context_on_session_active(camera_group_t& context,
+                               ACameraCaptureSession* session) noexcept {
+    logger->info("on_session_active");
+    return;
+}
+
+void context_on_session_closed(camera_group_t& context,
+                               ACameraCaptureSession* session) noexcept {
+    logger->warn("on_session_closed");
+    return;
+}
+
+void context_on_session_ready(camera_group_t& context,
+                              ACameraCaptureSession* session) noexcept {
+    logger->info("on_session_ready");
+    return;
+}
+
+// capture callbacks
+
+void context_on_capture_started(camera_group_t& context,
+                                ACameraCaptureSession* session,
+                                const ACaptureRequest* request,
+                                uint64_t time_point) noexcept {
+    perf_scope_t scope{perf_stage_t::capture_started};
+    logger->debug("context_on_capture_started  : {}", time_point);
+
+    // time-to-first-frame. only the first one after `start_repeat` is marked
+    const auto id = context.get_id(session);
+    if (id < camera_group_t::max_camera_count) {
+        int64_t expected = 0;
+        context.timing_set[id].first_frame.compare_exchange_strong(
+            expected, startup_timing_t::now());
+        // the earliest callback of the frame. the least delay for the model
+        if (auto clock = context.clock_set[id])
+            clock->update(static_cast<int64_t>(time_point));
+    }
+    if (context.event_channel) {
+        capture_event_t event{};
+        event.type = static_cast<uint16_t>(capture_event_type_t::started);
+        event.id = id;
+        event.timestamp = static_cast<int64_t>(time_point);
+        push_capture_event(context, event);
+    }
+    return;
+}
+
+void context_on_capture_progressed(camera_group_t& context,
+                                   ACameraCaptureSession* session,
+                                   ACaptureRequest* request,
+                                   const ACameraMetadata* result) noexcept {
+    camera_status_t status = ACAMERA_OK;
+    ACameraMetadata_const_entry entry{};
+    uint64_t time_point = 0;
+    // ACAMERA_SENSOR_TIMESTAMP
+    // ACAMERA_SENSOR_FRAME_DURATION
+    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE is in `clock_model_t`
+    status =
+        ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_TIMESTAMP, &entry);
+    if (status == ACAMERA_OK)
+        time_point = static_cast<uint64_t>(*(entry.data.i64));
+
+    logger->debug("context_on_capture_progressed: {}", time_point);
+    const auto id = context.get_id(session);
+    if (id >= camera_group_t::max_camera_count || time_point == 0)
+        return;
+    if (auto clock = context.clock_set[id])
+        clock->update(static_cast<int64_t>(time_point));
+    return;
+}
+
+void context_on_capture_completed(camera_group_t& context,
+                                  ACameraCaptureSession* session,
+                                  ACaptureRequest* request,
+                                  const ACameraMetadata* result) noexcept {
+    // ACAMERA_SENSOR_TIMESTAMP
+    // ACAMERA_SENSOR_FRAME_DURATION
+    // ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE is in `clock_model_t`
+    perf_scope_t scope{perf_stage_t::capture_completed};
+    const auto id = context.get_id(session);
+    capture_result_t capture{};
+    const auto status = read_capture_result(id, result, capture);
+
+    logger->debug("context_on_capture_completed: {}", capture.timestamp);
+    if (status != ACAMERA_OK || id >= camera_group_t::max_camera_count)
+        return;
+
+    if (auto clock = context.clock_set[id]) {
+        clock->update(capture.timestamp);
+        capture.mapped_timestamp =
+            clock->map(capture.timestamp, capture.confidence);
+    }
+
+    if (context.synchronizer)
+        context.synchronizer->push(id, capture.timestamp);
+    if (auto statistics = context.statistics_set[id])
+        statistics->update(capture);
+    if (auto publisher = context.publisher_set[id])
+        publisher->update(capture);
+    if (context.event_channel) {
+        capture_event_t event{};
+        event.type = static_cast<uint16_t>(capture_event_type_t::completed);
+        event.id = id;
+        event.timestamp = capture.timestamp;
+        event.exposure_time = capture.exposure_time;
+        event.frame_duration = capture.frame_duration;
+        event.sensitivity = capture.sensitivity;
+        push_capture_event(context, event);
+    }
+    return;
+}
+
+void context_on_capture_failed(camera_group_t& context,
+                               ACameraCaptureSession* session,
+                               ACaptureRequest* request,
+                               ACameraCaptureFailure* failure) noexcept {
+    logger->error("context_on_capture_failed {} {} {} {}", failure->frameNumber,
+                  failure->reason, failure->sequenceId,
+                  failure->wasImageCaptured);
+    if (context.event_channel) {
+        capture_event_t event{};
+        event.type = static_cast<uint16_t>(capture_event_type_t::failed);
+        event.id = context.get_id(session);
+        event.sequence = failure->sequenceId;
+        event.frame_number = failure->frameNumber;
+        event.reason = static_cast<int16_t>(failure->reason);
+        event.captured = failure->wasImageCaptured;
+        push_capture_event(context, event);
+    }
+    return;
+}
+
+void context_on_capture_buffer_lost(camera_group_t& context,
+                                    ACameraCaptureSession* session,
+                                    ACaptureRequest* request,
+                                    ANativeWindow* window,
+                                    int64_t frameNumber) noexcept {
+    logger->error("context_on_capture_buffer_lost");
+    if (context.event_channel) {
+        capture_event_t event{};
+        event.type = static_cast<uint16_t>(capture_event_type_t::buffer_lost);
+        event.id = context.get_id(session);
+        event.frame_number = frameNumber;
+        push_capture_event(context, event);
+    }
+    return;
+}
+
+void context_on_capture_sequence_abort(camera_group_t& context,
+                                       ACameraCaptureSession* session,
+                                       int sequenceId) noexcept {
+    logger->error("context_on_capture_sequence_abort");
+    return;
+}
+
+void context_on_capture_sequence_complete(camera_group_t& context,
+                                          ACameraCaptureSession* session,
+                                          int sequenceId,
+                                          int64_t frameNumber) noexcept {
+    logger->debug("context_on_capture_sequence_complete");
+    return;
+}
+
+// image reader callbacks
+
+// the analysis and the consumer. in the image listener or the executor
+static void process_image(camera_group_t& context, uint16_t id,
+                          tracked_image_ptr image) noexcept {
+    frame_info_t info{id, 0, true, 0, 0};
+    AImage_getTimestamp(image.get(), &info.timestamp);
+    if (auto clock = context.clock_set[id])
+        info.mapped_timestamp = clock->map(info.timestamp, info.confidence);
+
+    // every frame. the capture result waits for the statistics
+    if (auto statistics = context.statistics_set[id]) {
+        perf_scope_t scope{perf_stage_t::statistics};
+        statistics->update(image.get());
+    }
+
+    // static frames end here. before any conversion or consumer
+    if (auto gate = context.motion_gate_set[id]) {
+        {
+            perf_scope_t scope{perf_stage_t::motion};
+            gate->update(image.get(), info.motion);
+        }
+        if (info.motion == false && gate->get_config().drop_static)
+            return;
+    }
+    if (auto ring = context.preevent_set[id]) {
+        perf_scope_t scope{perf_stage_t::preevent};
+        ring->push(image.get());
+    }
+    if (auto publisher = context.publisher_set[id]) {
+        perf_scope_t scope{perf_stage_t::publish};
+        publisher->publish(image.get());
+    }
+
+    // the consumer releases it with `release_image`
+    if (context.image_consumer) {
+        perf_scope_t scope{perf_stage_t::consume};
+        return context.image_consumer(context.image_consumer_context,
+                                      image.release(), info);
+    }
+}
+
+static void dispatch_image(camera_group_t& context, uint16_t id,
+                           AImageReader* reader) noexcept {
+    // stale images are not worth to analyze
+    AImage* ptr = nullptr;
+    if (AImageReader_acquireLatestImage(reader, &ptr) != AMEDIA_OK)
+        return;
+    const auto bytes = context.resources ? get_image_bytes(ptr) : 0;
+    auto image = make_tracked<resource_type_t::image>(
+        ptr, AImage_delete, context.resources, id, bytes, NDCAM_RESOURCE_SITE);
+
+    // the listener thread of NDK can't be placed. move to the executor's
+    if (auto executor = context.executor) {
+        const auto deleter = image.get_deleter();
+        auto task = [&context, id, ptr, deleter]() {
+            process_image(context, id, tracked_image_ptr{ptr, deleter});
+        };
+        if (executor->submit(executor_lane_t::dispatch, task)) {
+            image.release(); // owned by the task
+            return;
+        }
+    }
+    process_image(context, id, move(image));
+}
+
+void context_on_image_available(camera_group_t& context,
+                                AImageReader* reader) noexcept {
+    perf_scope_t scope{perf_stage_t::image_available};
+    const auto id = context.get_id(reader);
+    if (id >= camera_group_t::max_camera_count)
+        return;
+    // counted before the check. if the reader is still in the slot,
+    // `close_reader` waits for the count
+    auto& listeners = context.listener_set[id];
+    listeners.fetch_add(1);
+    if (context.reader_set[id] == reader)
+        dispatch_image(context, id, reader);
+    listeners.fetch_sub(1);
+}
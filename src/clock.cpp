@@ -0,0 +1,218 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_clock.h>
+#include <ndk_camera_log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// the callbacks of the frames are not ordered. started of the next frame can
+// come before completed of this one
+static constexpr int64_t max_backward = 1'000'000'000;
+
+auto get_clock_time(clock_domain_t domain) noexcept -> int64_t {
+    timespec ts{};
+    clock_gettime(domain == clock_domain_t::boottime ? CLOCK_BOOTTIME
+                                                     : CLOCK_MONOTONIC,
+                  &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+// domain - CLOCK_BOOTTIME. changes after the suspend
+static int64_t get_boottime_offset(clock_domain_t domain) noexcept {
+    if (domain == clock_domain_t::boottime)
+        return 0;
+    const auto before = get_clock_time(domain);
+    const auto boottime = get_clock_time(clock_domain_t::boottime);
+    const auto after = get_clock_time(domain);
+    return before + (after - before) / 2 - boottime;
+}
+
+clock_model_t::clock_model_t(const clock_model_config_t& _config) noexcept
+    : config{_config} {
+    config.block = max(config.block, 1u);
+    config.points = clamp(config.points, 2u,
+                          static_cast<uint32_t>(max_point_count));
+    config.tolerance = max<int64_t>(config.tolerance, 1);
+}
+
+auto clock_model_t::set_source(const ACameraMetadata* characteristics) noexcept
+    -> camera_status_t {
+    ACameraMetadata_const_entry entry{};
+    const auto status = ACameraMetadata_getConstEntry(
+        characteristics, ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, &entry);
+    if (status != ACAMERA_OK)
+        return status;
+    set_source(entry.data.u8[0]);
+    return ACAMERA_OK;
+}
+
+void clock_model_t::set_source(uint8_t _source) noexcept {
+    unique_lock lck{mtx};
+    source = state.source = _source;
+    if (source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME) {
+        state.offset = get_boottime_offset(config.domain);
+        state.drift = 0;
+        state.confidence = 1;
+        return;
+    }
+    clear();
+}
+
+void clock_model_t::update(int64_t sensor_timestamp) noexcept {
+    update(sensor_timestamp, get_clock_time(config.domain));
+}
+
+void clock_model_t::update(int64_t sensor, int64_t arrival) noexcept {
+    if (sensor <= 0)
+        return;
+    unique_lock lck{mtx};
+    if (sensor < last_sensor - max_backward) {
+        logger->warn("clock_model: sensor timestamp went back {} -> {}",
+                     last_sensor, sensor);
+        clear();
+        state.resets += 1;
+    }
+    last_sensor = max(last_sensor, sensor);
+    state.observed += 1;
+
+    const auto delay = arrival - sensor;
+    if (count == 0 || delay < least.delay)
+        least = point_t{sensor, delay};
+    delay_sum += delay;
+    if (++count < config.block)
+        return;
+    add_block();
+    count = 0;
+    delay_sum = 0;
+}
+
+void clock_model_t::add_block() noexcept {
+    const auto average = delay_sum / count;
+    if (source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME) {
+        // exact. the points are not needed
+        state.offset = get_boottime_offset(config.domain);
+        state.latency = average - state.offset;
+        return;
+    }
+    if (point_count) {
+        const auto x = static_cast<double>(least.sensor - state.reference);
+        const auto line = state.offset + llround(state.drift * x);
+        const auto diff = least.delay - line;
+        const auto limit = config.tolerance * 16;
+        // a stall delays all callbacks of the block. wait for the next one
+        if (diff > limit && ++outliers < 2)
+            return;
+        if (diff < -limit || diff > limit) {
+            logger->warn("clock_model: clock jump {}", diff);
+            clear();
+            state.resets += 1;
+        }
+    }
+    outliers = 0;
+    const auto capacity = config.points;
+    if (point_count == capacity) {
+        head = (head + 1) % capacity;
+        point_count -= 1;
+    }
+    points[(head + point_count) % capacity] = least;
+    point_count += 1;
+    fit();
+    state.latency = average - least.delay;
+}
+
+void clock_model_t::fit() noexcept {
+    const auto capacity = config.points;
+    const auto& newest = points[(head + point_count - 1) % capacity];
+    state.reference = newest.sensor;
+    state.points = point_count;
+    if (point_count == 1) {
+        state.offset = newest.delay;
+        state.drift = 0;
+        state.residual = config.tolerance;
+    } else {
+        // centered on the means. x is nanosecond from the reference
+        double mx = 0, my = 0;
+        for (auto i = 0u; i < point_count; ++i) {
+            const auto& p = points[(head + i) % capacity];
+            mx += static_cast<double>(p.sensor - newest.sensor);
+            my += static_cast<double>(p.delay);
+        }
+        mx /= point_count;
+        my /= point_count;
+        double sxx = 0, sxy = 0;
+        for (auto i = 0u; i < point_count; ++i) {
+            const auto& p = points[(head + i) % capacity];
+            const auto dx = static_cast<double>(p.sensor - newest.sensor) - mx;
+            sxx += dx * dx;
+            sxy += dx * (static_cast<double>(p.delay) - my);
+        }
+        const auto drift = sxx > 0 ? sxy / sxx : 0.0;
+        const auto offset = my - drift * mx;
+        double squared = 0;
+        for (auto i = 0u; i < point_count; ++i) {
+            const auto& p = points[(head + i) % capacity];
+            const auto x = static_cast<double>(p.sensor - newest.sensor);
+            const auto e = static_cast<double>(p.delay) - (offset + drift * x);
+            squared += e * e;
+        }
+        state.offset = llround(offset);
+        state.drift = drift;
+        state.residual = llround(sqrt(squared / point_count));
+    }
+    // more points, and less jitter of them
+    const auto fill = static_cast<double>(point_count) / capacity;
+    const auto tolerance = static_cast<double>(config.tolerance);
+    state.confidence = static_cast<float>(
+        fill * tolerance / (tolerance + static_cast<double>(state.residual)));
+}
+
+auto clock_model_t::map(int64_t sensor, float& confidence) const noexcept
+    -> int64_t {
+    unique_lock lck{mtx};
+    if (source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME) {
+        confidence = 1;
+        return sensor + state.offset;
+    }
+    confidence = state.confidence;
+    if (state.points == 0)
+        return sensor;
+    const auto x = static_cast<double>(sensor - state.reference);
+    return sensor + state.offset + llround(state.drift * x);
+}
+
+// `resets` is kept
+void clock_model_t::clear() noexcept {
+    count = 0;
+    delay_sum = 0;
+    last_sensor = 0;
+    outliers = 0;
+    head = point_count = 0;
+    state.offset = state.reference = 0;
+    state.drift = 0;
+    state.residual = state.latency = 0;
+    state.points = 0;
+    state.observed = 0;
+    state.confidence = 0;
+}
+
+void clock_model_t::reset() noexcept {
+    unique_lock lck{mtx};
+    clear();
+    if (source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME) {
+        state.offset = get_boottime_offset(config.domain);
+        state.confidence = 1;
+    }
+}
+
+auto clock_model_t::get_state() const noexcept -> clock_state_t {
+    unique_lock lck{mtx};
+    return state;
+}
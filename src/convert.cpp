@@ -0,0 +1,464 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_convert.h>
+#include <ndk_camera_perf.h>
+
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDCAM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NDCAM_SSE2 1
+#endif
+
+using namespace std;
+
+// tile of 32x32 RGBA pixels is 4 KB. both of the source and destination
+// lines of a tile stay in L1 while it is transposed
+static constexpr uint32_t tile = 32;
+
+auto get_yuv_planes(const AImage* image, yuv_planes_t& planes) noexcept
+    -> media_status_t {
+    frame_view_t frame{};
+    if (auto status = get_frame_view(image, frame))
+        return status;
+    return get_yuv_planes(frame, planes);
+}
+
+auto get_yuv_planes(const frame_view_t& frame, yuv_planes_t& planes) noexcept
+    -> media_status_t {
+    if (frame.format != AIMAGE_FORMAT_YUV_420_888 || frame.plane_count != 3)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    const auto& y = frame.planes[0];
+    const auto& u = frame.planes[1];
+    const auto& v = frame.planes[2];
+    if (y.is_packed() == false || u.row_stride != v.row_stride ||
+        u.pixel_stride != v.pixel_stride)
+        return AMEDIA_ERROR_UNSUPPORTED;
+
+    planes.y = y.data.data();
+    planes.u = u.data.data();
+    planes.v = v.data.data();
+    planes.y_row_stride = y.row_stride;
+    planes.uv_row_stride = u.row_stride;
+    planes.uv_pixel_stride = u.pixel_stride;
+    planes.width = frame.width;
+    planes.height = frame.height;
+    return AMEDIA_OK;
+}
+
+auto get_orientation(uint16_t facing, int32_t sensor_orientation,
+                     int32_t device_orientation) noexcept
+    -> frame_orientation_t {
+    device_orientation = (device_orientation % 360 + 360) % 360;
+    device_orientation = (device_orientation + 45) / 90 * 90 % 360;
+    sensor_orientation = (sensor_orientation % 360 + 360) % 360;
+
+    frame_orientation_t orientation{};
+    // front lens rotates in the opposite direction, and the viewer expects
+    // a mirror
+    if (facing == ACAMERA_LENS_FACING_FRONT) {
+        orientation.rotation = static_cast<uint16_t>(
+            (sensor_orientation - device_orientation + 360) % 360);
+        orientation.mirror = true;
+    } else {
+        orientation.rotation = static_cast<uint16_t>(
+            (sensor_orientation + device_orientation) % 360);
+        orientation.mirror = false;
+    }
+    return orientation;
+}
+
+auto get_orientation(camera_group_t& context, uint16_t id,
+                     int32_t device_orientation) noexcept
+    -> frame_orientation_t {
+    return get_orientation(context.get_facing(id),
+                           context.get_sensor_orientation(id),
+                           device_orientation);
+}
+
+void get_oriented_size(uint32_t width, uint32_t height,
+                       frame_orientation_t orientation, uint32_t& out_width,
+                       uint32_t& out_height) noexcept {
+    const bool swapped =
+        orientation.rotation == 90 || orientation.rotation == 270;
+    out_width = swapped ? height : width;
+    out_height = swapped ? width : height;
+}
+
+static uint32_t load_u32(const uint8_t* ptr) noexcept {
+    uint32_t value = 0;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static uint8_t clamp_u8(int32_t value) noexcept {
+    return static_cast<uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// BT.601 full range in 6 bit fixed point. SIMD paths use the same math
+static uint32_t yuv_to_rgba(int32_t y, int32_t u, int32_t v) noexcept {
+    u -= 128;
+    v -= 128;
+    const uint32_t r = clamp_u8(y + ((90 * v) >> 6));
+    const uint32_t g = clamp_u8(y - ((22 * u + 46 * v) >> 6));
+    const uint32_t b = clamp_u8(y + ((113 * u) >> 6));
+    return r | g << 8 | b << 16 | 0xFF000000u; // R, G, B, A in memory
+}
+
+// convert `count` pixels from the even column `x0` of the row
+static void convert_row(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint32_t uv_pixel_stride, uint32_t x0, uint32_t count,
+                        uint32_t* out) noexcept {
+    const auto ps = uv_pixel_stride;
+    y += x0;
+    u += x0 / 2 * ps;
+    v += x0 / 2 * ps;
+    auto x = 0u;
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+    // interleaved chroma reads 1 more byte for the other plane
+    const auto guard = ps == 2 ? 1u : 0u;
+    if (ps == 1 || ps == 2)
+        for (; x + 8 + guard <= count; x += 8) {
+#if defined(NDCAM_NEON)
+            const auto yy = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x)));
+            uint8x8_t cu{}, cv{};
+            if (ps == 1) {
+                cu = vcreate_u8(load_u32(u + x / 2));
+                cv = vcreate_u8(load_u32(v + x / 2));
+            } else {
+                cu = vuzp_u8(vld1_u8(u + x), vld1_u8(u + x)).val[0];
+                cv = vuzp_u8(vld1_u8(v + x), vld1_u8(v + x)).val[0];
+            }
+            const auto bias = vdup_n_u8(128);
+            const auto su = vreinterpretq_s16_u16(
+                vsubl_u8(vzip_u8(cu, cu).val[0], bias));
+            const auto sv = vreinterpretq_s16_u16(
+                vsubl_u8(vzip_u8(cv, cv).val[0], bias));
+
+            const auto r = vaddq_s16(yy, vshrq_n_s16(vmulq_n_s16(sv, 90), 6));
+            const auto g = vsubq_s16(
+                yy, vshrq_n_s16(vmlaq_n_s16(vmulq_n_s16(su, 22), sv, 46), 6));
+            const auto b = vaddq_s16(yy, vshrq_n_s16(vmulq_n_s16(su, 113), 6));
+            uint8x8x4_t rgba{};
+            rgba.val[0] = vqmovun_s16(r);
+            rgba.val[1] = vqmovun_s16(g);
+            rgba.val[2] = vqmovun_s16(b);
+            rgba.val[3] = vdup_n_u8(255);
+            vst4_u8(reinterpret_cast<uint8_t*>(out + x), rgba);
+#elif defined(NDCAM_SSE2)
+            const auto zero = _mm_setzero_si128();
+            const auto yy = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)),
+                zero);
+            __m128i cu{}, cv{};
+            if (ps == 1) {
+                const auto u4 = static_cast<int>(load_u32(u + x / 2));
+                const auto v4 = static_cast<int>(load_u32(v + x / 2));
+                cu = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero);
+                cv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero);
+            } else {
+                const auto mask = _mm_set1_epi16(0x00FF);
+                cu = _mm_and_si128(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x)),
+                    mask);
+                cv = _mm_and_si128(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x)),
+                    mask);
+            }
+            const auto bias = _mm_set1_epi16(128);
+            const auto su = _mm_sub_epi16(_mm_unpacklo_epi16(cu, cu), bias);
+            const auto sv = _mm_sub_epi16(_mm_unpacklo_epi16(cv, cv), bias);
+
+            const auto r = _mm_add_epi16(
+                yy, _mm_srai_epi16(_mm_mullo_epi16(sv, _mm_set1_epi16(90)), 6));
+            const auto g = _mm_sub_epi16(
+                yy, _mm_srai_epi16(
+                        _mm_add_epi16(_mm_mullo_epi16(su, _mm_set1_epi16(22)),
+                                      _mm_mullo_epi16(sv, _mm_set1_epi16(46))),
+                        6));
+            const auto b = _mm_add_epi16(
+                yy,
+                _mm_srai_epi16(_mm_mullo_epi16(su, _mm_set1_epi16(113)), 6));
+            const auto r8 = _mm_packus_epi16(r, r);
+            const auto g8 = _mm_packus_epi16(g, g);
+            const auto b8 = _mm_packus_epi16(b, b);
+            const auto a8 = _mm_set1_epi8(-1);
+            const auto rg = _mm_unpacklo_epi8(r8, g8);
+            const auto ba = _mm_unpacklo_epi8(b8, a8);
+            auto* p = reinterpret_cast<__m128i*>(out + x);
+            _mm_storeu_si128(p + 0, _mm_unpacklo_epi16(rg, ba));
+            _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(rg, ba));
+#endif
+        }
+#endif
+    for (; x < count; ++x) {
+        const auto c = x / 2 * ps;
+        out[x] = yuv_to_rgba(y[x], u[c], v[c]);
+    }
+}
+
+static auto row_of(uint8_t* dst, uint32_t row_stride, int64_t y) noexcept
+    -> uint32_t* {
+    return reinterpret_cast<uint32_t*>(dst + y * row_stride);
+}
+
+/**
+ * Write the transposed tile.
+ * `buf[i * tile + j]` goes to (dx0 + i * dx_step, dy0 + j * dy_step)
+ */
+static void transpose_tile(const uint32_t* buf, uint32_t rows, uint32_t cols,
+                           uint8_t* dst, uint32_t dst_row_stride, int64_t dx0,
+                           int64_t dx_step, int64_t dy0,
+                           int64_t dy_step) noexcept {
+    auto rows4 = 0u, cols4 = 0u;
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+    rows4 = rows & ~3u;
+    cols4 = cols & ~3u;
+    for (auto j = 0u; j < cols4; j += 4) {
+        uint32_t* out[4]{};
+        for (auto k = 0u; k < 4; ++k)
+            out[k] = row_of(dst, dst_row_stride, dy0 + (j + k) * dy_step);
+
+        for (auto i = 0u; i < rows4; i += 4) {
+            const auto* src = buf + i * tile + j;
+            // lanes of i .. i+3 are stored in the increasing order of dx
+            const auto dx = dx_step > 0 ? dx0 + i : dx0 - i - 3;
+#if defined(NDCAM_NEON)
+            const auto p = vtrnq_u32(vld1q_u32(src), vld1q_u32(src + tile));
+            const auto q = vtrnq_u32(vld1q_u32(src + 2 * tile),
+                                     vld1q_u32(src + 3 * tile));
+            uint32x4_t c[4] = {
+                vcombine_u32(vget_low_u32(p.val[0]), vget_low_u32(q.val[0])),
+                vcombine_u32(vget_low_u32(p.val[1]), vget_low_u32(q.val[1])),
+                vcombine_u32(vget_high_u32(p.val[0]), vget_high_u32(q.val[0])),
+                vcombine_u32(vget_high_u32(p.val[1]), vget_high_u32(q.val[1])),
+            };
+            for (auto k = 0u; k < 4; ++k) {
+                if (dx_step < 0) {
+                    const auto r = vrev64q_u32(c[k]);
+                    c[k] = vcombine_u32(vget_high_u32(r), vget_low_u32(r));
+                }
+                vst1q_u32(out[k] + dx, c[k]);
+            }
+#elif defined(NDCAM_SSE2)
+            const auto* s = reinterpret_cast<const __m128i*>(src);
+            const auto r0 = _mm_loadu_si128(s);
+            const auto r1 = _mm_loadu_si128(s + tile / 4);
+            const auto r2 = _mm_loadu_si128(s + 2 * tile / 4);
+            const auto r3 = _mm_loadu_si128(s + 3 * tile / 4);
+            const auto t0 = _mm_unpacklo_epi32(r0, r1);
+            const auto t1 = _mm_unpacklo_epi32(r2, r3);
+            const auto t2 = _mm_unpackhi_epi32(r0, r1);
+            const auto t3 = _mm_unpackhi_epi32(r2, r3);
+            __m128i c[4] = {
+                _mm_unpacklo_epi64(t0, t1),
+                _mm_unpackhi_epi64(t0, t1),
+                _mm_unpacklo_epi64(t2, t3),
+                _mm_unpackhi_epi64(t2, t3),
+            };
+            for (auto k = 0u; k < 4; ++k) {
+                if (dx_step < 0)
+                    c[k] = _mm_shuffle_epi32(c[k], _MM_SHUFFLE(0, 1, 2, 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out[k] + dx), c[k]);
+            }
+#endif
+        }
+    }
+#endif
+    for (auto j = 0u; j < cols; ++j) {
+        auto* out = row_of(dst, dst_row_stride, dy0 + j * dy_step);
+        for (auto i = j < cols4 ? rows4 : 0u; i < rows; ++i)
+            out[dx0 + i * dx_step] = buf[i * tile + j];
+    }
+}
+
+void convert_yuv_to_rgba(const yuv_planes_t& src, uint8_t* dst,
+                         uint32_t dst_row_stride,
+                         frame_orientation_t orientation) noexcept {
+    perf_scope_t scope{perf_stage_t::convert};
+    const auto width = src.width;
+    const auto height = src.height;
+    const auto rotation = orientation.rotation;
+    alignas(16) uint32_t buf[tile * tile];
+
+    auto convert = [&src](uint32_t y, uint32_t x0, uint32_t count,
+                          uint32_t* out) {
+        const auto cy = y / 2;
+        convert_row(src.y + y * src.y_row_stride,
+                    src.u + cy * src.uv_row_stride,
+                    src.v + cy * src.uv_row_stride, src.uv_pixel_stride, x0,
+                    count, out);
+    };
+
+    // rows are kept. reverse the columns in the tile buffer if needed
+    if (rotation != 90 && rotation != 270) {
+        const bool flip = rotation == 180;
+        const bool reverse = flip != orientation.mirror;
+        for (auto y = 0u; y < height; ++y) {
+            auto* out = row_of(dst, dst_row_stride, flip ? height - 1 - y : y);
+            if (reverse == false) {
+                convert(y, 0, width, out);
+                continue;
+            }
+            for (auto x0 = 0u; x0 < width; x0 += tile) {
+                const auto count = min(tile, width - x0);
+                convert(y, x0, count, buf);
+                reverse_copy(buf, buf + count, out + (width - x0 - count));
+            }
+        }
+        return;
+    }
+
+    // source column becomes the destination row.
+    // 90 : (x, y) -> (height - 1 - y, x)
+    // 270: (x, y) -> (y, width - 1 - x)
+    // and then mirroring reverses the destination column
+    for (auto y0 = 0u; y0 < height; y0 += tile) {
+        const auto rows = min(tile, height - y0);
+        int64_t dx0 = rotation == 90 ? height - 1 - y0 : y0;
+        int64_t dx_step = rotation == 90 ? -1 : 1;
+        if (orientation.mirror) {
+            dx0 = height - 1 - dx0;
+            dx_step = -dx_step;
+        }
+        for (auto x0 = 0u; x0 < width; x0 += tile) {
+            const auto cols = min(tile, width - x0);
+            for (auto i = 0u; i < rows; ++i)
+                convert(y0 + i, x0, cols, buf + i * tile);
+
+            const int64_t dy0 = rotation == 90 ? x0 : width - 1 - x0;
+            transpose_tile(buf, rows, cols, dst, dst_row_stride, dx0, dx_step,
+                           dy0, rotation == 90 ? 1 : -1);
+        }
+    }
+}
+
+void convert_yuv_to_rgba(const frame_view_t& src, uint8_t* dst,
+                         uint32_t dst_row_stride,
+                         frame_orientation_t orientation) noexcept {
+    yuv_planes_t planes{};
+    if (get_yuv_planes(src, planes) == AMEDIA_OK)
+        return convert_yuv_to_rgba(planes, dst, dst_row_stride, orientation);
+    // nearest-neighbor of the same size visits each pixel once
+    uint32_t width = 0, height = 0;
+    get_oriented_size(src.width, src.height, orientation, width, height);
+    resize_yuv_to_rgba(src, dst, width, height, dst_row_stride, orientation);
+}
+
+// nearest-neighbor mapping of 1 axis
+struct axis_t final {
+    uint32_t src_size;
+    uint32_t dst_size;
+    bool reverse;
+
+    void fill(uint32_t d0, uint32_t count, uint32_t* table) const noexcept {
+        for (auto i = 0u; i < count; ++i) {
+            const uint64_t d = d0 + i;
+            const auto s =
+                static_cast<uint32_t>((2 * d + 1) * src_size / (2 * dst_size));
+            table[i] = reverse ? src_size - 1 - s : s;
+        }
+    }
+};
+
+/**
+ * Visit the destination in tiles and sample the source with `fetch(x, y)`.
+ * For 90/270, the destination x axis follows the source y axis
+ */
+template <typename T, typename Fetch>
+static void resize_oriented(uint32_t width, uint32_t height, uint8_t* dst,
+                            uint32_t dst_width, uint32_t dst_height,
+                            uint32_t dst_row_stride,
+                            frame_orientation_t orientation,
+                            Fetch&& fetch) noexcept {
+    if (width == 0 || height == 0 || dst_width == 0 || dst_height == 0)
+        return;
+    perf_scope_t scope{perf_stage_t::resize};
+    const auto rotation = orientation.rotation;
+    const bool swapped = rotation == 90 || rotation == 270;
+    axis_t ax{swapped ? height : width, dst_width, false};
+    axis_t ay{swapped ? width : height, dst_height, false};
+    // see the mapping of `convert_yuv_to_rgba`
+    ax.reverse = rotation == 90 || rotation == 180;
+    ay.reverse = rotation == 180 || rotation == 270;
+    if (orientation.mirror)
+        ax.reverse = !ax.reverse;
+
+    uint32_t tx[tile]{}, ty[tile]{};
+    for (auto dy0 = 0u; dy0 < dst_height; dy0 += tile) {
+        const auto rows = min(tile, dst_height - dy0);
+        ay.fill(dy0, rows, ty);
+        for (auto dx0 = 0u; dx0 < dst_width; dx0 += tile) {
+            const auto cols = min(tile, dst_width - dx0);
+            ax.fill(dx0, cols, tx);
+            for (auto j = 0u; j < rows; ++j) {
+                auto* out = reinterpret_cast<T*>(
+                                dst + (dy0 + j) * dst_row_stride) +
+                            dx0;
+                if (swapped)
+                    for (auto i = 0u; i < cols; ++i)
+                        out[i] = fetch(ty[j], tx[i]);
+                else
+                    for (auto i = 0u; i < cols; ++i)
+                        out[i] = fetch(tx[i], ty[j]);
+            }
+        }
+    }
+}
+
+void resize_yuv_to_rgba(const yuv_planes_t& src, uint8_t* dst,
+                        uint32_t dst_width, uint32_t dst_height,
+                        uint32_t dst_row_stride,
+                        frame_orientation_t orientation) noexcept {
+    resize_oriented<uint32_t>(
+        src.width, src.height, dst, dst_width, dst_height, dst_row_stride,
+        orientation, [&src](uint32_t x, uint32_t y) {
+            const auto c =
+                y / 2 * src.uv_row_stride + x / 2 * src.uv_pixel_stride;
+            return yuv_to_rgba(src.y[y * src.y_row_stride + x], src.u[c],
+                               src.v[c]);
+        });
+}
+
+void resize_plane(const uint8_t* src, uint32_t src_row_stride,
+                  uint32_t src_width, uint32_t src_height, uint8_t* dst,
+                  uint32_t dst_width, uint32_t dst_height,
+                  uint32_t dst_row_stride,
+                  frame_orientation_t orientation) noexcept {
+    resize_oriented<uint8_t>(
+        src_width, src_height, dst, dst_width, dst_height, dst_row_stride,
+        orientation, [src, src_row_stride](uint32_t x, uint32_t y) {
+            return src[y * src_row_stride + x];
+        });
+}
+
+void resize_yuv_to_rgba(const frame_view_t& src, uint8_t* dst,
+                        uint32_t dst_width, uint32_t dst_height,
+                        uint32_t dst_row_stride,
+                        frame_orientation_t orientation) noexcept {
+    if (src.format != AIMAGE_FORMAT_YUV_420_888 || src.plane_count != 3)
+        return;
+    const auto& luma = src.planes[0];
+    const auto& u = src.planes[1];
+    const auto& v = src.planes[2];
+    resize_oriented<uint32_t>(
+        src.width, src.height, dst, dst_width, dst_height, dst_row_stride,
+        orientation, [&luma, &u, &v](uint32_t x, uint32_t y) {
+            return yuv_to_rgba(luma.at(x, y), u.at(x / 2, y / 2),
+                               v.at(x / 2, y / 2));
+        });
+}
+
+void resize_plane(const plane_view_t& src, uint8_t* dst, uint32_t dst_width,
+                  uint32_t dst_height, uint32_t dst_row_stride,
+                  frame_orientation_t orientation) noexcept {
+    resize_oriented<uint8_t>(
+        src.width, src.height, dst, dst_width, dst_height, dst_row_stride,
+        orientation,
+        [&src](uint32_t x, uint32_t y) { return src.at(x, y); });
+}
@@ -0,0 +1,110 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_event.h>
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+
+using namespace std;
+
+static_assert(offsetof(capture_event_t, frame_number) == 8, "");
+static_assert(offsetof(capture_event_t, timestamp) == 16, "");
+static_assert(offsetof(capture_event_t, sensitivity) == 40, "");
+
+static uint32_t round_capacity(uint32_t capacity) noexcept {
+    uint32_t result = 16;
+    while (result < capacity && result < 65536)
+        result <<= 1;
+    return result;
+}
+
+event_channel_t::event_channel_t(uint32_t capacity) noexcept
+    : storage{}, length{}, header{}, records{} {
+    capacity = round_capacity(capacity);
+    length = header_size + capacity * sizeof(capture_event_t);
+    storage.reset(new (nothrow) uint8_t[length]{});
+    if (storage == nullptr) {
+        length = 0;
+        return;
+    }
+    header = new (storage.get()) header_t{};
+    header->capacity = capacity;
+    records = reinterpret_cast<capture_event_t*>(storage.get() + header_size);
+}
+
+bool event_channel_t::push(const capture_event_t& event) noexcept {
+    unique_lock lck{mtx};
+    const auto head = header->head.load(memory_order_relaxed);
+    const auto tail = header->tail.load(memory_order_acquire);
+    if (head - tail >= header->capacity) {
+        header->dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    memcpy(records + (head & (header->capacity - 1)), &event, sizeof(event));
+    header->head.store(head + 1, memory_order_release);
+    return true;
+}
+
+uint32_t event_channel_t::poll(uint32_t consumed) noexcept {
+    const auto head = header->head.load(memory_order_acquire);
+    auto tail = header->tail.load(memory_order_relaxed);
+    // can't release more than written
+    tail += min(consumed, head - tail);
+    header->tail.store(tail, memory_order_release);
+    return head - tail;
+}
+
+uint32_t event_channel_t::drain(gsl::span<capture_event_t> events) noexcept {
+    const auto count = min<uint32_t>(poll(0), events.size());
+    const auto tail = header->tail.load(memory_order_relaxed);
+    for (auto i = 0u; i < count; ++i)
+        events[i] = records[(tail + i) & (header->capacity - 1)];
+    poll(count);
+    return count;
+}
+
+uint32_t event_channel_t::get_capacity() const noexcept {
+    return header->capacity;
+}
+
+uint32_t event_channel_t::get_dropped() const noexcept {
+    return header->dropped.load(memory_order_relaxed);
+}
+
+// the pusher is counted in the current epoch before it loads the channel.
+// if it sees the channel, `detach_event_channel` waits for its epoch
+void push_capture_event(camera_group_t& context,
+                        const capture_event_t& event) noexcept {
+    while (true) {
+        const auto epoch = context.event_epoch.load();
+        auto& pushers = context.event_pushers[epoch % 2];
+        pushers.fetch_add(1);
+        // the epoch is changed before the count. count in the new one
+        if (context.event_epoch.load() != epoch) {
+            pushers.fetch_sub(1);
+            continue;
+        }
+        if (auto channel = context.event_channel.load())
+            channel->push(event);
+        pushers.fetch_sub(1);
+        return;
+    }
+}
+
+void detach_event_channel(camera_group_t& context,
+                          const event_channel_t* channel) noexcept {
+    // the pushers of an epoch must be gone before the next one ends
+    static mutex detach_mtx{};
+    unique_lock lck{detach_mtx};
+    auto expected = const_cast<event_channel_t*>(channel);
+    context.event_channel.compare_exchange_strong(expected, nullptr);
+    // the pushers may hold it even if it's replaced. the new pushers are
+    // counted in the next epoch, so the previous one drains
+    const auto epoch = context.event_epoch.fetch_add(1);
+    while (context.event_pushers[epoch % 2].load() != 0)
+        this_thread::yield();
+}
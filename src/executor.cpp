@@ -0,0 +1,340 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_executor.h>
+#include <ndk_camera_log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// "0-3,5,7-8" to the mask. the CPUs after 63 are ignored
+static uint64_t parse_cpu_list(const char* text) noexcept {
+    uint64_t mask = 0;
+    while (*text) {
+        char* end = nullptr;
+        const auto first = strtoul(text, &end, 10);
+        if (end == text)
+            break;
+        auto last = first;
+        if (*end == '-') {
+            text = end + 1;
+            last = strtoul(text, &end, 10);
+            if (end == text)
+                break;
+        }
+        for (auto cpu = first; cpu <= last && cpu < 64; ++cpu)
+            mask |= uint64_t{1} << cpu;
+        text = end;
+        if (*text == ',')
+            ++text;
+        else
+            break;
+    }
+    return mask;
+}
+
+// the first line of the file
+static bool read_line(const char* path, char* buf, size_t size) noexcept {
+    auto* stream = fopen(path, "r");
+    if (stream == nullptr)
+        return false;
+    const auto ok = fgets(buf, static_cast<int>(size), stream) != nullptr;
+    fclose(stream);
+    return ok;
+}
+
+bool read_cpu_topology(const char* root, cpu_topology_t& topology) noexcept {
+    char path[256]{}, line[256]{};
+    snprintf(path, sizeof(path), "%s/present", root);
+    if (read_line(path, line, sizeof(line)) == false)
+        return false;
+    const auto mask = parse_cpu_list(line);
+    if (mask == 0)
+        return false;
+
+    topology.cpus.clear();
+    uint32_t lowest = UINT32_MAX, highest = 0;
+    for (auto cpu = 0u; cpu < 64; ++cpu) {
+        if ((mask & (uint64_t{1} << cpu)) == 0)
+            continue;
+        cpu_info_t info{cpu, 0, core_class_t::big};
+        snprintf(path, sizeof(path), "%s/cpu%u/cpufreq/cpuinfo_max_freq", root,
+                 cpu);
+        if (read_line(path, line, sizeof(line)))
+            info.max_freq = static_cast<uint32_t>(strtoul(line, nullptr, 10));
+        if (info.max_freq) {
+            lowest = min(lowest, info.max_freq);
+            highest = max(highest, info.max_freq);
+        }
+        topology.cpus.emplace_back(info);
+    }
+    // the CPUs of unknown frequency are not little
+    if (lowest < highest)
+        for (auto& info : topology.cpus)
+            if (info.max_freq == lowest)
+                info.type = core_class_t::little;
+    return true;
+}
+
+uint64_t cpu_topology_t::get_mask(core_class_t type) const noexcept {
+    uint64_t all = 0, mask = 0;
+    for (const auto& info : cpus) {
+        all |= uint64_t{1} << info.cpu;
+        if (info.type == type)
+            mask |= uint64_t{1} << info.cpu;
+    }
+    return mask ? mask : all;
+}
+
+static int32_t get_tid() noexcept {
+    return static_cast<int32_t>(syscall(SYS_gettid));
+}
+
+// lane of the worker thread. see `is_current`
+static thread_local const void* current_lane = nullptr;
+
+camera_executor_t::camera_executor_t(const executor_config_t& config) noexcept {
+    if (read_cpu_topology(config.sysfs, topology) == false)
+        logger->warn("executor: no cpu topology in {}", config.sysfs);
+    for (const auto& info : topology.cpus)
+        if (info.type == core_class_t::little)
+            little_mask |= uint64_t{1} << info.cpu;
+
+    for (auto i = 0u; i < executor_lane_count; ++i) {
+        auto& lane = lanes[i];
+        lane.config = config.lanes[i];
+        if (lane.config.name == nullptr)
+            lane.config.name = "ndcam";
+        lane.mask = lane.config.cpu_mask;
+        if (lane.mask == 0 && lane.config.cores != core_class_t::any)
+            lane.mask = topology.get_mask(lane.config.cores);
+        for (auto t = 0u; t < lane.config.threads; ++t) {
+            auto worker = make_unique<worker_t>();
+            worker->thread = thread{&camera_executor_t::run, this, ref(lane),
+                                    ref(*worker), t};
+            lane.workers.emplace_back(move(worker));
+        }
+    }
+}
+
+camera_executor_t::~camera_executor_t() noexcept {
+    for (auto& lane : lanes) {
+        {
+            unique_lock lck{lane.mtx};
+            lane.stopping = true;
+        }
+        lane.cv.notify_all();
+    }
+    for (auto& lane : lanes)
+        for (auto& worker : lane.workers)
+            worker->thread.join();
+}
+
+void camera_executor_t::setup(lane_t& lane, worker_t& worker,
+                              uint32_t index) noexcept {
+    worker.tid = get_tid();
+    // 16 bytes with the null
+    char name[16]{};
+    snprintf(name, sizeof(name), "%s:%u", lane.config.name, index);
+    pthread_setname_np(pthread_self(), name);
+
+    if (lane.mask) {
+        cpu_set_t set{};
+        CPU_ZERO(&set);
+        for (auto cpu = 0u; cpu < 64; ++cpu)
+            if (lane.mask & (uint64_t{1} << cpu))
+                CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            logger->warn("executor: {} affinity {:x} {}", name, lane.mask,
+                         strerror(errno));
+    }
+    // the nice value of Linux is per thread
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(worker.tid),
+                    lane.config.nice) != 0)
+        logger->warn("executor: {} nice {} {}", name, lane.config.nice,
+                     strerror(errno));
+}
+
+void camera_executor_t::run(lane_t& lane, worker_t& worker,
+                            uint32_t index) noexcept {
+    setup(lane, worker, index);
+    current_lane = &lane;
+    unique_lock lck{lane.mtx};
+    while (true) {
+        lane.cv.wait(lck, [&lane]() {
+            return lane.stopping || lane.tasks.empty() == false;
+        });
+        // finish the queue before the exit
+        if (lane.tasks.empty())
+            return;
+        auto task = move(lane.tasks.front());
+        lane.tasks.pop_front();
+        ++lane.running;
+
+        const auto delay = startup_timing_t::now() - task.submitted;
+        const auto cpu = static_cast<uint32_t>(sched_getcpu());
+        lane.delay_sum += delay;
+        lane.delay_max = max(lane.delay_max, delay);
+        if (worker.last_cpu != UINT32_MAX && worker.last_cpu != cpu)
+            ++lane.migrations;
+        if (cpu < 64 && (little_mask & (uint64_t{1} << cpu)))
+            ++lane.little_tasks;
+        worker.last_cpu = cpu;
+        lck.unlock();
+
+        task.function();
+        task.function = nullptr; // the captures are released out of the lock
+
+        lck.lock();
+        ++lane.finished;
+        if (--lane.running == 0 && lane.tasks.empty())
+            lane.idle_cv.notify_all();
+    }
+}
+
+bool camera_executor_t::submit(executor_lane_t id,
+                               executor_task_t function) noexcept {
+    auto& lane = lanes[static_cast<uint8_t>(id)];
+    if (lane.workers.empty()) {
+        {
+            unique_lock lck{lane.mtx};
+            if (lane.stopping)
+                return false;
+        }
+        function();
+        unique_lock lck{lane.mtx};
+        ++lane.finished;
+        return true;
+    }
+    {
+        unique_lock lck{lane.mtx};
+        if (lane.stopping)
+            return false;
+        lane.tasks.emplace_back(
+            task_t{move(function), startup_timing_t::now()});
+    }
+    lane.cv.notify_one();
+    return true;
+}
+
+void camera_executor_t::drain(executor_lane_t id) noexcept {
+    auto& lane = lanes[static_cast<uint8_t>(id)];
+    unique_lock lck{lane.mtx};
+    lane.idle_cv.wait(lck, [&lane]() {
+        return lane.tasks.empty() && lane.running == 0;
+    });
+}
+
+bool camera_executor_t::is_current(executor_lane_t id) const noexcept {
+    return current_lane == &lanes[static_cast<uint8_t>(id)];
+}
+
+// exec time and run queue delay of the thread in nanosecond
+static bool read_schedstat(int32_t tid, int64_t& cpu_time,
+                           int64_t& run_delay) noexcept {
+    char path[64]{}, line[128]{};
+    snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+    if (read_line(path, line, sizeof(line)) == false)
+        return false;
+    long long exec = 0, wait = 0;
+    if (sscanf(line, "%lld %lld", &exec, &wait) != 2)
+        return false;
+    cpu_time += exec;
+    run_delay += wait;
+    return true;
+}
+
+auto camera_executor_t::get_stats(executor_lane_t id) noexcept
+    -> executor_stats_t {
+    auto& lane = lanes[static_cast<uint8_t>(id)];
+    executor_stats_t stats{};
+    {
+        unique_lock lck{lane.mtx};
+        stats.tasks = lane.finished;
+        stats.queued = lane.tasks.size();
+        stats.queue_delay_avg =
+            lane.finished ? lane.delay_sum / static_cast<int64_t>(lane.finished)
+                          : 0;
+        stats.queue_delay_max = lane.delay_max;
+        stats.migrations = lane.migrations;
+        stats.little_tasks = lane.little_tasks;
+    }
+    for (const auto& worker : lane.workers)
+        if (const auto tid = worker->tid.load())
+            read_schedstat(tid, stats.cpu_time, stats.run_delay);
+    return stats;
+}
+
+uint64_t camera_executor_t::get_mask(executor_lane_t id) const noexcept {
+    return lanes[static_cast<uint8_t>(id)].mask;
+}
+
+/**
+ * Indices of a `parallel_for`. The late tasks find no index, and this lives
+ * until they return
+ */
+struct parallel_state_t final {
+    const function<void(uint32_t)>* task = nullptr;
+    uint32_t count = 0;
+    atomic<uint32_t> next{}, done{};
+    mutex mtx{};
+    condition_variable cv{};
+};
+
+static void run_parallel(parallel_state_t& state) noexcept {
+    for (auto i = state.next++; i < state.count; i = state.next++) {
+        (*state.task)(i);
+        if (++state.done == state.count) {
+            lock_guard lck{state.mtx};
+            state.cv.notify_all();
+        }
+    }
+}
+
+// for `parallel_for` without the executor. only the convert lane has the
+// threads. they are created in the first use and live until the exit
+static camera_executor_t& get_shared_executor() noexcept {
+    static camera_executor_t executor{[]() {
+        const auto cpus = max(thread::hardware_concurrency(), 2u);
+        executor_config_t config{};
+        config.lanes[0].threads = 0;
+        config.lanes[1] = {"ndcam-par", cpus - 1, core_class_t::any, 0, 0};
+        config.lanes[2].threads = 0;
+        return config;
+    }()};
+    return executor;
+}
+
+void parallel_for(camera_executor_t* executor, uint32_t count,
+                  const function<void(uint32_t)>& task) noexcept {
+    if (count == 1) {
+        task(0);
+        return;
+    }
+    if (executor == nullptr)
+        executor = &get_shared_executor();
+    auto state = make_shared<parallel_state_t>();
+    state->task = &task;
+    state->count = count;
+    for (auto i = 1u; i < count; ++i) {
+        auto job = [state]() { run_parallel(*state); };
+        if (executor->submit(executor_lane_t::convert, job) == false)
+            break;
+    }
+    run_parallel(*state);
+    unique_lock lck{state->mtx};
+    state->cv.wait(lck, [&state]() { return state->done == state->count; });
+}
@@ -0,0 +1,204 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_fanout.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_resource.h>
+
+#include <new>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+fanout_hub_t::fanout_hub_t(camera_group_t& _context) noexcept
+    : context{_context} {
+}
+
+fanout_hub_t::~fanout_hub_t() noexcept {
+    close();
+    for (auto& subscriber : subscribers) {
+        for (auto* frame : subscriber.queue)
+            unref(frame);
+        subscriber.queue.clear();
+    }
+    if (held)
+        logger->warn("fanout: {} images are not released", held.load());
+}
+
+void fanout_hub_t::consume(void* hub, AImage* image,
+                           const frame_info_t& info) noexcept {
+    reinterpret_cast<fanout_hub_t*>(hub)->push(image, info);
+}
+
+bool fanout_hub_t::take(subscriber_t& subscriber,
+                        const frame_info_t& info) noexcept {
+    const auto& config = subscriber.config;
+    if (info.id >= 32 || (config.camera_mask >> info.id & 1) == 0)
+        return false;
+    auto& stats = subscriber.stats;
+    stats.offered += 1;
+    if (subscriber.seen++ % config.decimation) {
+        stats.decimated += 1;
+        return false;
+    }
+    if (config.min_interval > 0) {
+        // the timestamps jitter. a bit early one is on the schedule
+        const auto early = config.min_interval / 4;
+        if (subscriber.due && info.timestamp < subscriber.due - early) {
+            stats.decimated += 1;
+            return false;
+        }
+        // keep the schedule for the average rate. restart it after a gap
+        if (subscriber.due == 0 ||
+            info.timestamp - subscriber.due >= config.min_interval)
+            subscriber.due = info.timestamp + config.min_interval;
+        else
+            subscriber.due += config.min_interval;
+    }
+    return true;
+}
+
+void fanout_hub_t::push(AImage* image, const frame_info_t& info) noexcept {
+    auto* frame = new (nothrow)
+        fanout_frame_t{image, info, startup_timing_t::now(), {}};
+    if (frame == nullptr) {
+        release_image(context, info.id, image);
+        return;
+    }
+    held += 1;
+
+    // unref after the lock. `release_image` returns the buffer to the camera
+    array<fanout_frame_t*, max_subscriber_count> dropped{};
+    auto drop_count = 0u;
+    auto takers = 0u;
+    {
+        lock_guard lck{mtx};
+        for (auto& subscriber : subscribers) {
+            if (closed || subscriber.active == false ||
+                take(subscriber, info) == false)
+                continue;
+            auto& queue = subscriber.queue;
+            if (queue.size() >= subscriber.config.depth) {
+                dropped[drop_count++] = queue.front();
+                queue.pop_front();
+                subscriber.stats.dropped += 1;
+            }
+            queue.emplace_back(frame);
+            takers += 1;
+            subscriber.cv.notify_one();
+        }
+        // nobody can acquire before the unlock
+        frame->references = takers;
+    }
+    if (takers == 0) {
+        frame->references = 1;
+        unref(frame);
+    }
+    for (auto i = 0u; i < drop_count; ++i)
+        unref(dropped[i]);
+}
+
+void fanout_hub_t::unref(fanout_frame_t* frame) noexcept {
+    if (--frame->references)
+        return;
+    release_image(context, frame->info.id, frame->image);
+    delete frame;
+    held -= 1;
+}
+
+auto fanout_hub_t::subscribe(const fanout_subscriber_config_t& config) noexcept
+    -> uint32_t {
+    lock_guard lck{mtx};
+    for (auto i = 0u; i < max_subscriber_count; ++i) {
+        auto& subscriber = subscribers[i];
+        if (subscriber.active)
+            continue;
+        subscriber.active = true;
+        subscriber.config = config;
+        subscriber.config.decimation = max(config.decimation, 1u);
+        subscriber.config.depth = max(config.depth, 1u);
+        subscriber.seen = 0;
+        subscriber.due = 0;
+        subscriber.stats = {};
+        subscriber.lag_sum = 0;
+        logger->info("fanout: subscriber {} {}", i, config.name);
+        return i;
+    }
+    return invalid_subscriber;
+}
+
+void fanout_hub_t::unsubscribe(uint32_t index) noexcept {
+    if (index >= max_subscriber_count)
+        return;
+    deque<fanout_frame_t*> pending{};
+    {
+        lock_guard lck{mtx};
+        auto& subscriber = subscribers[index];
+        subscriber.active = false;
+        subscriber.queue.swap(pending);
+        subscriber.stats.dropped += pending.size();
+        subscriber.cv.notify_all();
+    }
+    for (auto* frame : pending)
+        unref(frame);
+}
+
+auto fanout_hub_t::acquire(uint32_t index, milliseconds timeout) noexcept
+    -> fanout_frame_t* {
+    if (index >= max_subscriber_count)
+        return nullptr;
+    unique_lock lck{mtx};
+    auto& subscriber = subscribers[index];
+    subscriber.cv.wait_for(lck, timeout, [this, &subscriber]() {
+        return closed || subscriber.active == false ||
+               subscriber.queue.empty() == false;
+    });
+    if (subscriber.active == false || subscriber.queue.empty())
+        return nullptr;
+    auto* frame = subscriber.queue.front();
+    subscriber.queue.pop_front();
+
+    auto& stats = subscriber.stats;
+    const auto lag = startup_timing_t::now() - frame->arrival;
+    stats.delivered += 1;
+    stats.holding += 1;
+    stats.lag_max = max(stats.lag_max, lag);
+    subscriber.lag_sum += lag;
+    return frame;
+}
+
+void fanout_hub_t::release(uint32_t index, fanout_frame_t* frame) noexcept {
+    if (frame == nullptr)
+        return;
+    if (index < max_subscriber_count) {
+        lock_guard lck{mtx};
+        auto& stats = subscribers[index].stats;
+        if (stats.holding)
+            stats.holding -= 1;
+    }
+    unref(frame);
+}
+
+void fanout_hub_t::close() noexcept {
+    lock_guard lck{mtx};
+    closed = true;
+    for (auto& subscriber : subscribers)
+        subscriber.cv.notify_all();
+}
+
+auto fanout_hub_t::get_stats(uint32_t index) const noexcept
+    -> fanout_stats_t {
+    if (index >= max_subscriber_count)
+        return {};
+    lock_guard lck{mtx};
+    const auto& subscriber = subscribers[index];
+    auto stats = subscriber.stats;
+    stats.pending = static_cast<uint32_t>(subscriber.queue.size());
+    if (stats.delivered)
+        stats.lag_avg =
+            subscriber.lag_sum / static_cast<int64_t>(stats.delivered);
+    return stats;
+}
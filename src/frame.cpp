@@ -0,0 +1,185 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_frame.h>
+
+using namespace std;
+
+// bytes from the first pixel to the last byte of the last pixel
+static size_t get_extent(uint32_t width, uint32_t height, uint32_t row_stride,
+                         uint32_t pixel_stride) noexcept {
+    if (width == 0 || height == 0)
+        return 0;
+    return static_cast<size_t>(height - 1) * row_stride +
+           static_cast<size_t>(width - 1) * pixel_stride + 1;
+}
+
+auto clamp_roi(image_roi_t roi, uint32_t width, uint32_t height) noexcept
+    -> image_roi_t {
+    if (roi.width == 0 || roi.height == 0)
+        return image_roi_t{0, 0, width, height};
+    roi.x = min(roi.x, width);
+    roi.y = min(roi.y, height);
+    roi.width = min(roi.width, width - roi.x);
+    roi.height = min(roi.height, height - roi.y);
+    return roi;
+}
+
+auto make_plane_view(const uint8_t* data, uint32_t row_stride, uint32_t width,
+                     uint32_t height, uint32_t pixel_stride) noexcept
+    -> plane_view_t {
+    plane_view_t view{};
+    view.row_stride = row_stride;
+    view.pixel_stride = pixel_stride;
+    const auto extent = get_extent(width, height, row_stride, pixel_stride);
+    if (data == nullptr || extent == 0)
+        return view;
+    view.data = gsl::span<const uint8_t>{data, extent};
+    view.width = width;
+    view.height = height;
+    return view;
+}
+
+// view of the pixels from `offset` with the size/strides
+static auto make_view(const plane_view_t& plane, size_t offset, uint32_t width,
+                      uint32_t height, uint32_t row_stride,
+                      uint32_t pixel_stride) noexcept -> plane_view_t {
+    if (plane.empty())
+        return make_plane_view(nullptr, row_stride, 0, 0, pixel_stride);
+    Expects(offset + get_extent(width, height, row_stride, pixel_stride) <=
+            static_cast<size_t>(plane.data.size()));
+    return make_plane_view(plane.data.data() + offset, row_stride, width,
+                           height, pixel_stride);
+}
+
+auto plane_view_t::row(uint32_t y) const noexcept -> gsl::span<const uint8_t> {
+    Expects(y < height);
+    return gsl::span<const uint8_t>{
+        data.data() + static_cast<size_t>(y) * row_stride,
+        get_extent(width, 1, row_stride, pixel_stride)};
+}
+
+auto plane_view_t::crop(const image_roi_t& roi) const noexcept
+    -> plane_view_t {
+    const auto region = clamp_roi(roi, width, height);
+    const auto offset = static_cast<size_t>(region.y) * row_stride +
+                        static_cast<size_t>(region.x) * pixel_stride;
+    return make_view(*this, offset, region.width, region.height, row_stride,
+                     pixel_stride);
+}
+
+auto plane_view_t::subsample(uint32_t step) const noexcept -> plane_view_t {
+    step = max(step, 1u);
+    // same size with `subsample_plane`
+    return make_view(*this, 0, width / step, height / step, row_stride * step,
+                     pixel_stride * step);
+}
+
+static bool is_yuv_420(const frame_view_t& view) noexcept {
+    return view.format == AIMAGE_FORMAT_YUV_420_888 && view.plane_count == 3;
+}
+
+auto frame_view_t::crop(const image_roi_t& roi) const noexcept
+    -> frame_view_t {
+    auto region = clamp_roi(roi, width, height);
+    frame_view_t view = *this;
+    if (is_yuv_420(*this) == false) {
+        for (auto i = 0u; i < plane_count; ++i)
+            view.planes[i] = planes[i].crop(region);
+        view.width = region.width;
+        view.height = region.height;
+        return view;
+    }
+    // keep the right/bottom edge while the origin moves to the even position
+    region.width += region.x % 2;
+    region.height += region.y % 2;
+    region.x -= region.x % 2;
+    region.y -= region.y % 2;
+    view.planes[0] = planes[0].crop(region);
+    const image_roi_t chroma{region.x / 2, region.y / 2,
+                             (region.width + 1) / 2, (region.height + 1) / 2};
+    view.planes[1] = planes[1].crop(chroma);
+    view.planes[2] = planes[2].crop(chroma);
+    view.width = region.width;
+    view.height = region.height;
+    return view;
+}
+
+auto frame_view_t::subsample(uint32_t step) const noexcept -> frame_view_t {
+    step = max(step, 1u);
+    frame_view_t view = *this;
+    if (is_yuv_420(*this) == false) {
+        for (auto i = 0u; i < plane_count; ++i)
+            view.planes[i] = planes[i].subsample(step);
+        view.width = view.planes[0].width;
+        view.height = view.planes[0].height;
+        return view;
+    }
+    // the 2x2 block of the subsampled luma shares the chroma of its top-left
+    const auto& y = view.planes[0] = planes[0].subsample(step);
+    for (auto i = 1u; i < 3; ++i) {
+        const auto& plane = planes[i];
+        view.planes[i] = make_view(plane, 0, (y.width + 1) / 2,
+                                   (y.height + 1) / 2, plane.row_stride * step,
+                                   plane.pixel_stride * step);
+    }
+    view.width = y.width;
+    view.height = y.height;
+    return view;
+}
+
+auto get_frame_view(const AImage* image, frame_view_t& view) noexcept
+    -> media_status_t {
+    int32_t format = 0, width = 0, height = 0, count = 0;
+    int64_t timestamp = 0;
+
+    if (auto status = AImage_getFormat(image, &format))
+        return status;
+    AImage_getWidth(image, &width);
+    AImage_getHeight(image, &height);
+    AImage_getTimestamp(image, &timestamp);
+    if (auto status = AImage_getNumberOfPlanes(image, &count))
+        return status;
+    if (count <= 0 || count > frame_view_t::max_plane_count)
+        return AMEDIA_ERROR_UNSUPPORTED;
+
+    view = frame_view_t{};
+    for (auto i = 0; i < count; ++i) {
+        int32_t row_stride = 0, pixel_stride = 0, length = 0;
+        uint8_t* data = nullptr;
+        if (auto status = AImage_getPlaneData(image, i, &data, &length))
+            return status;
+
+        auto& plane = view.planes[i];
+        plane.data =
+            gsl::span<const uint8_t>{data, static_cast<size_t>(length)};
+        // compressed(JPEG) or opaque plane. see it as 1 row
+        if (AImage_getPlaneRowStride(image, i, &row_stride) != AMEDIA_OK ||
+            AImage_getPlanePixelStride(image, i, &pixel_stride) != AMEDIA_OK ||
+            row_stride <= 0 || pixel_stride <= 0) {
+            plane.width = plane.row_stride = static_cast<uint32_t>(length);
+            plane.height = plane.pixel_stride = 1;
+            continue;
+        }
+        plane.width = static_cast<uint32_t>(width);
+        plane.height = static_cast<uint32_t>(height);
+        if (format == AIMAGE_FORMAT_YUV_420_888 && i > 0) {
+            plane.width = (plane.width + 1) / 2;
+            plane.height = (plane.height + 1) / 2;
+        }
+        plane.row_stride = static_cast<uint32_t>(row_stride);
+        plane.pixel_stride = static_cast<uint32_t>(pixel_stride);
+        const auto extent = get_extent(plane.width, plane.height,
+                                       plane.row_stride, plane.pixel_stride);
+        if (extent > static_cast<size_t>(length))
+            return AMEDIA_ERROR_MALFORMED;
+        plane.data = plane.data.first(extent);
+    }
+    view.format = format;
+    view.width = static_cast<uint32_t>(width);
+    view.height = static_cast<uint32_t>(height);
+    view.timestamp = timestamp;
+    view.plane_count = static_cast<uint32_t>(count);
+    return AMEDIA_OK;
+}
@@ -0,0 +1,760 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_executor.h>
+#include <ndk_camera_jpeg.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDCAM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NDCAM_SSE2 1
+#endif
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// ---- tables of the spec. Annex K
+
+static constexpr uint8_t zigzag[64]{
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static constexpr uint8_t luma_quant[64]{
+    16, 11, 10, 16, 24,  40,  51,  61,  //
+    12, 12, 14, 19, 26,  58,  60,  55,  //
+    14, 13, 16, 24, 40,  57,  69,  56,  //
+    14, 17, 22, 29, 51,  87,  80,  62,  //
+    18, 22, 37, 56, 68,  109, 103, 77,  //
+    24, 35, 55, 64, 81,  104, 113, 92,  //
+    49, 64, 78, 87, 103, 121, 120, 101, //
+    72, 92, 95, 98, 112, 100, 103, 99,  //
+};
+static constexpr uint8_t chroma_quant[64]{
+    17, 18, 24, 47, 99, 99, 99, 99, //
+    18, 21, 26, 66, 99, 99, 99, 99, //
+    24, 26, 56, 99, 99, 99, 99, 99, //
+    47, 66, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+};
+
+// count of the codes for each length 1 ~ 16, then the symbols
+struct huffman_spec_t final {
+    uint8_t bits[16];
+    const uint8_t* values;
+    uint32_t count;
+};
+
+static constexpr uint8_t dc_values[12]{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static constexpr uint8_t luma_ac_values[162]{
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+static constexpr uint8_t chroma_ac_values[162]{
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+// luma DC, luma AC, chroma DC, chroma AC. same order with the DHT
+static constexpr huffman_spec_t huffman_specs[4]{
+    {{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0}, dc_values, 12},
+    {{0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d}, luma_ac_values, 162},
+    {{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0}, dc_values, 12},
+    {{0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+     chroma_ac_values,
+     162},
+};
+static constexpr uint8_t huffman_ids[4]{0x00, 0x10, 0x01, 0x11};
+
+// ---- 4 lanes of float. the DCT is written once with these
+
+#if defined(NDCAM_NEON)
+using f4_t = float32x4_t;
+static f4_t f4_load(const float* p) noexcept {
+    return vld1q_f32(p);
+}
+static void f4_store(float* p, f4_t v) noexcept {
+    vst1q_f32(p, v);
+}
+static f4_t f4_add(f4_t a, f4_t b) noexcept {
+    return vaddq_f32(a, b);
+}
+static f4_t f4_sub(f4_t a, f4_t b) noexcept {
+    return vsubq_f32(a, b);
+}
+static f4_t f4_mul(f4_t a, float b) noexcept {
+    return vmulq_n_f32(a, b);
+}
+static void f4_transpose(f4_t& r0, f4_t& r1, f4_t& r2, f4_t& r3) noexcept {
+    const auto p = vtrnq_f32(r0, r1);
+    const auto q = vtrnq_f32(r2, r3);
+    r0 = vcombine_f32(vget_low_f32(p.val[0]), vget_low_f32(q.val[0]));
+    r1 = vcombine_f32(vget_low_f32(p.val[1]), vget_low_f32(q.val[1]));
+    r2 = vcombine_f32(vget_high_f32(p.val[0]), vget_high_f32(q.val[0]));
+    r3 = vcombine_f32(vget_high_f32(p.val[1]), vget_high_f32(q.val[1]));
+}
+#elif defined(NDCAM_SSE2)
+using f4_t = __m128;
+static f4_t f4_load(const float* p) noexcept {
+    return _mm_loadu_ps(p);
+}
+static void f4_store(float* p, f4_t v) noexcept {
+    _mm_storeu_ps(p, v);
+}
+static f4_t f4_add(f4_t a, f4_t b) noexcept {
+    return _mm_add_ps(a, b);
+}
+static f4_t f4_sub(f4_t a, f4_t b) noexcept {
+    return _mm_sub_ps(a, b);
+}
+static f4_t f4_mul(f4_t a, float b) noexcept {
+    return _mm_mul_ps(a, _mm_set1_ps(b));
+}
+static void f4_transpose(f4_t& r0, f4_t& r1, f4_t& r2, f4_t& r3) noexcept {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+}
+#else
+struct f4_t final {
+    float v[4];
+};
+static f4_t f4_load(const float* p) noexcept {
+    return {{p[0], p[1], p[2], p[3]}};
+}
+static void f4_store(float* p, f4_t v) noexcept {
+    copy_n(v.v, 4, p);
+}
+static f4_t f4_add(f4_t a, f4_t b) noexcept {
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+             a.v[3] + b.v[3]}};
+}
+static f4_t f4_sub(f4_t a, f4_t b) noexcept {
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2],
+             a.v[3] - b.v[3]}};
+}
+static f4_t f4_mul(f4_t a, float b) noexcept {
+    return {{a.v[0] * b, a.v[1] * b, a.v[2] * b, a.v[3] * b}};
+}
+static void f4_transpose(f4_t& r0, f4_t& r1, f4_t& r2, f4_t& r3) noexcept {
+    f4_t* rows[4]{&r0, &r1, &r2, &r3};
+    for (auto i = 0; i < 4; ++i)
+        for (auto j = i + 1; j < 4; ++j)
+            swap(rows[i]->v[j], rows[j]->v[i]);
+}
+#endif
+
+/**
+ * AAN forward DCT of 4 columns. The outputs are scaled and the scale is
+ * folded into the quantization. see `make_divisors`
+ */
+static void dct_8(f4_t* d) noexcept {
+    const auto tmp0 = f4_add(d[0], d[7]), tmp7 = f4_sub(d[0], d[7]);
+    const auto tmp1 = f4_add(d[1], d[6]), tmp6 = f4_sub(d[1], d[6]);
+    const auto tmp2 = f4_add(d[2], d[5]), tmp5 = f4_sub(d[2], d[5]);
+    const auto tmp3 = f4_add(d[3], d[4]), tmp4 = f4_sub(d[3], d[4]);
+
+    // even part
+    auto tmp10 = f4_add(tmp0, tmp3);
+    const auto tmp13 = f4_sub(tmp0, tmp3);
+    auto tmp11 = f4_add(tmp1, tmp2);
+    auto tmp12 = f4_sub(tmp1, tmp2);
+    d[0] = f4_add(tmp10, tmp11);
+    d[4] = f4_sub(tmp10, tmp11);
+    const auto z1 = f4_mul(f4_add(tmp12, tmp13), 0.707106781f);
+    d[2] = f4_add(tmp13, z1);
+    d[6] = f4_sub(tmp13, z1);
+
+    // odd part
+    tmp10 = f4_add(tmp4, tmp5);
+    tmp11 = f4_add(tmp5, tmp6);
+    tmp12 = f4_add(tmp6, tmp7);
+    const auto z5 = f4_mul(f4_sub(tmp10, tmp12), 0.382683433f);
+    const auto z2 = f4_add(f4_mul(tmp10, 0.541196100f), z5);
+    const auto z4 = f4_add(f4_mul(tmp12, 1.306562965f), z5);
+    const auto z3 = f4_mul(tmp11, 0.707106781f);
+    const auto z11 = f4_add(tmp7, z3);
+    const auto z13 = f4_sub(tmp7, z3);
+    d[5] = f4_add(z13, z2);
+    d[3] = f4_sub(z13, z2);
+    d[1] = f4_add(z11, z4);
+    d[7] = f4_sub(z11, z4);
+}
+
+static void dct_columns(float* block) noexcept {
+    for (auto half = 0; half < 8; half += 4) {
+        f4_t d[8];
+        for (auto r = 0; r < 8; ++r)
+            d[r] = f4_load(block + r * 8 + half);
+        dct_8(d);
+        for (auto r = 0; r < 8; ++r)
+            f4_store(block + r * 8 + half, d[r]);
+    }
+}
+
+// 4 of 4x4 transposes, and the off-diagonal ones are swapped
+static void transpose_8x8(float* block) noexcept {
+    for (auto by = 0; by < 8; by += 4)
+        for (auto bx = by; bx < 8; bx += 4) {
+            f4_t a[4], b[4];
+            for (auto i = 0; i < 4; ++i) {
+                a[i] = f4_load(block + (by + i) * 8 + bx);
+                b[i] = f4_load(block + (bx + i) * 8 + by);
+            }
+            f4_transpose(a[0], a[1], a[2], a[3]);
+            f4_transpose(b[0], b[1], b[2], b[3]);
+            for (auto i = 0; i < 4; ++i) {
+                f4_store(block + (bx + i) * 8 + by, a[i]);
+                if (bx != by)
+                    f4_store(block + (by + i) * 8 + bx, b[i]);
+            }
+        }
+}
+
+/**
+ * The columns, then the rows of the transposed block. The coefficient of
+ * (v, u) is at `u * 8 + v`
+ */
+static void forward_dct(float* block) noexcept {
+    dct_columns(block);
+    transpose_8x8(block);
+    dct_columns(block);
+}
+
+// position of the zigzag index in the output of `forward_dct`
+static constexpr auto make_dct_order() noexcept -> array<uint8_t, 64> {
+    array<uint8_t, 64> order{};
+    for (auto i = 0u; i < 64; ++i)
+        order[i] = static_cast<uint8_t>(zigzag[i] % 8 * 8 + zigzag[i] / 8);
+    return order;
+}
+static constexpr auto dct_order = make_dct_order();
+
+// round(coefficient * divisor) to 16 bit
+static void quantize(const float* block, const float* divisors,
+                     int16_t* out) noexcept {
+#if defined(NDCAM_NEON)
+    const auto zero = vdupq_n_f32(0);
+    const auto half = vdupq_n_f32(0.5f), minus_half = vdupq_n_f32(-0.5f);
+    for (auto i = 0; i < 64; i += 8) {
+        int32x4_t q[2];
+        for (auto k = 0; k < 2; ++k) {
+            const auto v = vmulq_f32(vld1q_f32(block + i + k * 4),
+                                     vld1q_f32(divisors + i + k * 4));
+            // away from zero. armv7 has no rounding conversion
+            const auto bias = vbslq_f32(vcltq_f32(v, zero), minus_half, half);
+            q[k] = vcvtq_s32_f32(vaddq_f32(v, bias));
+        }
+        vst1q_s16(out + i, vcombine_s16(vmovn_s32(q[0]), vmovn_s32(q[1])));
+    }
+#elif defined(NDCAM_SSE2)
+    const auto sign = _mm_set1_ps(-0.0f), half = _mm_set1_ps(0.5f);
+    for (auto i = 0; i < 64; i += 8) {
+        __m128i q[2];
+        for (auto k = 0; k < 2; ++k) {
+            const auto v = _mm_mul_ps(_mm_loadu_ps(block + i + k * 4),
+                                      _mm_loadu_ps(divisors + i + k * 4));
+            // away from zero like the others. `_mm_cvtps_epi32` is half to
+            // even
+            const auto bias = _mm_or_ps(_mm_and_ps(v, sign), half);
+            q[k] = _mm_cvttps_epi32(_mm_add_ps(v, bias));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_packs_epi32(q[0], q[1]));
+    }
+#else
+    for (auto i = 0; i < 64; ++i)
+        out[i] = static_cast<int16_t>(lroundf(block[i] * divisors[i]));
+#endif
+}
+
+// 8 samples to float with the level shift
+static void load_8(const uint8_t* samples, float* out) noexcept {
+#if defined(NDCAM_NEON)
+    const auto wide = vmovl_u8(vld1_u8(samples));
+    const auto shift = vdupq_n_f32(128);
+    vst1q_f32(out, vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide))),
+                             shift));
+    vst1q_f32(out + 4, vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(wide))),
+                                 shift));
+#elif defined(NDCAM_SSE2)
+    const auto zero = _mm_setzero_si128();
+    const auto shift = _mm_set1_ps(128);
+    const auto wide = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples)), zero);
+    _mm_storeu_ps(out, _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(wide,
+                                                                     zero)),
+                                  shift));
+    _mm_storeu_ps(out + 4,
+                  _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(wide, zero)),
+                             shift));
+#else
+    for (auto i = 0; i < 8; ++i)
+        out[i] = static_cast<float>(samples[i]) - 128;
+#endif
+}
+
+// Y, Cb, Cr with their strides. the chroma planes are half of the luma
+struct jpeg_source_t final {
+    const uint8_t* data[3];
+    uint32_t row_stride[3];
+    uint32_t pixel_stride[3];
+    uint32_t width[3], height[3];
+};
+
+// the pixels out of the plane repeat the edge
+static void load_block(const jpeg_source_t& src, uint32_t c, uint32_t x0,
+                       uint32_t y0, float* block) noexcept {
+    const auto width = src.width[c], height = src.height[c];
+    const auto ps = src.pixel_stride[c];
+    uint8_t samples[8]{};
+    for (auto r = 0u; r < 8; ++r) {
+        const auto y = min(y0 + r, height - 1);
+        const auto* row = src.data[c] + static_cast<size_t>(y) *
+                                            src.row_stride[c];
+        if (ps == 1 && x0 + 8 <= width) {
+            load_8(row + x0, block + r * 8);
+            continue;
+        }
+        for (auto i = 0u; i < 8; ++i)
+            samples[i] = row[static_cast<size_t>(min(x0 + i, width - 1)) * ps];
+        load_8(samples, block + r * 8);
+    }
+}
+
+// ---- entropy coding
+
+/**
+ * Bytes of the entropy-coded data. `reserve` before each MCU, so `put` writes
+ * without the checks of the capacity
+ */
+class bit_writer_t final {
+    vector<uint8_t>* out;
+    uint8_t* next = nullptr;
+    uint64_t bits = 0;
+    uint32_t count = 0;
+
+  public:
+    // `out` is overwritten. its capacity is reused
+    explicit bit_writer_t(vector<uint8_t>& _out) noexcept
+        : out{&_out}, next{_out.data()} {
+        out->clear();
+    }
+
+    // a block can be 64 codes of 27 bits, and all of them are stuffed
+    void reserve(uint32_t blocks) noexcept {
+        const auto used = static_cast<size_t>(next - out->data());
+        const auto needed = used + blocks * 432u;
+        if (out->size() < needed)
+            out->resize(max(needed, out->size() * 2));
+        next = out->data() + used;
+    }
+
+    // up to 27 bits for each
+    void put(uint32_t code, uint32_t size) noexcept {
+        bits = bits << size | code;
+        count += size;
+        if (count < 32)
+            return;
+        count -= 32;
+        const auto word = static_cast<uint32_t>(bits >> count);
+        // no 0xFF in the 4 bytes. see "Bit Twiddling Hacks" for the zero byte
+        if ((~(word + 0x01010101u) & word & 0x80808080u) == 0) {
+            next[0] = static_cast<uint8_t>(word >> 24);
+            next[1] = static_cast<uint8_t>(word >> 16);
+            next[2] = static_cast<uint8_t>(word >> 8);
+            next[3] = static_cast<uint8_t>(word);
+            next += 4;
+            return;
+        }
+        for (auto shift = 24; shift >= 0; shift -= 8) {
+            const auto byte = static_cast<uint8_t>(word >> shift);
+            *next++ = byte;
+            if (byte == 0xFF) // stuffing
+                *next++ = 0;
+        }
+    }
+
+    // pad with 1 bits for the restart marker. `out` is resized to the data
+    void flush() noexcept {
+        reserve(1);
+        if (const auto pad = (8 - count % 8) & 7)
+            bits = bits << pad | ((1u << pad) - 1), count += pad;
+        while (count >= 8) {
+            count -= 8;
+            const auto byte = static_cast<uint8_t>(bits >> count);
+            *next++ = byte;
+            if (byte == 0xFF)
+                *next++ = 0;
+        }
+        out->resize(static_cast<size_t>(next - out->data()));
+    }
+};
+
+static uint32_t get_bit_count(int32_t value) noexcept {
+    const auto magnitude = static_cast<uint32_t>(value < 0 ? -value : value);
+    return magnitude ? 32 - __builtin_clz(magnitude) : 0;
+}
+
+// the extra bits of the value. 1's complement for the negative ones
+static uint32_t get_value_bits(int32_t value, uint32_t count) noexcept {
+    const auto bits = static_cast<uint32_t>(value < 0 ? value - 1 : value);
+    return bits & ((1u << count) - 1);
+}
+
+struct huffman_table_t final {
+    const uint16_t* codes;
+    const uint8_t* sizes;
+};
+
+// bit N for the non-zero value N
+static uint64_t get_nonzero_mask(const int16_t* values) noexcept {
+#if defined(NDCAM_NEON)
+    // 1 bit of each lane, then the pairwise sums collect them
+    static constexpr uint16_t weights[8]{1, 2, 4, 8, 16, 32, 64, 128};
+    const auto weight = vld1q_u16(weights);
+    uint64_t mask = 0;
+    for (auto i = 0u; i < 64; i += 8) {
+        const auto zero = vceqq_s16(vld1q_s16(values + i), vdupq_n_s16(0));
+        const auto bits = vandq_u16(vmvnq_u16(zero), weight);
+        const auto sum = vpaddlq_u32(vpaddlq_u16(bits));
+        const auto byte = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+        mask |= byte << i;
+    }
+    return mask;
+#elif defined(NDCAM_SSE2)
+    uint64_t mask = 0;
+    const auto zero = _mm_setzero_si128();
+    for (auto i = 0u; i < 64; i += 16) {
+        const auto* p = reinterpret_cast<const __m128i*>(values + i);
+        const auto lo = _mm_cmpeq_epi16(_mm_load_si128(p), zero);
+        const auto hi = _mm_cmpeq_epi16(_mm_load_si128(p + 1), zero);
+        const auto bits = _mm_movemask_epi8(_mm_packs_epi16(lo, hi));
+        mask |= static_cast<uint64_t>(~bits & 0xFFFF) << i;
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (auto i = 0u; i < 64; ++i)
+        mask |= static_cast<uint64_t>(values[i] != 0) << i;
+    return mask;
+#endif
+}
+
+// the zeros are skipped with the mask of the others
+static void encode_block(bit_writer_t& output, const int16_t* coefficients,
+                         int32_t& last_dc, huffman_table_t dc,
+                         huffman_table_t ac) noexcept {
+    // a copy in the registers. the stores of the bytes may alias the members
+    auto writer = output;
+    alignas(16) int16_t values[64];
+    for (auto i = 0u; i < 64; ++i)
+        values[i] = coefficients[dct_order[i]];
+    auto mask = get_nonzero_mask(values);
+    const auto diff = values[0] - last_dc;
+    last_dc = values[0];
+    auto n = get_bit_count(diff);
+    writer.put(dc.codes[n] << n | get_value_bits(diff, n), dc.sizes[n] + n);
+
+    auto last = 0u;
+    for (mask &= ~1ull; mask; mask &= mask - 1) {
+        const auto i = static_cast<uint32_t>(__builtin_ctzll(mask));
+        auto run = i - last - 1;
+        last = i;
+        for (; run > 15; run -= 16) // ZRL
+            writer.put(ac.codes[0xF0], ac.sizes[0xF0]);
+        const int32_t value = values[i];
+        const auto magnitude = static_cast<uint32_t>(abs(value));
+        n = 32 - __builtin_clz(magnitude);
+        const auto symbol = run << 4 | n;
+        writer.put(ac.codes[symbol] << n | get_value_bits(value, n),
+                   ac.sizes[symbol] + n);
+    }
+    if (last != 63) // EOB
+        writer.put(ac.codes[0x00], ac.sizes[0x00]);
+    output = writer;
+}
+
+// ---- encoder
+
+static void make_quant_table(const uint8_t* base, uint32_t quality,
+                             array<uint8_t, 64>& table) noexcept {
+    quality = clamp(quality, 1u, 100u);
+    const auto scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (auto i = 0u; i < 64; ++i) {
+        const auto value = (base[zigzag[i]] * scale + 50) / 100;
+        table[i] = static_cast<uint8_t>(clamp(value, 1u, 255u));
+    }
+}
+
+// 1 / (quant * the scale of AAN DCT * 8) in the layout of `forward_dct`
+static void make_divisors(const array<uint8_t, 64>& table,
+                          array<float, 64>& divisors) noexcept {
+    constexpr double pi = 3.14159265358979323846;
+    double aan[8]{1};
+    for (auto k = 1; k < 8; ++k)
+        aan[k] = cos(k * pi / 16) * sqrt(2.0);
+    for (auto i = 0u; i < 64; ++i) {
+        const auto v = zigzag[i] / 8, u = zigzag[i] % 8;
+        divisors[u * 8 + v] =
+            static_cast<float>(1 / (table[i] * aan[v] * aan[u] * 8));
+    }
+}
+
+jpeg_encoder_t::jpeg_encoder_t(const jpeg_config_t& _config) noexcept
+    : config{_config} {
+    make_quant_table(luma_quant, config.quality, quant_tables[0]);
+    make_quant_table(chroma_quant, config.quality, quant_tables[1]);
+    for (auto t = 0u; t < 2; ++t)
+        make_divisors(quant_tables[t], divisors[t]);
+
+    for (auto t = 0u; t < 4; ++t) {
+        const auto& spec = huffman_specs[t];
+        auto code = 0u, k = 0u;
+        for (auto length = 1u; length <= 16; ++length) {
+            for (auto i = 0u; i < spec.bits[length - 1]; ++i, ++k) {
+                codes[t][spec.values[k]] = static_cast<uint16_t>(code++);
+                sizes[t][spec.values[k]] = static_cast<uint8_t>(length);
+            }
+            code <<= 1;
+        }
+    }
+}
+
+static void put_u16(vector<uint8_t>& out, uint32_t value) noexcept {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void put_marker(vector<uint8_t>& out, uint8_t marker,
+                       uint32_t length) noexcept {
+    out.push_back(0xFF);
+    out.push_back(marker);
+    if (length)
+        put_u16(out, length);
+}
+
+static void write_headers(vector<uint8_t>& out, uint32_t width,
+                          uint32_t height, uint32_t interval,
+                          const array<array<uint8_t, 64>, 2>& tables) noexcept {
+    put_marker(out, 0xD8, 0); // SOI
+    put_marker(out, 0xE0, 16);
+    for (auto c : {'J', 'F', 'I', 'F', '\0'})
+        out.push_back(static_cast<uint8_t>(c));
+    // version 1.1, no unit, 1:1 pixel, no thumbnail
+    for (auto v : {1, 1, 0, 0, 1, 0, 1, 0, 0})
+        out.push_back(static_cast<uint8_t>(v));
+
+    put_marker(out, 0xDB, 2 + 2 * 65);
+    for (auto t = 0u; t < 2; ++t) {
+        out.push_back(static_cast<uint8_t>(t));
+        out.insert(out.end(), tables[t].begin(), tables[t].end());
+    }
+
+    put_marker(out, 0xC0, 17); // SOF0
+    out.push_back(8);
+    put_u16(out, height);
+    put_u16(out, width);
+    out.push_back(3);
+    // id, sampling factors, quant table. Y is 2x2 of the chroma
+    for (auto v : {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1})
+        out.push_back(static_cast<uint8_t>(v));
+
+    auto length = 2u;
+    for (const auto& spec : huffman_specs)
+        length += 1 + 16 + spec.count;
+    put_marker(out, 0xC4, length);
+    for (auto t = 0u; t < 4; ++t) {
+        const auto& spec = huffman_specs[t];
+        out.push_back(huffman_ids[t]);
+        out.insert(out.end(), spec.bits, spec.bits + 16);
+        out.insert(out.end(), spec.values, spec.values + spec.count);
+    }
+
+    if (interval) {
+        put_marker(out, 0xDD, 4);
+        put_u16(out, interval);
+    }
+
+    put_marker(out, 0xDA, 12); // SOS
+    out.push_back(3);
+    for (auto v : {1, 0x00, 2, 0x11, 3, 0x11})
+        out.push_back(static_cast<uint8_t>(v));
+    // spectral selection 0 ~ 63, no approximation
+    for (auto v : {0, 63, 0})
+        out.push_back(static_cast<uint8_t>(v));
+}
+
+void jpeg_encoder_t::write(const jpeg_source_t& src,
+                           vector<uint8_t>& output) noexcept {
+    const auto width = src.width[0], height = src.height[0];
+    const auto mcus_x = (width + 15) / 16, mcus_y = (height + 15) / 16;
+
+    // rows of MCUs for each slice. the interval must fit in 16 bit
+    auto count = config.slices ? config.slices : thread::hardware_concurrency();
+    count = clamp(count, 1u, mcus_y);
+    auto rows = (mcus_y + count - 1) / count;
+    rows = min(rows, 65535 / mcus_x);
+    count = (mcus_y + rows - 1) / rows;
+    if (slices.size() < count)
+        slices.resize(count);
+
+    const auto slice = [this, &src, mcus_x, mcus_y, rows](uint32_t i) {
+        bit_writer_t writer{slices[i]};
+        const huffman_table_t tables[4]{
+            {codes[0].data(), sizes[0].data()},
+            {codes[1].data(), sizes[1].data()},
+            {codes[2].data(), sizes[2].data()},
+            {codes[3].data(), sizes[3].data()},
+        };
+        alignas(16) float block[64];
+        alignas(16) int16_t coefficients[64];
+        int32_t last_dc[3]{}; // reset at each restart
+        const auto encode_at = [&](uint32_t c, uint32_t x, uint32_t y) {
+            const auto t = c ? 1 : 0;
+            load_block(src, c, x, y, block);
+            forward_dct(block);
+            quantize(block, divisors[t].data(), coefficients);
+            encode_block(writer, coefficients, last_dc[c], tables[t * 2],
+                         tables[t * 2 + 1]);
+        };
+        const auto y1 = min((i + 1) * rows, mcus_y);
+        for (auto my = i * rows; my < y1; ++my)
+            for (auto mx = 0u; mx < mcus_x; ++mx) {
+                writer.reserve(6);
+                encode_at(0, mx * 16, my * 16);
+                encode_at(0, mx * 16 + 8, my * 16);
+                encode_at(0, mx * 16, my * 16 + 8);
+                encode_at(0, mx * 16 + 8, my * 16 + 8);
+                encode_at(1, mx * 8, my * 8);
+                encode_at(2, mx * 8, my * 8);
+            }
+        writer.flush();
+    };
+    parallel_for(config.executor, count, slice);
+
+    output.clear();
+    write_headers(output, width, height, count > 1 ? mcus_x * rows : 0,
+                  quant_tables);
+    auto length = output.size() + 2;
+    for (auto i = 0u; i < count; ++i)
+        length += slices[i].size() + 2;
+    output.reserve(length);
+    for (auto i = 0u; i < count; ++i) {
+        output.insert(output.end(), slices[i].begin(), slices[i].end());
+        if (i + 1 < count)
+            put_marker(output, static_cast<uint8_t>(0xD0 + i % 8), 0);
+    }
+    put_marker(output, 0xD9, 0); // EOI
+}
+
+auto jpeg_encoder_t::encode(const yuv_planes_t& planes,
+                            vector<uint8_t>& output) noexcept
+    -> media_status_t {
+    if (planes.width == 0 || planes.height == 0 || planes.width > 65535 ||
+        planes.height > 65535)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    perf_scope_t scope{perf_stage_t::encode_jpeg};
+    const auto cw = (planes.width + 1) / 2, ch = (planes.height + 1) / 2;
+    const jpeg_source_t src{
+        {planes.y, planes.u, planes.v},
+        {planes.y_row_stride, planes.uv_row_stride, planes.uv_row_stride},
+        {1, planes.uv_pixel_stride, planes.uv_pixel_stride},
+        {planes.width, cw, cw},
+        {planes.height, ch, ch},
+    };
+    write(src, output);
+    return AMEDIA_OK;
+}
+
+auto jpeg_encoder_t::encode(const frame_view_t& frame,
+                            vector<uint8_t>& output) noexcept
+    -> media_status_t {
+    if (frame.format != AIMAGE_FORMAT_YUV_420_888 || frame.plane_count != 3)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    if (frame.width == 0 || frame.height == 0 || frame.width > 65535 ||
+        frame.height > 65535)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    perf_scope_t scope{perf_stage_t::encode_jpeg};
+    jpeg_source_t src{};
+    for (auto c = 0u; c < 3; ++c) {
+        const auto& plane = frame.planes[c];
+        if (plane.width == 0 || plane.height == 0)
+            return AMEDIA_ERROR_INVALID_PARAMETER;
+        src.data[c] = plane.data.data();
+        src.row_stride[c] = plane.row_stride;
+        src.pixel_stride[c] = plane.pixel_stride;
+        src.width[c] = plane.width;
+        src.height[c] = plane.height;
+    }
+    write(src, output);
+    return AMEDIA_OK;
+}
+
+jpeg_encoder_t::~jpeg_encoder_t() noexcept {
+    for (const auto& buffer : pool)
+        if (config.resources && buffer.capacity())
+            config.resources->release(resource_type_t::frame_buffer, config.id,
+                                      buffer.data(), buffer.capacity());
+}
+
+auto jpeg_encoder_t::acquire() noexcept -> vector<uint8_t> {
+    unique_lock lck{mtx};
+    if (pool.empty())
+        return {};
+    auto buffer = move(pool.back());
+    pool.pop_back();
+    if (config.resources && buffer.capacity())
+        config.resources->release(resource_type_t::frame_buffer, config.id,
+                                  buffer.data(), buffer.capacity());
+    return buffer;
+}
+
+void jpeg_encoder_t::recycle(vector<uint8_t>&& buffer) noexcept {
+    unique_lock lck{mtx};
+    if (pool.size() >= config.pool_size)
+        return;
+    if (config.resources && buffer.capacity())
+        config.resources->acquire(resource_type_t::frame_buffer, config.id,
+                                  buffer.data(), buffer.capacity(),
+                                  NDCAM_RESOURCE_SITE);
+    pool.emplace_back(move(buffer));
+}
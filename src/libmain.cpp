@@ -3,16 +3,38 @@
 //      luncliff@gmail.com
 //
 #include <ndk_camera.h>
+#include <ndk_camera_executor.h>
 #include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_recovery.h>
+#include <ndk_camera_resource.h>
+
+#include <thread>
 
 using namespace std;
 
 shared_ptr<spdlog::logger> logger{};
 
+// the new session closes the previous one of the device, but the handle is
+// freed only by `ACameraCaptureSession_close`
+static void close_previous_session(camera_group_t& context,
+                                   uint16_t id) noexcept {
+    auto session = context.session_set[id].exchange(nullptr);
+    if (session == nullptr)
+        return;
+    ACameraCaptureSession_close(session);
+    if (context.resources)
+        context.resources->release(resource_type_t::capture_session, id,
+                                   session, 0);
+}
+
 void camera_group_t::release() noexcept {
     // close all devices
     for (uint16_t id = 0u; id < max_camera_count; ++id)
         close_device(id);
+    // readers are not used without the devices
+    for (uint16_t id = 0u; id < max_camera_count; ++id)
+        close_reader(id);
 
     // release all metadata
     for (auto& meta : metadata_set)
@@ -35,18 +57,33 @@ void camera_group_t::release() noexcept {
 camera_status_t
 camera_group_t::open_device(uint16_t id,
                             ACameraDevice_StateCallbacks& callbacks) noexcept {
-    auto& device = this->device_set[id];
+    perf_scope_t scope{perf_stage_t::open_device};
+    unique_lock lck{this->operation_mtx_set[id]};
+    auto& timing = this->timing_set[id];
+    timing.reset();
+    timing.open_begin = startup_timing_t::now();
+
+    ACameraDevice* device = nullptr;
     auto status = ACameraManager_openCamera(         //
         this->manager, this->id_list->cameraIds[id], //
         addressof(callbacks), addressof(device));
+
+    timing.open_end = startup_timing_t::now();
+    if (status != ACAMERA_OK)
+        return status;
+    this->device_set[id] = device;
+    if (recovery)
+        recovery->on_open(id, callbacks);
     return status;
 }
 
 // Notice that this routine doesn't free metadata
 void camera_group_t::close_device(uint16_t id) noexcept {
+    unique_lock lck{this->operation_mtx_set[id]};
+    if (recovery)
+        recovery->on_close(id);
     // close session
-    auto& session = this->session_set[id];
-    if (session) {
+    if (auto session = this->session_set[id].exchange(nullptr)) {
         logger->warn("session for device {} is alive. abort/closing...", id);
 
         // Abort all kind of requests
@@ -54,11 +91,21 @@ void camera_group_t::close_device(uint16_t id) noexcept {
         ACameraCaptureSession_stopRepeating(session);
         // close
         ACameraCaptureSession_close(session);
-        session = nullptr;
+        if (resources)
+            resources->release(resource_type_t::capture_session, id, session,
+                               0);
+    }
+    // prepared request belongs to the device
+    auto& request = this->repeat_request_set[id];
+    if (request) {
+        if (resources)
+            resources->release(resource_type_t::capture_request, id, request,
+                               0);
+        ACaptureRequest_free(request);
+        request = nullptr;
     }
     // close device
-    auto& device = this->device_set[id];
-    if (device) {
+    if (auto device = this->device_set[id].exchange(nullptr)) {
         // Producing meesage like following
         // W/ACameraCaptureSession: Device is closed but session 0 is not
         // notified
@@ -69,7 +116,6 @@ void camera_group_t::close_device(uint16_t id) noexcept {
         logger->warn("closing device {} ...", id);
 
         ACameraDevice_close(device);
-        device = nullptr;
     }
 }
 
@@ -77,8 +123,15 @@ camera_status_t camera_group_t::start_repeat(
     uint16_t id, ANativeWindow* window,
     ACameraCaptureSession_stateCallbacks& on_session_changed,
     ACameraCaptureSession_captureCallbacks& on_capture_event) noexcept {
+    perf_scope_t scope{perf_stage_t::start_repeat};
+    unique_lock lck{this->operation_mtx_set[id]};
     camera_status_t status = ACAMERA_OK;
 
+    auto& timing = this->timing_set[id];
+    timing.surface_begin = startup_timing_t::now();
+    timing.session_end = timing.repeat_end = 0;
+    timing.first_frame = 0;
+
     // ---- target surface for camera ----
     auto target = camera_output_target_ptr{[=]() {
                                                ACameraOutputTarget* target{};
@@ -90,18 +143,13 @@ camera_status_t camera_group_t::start_repeat(
     assert(target.get() != nullptr);
 
     // ---- capture request (preview) ----
-    auto request = capture_request_ptr{
-        [=]() {
-            ACaptureRequest* ptr{};
-            // capture as a preview
-            // TEMPLATE_RECORD, TEMPLATE_PREVIEW, TEMPLATE_MANUAL,
-            const auto status = ACameraDevice_createCaptureRequest(
-                this->device_set[id], TEMPLATE_PREVIEW, &ptr);
-            assert(status == ACAMERA_OK);
-            return ptr;
-        }(),
-        ACaptureRequest_free};
-    assert(request.get() != nullptr);
+    // reuse the request from `prewarm`. if there is none, create it now
+    status = prepare_repeat(id);
+    if (status != ACAMERA_OK) // the device is not opened
+        return status;
+    // the request is owned by the context. see `close_device`
+    ACaptureRequest* request = this->repeat_request_set[id];
+    assert(request != nullptr);
 
     // `ACaptureRequest` == how to capture
     // detailed config comes here...
@@ -110,7 +158,7 @@ camera_status_t camera_group_t::start_repeat(
     // -
 
     // designate target surface in request
-    status = ACaptureRequest_addTarget(request.get(), target.get());
+    status = ACaptureRequest_addTarget(request, target.get());
     assert(status == ACAMERA_OK);
     // ---- session output ----
 
@@ -137,41 +185,129 @@ camera_status_t camera_group_t::start_repeat(
     status = ACaptureSessionOutputContainer_add(container.get(), output.get());
     assert(status == ACAMERA_OK);
 
+    // ---- analysis output ----
+    // the window is owned by the reader. so no release for it
+    ANativeWindow* reader_window = nullptr;
+    if (AImageReader* reader = this->reader_set[id])
+        AImageReader_getWindow(reader, addressof(reader_window));
+
+    auto reader_target =
+        camera_output_target_ptr{nullptr, ACameraOutputTarget_free};
+    auto reader_output =
+        capture_session_output_ptr{nullptr, ACaptureSessionOutput_free};
+    if (reader_window) {
+        ACameraOutputTarget* target{};
+        ACameraOutputTarget_create(reader_window, addressof(target));
+        reader_target.reset(target);
+        ACaptureSessionOutput* output{};
+        ACaptureSessionOutput_create(reader_window, addressof(output));
+        reader_output.reset(output);
+
+        status = ACaptureRequest_addTarget(request, reader_target.get());
+        assert(status == ACAMERA_OK);
+        status = ACaptureSessionOutputContainer_add(container.get(),
+                                                    reader_output.get());
+        assert(status == ACAMERA_OK);
+    }
+
     // ---- create a session ----
+    close_previous_session(*this, id);
+    // the device might be broken while the recovery is pending
+    ACameraCaptureSession* session = nullptr;
     status = ACameraDevice_createCaptureSession(
         this->device_set[id], container.get(), addressof(on_session_changed),
-        addressof(this->session_set[id]));
-    assert(status == ACAMERA_OK);
-
-    // ---- set request ----
-    array<ACaptureRequest*, 1> batch_request{};
-    batch_request[0] = request.get();
-
-    status = ACameraCaptureSession_setRepeatingRequest(
-        this->session_set[id], addressof(on_capture_event),
-        batch_request.size(), batch_request.data(),
-        addressof(this->seq_id_set[id]));
-    assert(status == ACAMERA_OK);
-
+        addressof(session));
+    if (status == ACAMERA_OK) {
+        this->session_set[id] = session;
+        timing.session_end = startup_timing_t::now();
+        if (resources)
+            resources->acquire(resource_type_t::capture_session, id, session,
+                               0, NDCAM_RESOURCE_SITE);
+
+        // ---- set request ----
+        array<ACaptureRequest*, 1> batch_request{};
+        batch_request[0] = request;
+
+        status = ACameraCaptureSession_setRepeatingRequest(
+            session, addressof(on_capture_event),
+            batch_request.size(), batch_request.data(),
+            addressof(this->seq_id_set[id]));
+    }
+    if (status == ACAMERA_OK) {
+        timing.repeat_end = startup_timing_t::now();
+        if (recovery)
+            recovery->on_repeat(id, window, on_session_changed,
+                                on_capture_event);
+    } else
+        logger->error("start_repeat for device {}: {}", id, status);
+    const auto result = status;
+
+    // the request is reused. the targets are only for this session
     status =
         ACaptureSessionOutputContainer_remove(container.get(), output.get());
     assert(status == ACAMERA_OK);
-    status = ACaptureRequest_removeTarget(request.get(), target.get());
+    status = ACaptureRequest_removeTarget(request, target.get());
     assert(status == ACAMERA_OK);
+    if (reader_window) {
+        status = ACaptureSessionOutputContainer_remove(container.get(),
+                                                       reader_output.get());
+        assert(status == ACAMERA_OK);
+        status = ACaptureRequest_removeTarget(request, reader_target.get());
+        assert(status == ACAMERA_OK);
+    }
+
+    return result;
+}
+
+camera_status_t
+camera_group_t::prewarm(uint16_t id,
+                        ACameraDevice_StateCallbacks& callbacks) noexcept {
+    unique_lock lck{this->operation_mtx_set[id]};
+    camera_status_t status = ACAMERA_OK;
+    // the device might be opened already. reuse it
+    if (this->device_set[id] == nullptr)
+        status = open_device(id, callbacks);
+    if (status != ACAMERA_OK)
+        return status;
+
+    return prepare_repeat(id);
+}
 
+camera_status_t camera_group_t::prepare_repeat(uint16_t id) noexcept {
+    unique_lock lck{this->operation_mtx_set[id]};
+    auto& request = this->repeat_request_set[id];
+    if (request) // already prepared
+        return ACAMERA_OK;
+
+    auto& timing = this->timing_set[id];
+    timing.request_begin = startup_timing_t::now();
+
+    // capture as a preview
+    // TEMPLATE_RECORD, TEMPLATE_PREVIEW, TEMPLATE_MANUAL,
+    const auto status = ACameraDevice_createCaptureRequest(
+        this->device_set[id], TEMPLATE_PREVIEW, addressof(request));
+
+    timing.request_end = startup_timing_t::now();
+    if (status == ACAMERA_OK && resources)
+        resources->acquire(resource_type_t::capture_request, id, request, 0,
+                           NDCAM_RESOURCE_SITE);
     return status;
 }
 
 void camera_group_t::stop_repeat(uint16_t id) noexcept {
-    auto& session = this->session_set[id];
-    if (session) {
+    unique_lock lck{this->operation_mtx_set[id]};
+    if (recovery)
+        recovery->on_stop(id);
+    if (auto session = this->session_set[id].exchange(nullptr)) {
         logger->warn("stop_repeat for session {} ", id);
 
         // follow `ACameraCaptureSession_setRepeatingRequest`
         ACameraCaptureSession_stopRepeating(session);
 
         ACameraCaptureSession_close(session);
-        session = nullptr;
+        if (resources)
+            resources->release(resource_type_t::capture_session, id, session,
+                               0);
     }
     this->seq_id_set[id] = CAPTURE_SEQUENCE_ID_NONE;
 }
@@ -180,7 +316,12 @@ camera_status_t camera_group_t::start_capture(
     uint16_t id, ANativeWindow* window,
     ACameraCaptureSession_stateCallbacks& on_session_changed,
     ACameraCaptureSession_captureCallbacks& on_capture_event) noexcept {
+    perf_scope_t scope{perf_stage_t::start_capture};
+    unique_lock lck{this->operation_mtx_set[id]};
     camera_status_t status = ACAMERA_OK;
+    // the new session replaces the repeating one
+    if (recovery)
+        recovery->on_stop(id);
 
     // ---- target surface for camera ----
     auto target = camera_output_target_ptr{[=]() {
@@ -193,19 +334,18 @@ camera_status_t camera_group_t::start_capture(
     assert(target.get() != nullptr);
 
     // ---- capture request (preview) ----
-    auto request =
-        capture_request_ptr{[](ACameraDevice* device) {
-                                ACaptureRequest* ptr{};
-                                // capture as a preview
-                                // TEMPLATE_RECORD, TEMPLATE_PREVIEW,
-                                // TEMPLATE_MANUAL,
-                                const auto status =
-                                    ACameraDevice_createCaptureRequest(
-                                        device, TEMPLATE_STILL_CAPTURE, &ptr);
-                                assert(status == ACAMERA_OK);
-                                return ptr;
-                            }(this->device_set[id]),
-                            ACaptureRequest_free};
+    auto request = make_tracked<resource_type_t::capture_request>(
+        [](ACameraDevice* device) {
+            ACaptureRequest* ptr{};
+            // capture as a preview
+            // TEMPLATE_RECORD, TEMPLATE_PREVIEW,
+            // TEMPLATE_MANUAL,
+            const auto status = ACameraDevice_createCaptureRequest(
+                device, TEMPLATE_STILL_CAPTURE, &ptr);
+            assert(status == ACAMERA_OK);
+            return ptr;
+        }(this->device_set[id]),
+        ACaptureRequest_free, this->resources, id, 0, NDCAM_RESOURCE_SITE);
     assert(request.get() != nullptr);
 
     // `ACaptureRequest` == how to capture
@@ -246,17 +386,23 @@ camera_status_t camera_group_t::start_capture(
     // defer ACaptureSessionOutputContainer_remove
 
     // ---- create a session ----
+    close_previous_session(*this, id);
+    ACameraCaptureSession* session = nullptr;
     status = ACameraDevice_createCaptureSession(
         this->device_set[id], container.get(), addressof(on_session_changed),
-        addressof(this->session_set[id]));
+        addressof(session));
     assert(status == ACAMERA_OK);
+    this->session_set[id] = session;
+    if (resources)
+        resources->acquire(resource_type_t::capture_session, id, session, 0,
+                           NDCAM_RESOURCE_SITE);
 
     // ---- set request ----
     array<ACaptureRequest*, 1> batch_request{};
     batch_request[0] = request.get();
 
     status = ACameraCaptureSession_capture(
-        this->session_set[id], addressof(on_capture_event),
+        session, addressof(on_capture_event),
         batch_request.size(), batch_request.data(),
         addressof(this->seq_id_set[id]));
     assert(status == ACAMERA_OK);
@@ -272,19 +418,101 @@ camera_status_t camera_group_t::start_capture(
 }
 
 void camera_group_t::stop_capture(uint16_t id) noexcept {
-    auto& session = this->session_set[id];
-    if (session) {
+    unique_lock lck{this->operation_mtx_set[id]};
+    if (auto session = this->session_set[id].exchange(nullptr)) {
         logger->warn("stop_capture for session {} ", id);
 
         // follow `ACameraCaptureSession_capture`
         ACameraCaptureSession_abortCaptures(session);
 
         ACameraCaptureSession_close(session);
-        session = nullptr;
+        if (resources)
+            resources->release(resource_type_t::capture_session, id, session,
+                               0);
     }
     this->seq_id_set[id] = 0;
 }
 
+// stop the listener and clear the slot. the caller holds the device's
+// operation lock, and then frees the reader with `delete_reader` after the
+// lock is released
+static auto close_reader_locked(camera_group_t& context, uint16_t id) noexcept
+    -> AImageReader* {
+    AImageReader* reader = context.reader_set[id];
+    if (reader == nullptr)
+        return nullptr;
+    // the session must not use the reader's window
+    if (context.session_set[id])
+        context.stop_repeat(id);
+
+    // no more task from the listener
+    AImageReader_setImageListener(reader, nullptr);
+    context.reader_set[id] = nullptr;
+    return reader;
+}
+
+// the tasks may use the operations of the device. the caller must not hold
+// its lock
+static void delete_reader(camera_group_t& context, uint16_t id,
+                          AImageReader* reader) noexcept {
+    // wait for the listeners in progress
+    while (context.listener_set[id].load() != 0)
+        this_thread::yield();
+    // the images in the dispatch lane are freed with the reader
+    if (context.executor)
+        context.executor->drain(executor_lane_t::dispatch);
+    AImageReader_delete(reader);
+}
+
+// the lane can't wait for its own tasks. and the task's image is freed with
+// the reader
+static bool in_dispatch_lane(camera_group_t& context) noexcept {
+    return context.executor &&
+           context.executor->is_current(executor_lane_t::dispatch);
+}
+
+media_status_t camera_group_t::open_reader(uint16_t id, int32_t width,
+                                           int32_t height, int32_t format,
+                                           int32_t max_images) noexcept {
+    unique_lock lck{this->operation_mtx_set[id]};
+    if (this->reader_set[id] && in_dispatch_lane(*this)) {
+        logger->error("open_reader for device {}: in the dispatch lane", id);
+        return AMEDIA_ERROR_INVALID_OPERATION;
+    }
+    // the other thread may open a reader while the lock is released
+    while (auto* previous = close_reader_locked(*this, id)) {
+        lck.unlock();
+        delete_reader(*this, id, previous);
+        lck.lock();
+    }
+
+    AImageReader* reader = nullptr;
+    auto status =
+        AImageReader_new(width, height, format, max_images, addressof(reader));
+    if (status != AMEDIA_OK)
+        return status;
+    // the listener finds the device with the slot
+    this->reader_set[id] = reader;
+
+    AImageReader_ImageListener listener{};
+    listener.context = this;
+    listener.onImageAvailable = reinterpret_cast<AImageReader_ImageCallback>(
+        context_on_image_available);
+    return AImageReader_setImageListener(reader, addressof(listener));
+}
+
+void camera_group_t::close_reader(uint16_t id) noexcept {
+    if (in_dispatch_lane(*this)) {
+        logger->error("close_reader for device {}: in the dispatch lane", id);
+        return;
+    }
+    unique_lock lck{this->operation_mtx_set[id]};
+    auto* reader = close_reader_locked(*this, id);
+    lck.unlock();
+    if (reader)
+        delete_reader(*this, id, reader);
+}
+
 auto camera_group_t::get_facing(uint16_t id) noexcept -> uint16_t {
     // const ACameraMetadata*
     const auto* metadata = metadata_set[id];
@@ -302,6 +530,64 @@ auto camera_group_t::get_facing(uint16_t id) noexcept -> uint16_t {
     return facing;
 }
 
+auto camera_group_t::get_sensor_orientation(uint16_t id) noexcept -> int32_t {
+    const auto* metadata = metadata_set[id];
+
+    ACameraMetadata_const_entry entry{};
+    if (ACameraMetadata_getConstEntry(metadata, ACAMERA_SENSOR_ORIENTATION,
+                                      &entry) != ACAMERA_OK)
+        return 0;
+    return *(entry.data.i32);
+}
+
+auto camera_group_t::get_id(const ACameraDevice* device) const noexcept
+    -> uint16_t {
+    for (uint16_t id = 0u; id < max_camera_count; ++id)
+        if (device_set[id] == device)
+            return id;
+    return max_camera_count;
+}
+
+auto camera_group_t::get_id(const ACameraCaptureSession* session) const
+    noexcept -> uint16_t {
+    for (uint16_t id = 0u; id < max_camera_count; ++id)
+        if (session_set[id] == session)
+            return id;
+    return max_camera_count;
+}
+
+auto camera_group_t::get_id(const AImageReader* reader) const noexcept
+    -> uint16_t {
+    for (uint16_t id = 0u; id < max_camera_count; ++id)
+        if (reader_set[id] == reader)
+            return id;
+    return max_camera_count;
+}
+
+camera_status_t read_capture_result(uint16_t id, const ACameraMetadata* result,
+                                    capture_result_t& output) noexcept {
+    ACameraMetadata_const_entry entry{};
+    output = capture_result_t{};
+    output.id = id;
+
+    auto status =
+        ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_TIMESTAMP, &entry);
+    if (status != ACAMERA_OK)
+        return status;
+    output.timestamp = entry.data.i64[0];
+
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_EXPOSURE_TIME,
+                                      &entry) == ACAMERA_OK)
+        output.exposure_time = entry.data.i64[0];
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_FRAME_DURATION,
+                                      &entry) == ACAMERA_OK)
+        output.frame_duration = entry.data.i64[0];
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_SENSOR_SENSITIVITY,
+                                      &entry) == ACAMERA_OK)
+        output.sensitivity = entry.data.i32[0];
+    return ACAMERA_OK;
+}
+
 __attribute__((constructor)) void on_ndkcamera_attach() noexcept(false) {
     return;
 }
@@ -0,0 +1,248 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_motion.h>
+
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDCAM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NDCAM_SSE2 1
+#endif
+
+using namespace std;
+
+void subsample_plane(const uint8_t* src, uint32_t row_stride, uint32_t width,
+                     uint32_t height, uint32_t step, uint8_t* dst) noexcept {
+    const auto dst_width = width / step;
+    const auto dst_height = height / step;
+    for (auto y = 0u; y < dst_height; ++y) {
+        const uint8_t* row = src + y * step * row_stride;
+        uint8_t* out = dst + y * dst_width;
+        auto x = 0u;
+        if (step == 1) {
+            memcpy(out, row, dst_width);
+            continue;
+        }
+#if defined(NDCAM_NEON)
+        if (step == 2)
+            for (; x + 16 <= dst_width; x += 16)
+                vst1q_u8(out + x, vld2q_u8(row + x * 2).val[0]);
+        if (step == 4)
+            for (; x + 16 <= dst_width; x += 16)
+                vst1q_u8(out + x, vld4q_u8(row + x * 4).val[0]);
+#elif defined(NDCAM_SSE2)
+        if (step == 2) {
+            const auto mask = _mm_set1_epi16(0x00FF);
+            for (; x + 16 <= dst_width; x += 16) {
+                const auto* p = reinterpret_cast<const __m128i*>(row + x * 2);
+                const auto lo = _mm_and_si128(_mm_loadu_si128(p + 0), mask);
+                const auto hi = _mm_and_si128(_mm_loadu_si128(p + 1), mask);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                                 _mm_packus_epi16(lo, hi));
+            }
+        }
+        if (step == 4) {
+            const auto mask = _mm_set1_epi32(0x000000FF);
+            for (; x + 16 <= dst_width; x += 16) {
+                const auto* p = reinterpret_cast<const __m128i*>(row + x * 4);
+                const auto v0 = _mm_and_si128(_mm_loadu_si128(p + 0), mask);
+                const auto v1 = _mm_and_si128(_mm_loadu_si128(p + 1), mask);
+                const auto v2 = _mm_and_si128(_mm_loadu_si128(p + 2), mask);
+                const auto v3 = _mm_and_si128(_mm_loadu_si128(p + 3), mask);
+                const auto lo = _mm_packs_epi32(v0, v1);
+                const auto hi = _mm_packs_epi32(v2, v3);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                                 _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (; x < dst_width; ++x)
+            out[x] = row[x * step];
+    }
+}
+
+void subsample_plane(const plane_view_t& src, uint32_t step,
+                     uint8_t* dst) noexcept {
+    step = max(step, 1u);
+    if (src.is_packed()) {
+        subsample_plane(src.data.data(), src.row_stride, src.width,
+                        src.height, step, dst);
+        return;
+    }
+    const auto dst_width = src.width / step;
+    const auto dst_height = src.height / step;
+    const auto stride = step * src.pixel_stride;
+    for (auto y = 0u; y < dst_height; ++y) {
+        const uint8_t* row = src.row(y * step).data();
+        uint8_t* out = dst + y * dst_width;
+        for (auto x = 0u; x < dst_width; ++x)
+            out[x] = row[x * stride];
+    }
+}
+
+// sum of absolute difference in [0, count)
+static uint32_t row_sad(const uint8_t* lhs, const uint8_t* rhs,
+                        uint32_t count) noexcept {
+    uint32_t sum = 0;
+    auto x = 0u;
+#if defined(NDCAM_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; x + 16 <= count; x += 16) {
+        const auto diff = vabdq_u8(vld1q_u8(lhs + x), vld1q_u8(rhs + x));
+        acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+    }
+    const auto pair = vpaddlq_u32(acc);
+    sum += static_cast<uint32_t>(vgetq_lane_u64(pair, 0) +
+                                 vgetq_lane_u64(pair, 1));
+#elif defined(NDCAM_SSE2)
+    auto acc = _mm_setzero_si128();
+    for (; x + 16 <= count; x += 16) {
+        const auto* a = reinterpret_cast<const __m128i*>(lhs + x);
+        const auto* b = reinterpret_cast<const __m128i*>(rhs + x);
+        const auto sad = _mm_sad_epu8(_mm_loadu_si128(a), _mm_loadu_si128(b));
+        acc = _mm_add_epi64(acc, sad);
+    }
+    for (; x + 8 <= count; x += 8) {
+        const auto* a = reinterpret_cast<const __m128i*>(lhs + x);
+        const auto* b = reinterpret_cast<const __m128i*>(rhs + x);
+        const auto sad = _mm_sad_epu8(_mm_loadl_epi64(a), _mm_loadl_epi64(b));
+        acc = _mm_add_epi64(acc, sad);
+    }
+    sum += static_cast<uint32_t>(_mm_cvtsi128_si32(acc) +
+                                 _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; x < count; ++x)
+        sum += static_cast<uint32_t>(abs(lhs[x] - rhs[x]));
+    return sum;
+}
+
+void block_difference(const uint8_t* lhs, const uint8_t* rhs, uint32_t width,
+                      uint32_t height, uint32_t block,
+                      uint8_t* diffs) noexcept {
+    const auto blocks_x = (width + block - 1) / block;
+    const auto blocks_y = (height + block - 1) / block;
+    for (auto by = 0u; by < blocks_y; ++by) {
+        const auto y0 = by * block;
+        const auto y1 = min(y0 + block, height);
+        for (auto bx = 0u; bx < blocks_x; ++bx) {
+            const auto x0 = bx * block;
+            const auto x1 = min(x0 + block, width);
+            uint32_t sum = 0;
+            for (auto y = y0; y < y1; ++y)
+                sum += row_sad(lhs + y * width + x0, rhs + y * width + x0,
+                               x1 - x0);
+            const auto area = (x1 - x0) * (y1 - y0);
+            diffs[by * blocks_x + bx] =
+                static_cast<uint8_t>(min(sum / area, 255u));
+        }
+    }
+}
+
+motion_gate_t::motion_gate_t(const motion_config_t& _config) noexcept
+    : config{_config} {
+    if (config.step == 0)
+        config.step = 1;
+    if (config.block == 0)
+        config.block = 16;
+}
+
+bool motion_gate_t::update(const uint8_t* y, uint32_t row_stride,
+                           uint32_t _width, uint32_t _height,
+                           int64_t timestamp) noexcept {
+    return update(make_plane_view(y, row_stride, _width, _height), timestamp);
+}
+
+bool motion_gate_t::update(const plane_view_t& y, int64_t timestamp) noexcept {
+    const auto step = config.step;
+    const auto _width = y.width;
+    const auto _height = y.height;
+    const auto block = config.block;
+
+    // first frame or resolution changed. it becomes the reference
+    if (_width / step != width || _height / step != height) {
+        unique_lock lck{mtx};
+        width = _width / step;
+        height = _height / step;
+        blocks_x = (width + block - 1) / block;
+        blocks_y = (height + block - 1) / block;
+        reference.resize(width * height);
+        current.resize(width * height);
+        next_map.resize(blocks_x * blocks_y);
+        subsample_plane(y, step, reference.data());
+        since_refresh = 0;
+
+        motion_map.assign(blocks_x * blocks_y, 0);
+        map_timestamp = timestamp;
+        ++stats.frames;
+        ++stats.moving;
+        return true;
+    }
+
+    subsample_plane(y, step, current.data());
+    block_difference(reference.data(), current.data(), width, height, block,
+                     next_map.data());
+
+    uint32_t count = 0;
+    for (auto diff : next_map)
+        if (diff > config.block_threshold)
+            ++count;
+    const bool moving = count >= config.min_blocks;
+
+    // moving frame becomes the reference of the next one
+    if (moving || ++since_refresh >= config.refresh_interval) {
+        swap(reference, current);
+        since_refresh = 0;
+    }
+
+    unique_lock lck{mtx};
+    swap(motion_map, next_map);
+    map_timestamp = timestamp;
+    ++stats.frames;
+    if (moving)
+        ++stats.moving;
+    return moving;
+}
+
+media_status_t motion_gate_t::update(const AImage* image,
+                                     bool& moving) noexcept {
+    frame_view_t frame{};
+    if (auto status = get_frame_view(image, frame))
+        return status;
+    if (frame.format != AIMAGE_FORMAT_YUV_420_888)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+
+    moving = update(frame.planes[0], frame.timestamp);
+    return AMEDIA_OK;
+}
+
+void motion_gate_t::reset() noexcept {
+    unique_lock lck{mtx};
+    width = height = 0;
+}
+
+auto motion_gate_t::get_stats() const noexcept -> motion_stats_t {
+    unique_lock lck{mtx};
+    return stats;
+}
+
+void motion_gate_t::get_map_size(uint32_t& _blocks_x,
+                                 uint32_t& _blocks_y) const noexcept {
+    unique_lock lck{mtx};
+    const auto count = static_cast<uint32_t>(motion_map.size());
+    _blocks_x = count ? blocks_x : 0;
+    _blocks_y = count ? blocks_y : 0;
+}
+
+int64_t motion_gate_t::read_map(gsl::span<uint8_t> dst) const noexcept {
+    unique_lock lck{mtx};
+    if (motion_map.empty() ||
+        static_cast<size_t>(dst.size()) < motion_map.size())
+        return 0;
+    copy(motion_map.begin(), motion_map.end(), dst.begin());
+    return map_timestamp;
+}
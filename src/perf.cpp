@@ -0,0 +1,256 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+auto get_perf_stage_name(perf_stage_t stage) noexcept -> const char* {
+    static constexpr const char* names[perf_stage_count]{
+        "open_device", "start_repeat",    "start_capture", "capture_started",
+        "capture_completed", "image_available", "motion", "statistics",
+        "preevent",    "publish",         "consume",       "convert",
+        "resize",      "develop_raw",     "encode_jpeg",
+    };
+    const auto index = static_cast<uint8_t>(stage);
+    return index < perf_stage_count ? names[index] : "unknown";
+}
+
+auto get_perf_counter_name(perf_counter_t counter) noexcept -> const char* {
+    static constexpr const char* names[perf_counter_count]{
+        "cycles", "instructions", "cache_misses", "branch_misses"};
+    const auto index = static_cast<uint8_t>(counter);
+    return index < perf_counter_count ? names[index] : "unknown";
+}
+
+// PERF_FORMAT_GROUP with ID, TOTAL_TIME_ENABLED and TOTAL_TIME_RUNNING
+struct perf_read_t final {
+    uint64_t nr;
+    uint64_t enabled;
+    uint64_t running;
+    struct {
+        uint64_t value;
+        uint64_t id;
+    } values[perf_counter_count];
+};
+
+/**
+ * Counters of the thread in 1 group. The kernel schedules them together so
+ * they are comparable. The first one opened is the leader
+ */
+struct perf_group_t final {
+    bool opened = false;
+    int leader = -1;
+    uint32_t mask = 0;
+    array<int, perf_counter_count> fds{-1, -1, -1, -1};
+    array<uint64_t, perf_counter_count> ids{};
+
+  public:
+    ~perf_group_t() noexcept {
+        for (auto fd : fds)
+            if (fd != -1)
+                close(fd);
+    }
+
+    void open() noexcept {
+        opened = true;
+        static constexpr uint64_t configs[perf_counter_count]{
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (auto i = 0u; i < perf_counter_count; ++i) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            // this thread on any CPU
+            const auto fd = static_cast<int>(
+                syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd == -1) {
+                logger->debug("perf: {} {}",
+                              get_perf_counter_name(
+                                  static_cast<perf_counter_t>(i)),
+                              strerror(errno));
+                continue;
+            }
+            if (ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]) != 0) {
+                close(fd);
+                continue;
+            }
+            fds[i] = fd;
+            mask |= 1u << i;
+            if (leader == -1)
+                leader = fd;
+        }
+    }
+
+    /**
+     * @return false if the group couldn't be read
+     */
+    bool read(uint64_t& enabled, uint64_t& running,
+              array<uint64_t, perf_counter_count>& counters) noexcept {
+        if (opened == false)
+            open();
+        if (leader == -1)
+            return false;
+        perf_read_t values{};
+        const auto length = ::read(leader, &values, sizeof(values));
+        if (length < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+            return false;
+        enabled = values.enabled;
+        running = values.running;
+        for (auto n = 0u; n < values.nr && n < perf_counter_count; ++n)
+            for (auto i = 0u; i < perf_counter_count; ++i)
+                if (fds[i] != -1 && ids[i] == values.values[n].id)
+                    counters[i] = values.values[n].value;
+        return true;
+    }
+};
+
+static thread_local perf_group_t group{};
+
+uint32_t get_perf_counters() noexcept {
+    if (group.opened == false)
+        group.open();
+    return group.mask;
+}
+
+perf_profiler_t::perf_profiler_t(const perf_config_t& config) noexcept
+    : config{config} {
+}
+
+void perf_profiler_t::add(perf_stage_t id, int64_t wall_time,
+                          const uint64_t* values, uint32_t mask) noexcept {
+    auto& stage = stages[static_cast<uint8_t>(id)];
+    stage.count += 1;
+    stage.wall_time += wall_time;
+    auto peak = stage.wall_time_max.load(memory_order_relaxed);
+    while (peak < wall_time &&
+           stage.wall_time_max.compare_exchange_weak(peak, wall_time) == false)
+        continue;
+    if (values == nullptr)
+        return;
+    stage.counted += 1;
+    stage.counter_mask.fetch_or(mask);
+    for (auto i = 0u; i < perf_counter_count; ++i)
+        stage.counters[i] += values[i];
+}
+
+void perf_profiler_t::reset() noexcept {
+    for (auto& stage : stages) {
+        stage.count = stage.counted = 0;
+        stage.wall_time = stage.wall_time_max = 0;
+        stage.counter_mask = 0;
+        for (auto& counter : stage.counters)
+            counter = 0;
+    }
+}
+
+auto perf_profiler_t::get_summary(perf_stage_t id) const noexcept
+    -> perf_summary_t {
+    const auto& stage = stages[static_cast<uint8_t>(id)];
+    perf_summary_t summary{};
+    summary.count = stage.count;
+    summary.wall_time = stage.wall_time;
+    summary.wall_time_max = stage.wall_time_max;
+    summary.counted = stage.counted;
+    summary.counter_mask = stage.counter_mask;
+    for (auto i = 0u; i < perf_counter_count; ++i)
+        summary.counters[i] = stage.counters[i];
+    return summary;
+}
+
+auto perf_profiler_t::to_json() const noexcept -> std::string {
+    string text{"{\"stages\":["};
+    auto first = true;
+    for (auto s = 0u; s < perf_stage_count; ++s) {
+        const auto id = static_cast<perf_stage_t>(s);
+        const auto summary = get_summary(id);
+        if (summary.count == 0)
+            continue;
+        if (first == false)
+            text += ',';
+        first = false;
+        fmt::format_to(back_inserter(text),
+                       "{{\"name\":\"{}\",\"count\":{},\"wall_time_avg\":{},"
+                       "\"wall_time_max\":{},\"counted\":{}",
+                       get_perf_stage_name(id), summary.count,
+                       summary.wall_time /
+                           static_cast<int64_t>(summary.count),
+                       summary.wall_time_max, summary.counted);
+        if (summary.counted) {
+            for (auto i = 0u; i < perf_counter_count; ++i)
+                if (summary.counter_mask & (1u << i))
+                    fmt::format_to(
+                        back_inserter(text), ",\"{}\":{}",
+                        get_perf_counter_name(static_cast<perf_counter_t>(i)),
+                        summary.counters[i] / summary.counted);
+            // instructions per cycle
+            constexpr uint32_t both = 0b11;
+            if ((summary.counter_mask & both) == both && summary.counters[0])
+                fmt::format_to(back_inserter(text), ",\"ipc\":{:.3f}",
+                               static_cast<double>(summary.counters[1]) /
+                                   static_cast<double>(summary.counters[0]));
+        }
+        text += '}';
+    }
+    text += "]}";
+    return text;
+}
+
+static atomic<perf_profiler_t*> current{};
+
+void set_perf_profiler(perf_profiler_t* profiler) noexcept {
+    current = profiler;
+}
+
+auto get_perf_profiler() noexcept -> perf_profiler_t* {
+    return current.load(memory_order_acquire);
+}
+
+perf_scope_t::perf_scope_t(perf_stage_t stage) noexcept
+    : profiler{get_perf_profiler()}, stage{stage} {
+    if (profiler == nullptr)
+        return;
+    if (profiler->get_config().counters)
+        counted = group.read(enabled, running, counters);
+    // after the read. its cost is not in the wall time
+    begin = startup_timing_t::now();
+}
+
+perf_scope_t::~perf_scope_t() noexcept {
+    if (profiler == nullptr)
+        return;
+    const auto end = startup_timing_t::now();
+    uint64_t enabled = 0, running = 0;
+    array<uint64_t, perf_counter_count> values{};
+    if (counted)
+        counted = group.read(enabled, running, values);
+    // multiplexed in the scope. the values are not for the whole scope
+    if (counted && enabled - this->enabled != running - this->running)
+        counted = false;
+    if (counted == false) {
+        profiler->add(stage, end - begin, nullptr, 0);
+        return;
+    }
+    for (auto i = 0u; i < perf_counter_count; ++i)
+        values[i] -= counters[i];
+    profiler->add(stage, end - begin, values.data(), group.mask);
+}
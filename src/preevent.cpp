@@ -0,0 +1,530 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_preevent.h>
+#include <ndk_camera_resource.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// rANS with byte-wise renormalization. the state stays in [low, low << 8)
+static constexpr uint32_t prob_bits = 12;
+static constexpr uint32_t prob_scale = 1u << prob_bits;
+static constexpr uint32_t rans_low = 1u << 23;
+
+enum tile_mode_t : uint8_t {
+    tile_raw = 0, // residuals without the entropy coding
+    tile_rans = 1,
+};
+
+// the chroma tile must have the half rows of the luma
+static uint32_t normalize_tile_rows(uint32_t tile_rows) noexcept {
+    return max(2u, tile_rows + tile_rows % 2);
+}
+
+uint32_t get_tile_count(uint32_t height, uint32_t tile_rows) noexcept {
+    tile_rows = normalize_tile_rows(tile_rows);
+    return 3 * ((height + tile_rows - 1) / tile_rows);
+}
+
+size_t get_decoded_size(const encoded_frame_t& frame) noexcept {
+    const size_t cw = (frame.width + 1) / 2, ch = (frame.height + 1) / 2;
+    return size_t{frame.width} * frame.height + 2 * cw * ch;
+}
+
+struct tile_geometry_t final {
+    uint32_t plane; // 0: Y, 1: U, 2: V
+    uint32_t y0, rows, width;
+    size_t offset; // of the plane in the decoded frame
+};
+
+static auto get_geometry(uint32_t width, uint32_t height, uint32_t tile_rows,
+                         uint32_t index) noexcept -> tile_geometry_t {
+    const auto strips = (height + tile_rows - 1) / tile_rows;
+    const uint32_t cw = (width + 1) / 2, ch = (height + 1) / 2;
+    tile_geometry_t tile{};
+    tile.plane = index / strips;
+    const auto strip = index % strips;
+    const auto rows = tile.plane ? tile_rows / 2 : tile_rows;
+    const auto plane_height = tile.plane ? ch : height;
+    tile.y0 = strip * rows;
+    tile.rows = min(rows, plane_height - tile.y0);
+    tile.width = tile.plane ? cw : width;
+    tile.offset = size_t{width} * height;
+    if (tile.plane == 0)
+        tile.offset = 0;
+    if (tile.plane == 2)
+        tile.offset += size_t{cw} * ch;
+    return tile;
+}
+
+// median edge detector of LOCO-I
+static uint8_t predict(uint8_t a, uint8_t b, uint8_t c) noexcept {
+    const auto lo = min(a, b), hi = max(a, b);
+    if (c >= hi)
+        return lo;
+    if (c <= lo)
+        return hi;
+    return static_cast<uint8_t>(a + b - c);
+}
+
+// the first row of the tile is predicted only with the left pixel
+static void get_residuals(const plane_view_t& plane,
+                          const tile_geometry_t& tile, uint8_t* out) noexcept {
+    const auto ps = plane.pixel_stride;
+    const uint8_t* up = nullptr;
+    for (auto r = 0u; r < tile.rows; ++r, out += tile.width) {
+        const uint8_t* row = plane.row(tile.y0 + r).data();
+        if (up == nullptr) {
+            out[0] = static_cast<uint8_t>(row[0] - 128);
+            for (auto x = 1u; x < tile.width; ++x)
+                out[x] =
+                    static_cast<uint8_t>(row[x * ps] - row[(x - 1) * ps]);
+        } else {
+            out[0] = static_cast<uint8_t>(row[0] - up[0]);
+            for (auto x = 1u; x < tile.width; ++x)
+                out[x] = static_cast<uint8_t>(
+                    row[x * ps] -
+                    predict(row[(x - 1) * ps], up[x * ps], up[(x - 1) * ps]));
+        }
+        up = row;
+    }
+}
+
+// scale the counts so their sum is `prob_scale`. used symbols keep 1 at least
+static void normalize(const uint32_t (&counts)[256], uint32_t total,
+                      uint16_t (&freqs)[256]) noexcept {
+    uint32_t sum = 0, largest = 0;
+    for (auto s = 0u; s < 256; ++s) {
+        freqs[s] = 0;
+        if (counts[s] == 0)
+            continue;
+        const auto scaled = uint64_t{counts[s]} * prob_scale / total;
+        freqs[s] = static_cast<uint16_t>(max<uint64_t>(scaled, 1));
+        sum += freqs[s];
+        if (counts[s] > counts[largest])
+            largest = s;
+    }
+    while (sum > prob_scale) {
+        auto s = static_cast<uint32_t>(
+            max_element(begin(freqs), end(freqs)) - begin(freqs));
+        --freqs[s];
+        --sum;
+    }
+    freqs[largest] += static_cast<uint16_t>(prob_scale - sum);
+}
+
+// division-free encoding. see ryg_rans
+struct rans_symbol_t final {
+    uint32_t x_max;
+    uint32_t rcp_freq;
+    uint32_t bias;
+    uint16_t cmpl_freq;
+    uint16_t rcp_shift;
+
+  public:
+    void init(uint32_t start, uint32_t freq) noexcept {
+        x_max = ((rans_low >> prob_bits) << 8) * freq;
+        cmpl_freq = static_cast<uint16_t>(prob_scale - freq);
+        if (freq < 2) {
+            rcp_freq = ~0u;
+            rcp_shift = 0;
+            bias = start + prob_scale - 1;
+            return;
+        }
+        uint32_t shift = 0;
+        while (freq > (1u << shift))
+            ++shift;
+        rcp_freq = static_cast<uint32_t>(
+            ((uint64_t{1} << (shift + 31)) + freq - 1) / freq);
+        rcp_shift = static_cast<uint16_t>(shift - 1);
+        bias = start;
+    }
+};
+
+void encode_tile(const frame_view_t& frame, uint32_t tile_rows,
+                 uint32_t index, vector<uint8_t>& output) noexcept {
+    tile_rows = normalize_tile_rows(tile_rows);
+    Expects(index < get_tile_count(frame.height, tile_rows));
+    const auto tile = get_geometry(frame.width, frame.height, tile_rows, index);
+    const auto count = size_t{tile.rows} * tile.width;
+
+    static thread_local vector<uint8_t> residuals{};
+    residuals.resize(count);
+    get_residuals(frame.planes[tile.plane], tile, residuals.data());
+
+    uint32_t counts[256]{};
+    for (auto r : residuals)
+        ++counts[r];
+    uint16_t freqs[256]{};
+    normalize(counts, static_cast<uint32_t>(count), freqs);
+
+    // mode, symbol count(2), (symbol, frequency(2)) x count, state(4), stream
+    size_t header_size = 3;
+    rans_symbol_t symbols[256]{};
+    for (uint32_t s = 0, start = 0; s < 256; start += freqs[s++]) {
+        if (freqs[s] == 0)
+            continue;
+        symbols[s].init(start, freqs[s]);
+        header_size += 3;
+    }
+    output.resize(header_size + count);
+
+    // the stream is written backward. larger than raw? then use raw
+    uint8_t* const limit = output.data() + header_size + 4;
+    uint8_t* ptr = output.data() + output.size();
+    uint32_t x = rans_low;
+    for (auto i = count; i-- > 0;) {
+        const auto& symbol = symbols[residuals[i]];
+        while (x >= symbol.x_max) {
+            if (ptr <= limit)
+                goto UseRaw;
+            *--ptr = static_cast<uint8_t>(x);
+            x >>= 8;
+        }
+        const auto q = static_cast<uint32_t>(
+                           (uint64_t{x} * symbol.rcp_freq) >> 32) >>
+                       symbol.rcp_shift;
+        x += symbol.bias + q * symbol.cmpl_freq;
+    }
+    // the tiny tile may not have the room for the state
+    if (ptr < limit)
+        goto UseRaw;
+    ptr -= 4;
+    for (auto i = 0; i < 4; ++i)
+        ptr[i] = static_cast<uint8_t>(x >> (8 * i));
+    {
+        const auto stream = static_cast<size_t>(
+            output.data() + output.size() - ptr);
+        memmove(output.data() + header_size, ptr, stream);
+        output.resize(header_size + stream);
+
+        uint8_t* header = output.data();
+        header[0] = tile_rans;
+        const auto used = static_cast<uint16_t>((header_size - 3) / 3);
+        memcpy(header + 1, &used, 2);
+        header += 3;
+        for (auto s = 0u; s < 256; ++s) {
+            if (freqs[s] == 0)
+                continue;
+            header[0] = static_cast<uint8_t>(s);
+            memcpy(header + 1, &freqs[s], 2);
+            header += 3;
+        }
+        return;
+    }
+UseRaw:
+    output.resize(1 + count);
+    output[0] = tile_raw;
+    memcpy(output.data() + 1, residuals.data(), count);
+}
+
+// reverse of `get_residuals` with the residuals from `next()`
+template <typename Next>
+static bool restore_tile(const tile_geometry_t& tile, uint8_t* plane,
+                         Next&& next) noexcept {
+    uint8_t* up = nullptr;
+    uint8_t* row = plane + size_t{tile.y0} * tile.width;
+    for (auto r = 0u; r < tile.rows; ++r, row += tile.width) {
+        uint8_t value = 0;
+        if (next(value) == false)
+            return false;
+        row[0] = static_cast<uint8_t>(value + (up ? up[0] : 128));
+        for (auto x = 1u; x < tile.width; ++x) {
+            if (next(value) == false)
+                return false;
+            const auto pred =
+                up ? predict(row[x - 1], up[x], up[x - 1]) : row[x - 1];
+            row[x] = static_cast<uint8_t>(value + pred);
+        }
+        up = row;
+    }
+    return true;
+}
+
+static bool decode_tile(const tile_geometry_t& tile, const uint8_t* src,
+                        const uint8_t* end, uint8_t* plane) noexcept {
+    const auto count = size_t{tile.rows} * tile.width;
+    if (src == end)
+        return false;
+    const auto mode = *src++;
+    if (mode == tile_raw) {
+        if (static_cast<size_t>(end - src) < count)
+            return false;
+        return restore_tile(tile, plane, [&src](uint8_t& value) {
+            value = *src++;
+            return true;
+        });
+    }
+    if (mode != tile_rans || end - src < 2)
+        return false;
+
+    uint16_t used = 0;
+    memcpy(&used, src, 2);
+    src += 2;
+    if (used == 0 || used > 256 || end - src < 3 * used + 4)
+        return false;
+    uint16_t freqs[256]{}, starts[256]{};
+    uint8_t symbol_of[prob_scale]{};
+    uint32_t sum = 0;
+    for (auto i = 0u; i < used; ++i, src += 3) {
+        const auto s = src[0];
+        uint16_t freq = 0;
+        memcpy(&freq, src + 1, 2);
+        if (freq == 0 || sum + freq > prob_scale)
+            return false;
+        freqs[s] = freq;
+        starts[s] = static_cast<uint16_t>(sum);
+        memset(symbol_of + sum, s, freq);
+        sum += freq;
+    }
+    if (sum != prob_scale)
+        return false;
+
+    uint32_t x = 0;
+    for (auto i = 0; i < 4; ++i)
+        x |= uint32_t{*src++} << (8 * i);
+    return restore_tile(tile, plane, [&](uint8_t& value) {
+        const auto slot = x & (prob_scale - 1);
+        const auto s = symbol_of[slot];
+        x = freqs[s] * (x >> prob_bits) + slot - starts[s];
+        while (x < rans_low) {
+            if (src == end)
+                return false;
+            x = (x << 8) | *src++;
+        }
+        value = s;
+        return true;
+    });
+}
+
+bool decode_frame(const encoded_frame_t& frame,
+                  gsl::span<uint8_t> dst) noexcept {
+    const auto tile_rows = normalize_tile_rows(frame.tile_rows);
+    const auto count = get_tile_count(frame.height, tile_rows);
+    if (frame.offsets.size() != count ||
+        static_cast<size_t>(dst.size()) < get_decoded_size(frame))
+        return false;
+    const auto* data = frame.data.data();
+    for (auto i = 0u; i < count; ++i) {
+        const auto begin = frame.offsets[i];
+        const auto end = i + 1 < count
+                             ? frame.offsets[i + 1]
+                             : static_cast<uint32_t>(frame.data.size());
+        if (begin > end || end > frame.data.size())
+            return false;
+        const auto tile =
+            get_geometry(frame.width, frame.height, tile_rows, i);
+        if (decode_tile(tile, data + begin, data + end,
+                        dst.data() + tile.offset) == false)
+            return false;
+    }
+    return true;
+}
+
+preevent_ring_t::preevent_ring_t(const preevent_config_t& _config) noexcept
+    : config{_config} {
+    config.tile_rows = normalize_tile_rows(config.tile_rows);
+    for (auto i = 0u; i < config.threads; ++i)
+        workers.emplace_back(&preevent_ring_t::run, this);
+}
+
+preevent_ring_t::~preevent_ring_t() noexcept {
+    {
+        unique_lock lck{job_mtx};
+        stopping = true;
+    }
+    job_cv.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    clear();
+}
+
+void preevent_ring_t::work(const frame_view_t& frame, uint32_t count) noexcept {
+    uint32_t finished = 0;
+    for (auto i = next_tile++; i < count; i = next_tile++, ++finished)
+        encode_tile(frame, config.tile_rows, i, tiles[i]);
+
+    unique_lock lck{job_mtx};
+    done_tiles += finished;
+    if (done_tiles == count)
+        done_cv.notify_all();
+}
+
+void preevent_ring_t::run() noexcept {
+    uint64_t seen = 0;
+    unique_lock lck{job_mtx};
+    while (true) {
+        job_cv.wait(lck, [this, seen]() {
+            return stopping || (job && generation != seen);
+        });
+        if (stopping)
+            return;
+        seen = generation;
+        const auto& frame = *job;
+        const auto count = job_tiles;
+        ++active;
+        lck.unlock();
+        work(frame, count);
+        lck.lock();
+        // `push` may return after this
+        if (--active == 0)
+            done_cv.notify_all();
+    }
+}
+
+auto preevent_ring_t::push(const frame_view_t& frame) noexcept
+    -> media_status_t {
+    if (frame.format != AIMAGE_FORMAT_YUV_420_888 || frame.plane_count != 3 ||
+        frame.empty())
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    const auto begin = startup_timing_t::now();
+    const auto count = get_tile_count(frame.height, config.tile_rows);
+    if (tiles.size() < count)
+        tiles.resize(count);
+
+    {
+        unique_lock lck{job_mtx};
+        job = &frame;
+        job_tiles = count;
+        next_tile = 0;
+        done_tiles = 0;
+        ++generation;
+    }
+    job_cv.notify_all();
+    work(frame, count);
+    {
+        // the frame must not be touched after the return
+        unique_lock lck{job_mtx};
+        done_cv.wait(lck, [this, count]() {
+            return done_tiles == count && active == 0;
+        });
+        job = nullptr;
+    }
+
+    auto encoded = make_shared<encoded_frame_t>();
+    encoded->timestamp = frame.timestamp;
+    encoded->width = frame.width;
+    encoded->height = frame.height;
+    encoded->tile_rows = config.tile_rows;
+    encoded->offsets.resize(count);
+    size_t bytes = 0;
+    for (auto i = 0u; i < count; ++i) {
+        encoded->offsets[i] = static_cast<uint32_t>(bytes);
+        bytes += tiles[i].size();
+    }
+    encoded->data.resize(bytes);
+    for (auto i = 0u; i < count; ++i)
+        memcpy(encoded->data.data() + encoded->offsets[i], tiles[i].data(),
+               tiles[i].size());
+    const auto raw_bytes = get_decoded_size(*encoded);
+
+    unique_lock lck{mtx};
+    if (config.resources)
+        config.resources->acquire(resource_type_t::frame_buffer, config.id,
+                                  encoded.get(), bytes, NDCAM_RESOURCE_SITE);
+    frames.emplace_back(move(encoded));
+    stats.bytes += bytes;
+    stats.raw_bytes += raw_bytes;
+    stats.pushed += 1;
+    // evict the old ones. the latest frame stays
+    const auto max_duration = duration_cast<nanoseconds>(config.max_duration);
+    while (frames.size() > 1) {
+        const auto& oldest = *frames.front();
+        if (stats.bytes <= config.max_bytes &&
+            frame.timestamp - oldest.timestamp <= max_duration.count())
+            break;
+        stats.bytes -= oldest.data.size();
+        stats.raw_bytes -= get_decoded_size(oldest);
+        stats.evicted += 1;
+        if (config.resources)
+            config.resources->release(resource_type_t::frame_buffer, config.id,
+                                      &oldest, oldest.data.size());
+        frames.pop_front();
+    }
+    stats.frames = static_cast<uint32_t>(frames.size());
+    stats.encode_time = startup_timing_t::now() - begin;
+    return AMEDIA_OK;
+}
+
+auto preevent_ring_t::push(const AImage* image) noexcept -> media_status_t {
+    frame_view_t frame{};
+    if (auto status = get_frame_view(image, frame))
+        return status;
+    return push(frame);
+}
+
+void preevent_ring_t::snapshot(
+    vector<encoded_frame_ptr>& output) const noexcept {
+    unique_lock lck{mtx};
+    output.assign(frames.begin(), frames.end());
+}
+
+void preevent_ring_t::flush(preevent_consumer_t consumer,
+                            void* context) const noexcept {
+    vector<encoded_frame_ptr> window{};
+    snapshot(window);
+    for (const auto& frame : window)
+        consumer(context, frame);
+}
+
+int preevent_ring_t::save(const char* path) const noexcept {
+    vector<encoded_frame_ptr> window{};
+    snapshot(window);
+    return save_encoded_frames(path, window);
+}
+
+void preevent_ring_t::clear() noexcept {
+    unique_lock lck{mtx};
+    if (config.resources)
+        for (const auto& frame : frames)
+            config.resources->release(resource_type_t::frame_buffer, config.id,
+                                      frame.get(), frame->data.size());
+    frames.clear();
+    stats.frames = 0;
+    stats.bytes = stats.raw_bytes = 0;
+}
+
+auto preevent_ring_t::get_stats() const noexcept -> preevent_stats_t {
+    unique_lock lck{mtx};
+    return stats;
+}
+
+int save_encoded_frames(const char* path,
+                        const vector<encoded_frame_ptr>& frames) noexcept {
+    auto* stream = fopen(path, "wb");
+    if (stream == nullptr) {
+        const auto ec = errno;
+        logger->error("preevent: {} {}", path, strerror(ec));
+        return ec;
+    }
+    auto write = [stream](const void* ptr, size_t size) {
+        return fwrite(ptr, 1, size, stream) == size;
+    };
+    const uint32_t version = 1, count = static_cast<uint32_t>(frames.size());
+    bool ok = write("NDPE", 4) && write(&version, 4) && write(&count, 4);
+    for (const auto& frame : frames) {
+        if (ok == false)
+            break;
+        const uint32_t fields[]{
+            frame->width, frame->height, frame->tile_rows,
+            static_cast<uint32_t>(frame->offsets.size()),
+            static_cast<uint32_t>(frame->data.size())};
+        ok = write(&frame->timestamp, 8) && write(fields, sizeof(fields)) &&
+             write(frame->offsets.data(), 4 * frame->offsets.size()) &&
+             write(frame->data.data(), frame->data.size());
+    }
+    const auto ec = ok ? 0 : errno;
+    if (fclose(stream) != 0 && ok)
+        return errno;
+    return ec;
+}
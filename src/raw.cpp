@@ -0,0 +1,698 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_executor.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_raw.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDCAM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NDCAM_SSE2 1
+#endif
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// rows/columns around the band. the edge-aware green of the neighbors reads
+// 2 more pixels from them. even, so the padded buffer keeps the CFA phase
+static constexpr int32_t pad = 4;
+
+// at least this rows in a band. the padding is read twice
+static constexpr uint32_t min_band_rows = 16;
+
+auto read_raw_params(const ACameraMetadata* characteristics,
+                     const ACameraMetadata* result,
+                     raw_params_t& params) noexcept -> camera_status_t {
+    ACameraMetadata_const_entry entry{};
+    if (ACameraMetadata_getConstEntry(
+            characteristics, ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT,
+            &entry) != ACAMERA_OK ||
+        entry.count == 0)
+        return ACAMERA_ERROR_METADATA_NOT_FOUND;
+    const auto arrangement = entry.data.u8[0];
+    if (arrangement > ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_BGGR) {
+        logger->warn("color filter arrangement {} is not bayer", arrangement);
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    }
+    params.pattern = static_cast<bayer_pattern_t>(arrangement);
+
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_SENSOR_INFO_WHITE_LEVEL,
+                                      &entry) != ACAMERA_OK ||
+        entry.count == 0)
+        return ACAMERA_ERROR_METADATA_NOT_FOUND;
+    params.white_level = static_cast<float>(entry.data.i32[0]);
+
+    params.black_level.fill(0);
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_SENSOR_BLACK_LEVEL_PATTERN,
+                                      &entry) == ACAMERA_OK &&
+        entry.count == 4)
+        for (auto i = 0u; i < 4; ++i)
+            params.black_level[i] = static_cast<float>(entry.data.i32[i]);
+
+    params.gains.fill(1);
+    params.shading_width = params.shading_height = 0;
+    params.shading_map.clear();
+    if (result == nullptr)
+        return ACAMERA_OK;
+
+    // the levels of the frame. they may drift with the temperature
+    if (ACameraMetadata_getConstEntry(
+            result, ACAMERA_SENSOR_DYNAMIC_BLACK_LEVEL, &entry) == ACAMERA_OK &&
+        entry.count == 4)
+        copy_n(entry.data.f, 4, params.black_level.begin());
+    if (ACameraMetadata_getConstEntry(
+            result, ACAMERA_SENSOR_DYNAMIC_WHITE_LEVEL, &entry) == ACAMERA_OK &&
+        entry.count)
+        params.white_level = static_cast<float>(entry.data.i32[0]);
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_COLOR_CORRECTION_GAINS,
+                                      &entry) == ACAMERA_OK &&
+        entry.count == 4)
+        copy_n(entry.data.f, 4, params.gains.begin());
+
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_LENS_INFO_SHADING_MAP_SIZE,
+                                      &entry) != ACAMERA_OK ||
+        entry.count != 2 || entry.data.i32[0] <= 0 || entry.data.i32[1] <= 0)
+        return ACAMERA_OK;
+    const auto width = static_cast<uint32_t>(entry.data.i32[0]);
+    const auto height = static_cast<uint32_t>(entry.data.i32[1]);
+    const auto status = ACameraMetadata_getConstEntry(
+        result, ACAMERA_STATISTICS_LENS_SHADING_MAP, &entry);
+    if (status != ACAMERA_OK || entry.count != 4 * width * height)
+        return ACAMERA_OK;
+    params.shading_width = width;
+    params.shading_height = height;
+    params.shading_map.assign(entry.data.f, entry.data.f + entry.count);
+    return ACAMERA_OK;
+}
+
+// color of the 2x2 position. 0 for R, 1 for G, 2 for B
+static constexpr uint8_t bayer_colors[4][4]{
+    {0, 1, 1, 2}, // RGGB
+    {1, 0, 2, 1}, // GRBG
+    {1, 2, 0, 1}, // GBRG
+    {2, 1, 1, 0}, // BGGR
+};
+
+/**
+ * Values of 1 `develop_raw16`. Shared by the bands
+ */
+struct raw_job_t final {
+    const uint8_t* src;
+    uint32_t src_row_stride;
+    int32_t width, height;
+    raw_demosaic_t demosaic;
+    bool vectorize;
+    uint16_t* dst16;
+    uint8_t* dst8;
+    uint32_t dst_row_stride;
+    const raw_params_t* params;
+
+    // of the 2x2 position
+    array<uint8_t, 4> color;
+    array<uint8_t, 4> channel; // index of the gains and the shading map
+    array<float, 4> black;
+    array<float, 4> scale; // to 0 ~ 65535 with the color gains
+
+    // columns in the shading map, and the weight of the next one
+    vector<uint32_t> shading_x{};
+    vector<float> shading_wx{};
+    // gains of the even/odd rows if there is no shading map
+    array<vector<float>, 2> gain_rows{};
+};
+
+static int32_t reflect(int32_t i, int32_t n) noexcept {
+    // the parity is kept, so is the color
+    while (i < 0 || i >= n)
+        i = i < 0 ? -i : 2 * (n - 1) - i;
+    return i;
+}
+
+static uint16_t clamp_u16(int32_t value) noexcept {
+    return static_cast<uint16_t>(value < 0 ? 0 : value > 65535 ? 65535 : value);
+}
+
+// gains of the row's pixels. `buf` is used if there is a shading map
+static auto get_gain_row(const raw_job_t& job, int32_t y,
+                         vector<float>& buf) noexcept -> const float* {
+    const auto parity = y & 1;
+    if (job.shading_x.empty())
+        return job.gain_rows[parity].data();
+
+    const auto& params = *job.params;
+    const auto sw = params.shading_width, sh = params.shading_height;
+    const auto gy = sh > 1 ? static_cast<float>(y) *
+                                 static_cast<float>(sh - 1) /
+                                 static_cast<float>(job.height - 1)
+                           : 0.0f;
+    const auto j0 = min(static_cast<uint32_t>(gy), sh - 1);
+    const auto j1 = min(j0 + 1, sh - 1);
+    const auto wy = gy - static_cast<float>(j0);
+
+    // the 2 channels of the row at each column of the map
+    thread_local vector<float> columns{};
+    columns.resize(2 * sw);
+    const auto* map = params.shading_map.data();
+    for (auto i = 0u; i < sw; ++i)
+        for (auto k = 0u; k < 2; ++k) {
+            const auto c = job.channel[parity * 2 + k];
+            const auto a = map[(j0 * sw + i) * 4 + c];
+            const auto b = map[(j1 * sw + i) * 4 + c];
+            columns[i * 2 + k] = a + (b - a) * wy;
+        }
+    buf.resize(job.width);
+    for (auto x = 0; x < job.width; ++x) {
+        const auto k = x & 1;
+        const auto i0 = job.shading_x[x];
+        const auto i1 = min(i0 + 1, sw - 1);
+        const auto a = columns[i0 * 2 + k];
+        const auto b = columns[i1 * 2 + k];
+        buf[x] = job.scale[parity * 2 + k] * (a + (b - a) * job.shading_wx[x]);
+    }
+    return buf.data();
+}
+
+/**
+ * (raw - black) * gain, clamped to 0 ~ 65535.
+ * `black` is for the even and odd columns
+ */
+static void normalize_row(const raw_job_t& job, const uint16_t* src,
+                          const float* gains, const float* black,
+                          uint16_t* out) noexcept {
+    const auto width = job.width;
+    auto x = 0;
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+    const auto vector_width = job.vectorize ? width : 0;
+#endif
+#if defined(NDCAM_NEON)
+    const float32x4_t bias{black[0], black[1], black[0], black[1]};
+    const auto zero = vdupq_n_f32(0);
+    const auto top = vdupq_n_f32(65535);
+    const auto half = vdupq_n_f32(0.5f);
+    for (; x + 8 <= vector_width; x += 8) {
+        const auto raw = vld1q_u16(src + x);
+        auto lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(raw)));
+        auto hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(raw)));
+        lo = vmulq_f32(vsubq_f32(lo, bias), vld1q_f32(gains + x));
+        hi = vmulq_f32(vsubq_f32(hi, bias), vld1q_f32(gains + x + 4));
+        lo = vaddq_f32(vminq_f32(vmaxq_f32(lo, zero), top), half);
+        hi = vaddq_f32(vminq_f32(vmaxq_f32(hi, zero), top), half);
+        vst1q_u16(out + x, vcombine_u16(vmovn_u32(vcvtq_u32_f32(lo)),
+                                        vmovn_u32(vcvtq_u32_f32(hi))));
+    }
+#elif defined(NDCAM_SSE2)
+    const auto bias = _mm_setr_ps(black[0], black[1], black[0], black[1]);
+    const auto zero = _mm_setzero_ps();
+    const auto top = _mm_set1_ps(65535);
+    const auto half = _mm_set1_ps(0.5f);
+    // no unsigned saturation for 32 bit. pack with the sign bit flipped
+    const auto flip32 = _mm_set1_epi32(32768);
+    const auto flip16 = _mm_set1_epi16(-32768);
+    for (; x + 8 <= vector_width; x += 8) {
+        const auto raw =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const auto zeros = _mm_setzero_si128();
+        auto lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zeros));
+        auto hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zeros));
+        lo = _mm_mul_ps(_mm_sub_ps(lo, bias), _mm_loadu_ps(gains + x));
+        hi = _mm_mul_ps(_mm_sub_ps(hi, bias), _mm_loadu_ps(gains + x + 4));
+        // round half up like the scalar. `_mm_cvtps_epi32` is half to even
+        lo = _mm_add_ps(_mm_min_ps(_mm_max_ps(lo, zero), top), half);
+        hi = _mm_add_ps(_mm_min_ps(_mm_max_ps(hi, zero), top), half);
+        const auto packed =
+            _mm_packs_epi32(_mm_sub_epi32(_mm_cvttps_epi32(lo), flip32),
+                            _mm_sub_epi32(_mm_cvttps_epi32(hi), flip32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                         _mm_xor_si128(packed, flip16));
+    }
+#endif
+    for (; x < width; ++x) {
+        const auto value = (src[x] - black[x & 1]) * gains[x];
+        out[x] = static_cast<uint16_t>(
+            value <= 0 ? 0 : value >= 65535 ? 65535 : value + 0.5f);
+    }
+}
+
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+// 4 lanes of int32 for the demosaic. the color differences and the gradients
+// don't fit in 16 bit. the kernels are written once with these
+#if defined(NDCAM_NEON)
+using lanes_t = int32x4_t;
+using pixels_t = uint16x8_t;
+
+static lanes_t lanes_dup(int32_t value) noexcept {
+    return vdupq_n_s32(value);
+}
+// p[0], p[2], p[4], p[6]. 8 pixels are read
+static lanes_t lanes_even(const uint16_t* p) noexcept {
+    return vreinterpretq_s32_u32(vmovl_u16(vld2_u16(p).val[0]));
+}
+static lanes_t lanes_add(lanes_t a, lanes_t b) noexcept {
+    return vaddq_s32(a, b);
+}
+static lanes_t lanes_sub(lanes_t a, lanes_t b) noexcept {
+    return vsubq_s32(a, b);
+}
+static lanes_t lanes_abs(lanes_t a) noexcept {
+    return vabsq_s32(a);
+}
+// truncated toward 0 like the scalar division
+static lanes_t lanes_div2(lanes_t a) noexcept {
+    return vshrq_n_s32(vsubq_s32(a, vshrq_n_s32(a, 31)), 1);
+}
+static lanes_t lanes_div4(lanes_t a) noexcept {
+    const auto bias = vandq_s32(vshrq_n_s32(a, 31), vdupq_n_s32(3));
+    return vshrq_n_s32(vaddq_s32(a, bias), 2);
+}
+static lanes_t lanes_clamp(lanes_t a) noexcept {
+    return vminq_s32(vmaxq_s32(a, vdupq_n_s32(0)), vdupq_n_s32(65535));
+}
+// a < b ? x : y
+static lanes_t lanes_select_lt(lanes_t a, lanes_t b, lanes_t x,
+                               lanes_t y) noexcept {
+    return vbslq_s32(vcltq_s32(a, b), x, y);
+}
+// 8 pixels of the even and odd columns. the lanes are in 0 ~ 65535
+static pixels_t lanes_interleave(lanes_t even, lanes_t odd) noexcept {
+    return vreinterpretq_u16_s32(vorrq_s32(even, vshlq_n_s32(odd, 16)));
+}
+static void pixels_store(uint16_t* p, pixels_t v) noexcept {
+    vst1q_u16(p, v);
+}
+static void pixels_store_rgb(uint16_t* p, pixels_t r, pixels_t g,
+                             pixels_t b) noexcept {
+    uint16x8x3_t rgb{};
+    rgb.val[0] = r;
+    rgb.val[1] = g;
+    rgb.val[2] = b;
+    vst3q_u16(p, rgb);
+}
+#elif defined(NDCAM_SSE2)
+using lanes_t = __m128i;
+using pixels_t = __m128i;
+
+static lanes_t lanes_dup(int32_t value) noexcept {
+    return _mm_set1_epi32(value);
+}
+static lanes_t lanes_even(const uint16_t* p) noexcept {
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_and_si128(v, _mm_set1_epi32(0xFFFF));
+}
+static lanes_t lanes_add(lanes_t a, lanes_t b) noexcept {
+    return _mm_add_epi32(a, b);
+}
+static lanes_t lanes_sub(lanes_t a, lanes_t b) noexcept {
+    return _mm_sub_epi32(a, b);
+}
+static lanes_t lanes_abs(lanes_t a) noexcept {
+    const auto sign = _mm_srai_epi32(a, 31);
+    return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+}
+static lanes_t lanes_div2(lanes_t a) noexcept {
+    return _mm_srai_epi32(_mm_sub_epi32(a, _mm_srai_epi32(a, 31)), 1);
+}
+static lanes_t lanes_div4(lanes_t a) noexcept {
+    const auto bias = _mm_and_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(3));
+    return _mm_srai_epi32(_mm_add_epi32(a, bias), 2);
+}
+static lanes_t lanes_clamp(lanes_t a) noexcept {
+    const auto top = _mm_set1_epi32(65535);
+    a = _mm_andnot_si128(_mm_srai_epi32(a, 31), a);
+    const auto over = _mm_cmpgt_epi32(a, top);
+    return _mm_or_si128(_mm_andnot_si128(over, a), _mm_and_si128(over, top));
+}
+static lanes_t lanes_select_lt(lanes_t a, lanes_t b, lanes_t x,
+                               lanes_t y) noexcept {
+    const auto mask = _mm_cmplt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+static pixels_t lanes_interleave(lanes_t even, lanes_t odd) noexcept {
+    return _mm_or_si128(even, _mm_slli_epi32(odd, 16));
+}
+static void pixels_store(uint16_t* p, pixels_t v) noexcept {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+// no 3 way interleave in SSE2
+static void pixels_store_rgb(uint16_t* p, pixels_t r, pixels_t g,
+                             pixels_t b) noexcept {
+    alignas(16) uint16_t planes[3][8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(planes[0]), r);
+    _mm_store_si128(reinterpret_cast<__m128i*>(planes[1]), g);
+    _mm_store_si128(reinterpret_cast<__m128i*>(planes[2]), b);
+    for (auto i = 0u; i < 8; ++i, p += 3) {
+        p[0] = planes[0][i];
+        p[1] = planes[1][i];
+        p[2] = planes[2][i];
+    }
+}
+#endif
+
+// (m - g) of the 4 lanes
+static lanes_t lanes_diff(const uint16_t* m, const uint16_t* g) noexcept {
+    return lanes_sub(lanes_even(m), lanes_even(g));
+}
+#endif
+
+/**
+ * Green of the R/B pixels along the smaller gradient, with the curvature of
+ * the pixel's own color(Hamilton-Adams).
+ * `m` and `g` point the first pixel of the row `y`. [-1, width] is written
+ */
+static void interpolate_green(const raw_job_t& job, const uint16_t* m,
+                              uint16_t* g, int32_t stride,
+                              int32_t y) noexcept {
+    const auto s = stride;
+    const auto parity = (y & 1) * 2;
+    auto x = -1;
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+    // the lanes are the R/B columns of 8 pixels. the others are green.
+    // the reads stay in the padding of the row
+    const auto phase = job.color[parity] == 1 ? 1 : 0;
+    for (; job.vectorize && x + 8 <= job.width + 1; x += 8) {
+        const auto c = x + ((x ^ phase) & 1);
+        const auto* p = m + c;
+        const auto v = lanes_even(p);
+        const auto w = lanes_even(p - 1), e = lanes_even(p + 1);
+        const auto n = lanes_even(p - s), so = lanes_even(p + s);
+        const auto v2 = lanes_add(v, v);
+        const auto ch =
+            lanes_sub(lanes_sub(v2, lanes_even(p - 2)), lanes_even(p + 2));
+        const auto cv = lanes_sub(lanes_sub(v2, lanes_even(p - 2 * s)),
+                                  lanes_even(p + 2 * s));
+        const auto dh = lanes_add(lanes_abs(lanes_sub(w, e)), lanes_abs(ch));
+        const auto dv = lanes_add(lanes_abs(lanes_sub(n, so)), lanes_abs(cv));
+        const auto sh = lanes_add(w, e), sv = lanes_add(n, so);
+        const auto gh = lanes_div4(lanes_add(lanes_add(sh, sh), ch));
+        const auto gv = lanes_div4(lanes_add(lanes_add(sv, sv), cv));
+        const auto mean = lanes_div2(lanes_add(gh, gv));
+        const auto green = lanes_clamp(lanes_select_lt(
+            dh, dv, gh, lanes_select_lt(dv, dh, gv, mean)));
+        const auto row = c == x ? lanes_interleave(green, lanes_even(p + 1))
+                                : lanes_interleave(lanes_even(p - 1), green);
+        pixels_store(g + x, row);
+    }
+#endif
+    for (; x <= job.width; ++x) {
+        const int32_t v = m[x];
+        if (job.color[parity + (x & 1)] == 1) {
+            g[x] = m[x];
+            continue;
+        }
+        const int32_t w = m[x - 1], e = m[x + 1], n = m[x - s], so = m[x + s];
+        const auto ch = 2 * v - m[x - 2] - m[x + 2];
+        const auto cv = 2 * v - m[x - 2 * s] - m[x + 2 * s];
+        const auto dh = abs(w - e) + abs(ch);
+        const auto dv = abs(n - so) + abs(cv);
+        const auto gh = (2 * (w + e) + ch) / 4;
+        const auto gv = (2 * (n + so) + cv) / 4;
+        g[x] = clamp_u16(dh < dv ? gh : dv < dh ? gv : (gh + gv) / 2);
+    }
+}
+
+// `m` points the first pixel of the row `y`. `g` is nullptr for bilinear
+static void demosaic_row(const raw_job_t& job, const uint16_t* m,
+                         const uint16_t* g, int32_t stride, int32_t y,
+                         uint16_t* rgb) noexcept {
+    const auto s = stride;
+    const auto parity = (y & 1) * 2;
+    auto x = 0;
+#if defined(NDCAM_NEON) || defined(NDCAM_SSE2)
+    // 8 pixels. the lanes of the G columns and the R/B columns
+    const auto phase = job.color[parity] == 1 ? 0 : 1; // of the G columns
+    const auto row_color = job.color[parity + (phase ^ 1)];
+    for (; job.vectorize && x + 8 <= job.width; x += 8, rgb += 24) {
+        const auto* pg = m + x + phase;
+        const auto* pc = m + x + (phase ^ 1);
+        const auto gm = lanes_even(pg), cm = lanes_even(pc);
+        // the row's color and the other one at the G columns.
+        // green and the other color at the R/B columns
+        lanes_t gh{}, gv{}, cg{}, co{};
+        if (g == nullptr) {
+            const auto one = lanes_dup(1), two = lanes_dup(2);
+            const auto h = lanes_add(lanes_even(pg - 1), lanes_even(pg + 1));
+            const auto v = lanes_add(lanes_even(pg - s), lanes_even(pg + s));
+            gh = lanes_div2(lanes_add(h, one));
+            gv = lanes_div2(lanes_add(v, one));
+            const auto cross =
+                lanes_add(lanes_add(lanes_even(pc - 1), lanes_even(pc + 1)),
+                          lanes_add(lanes_even(pc - s), lanes_even(pc + s)));
+            const auto diagonal = lanes_add(
+                lanes_add(lanes_even(pc - s - 1), lanes_even(pc - s + 1)),
+                lanes_add(lanes_even(pc + s - 1), lanes_even(pc + s + 1)));
+            cg = lanes_div4(lanes_add(cross, two));
+            co = lanes_div4(lanes_add(diagonal, two));
+        } else {
+            const auto* qg = g + x + phase;
+            const auto* qc = g + x + (phase ^ 1);
+            const auto dh = lanes_add(lanes_diff(pg - 1, qg - 1),
+                                      lanes_diff(pg + 1, qg + 1));
+            const auto dv = lanes_add(lanes_diff(pg - s, qg - s),
+                                      lanes_diff(pg + s, qg + s));
+            gh = lanes_clamp(lanes_add(gm, lanes_div2(dh)));
+            gv = lanes_clamp(lanes_add(gm, lanes_div2(dv)));
+            const auto d = lanes_add(
+                lanes_add(lanes_diff(pc - s - 1, qc - s - 1),
+                          lanes_diff(pc - s + 1, qc - s + 1)),
+                lanes_add(lanes_diff(pc + s - 1, qc + s - 1),
+                          lanes_diff(pc + s + 1, qc + s + 1)));
+            cg = lanes_even(qc);
+            co = lanes_clamp(lanes_add(cg, lanes_div4(d)));
+        }
+        const auto interleave = [phase](lanes_t at_g, lanes_t at_c) {
+            return phase == 0 ? lanes_interleave(at_g, at_c)
+                              : lanes_interleave(at_c, at_g);
+        };
+        const auto own = interleave(gh, cm);
+        const auto other = interleave(gv, co);
+        const auto green = interleave(gm, cg);
+        if (row_color == 0)
+            pixels_store_rgb(rgb, own, green, other);
+        else
+            pixels_store_rgb(rgb, other, green, own);
+    }
+#endif
+    for (; x < job.width; ++x, rgb += 3) {
+        const auto pos = parity + (x & 1);
+        const auto c = job.color[pos];
+        rgb[c] = m[x];
+        if (c == 1) {
+            // the colors of the horizontal and vertical neighbors
+            const auto hc = job.color[pos ^ 1], vc = job.color[pos ^ 2];
+            if (g == nullptr) {
+                rgb[hc] = static_cast<uint16_t>((m[x - 1] + m[x + 1] + 1) / 2);
+                rgb[vc] = static_cast<uint16_t>((m[x - s] + m[x + s] + 1) / 2);
+                continue;
+            }
+            const auto dh = (m[x - 1] - g[x - 1]) + (m[x + 1] - g[x + 1]);
+            const auto dv = (m[x - s] - g[x - s]) + (m[x + s] - g[x + s]);
+            rgb[hc] = clamp_u16(m[x] + dh / 2);
+            rgb[vc] = clamp_u16(m[x] + dv / 2);
+            continue;
+        }
+        const auto other = 2 - c;
+        if (g == nullptr) {
+            rgb[1] = static_cast<uint16_t>(
+                (m[x - 1] + m[x + 1] + m[x - s] + m[x + s] + 2) / 4);
+            rgb[other] = static_cast<uint16_t>((m[x - s - 1] + m[x - s + 1] +
+                                                m[x + s - 1] + m[x + s + 1] +
+                                                2) /
+                                               4);
+            continue;
+        }
+        const auto d = (m[x - s - 1] - g[x - s - 1]) +
+                       (m[x - s + 1] - g[x - s + 1]) +
+                       (m[x + s - 1] - g[x + s - 1]) +
+                       (m[x + s + 1] - g[x + s + 1]);
+        rgb[1] = g[x];
+        rgb[other] = clamp_u16(g[x] + d / 4);
+    }
+}
+
+static auto make_srgb_table() noexcept -> array<uint8_t, 4096> {
+    array<uint8_t, 4096> table{};
+    for (auto i = 0u; i < table.size(); ++i) {
+        const auto l = i / 4095.0;
+        const auto s = l <= 0.0031308 ? 12.92 * l
+                                      : 1.055 * pow(l, 1 / 2.4) - 0.055;
+        table[i] = static_cast<uint8_t>(lround(s * 255));
+    }
+    return table;
+}
+
+static void develop_band(const raw_job_t& job, int32_t y0,
+                         int32_t y1) noexcept {
+    const auto width = job.width, rows = y1 - y0;
+    const auto stride = width + 2 * pad;
+    thread_local vector<uint16_t> mosaic{}, green{}, line{};
+    thread_local vector<float> gains{};
+    mosaic.resize(static_cast<size_t>(rows + 2 * pad) * stride);
+
+    // normalized rows with the padding. `at(r)` is the first pixel of row r
+    const auto at = [stride](vector<uint16_t>& plane, int32_t r) {
+        return plane.data() + static_cast<ptrdiff_t>(r + pad) * stride + pad;
+    };
+    for (auto r = -pad; r < rows + pad; ++r) {
+        const auto sy = reflect(y0 + r, job.height);
+        const auto* src = reinterpret_cast<const uint16_t*>(
+            job.src + static_cast<size_t>(sy) * job.src_row_stride);
+        auto* out = at(mosaic, r);
+        normalize_row(job, src, get_gain_row(job, sy, gains),
+                      job.black.data() + (sy & 1) * 2, out);
+        for (auto x = 1; x <= pad; ++x) {
+            out[-x] = out[reflect(-x, width)];
+            out[width - 1 + x] = out[reflect(width - 1 + x, width)];
+        }
+    }
+
+    const uint16_t* g = nullptr;
+    if (job.demosaic == raw_demosaic_t::edge_aware) {
+        green.resize(mosaic.size());
+        for (auto r = -1; r <= rows; ++r)
+            interpolate_green(job, at(mosaic, r), at(green, r), stride,
+                              y0 + r);
+        g = at(green, 0);
+    }
+
+    static const auto srgb = make_srgb_table();
+    line.resize(static_cast<size_t>(width) * 3);
+    for (auto r = 0; r < rows; ++r) {
+        const auto y = y0 + r;
+        const auto offset = static_cast<size_t>(y) * job.dst_row_stride;
+        auto* rgb = job.dst16 ? reinterpret_cast<uint16_t*>(
+                                    reinterpret_cast<uint8_t*>(job.dst16) +
+                                    offset)
+                              : line.data();
+        demosaic_row(job, at(mosaic, r), g ? g + r * stride : nullptr, stride,
+                     y, rgb);
+        if (job.dst8 == nullptr)
+            continue;
+        auto* out = job.dst8 + offset;
+        for (auto i = 0u; i < line.size(); ++i)
+            out[i] = srgb[line[i] >> 4];
+    }
+}
+
+static void develop(const uint16_t* src, uint32_t src_row_stride,
+                    uint32_t width, uint32_t height, const raw_params_t& params,
+                    const raw_config_t& config, uint16_t* dst16, uint8_t* dst8,
+                    uint32_t dst_row_stride) noexcept {
+    if (width < 2 || height < 2)
+        return;
+    perf_scope_t scope{perf_stage_t::develop_raw};
+
+    raw_job_t job{reinterpret_cast<const uint8_t*>(src),
+                  src_row_stride,
+                  static_cast<int32_t>(width),
+                  static_cast<int32_t>(height),
+                  config.demosaic,
+                  config.vectorize,
+                  dst16,
+                  dst8,
+                  dst_row_stride,
+                  &params,
+                  {},
+                  {},
+                  {},
+                  {}};
+    const auto& colors = bayer_colors[static_cast<uint8_t>(params.pattern) & 3];
+    for (auto pos = 0u; pos < 4; ++pos) {
+        const auto color = colors[pos];
+        job.color[pos] = color;
+        job.channel[pos] = color == 0 ? 0 : color == 2 ? 3 : pos < 2 ? 1 : 2;
+        job.black[pos] = params.black_level[pos];
+        const auto range = params.white_level - params.black_level[pos];
+        job.scale[pos] =
+            range > 0 ? 65535 / range * params.gains[job.channel[pos]] : 0;
+    }
+    const auto sw = params.shading_width, sh = params.shading_height;
+    if (sw && sh && params.shading_map.size() >= 4u * sw * sh) {
+        job.shading_x.resize(width);
+        job.shading_wx.resize(width);
+        for (auto x = 0u; x < width; ++x) {
+            const auto gx = static_cast<float>(x) * static_cast<float>(sw - 1) /
+                            static_cast<float>(width - 1);
+            job.shading_x[x] = min(static_cast<uint32_t>(gx), sw - 1);
+            job.shading_wx[x] = gx - static_cast<float>(job.shading_x[x]);
+        }
+    } else {
+        for (auto parity = 0u; parity < 2; ++parity) {
+            auto& gains = job.gain_rows[parity];
+            gains.resize(width);
+            for (auto x = 0u; x < width; ++x)
+                gains[x] = job.scale[parity * 2 + (x & 1)];
+        }
+    }
+
+    auto count = config.bands ? config.bands : thread::hardware_concurrency();
+    count = clamp(count, 1u, max(height / min_band_rows, 1u));
+    const auto rows = (height + count - 1) / count;
+    count = (height + rows - 1) / rows;
+    const auto band = [&job, rows](uint32_t i) {
+        const auto y0 = static_cast<int32_t>(i * rows);
+        const auto y1 = min(y0 + static_cast<int32_t>(rows), job.height);
+        develop_band(job, y0, y1);
+    };
+    parallel_for(config.executor, count, band);
+}
+
+void develop_raw16(const uint16_t* src, uint32_t src_row_stride,
+                   uint32_t width, uint32_t height, const raw_params_t& params,
+                   const raw_config_t& config, uint16_t* dst,
+                   uint32_t dst_row_stride) noexcept {
+    develop(src, src_row_stride, width, height, params, config, dst, nullptr,
+            dst_row_stride);
+}
+
+void develop_raw16(const uint16_t* src, uint32_t src_row_stride,
+                   uint32_t width, uint32_t height, const raw_params_t& params,
+                   const raw_config_t& config, uint8_t* dst,
+                   uint32_t dst_row_stride) noexcept {
+    develop(src, src_row_stride, width, height, params, config, nullptr, dst,
+            dst_row_stride);
+}
+
+static auto get_raw16_plane(const frame_view_t& src, const uint16_t*& data)
+    -> media_status_t {
+    if (src.format != AIMAGE_FORMAT_RAW16 || src.plane_count != 1)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    const auto& plane = src.planes[0];
+    if (plane.pixel_stride != 2 || plane.row_stride % 2)
+        return AMEDIA_ERROR_UNSUPPORTED;
+    data = reinterpret_cast<const uint16_t*>(plane.data.data());
+    return AMEDIA_OK;
+}
+
+auto develop_raw16(const frame_view_t& src, const raw_params_t& params,
+                   const raw_config_t& config, uint16_t* dst,
+                   uint32_t dst_row_stride) noexcept -> media_status_t {
+    const uint16_t* data = nullptr;
+    if (auto status = get_raw16_plane(src, data))
+        return status;
+    const auto& plane = src.planes[0];
+    develop_raw16(data, plane.row_stride, plane.width, plane.height, params,
+                  config, dst, dst_row_stride);
+    return AMEDIA_OK;
+}
+
+auto develop_raw16(const frame_view_t& src, const raw_params_t& params,
+                   const raw_config_t& config, uint8_t* dst,
+                   uint32_t dst_row_stride) noexcept -> media_status_t {
+    const uint16_t* data = nullptr;
+    if (auto status = get_raw16_plane(src, data))
+        return status;
+    const auto& plane = src.planes[0];
+    develop_raw16(data, plane.row_stride, plane.width, plane.height, params,
+                  config, dst, dst_row_stride);
+    return AMEDIA_OK;
+}
@@ -0,0 +1,253 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_recovery.h>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+bool is_fatal_device_error(int error) noexcept {
+    // disabled by the device policy. reopening will fail the same way
+    return error == ERROR_CAMERA_DISABLED;
+}
+
+recovery_engine_t::recovery_engine_t(camera_group_t& _context,
+                                     const recovery_config_t& _config) noexcept
+    : context{_context}, config{_config},
+      worker{&recovery_engine_t::run, this} {
+}
+
+recovery_engine_t::~recovery_engine_t() noexcept {
+    {
+        unique_lock lck{mtx};
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable())
+        worker.join();
+    for (auto& target : targets)
+        if (target.window)
+            ANativeWindow_release(target.window);
+}
+
+void recovery_engine_t::set_listener(recovery_listener_t _listener,
+                                     void* _context) noexcept {
+    unique_lock lck{mtx};
+    listener = _listener;
+    listener_context = _context;
+}
+
+bool recovery_engine_t::is_worker() const noexcept {
+    return this_thread::get_id() == worker.get_id();
+}
+
+void recovery_engine_t::on_open(
+    uint16_t id, const ACameraDevice_StateCallbacks& callbacks) noexcept {
+    if (is_worker())
+        return;
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    target.opened = true;
+    target.device_callbacks = callbacks;
+}
+
+void recovery_engine_t::on_repeat(
+    uint16_t id, ANativeWindow* window,
+    const ACameraCaptureSession_stateCallbacks& on_session_changed,
+    const ACameraCaptureSession_captureCallbacks& on_capture_event) noexcept {
+    if (is_worker())
+        return;
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    // the app might release it after `start_repeat`
+    ANativeWindow_acquire(window);
+    if (target.window)
+        ANativeWindow_release(target.window);
+    target.window = window;
+    target.session_callbacks = on_session_changed;
+    target.capture_callbacks = on_capture_event;
+    // the pending attempt restores the new one. without the backoff
+    if (target.pending) {
+        target.due = steady_clock::now();
+        cv.notify_all();
+    }
+}
+
+void recovery_engine_t::on_stop(uint16_t id) noexcept {
+    if (is_worker())
+        return;
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    // the pending attempt only reopens the device
+    if (target.window)
+        ANativeWindow_release(target.window);
+    target.window = nullptr;
+}
+
+void recovery_engine_t::on_close(uint16_t id) noexcept {
+    if (is_worker())
+        return;
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    if (target.window)
+        ANativeWindow_release(target.window);
+    target.window = nullptr;
+    target.opened = false;
+    target.pending = false;
+}
+
+void recovery_engine_t::on_disconnected(uint16_t id) noexcept {
+    report(id, 0);
+}
+
+void recovery_engine_t::on_error(uint16_t id, int error) noexcept {
+    report(id, error);
+}
+
+void recovery_engine_t::report(uint16_t id, int error) noexcept {
+    if (id >= camera_group_t::max_camera_count)
+        return;
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    // not opened by the app, or the engine is working for it already
+    if (target.opened == false || target.pending)
+        return;
+
+    auto& incident = target.incident;
+    incident = recovery_incident_t{};
+    incident.id = id;
+    incident.error = error;
+    incident.begin = startup_timing_t::now();
+    incident.fatal = is_fatal_device_error(error);
+    target.pending = true;
+    target.due = steady_clock::now();
+    cv.notify_all();
+}
+
+bool recovery_engine_t::is_recovering(uint16_t id) const noexcept {
+    unique_lock lck{mtx};
+    return targets[id].pending;
+}
+
+void recovery_engine_t::get_incidents(
+    uint16_t id, vector<recovery_incident_t>& output) const noexcept {
+    output.clear();
+    unique_lock lck{mtx};
+    for (const auto& incident : history)
+        if (incident.id == id)
+            output.emplace_back(incident);
+}
+
+auto recovery_engine_t::get_backoff(uint32_t attempts) const noexcept
+    -> milliseconds {
+    auto delay = config.initial_delay;
+    for (auto i = 1u; i < attempts && delay < config.max_delay; ++i)
+        delay *= config.multiplier;
+    return min(delay, config.max_delay);
+}
+
+void recovery_engine_t::finish(target_t& target) noexcept {
+    target.pending = false;
+    // the device is closed unless it's recovered
+    if (target.incident.recovered == false) {
+        if (target.window)
+            ANativeWindow_release(target.window);
+        target.window = nullptr;
+        target.opened = false;
+    }
+    if (history.size() == max_history)
+        history.pop_front();
+    history.emplace_back(target.incident);
+}
+
+void recovery_engine_t::run() noexcept {
+    unique_lock lck{mtx};
+    while (stopping == false) {
+        // the incident which is due first
+        auto id = camera_group_t::max_camera_count;
+        for (uint16_t i = 0; i < camera_group_t::max_camera_count; ++i)
+            if (targets[i].pending &&
+                (id == camera_group_t::max_camera_count ||
+                 targets[i].due < targets[id].due))
+                id = i;
+
+        if (id == camera_group_t::max_camera_count) {
+            cv.wait(lck);
+            continue;
+        }
+        if (targets[id].due > steady_clock::now()) {
+            cv.wait_until(lck, targets[id].due);
+            continue;
+        }
+        lck.unlock();
+        attempt(id);
+        lck.lock();
+    }
+}
+
+void recovery_engine_t::attempt(uint16_t id) noexcept {
+    // the app's operations of the device wait until the attempt is done.
+    // the target can't be changed by them while it's held
+    unique_lock op{context.operation_mtx_set[id]};
+    unique_lock lck{mtx};
+    auto& target = targets[id];
+    if (target.pending == false) // cancelled by the app
+        return;
+    const auto device_callbacks = target.device_callbacks;
+    const auto window = target.window;
+    auto session_callbacks = target.session_callbacks;
+    auto capture_callbacks = target.capture_callbacks;
+    const bool fatal = target.incident.fatal;
+    if (fatal == false)
+        target.incident.attempts += 1;
+    lck.unlock();
+
+    // the device is dead. release it before the reopen
+    context.close_device(id);
+
+    camera_status_t status = ACAMERA_OK;
+    if (fatal == false) {
+        auto callbacks = device_callbacks;
+        status = context.open_device(id, callbacks);
+        if (status == ACAMERA_OK && window)
+            status = context.start_repeat(id, window, session_callbacks,
+                                          capture_callbacks);
+        if (status != ACAMERA_OK)
+            context.close_device(id);
+    }
+
+    lck.lock();
+    auto& incident = target.incident;
+    if (fatal) {
+        logger->error("recovery: device {} error {} is fatal", id,
+                      incident.error);
+        finish(target);
+    } else if (status == ACAMERA_OK) {
+        incident.end = startup_timing_t::now();
+        incident.recovered = true;
+        logger->info("recovery: device {} restored in {} ms, {} attempts", id,
+                     (incident.end - incident.begin) / 1'000'000,
+                     incident.attempts);
+        finish(target);
+    } else if (config.max_attempts &&
+               incident.attempts >= config.max_attempts) {
+        logger->error("recovery: device {} failed after {} attempts", id,
+                      incident.attempts);
+        finish(target);
+    } else {
+        target.due = steady_clock::now() + get_backoff(incident.attempts);
+        return;
+    }
+    // the incident is finished
+    const auto copy = incident;
+    const auto notify = listener;
+    const auto notify_context = listener_context;
+    lck.unlock();
+    op.unlock();
+    if (notify)
+        notify(notify_context, copy);
+}
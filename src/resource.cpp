@@ -0,0 +1,193 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_resource.h>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+using namespace std;
+
+static void raise_peak(atomic<int64_t>& peak, int64_t value) noexcept {
+    auto current = peak.load(memory_order_relaxed);
+    while (current < value &&
+           !peak.compare_exchange_weak(current, value, memory_order_relaxed))
+        ;
+}
+
+void resource_tracker_t::acquire(resource_type_t type, uint16_t id,
+                                 const void* handle, int64_t bytes,
+                                 resource_site_t site) noexcept {
+    id = min(id, shared_id);
+    auto& counter = counters[id][static_cast<size_t>(type)];
+    const auto live = counter.live.fetch_add(1, memory_order_relaxed) + 1;
+    const auto total = counter.bytes.fetch_add(bytes, memory_order_relaxed);
+    counter.total.fetch_add(1, memory_order_relaxed);
+    raise_peak(counter.peak_live, live);
+    raise_peak(counter.peak_bytes, total + bytes);
+
+    if (site_enabled.load(memory_order_relaxed) == false)
+        return;
+    unique_lock lck{mtx};
+    records[handle] = record_t{site, type, id, bytes};
+}
+
+void resource_tracker_t::release(resource_type_t type, uint16_t id,
+                                 const void* handle, int64_t bytes) noexcept {
+    id = min(id, shared_id);
+    auto& counter = counters[id][static_cast<size_t>(type)];
+    counter.live.fetch_sub(1, memory_order_relaxed);
+    counter.bytes.fetch_sub(bytes, memory_order_relaxed);
+
+    if (site_enabled.load(memory_order_relaxed) == false)
+        return;
+    // acquired before the enable, then there is no record
+    unique_lock lck{mtx};
+    records.erase(handle);
+}
+
+auto resource_tracker_t::get_stats(resource_type_t type, uint16_t id) const
+    noexcept -> resource_stats_t {
+    const auto& counter =
+        counters[min(id, shared_id)][static_cast<size_t>(type)];
+    return resource_stats_t{
+        counter.live.load(),      counter.bytes.load(),
+        counter.peak_live.load(), counter.peak_bytes.load(),
+        counter.total.load(),
+    };
+}
+
+auto resource_tracker_t::get_stats(resource_type_t type) const noexcept
+    -> resource_stats_t {
+    resource_stats_t sum{};
+    for (uint16_t id = 0; id <= shared_id; ++id) {
+        const auto stats = get_stats(type, id);
+        sum.live += stats.live;
+        sum.bytes += stats.bytes;
+        sum.peak_live += stats.peak_live;
+        sum.peak_bytes += stats.peak_bytes;
+        sum.total += stats.total;
+    }
+    return sum;
+}
+
+void resource_tracker_t::reset_peaks() noexcept {
+    for (auto& device : counters)
+        for (auto& counter : device) {
+            counter.peak_live = counter.live.load();
+            counter.peak_bytes = counter.bytes.load();
+        }
+}
+
+void resource_tracker_t::enable_sites(bool enable) noexcept {
+    unique_lock lck{mtx};
+    site_enabled = enable;
+    if (enable == false)
+        records.clear();
+}
+
+void resource_tracker_t::get_sites(
+    vector<resource_site_stats_t>& output) const noexcept {
+    output.clear();
+    // (file, line, type, id) -> index of the output
+    map<tuple<const char*, uint32_t, resource_type_t, uint16_t>, size_t>
+        groups{};
+    {
+        unique_lock lck{mtx};
+        for (const auto& [handle, record] : records) {
+            const auto key = make_tuple(record.site.file, record.site.line,
+                                        record.type, record.id);
+            auto it = groups.find(key);
+            if (it == groups.end()) {
+                it = groups.emplace(key, output.size()).first;
+                output.emplace_back(resource_site_stats_t{
+                    record.site, record.type, record.id, 0, 0});
+            }
+            output[it->second].live += 1;
+            output[it->second].bytes += record.bytes;
+        }
+    }
+    sort(output.begin(), output.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.bytes > rhs.bytes;
+    });
+}
+
+auto get_image_bytes(const AImage* image) noexcept -> int64_t {
+    int32_t count = 0;
+    if (AImage_getNumberOfPlanes(image, &count) != AMEDIA_OK)
+        return 0;
+    int64_t bytes = 0;
+    for (auto i = 0; i < count; ++i) {
+        uint8_t* data = nullptr;
+        int length = 0;
+        if (AImage_getPlaneData(image, i, &data, &length) == AMEDIA_OK)
+            bytes += length;
+    }
+    return bytes;
+}
+
+void release_image(camera_group_t& context, uint16_t id,
+                   AImage* image) noexcept {
+    if (image == nullptr)
+        return;
+    if (auto resources = context.resources)
+        resources->release(resource_type_t::image, id, image,
+                           get_image_bytes(image));
+    AImage_delete(image);
+}
+
+#if __ANDROID_API__ >= 26
+
+// `stride` is in pixels. BLOB uses `width` for its size
+static int64_t get_buffer_bytes(const AHardwareBuffer_Desc& desc) noexcept {
+    const int64_t pixels = int64_t{desc.stride} * desc.height * desc.layers;
+    switch (desc.format) {
+    case AHARDWAREBUFFER_FORMAT_BLOB:
+        return desc.width;
+    case AHARDWAREBUFFER_FORMAT_Y8Cb8Cr8_420:
+        return pixels * 3 / 2;
+    case AHARDWAREBUFFER_FORMAT_R5G6B5_UNORM:
+        return pixels * 2;
+    case AHARDWAREBUFFER_FORMAT_R8G8B8_UNORM:
+        return pixels * 3;
+    case AHARDWAREBUFFER_FORMAT_R16G16B16A16_FLOAT:
+        return pixels * 8;
+    default:
+        return pixels * 4;
+    }
+}
+
+static int64_t get_buffer_bytes(const AHardwareBuffer* buffer) noexcept {
+    AHardwareBuffer_Desc desc{};
+    AHardwareBuffer_describe(buffer, &desc);
+    return get_buffer_bytes(desc);
+}
+
+auto acquire_hardware_buffer(camera_group_t& context, uint16_t id,
+                             AImage* image, AHardwareBuffer** buffer,
+                             resource_site_t site) noexcept -> media_status_t {
+    if (image == nullptr || buffer == nullptr)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    // the image doesn't add a reference for this
+    if (auto status = AImage_getHardwareBuffer(image, buffer))
+        return status;
+    AHardwareBuffer_acquire(*buffer);
+    if (auto resources = context.resources)
+        resources->acquire(resource_type_t::hardware_buffer, id, *buffer,
+                           get_buffer_bytes(*buffer), site);
+    return AMEDIA_OK;
+}
+
+void release_hardware_buffer(camera_group_t& context, uint16_t id,
+                             AHardwareBuffer* buffer) noexcept {
+    if (buffer == nullptr)
+        return;
+    if (auto resources = context.resources)
+        resources->release(resource_type_t::hardware_buffer, id, buffer,
+                           get_buffer_bytes(buffer));
+    AHardwareBuffer_release(buffer);
+}
+
+#endif
@@ -0,0 +1,400 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_share.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <linux/memfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__ANDROID__)
+#include <linux/ashmem.h>
+#include <sys/ioctl.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static_assert(sizeof(share_header_t) ==
+                  64 + 64 * share_header_t::max_subscribers,
+              "layout is shared with the other processes");
+static_assert(atomic<uint64_t>::is_always_lock_free,
+              "the atomics must work across the processes");
+
+// the planes start at the cache line
+static constexpr size_t slot_header_size = (sizeof(share_slot_t) + 63) & ~63;
+
+static int create_shared_memory(const char* name, size_t size) noexcept {
+    // memfd_create is not in the libc of the old API levels
+    auto fd = static_cast<int>(syscall(__NR_memfd_create, name, MFD_CLOEXEC));
+    if (fd >= 0) {
+        if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+            return fd;
+        close(fd);
+        return -1;
+    }
+#if defined(__ANDROID__)
+    // kernels before 3.17 don't have memfd
+    fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ioctl(fd, ASHMEM_SET_NAME, name);
+    if (ioctl(fd, ASHMEM_SET_SIZE, size) < 0) {
+        close(fd);
+        return -1;
+    }
+#endif
+    return fd;
+}
+
+// not private. the word is shared with the other processes
+static void futex_wake(atomic<uint32_t>& word) noexcept {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE,
+            INT32_MAX, nullptr, nullptr, 0);
+}
+
+static void futex_wait(atomic<uint32_t>& word, uint32_t expected,
+                       milliseconds timeout) noexcept {
+    timespec duration{};
+    duration.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    duration.tv_nsec = static_cast<long>(timeout.count() % 1000) * 1'000'000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT,
+            expected, &duration, nullptr, 0);
+}
+
+static auto get_slot_data(share_slot_t* slot) noexcept -> uint8_t* {
+    return reinterpret_cast<uint8_t*>(slot) + slot_header_size;
+}
+
+frame_publisher_t::frame_publisher_t(const share_config_t& _config) noexcept
+    : config{_config}, fd{-1}, length{}, header{} {
+    config.slot_count = max(config.slot_count, 2u);
+    const auto slot_size =
+        (slot_header_size + config.max_frame_bytes + 63) & ~size_t{63};
+    length = sizeof(share_header_t) + slot_size * config.slot_count;
+
+    fd = create_shared_memory("ndk_camera_share", length);
+    if (fd < 0) {
+        logger->error("share: {}", strerror(errno));
+        return;
+    }
+    auto* ptr =
+        mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        logger->error("share: {}", strerror(errno));
+        close(fd);
+        fd = -1;
+        return;
+    }
+    // the memory is zero filled. the subscribers check the magic at last
+    header = new (ptr) share_header_t{};
+    header->version = share_header_t::version_value;
+    header->slot_count = config.slot_count;
+    header->slot_size = static_cast<uint32_t>(slot_size);
+    atomic_thread_fence(memory_order_release);
+    header->magic = share_header_t::magic_value;
+}
+
+frame_publisher_t::~frame_publisher_t() noexcept {
+    // the subscribers keep their own mapping
+    if (header)
+        munmap(header, length);
+    if (fd >= 0)
+        close(fd);
+}
+
+auto frame_publisher_t::get_slot(uint64_t number) noexcept -> share_slot_t* {
+    auto* slots = reinterpret_cast<uint8_t*>(header + 1);
+    return reinterpret_cast<share_slot_t*>(
+        slots + (number % header->slot_count) * header->slot_size);
+}
+
+auto frame_publisher_t::publish(const frame_view_t& frame) noexcept
+    -> media_status_t {
+    if (header == nullptr || frame.empty())
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    size_t bytes = 0;
+    for (auto i = 0u; i < frame.plane_count; ++i)
+        bytes += size_t{frame.planes[i].width} * frame.planes[i].height;
+    if (bytes > config.max_frame_bytes) {
+        header->rejected.fetch_add(1, memory_order_relaxed);
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+
+    unique_lock lck{mtx};
+    const auto number = header->head.load(memory_order_relaxed);
+    auto* slot = get_slot(number);
+    // seqlock. the readers of the old frame will see the change
+    slot->stamp.store(0, memory_order_relaxed);
+    slot->has_result.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->format = frame.format;
+    slot->timestamp = frame.timestamp;
+    slot->width = frame.width;
+    slot->height = frame.height;
+    slot->plane_count = frame.plane_count;
+    uint8_t* dst = get_slot_data(slot);
+    uint32_t offset = 0;
+    for (auto i = 0u; i < frame.plane_count; ++i) {
+        const auto& plane = frame.planes[i];
+        slot->offsets[i] = offset;
+        slot->plane_widths[i] = plane.width;
+        slot->plane_heights[i] = plane.height;
+        for (auto row : plane) {
+            if (plane.pixel_stride == 1) {
+                memcpy(dst + offset, row.data(), plane.width);
+            } else {
+                for (auto x = 0u; x < plane.width; ++x)
+                    dst[offset + x] = row[x * plane.pixel_stride];
+            }
+            offset += plane.width;
+        }
+    }
+    // the result arrived before the image
+    for (const auto& result : pending) {
+        if (result.timestamp != frame.timestamp || result.timestamp == 0)
+            continue;
+        slot->result = result;
+        slot->has_result.store(1, memory_order_relaxed);
+    }
+
+    slot->stamp.store(number + 1, memory_order_release);
+    header->head.store(number + 1, memory_order_release);
+    header->notify.fetch_add(1);
+    if (header->waiters.load() > 0)
+        futex_wake(header->notify);
+    return AMEDIA_OK;
+}
+
+auto frame_publisher_t::publish(const AImage* image) noexcept
+    -> media_status_t {
+    frame_view_t frame{};
+    if (auto status = get_frame_view(image, frame))
+        return status;
+    return publish(frame);
+}
+
+void frame_publisher_t::update(const capture_result_t& result) noexcept {
+    if (header == nullptr)
+        return;
+    unique_lock lck{mtx};
+    const auto head = header->head.load(memory_order_relaxed);
+    const auto count = min<uint64_t>(head, header->slot_count);
+    for (auto number = head - count; number < head; ++number) {
+        auto* slot = get_slot(number);
+        if (slot->timestamp != result.timestamp)
+            continue;
+        slot->result = result;
+        slot->has_result.store(1, memory_order_release);
+        return;
+    }
+    pending[next++ % pending_capacity] = result;
+}
+
+uint64_t frame_publisher_t::get_published() const noexcept {
+    return header ? header->head.load(memory_order_relaxed) : 0;
+}
+
+uint64_t frame_publisher_t::get_rejected() const noexcept {
+    return header ? header->rejected.load(memory_order_relaxed) : 0;
+}
+
+void frame_publisher_t::get_subscribers(
+    vector<share_subscriber_stats_t>& output) noexcept {
+    output.clear();
+    if (header == nullptr)
+        return;
+    const auto head = header->head.load(memory_order_acquire);
+    for (auto& entry : header->subscribers) {
+        const auto pid = entry.pid.load(memory_order_acquire);
+        if (pid == 0)
+            continue;
+        // the process is gone without the unsubscribe
+        if (kill(pid, 0) != 0 && errno == ESRCH) {
+            entry.pid.store(0, memory_order_release);
+            continue;
+        }
+        const auto cursor = entry.cursor.load(memory_order_relaxed);
+        output.emplace_back(share_subscriber_stats_t{
+            pid, head > cursor ? head - cursor : 0,
+            entry.received.load(memory_order_relaxed),
+            entry.dropped.load(memory_order_relaxed)});
+    }
+}
+
+// the slots must hold their headers and fit in the memory. the product of
+// the counts can overflow the 32 bit size_t
+static bool is_valid_layout(const share_header_t& header,
+                            size_t length) noexcept {
+    if (header.slot_count == 0 || header.slot_size < slot_header_size)
+        return false;
+    const auto capacity = (length - sizeof(share_header_t)) / header.slot_size;
+    return header.slot_count <= capacity;
+}
+
+frame_subscriber_t::frame_subscriber_t(int _fd) noexcept
+    : fd{-1}, length{}, header{}, entry{}, current{}, current_stamp{} {
+    struct stat info {};
+    fd = fcntl(_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0 || fstat(fd, &info) != 0 ||
+        static_cast<size_t>(info.st_size) < sizeof(share_header_t)) {
+        logger->error("share: subscribe {}", strerror(errno));
+        return;
+    }
+    length = static_cast<size_t>(info.st_size);
+    auto* ptr =
+        mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        logger->error("share: subscribe {}", strerror(errno));
+        length = 0;
+        return;
+    }
+    header = static_cast<share_header_t*>(ptr);
+    if (header->magic != share_header_t::magic_value ||
+        header->version != share_header_t::version_value ||
+        is_valid_layout(*header, length) == false) {
+        logger->error("share: subscribe to unknown memory");
+        return;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    const auto pid = static_cast<int32_t>(getpid());
+    for (auto& candidate : header->subscribers) {
+        int32_t expected = 0;
+        if (candidate.pid.compare_exchange_strong(expected, pid) == false)
+            continue;
+        candidate.received = 0;
+        candidate.dropped = 0;
+        // the frames before the subscription are not counted
+        candidate.cursor.store(header->head.load(memory_order_acquire),
+                               memory_order_release);
+        entry = &candidate;
+        return;
+    }
+    logger->error("share: no entry for the subscriber");
+}
+
+frame_subscriber_t::~frame_subscriber_t() noexcept {
+    if (entry)
+        entry->pid.store(0, memory_order_release);
+    if (header)
+        munmap(header, length);
+    if (fd >= 0)
+        close(fd);
+}
+
+bool frame_subscriber_t::wait(milliseconds timeout) noexcept {
+    if (entry == nullptr)
+        return false;
+    const auto cursor = entry->cursor.load(memory_order_relaxed);
+    const auto deadline = steady_clock::now() + timeout;
+    header->waiters.fetch_add(1);
+    auto ready = false;
+    while (true) {
+        const auto word = header->notify.load();
+        ready = header->head.load(memory_order_acquire) > cursor;
+        const auto remain =
+            duration_cast<milliseconds>(deadline - steady_clock::now());
+        if (ready || remain.count() <= 0)
+            break;
+        futex_wait(header->notify, word, remain);
+    }
+    header->waiters.fetch_sub(1);
+    return ready;
+}
+
+bool frame_subscriber_t::acquire(shared_frame_t& frame) noexcept {
+    if (entry == nullptr || current)
+        return false;
+    const auto head = header->head.load(memory_order_acquire);
+    auto cursor = entry->cursor.load(memory_order_relaxed);
+    // the oldest slot may be under the overwrite. like
+    // `AImageReader_acquireLatestImage`, the lagging one jumps to the latest
+    const auto oldest =
+        head >= header->slot_count ? head - header->slot_count + 1 : 0;
+    if (cursor < oldest) {
+        entry->dropped.fetch_add(head - 1 - cursor, memory_order_relaxed);
+        cursor = head - 1;
+        entry->cursor.store(cursor, memory_order_relaxed);
+    }
+    if (cursor >= head)
+        return false;
+
+    auto* slots = reinterpret_cast<uint8_t*>(header + 1);
+    auto* slot = reinterpret_cast<share_slot_t*>(
+        slots + (cursor % header->slot_count) * header->slot_size);
+    if (slot->stamp.load(memory_order_acquire) != cursor + 1) {
+        entry->dropped.fetch_add(1, memory_order_relaxed);
+        entry->cursor.store(cursor + 1, memory_order_relaxed);
+        return false;
+    }
+
+    // `plane_count` can be broken by the overwrite. `release` will tell
+    frame = shared_frame_t{};
+    frame.number = cursor;
+    frame.view.format = slot->format;
+    frame.view.timestamp = slot->timestamp;
+    frame.view.width = slot->width;
+    frame.view.height = slot->height;
+    frame.view.plane_count =
+        min<uint32_t>(slot->plane_count, frame_view_t::max_plane_count);
+    const auto capacity = header->slot_size - slot_header_size;
+    const auto* data =
+        reinterpret_cast<const uint8_t*>(slot) + slot_header_size;
+    for (auto i = 0u; i < frame.view.plane_count; ++i) {
+        const auto width = slot->plane_widths[i];
+        const auto height = slot->plane_heights[i];
+        const auto offset = slot->offsets[i];
+        if (offset + uint64_t{width} * height > capacity)
+            break;
+        frame.view.planes[i] =
+            make_plane_view(data + offset, width, width, height);
+    }
+    frame.has_result = slot->has_result.load(memory_order_acquire) != 0;
+    if (frame.has_result)
+        frame.result = slot->result;
+
+    current = slot;
+    current_stamp = cursor + 1;
+    return true;
+}
+
+bool frame_subscriber_t::release() noexcept {
+    if (current == nullptr)
+        return false;
+    atomic_thread_fence(memory_order_acquire);
+    const auto ok =
+        current->stamp.load(memory_order_relaxed) == current_stamp;
+    if (ok)
+        entry->received.fetch_add(1, memory_order_relaxed);
+    else
+        entry->dropped.fetch_add(1, memory_order_relaxed);
+    entry->cursor.store(current_stamp, memory_order_release);
+    current = nullptr;
+    return ok;
+}
+
+auto frame_subscriber_t::get_stats() const noexcept
+    -> share_subscriber_stats_t {
+    if (entry == nullptr)
+        return share_subscriber_stats_t{};
+    const auto head = header->head.load(memory_order_acquire);
+    const auto cursor = entry->cursor.load(memory_order_relaxed);
+    return share_subscriber_stats_t{entry->pid.load(memory_order_relaxed),
+                                    head > cursor ? head - cursor : 0,
+                                    entry->received.load(memory_order_relaxed),
+                                    entry->dropped.load(memory_order_relaxed)};
+}
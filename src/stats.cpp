@@ -0,0 +1,303 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_motion.h>
+#include <ndk_camera_stats.h>
+
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDCAM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NDCAM_SSE2 1
+#endif
+
+using namespace std;
+
+// 4 histograms to break the dependency of repeated values
+static void row_histogram(const uint8_t* row, uint32_t count,
+                          uint32_t (*histogram)[256]) noexcept {
+    auto x = 0u;
+    for (; x + 4 <= count; x += 4) {
+        ++histogram[0][row[x + 0]];
+        ++histogram[1][row[x + 1]];
+        ++histogram[2][row[x + 2]];
+        ++histogram[3][row[x + 3]];
+    }
+    for (; x < count; ++x)
+        ++histogram[0][row[x]];
+}
+
+static void row_moments(const uint8_t* row, uint32_t count, uint64_t& sum,
+                        uint64_t& square_sum) noexcept {
+    auto x = 0u;
+#if defined(NDCAM_NEON)
+    uint32x4_t acc = vdupq_n_u32(0), sq = vdupq_n_u32(0);
+    for (; x + 16 <= count; x += 16) {
+        const auto v = vld1q_u8(row + x);
+        acc = vpadalq_u16(acc, vpaddlq_u8(v));
+        sq = vpadalq_u16(sq, vmull_u8(vget_low_u8(v), vget_low_u8(v)));
+        sq = vpadalq_u16(sq, vmull_u8(vget_high_u8(v), vget_high_u8(v)));
+    }
+    const auto s = vpaddlq_u32(acc);
+    const auto q = vpaddlq_u32(sq);
+    sum += vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1);
+    square_sum += vgetq_lane_u64(q, 0) + vgetq_lane_u64(q, 1);
+#elif defined(NDCAM_SSE2)
+    const auto zero = _mm_setzero_si128();
+    auto acc = _mm_setzero_si128(), sq = _mm_setzero_si128();
+    for (; x + 16 <= count; x += 16) {
+        const auto v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        const auto lo = _mm_unpacklo_epi8(v, zero);
+        const auto hi = _mm_unpackhi_epi8(v, zero);
+        sq = _mm_add_epi32(sq, _mm_madd_epi16(lo, lo));
+        sq = _mm_add_epi32(sq, _mm_madd_epi16(hi, hi));
+    }
+    alignas(16) uint32_t lanes[4]{};
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sq);
+    sum += static_cast<uint32_t>(_mm_cvtsi128_si32(acc)) +
+           static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+    square_sum += uint64_t{lanes[0]} + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; x < count; ++x) {
+        sum += row[x];
+        square_sum += row[x] * row[x];
+    }
+}
+
+// 4-neighbor Laplacian of the middle row. [1, count - 1)
+static void row_laplacian(const uint8_t* top, const uint8_t* mid,
+                          const uint8_t* bottom, uint32_t count, int64_t& sum,
+                          uint64_t& square_sum) noexcept {
+    auto x = 1u;
+#if defined(NDCAM_NEON)
+    // flush before the lanes overflow. (4 * 255)^2 * 2 per iteration
+    while (x + 8 < count) {
+        int32x4_t acc = vdupq_n_s32(0), sq = vdupq_n_s32(0);
+        for (auto i = 0; i < 256 && x + 8 < count; ++i, x += 8) {
+            const auto c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x)));
+            const auto l =
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x - 1)));
+            const auto r =
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x + 1)));
+            const auto u = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(top + x)));
+            const auto d =
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(bottom + x)));
+            const auto lap = vsubq_s16(
+                vsubq_s16(vshlq_n_s16(c, 2), vaddq_s16(l, r)), vaddq_s16(u, d));
+            acc = vpadalq_s16(acc, lap);
+            sq = vmlal_s16(sq, vget_low_s16(lap), vget_low_s16(lap));
+            sq = vmlal_s16(sq, vget_high_s16(lap), vget_high_s16(lap));
+        }
+        const auto s = vpaddlq_s32(acc);
+        const auto q = vpaddlq_u32(vreinterpretq_u32_s32(sq));
+        sum += vgetq_lane_s64(s, 0) + vgetq_lane_s64(s, 1);
+        square_sum += vgetq_lane_u64(q, 0) + vgetq_lane_u64(q, 1);
+    }
+#elif defined(NDCAM_SSE2)
+    const auto zero = _mm_setzero_si128();
+    const auto one = _mm_set1_epi16(1);
+    const auto load = [=](const uint8_t* p) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+    while (x + 8 < count) {
+        auto acc = _mm_setzero_si128(), sq = _mm_setzero_si128();
+        for (auto i = 0; i < 256 && x + 8 < count; ++i, x += 8) {
+            const auto c = _mm_slli_epi16(load(mid + x), 2);
+            const auto n = _mm_add_epi16(
+                _mm_add_epi16(load(mid + x - 1), load(mid + x + 1)),
+                _mm_add_epi16(load(top + x), load(bottom + x)));
+            const auto lap = _mm_sub_epi16(c, n);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(lap, one));
+            sq = _mm_add_epi32(sq, _mm_madd_epi16(lap, lap));
+        }
+        alignas(16) int32_t s[4]{};
+        alignas(16) uint32_t q[4]{};
+        _mm_store_si128(reinterpret_cast<__m128i*>(s), acc);
+        _mm_store_si128(reinterpret_cast<__m128i*>(q), sq);
+        sum += int64_t{s[0]} + s[1] + s[2] + s[3];
+        square_sum += uint64_t{q[0]} + q[1] + q[2] + q[3];
+    }
+#endif
+    for (; x + 1 < count; ++x) {
+        const int32_t lap =
+            4 * mid[x] - mid[x - 1] - mid[x + 1] - top[x] - bottom[x];
+        sum += lap;
+        square_sum += static_cast<uint64_t>(lap * lap);
+    }
+}
+
+auto get_stats_scratch_size(const stats_config_t& config,
+                            uint32_t width) noexcept -> size_t {
+    const auto step = max(config.step, 1u);
+    if (step == 1) // rows are used in place
+        return 0;
+    const auto roi_width = config.roi.width ? config.roi.width : width;
+    return 3 * (roi_width / step);
+}
+
+auto get_stats_scratch_size(const stats_config_t& config,
+                            const plane_view_t& plane) noexcept -> size_t {
+    const auto step = max(config.step, 1u);
+    if (step == 1 && plane.is_packed()) // rows are used in place
+        return 0;
+    const auto roi = clamp_roi(config.roi, plane.width, plane.height);
+    return 3 * (roi.width / step);
+}
+
+void compute_frame_stats(const uint8_t* plane, uint32_t row_stride,
+                         uint32_t width, uint32_t height,
+                         const stats_config_t& config,
+                         gsl::span<uint8_t> scratch,
+                         frame_stats_t& stats) noexcept {
+    compute_frame_stats(make_plane_view(plane, row_stride, width, height),
+                        config, scratch, stats);
+}
+
+void compute_frame_stats(const plane_view_t& plane,
+                         const stats_config_t& config,
+                         gsl::span<uint8_t> scratch,
+                         frame_stats_t& stats) noexcept {
+    const auto roi = clamp_roi(config.roi, plane.width, plane.height);
+    const auto step = max(config.step, 1u);
+    const auto cols = roi.width / step;
+    const auto rows = roi.height / step;
+    const auto pixel_stride = plane.pixel_stride;
+    const bool gather = step > 1 || plane.is_packed() == false;
+
+    stats.count = 0;
+    stats.histogram.fill(0);
+    stats.mean = stats.variance = stats.sharpness = 0;
+    if (cols == 0 || rows == 0)
+        return;
+    Expects(gather == false ||
+            static_cast<size_t>(scratch.size()) >= 3 * cols);
+
+    uint32_t histogram[4][256]{};
+    uint64_t sum = 0, square_sum = 0;
+    int64_t lap_sum = 0;
+    uint64_t lap_square_sum = 0, lap_count = 0;
+    // the last 3 rows for the Laplacian
+    const uint8_t* window[3]{};
+
+    for (auto r = 0u; r < rows; ++r) {
+        const uint8_t* row =
+            plane.row(roi.y + r * step).data() + roi.x * pixel_stride;
+        if (gather) {
+            uint8_t* dst = scratch.data() + (r % 3) * cols;
+            if (pixel_stride == 1)
+                subsample_plane(row, plane.row_stride, roi.width, step, step,
+                                dst);
+            else
+                for (auto x = 0u; x < cols; ++x)
+                    dst[x] = row[x * step * pixel_stride];
+            row = dst;
+        }
+        if (config.histogram)
+            row_histogram(row, cols, histogram);
+        row_moments(row, cols, sum, square_sum);
+
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = row;
+        if (config.sharpness && r >= 2 && cols >= 3) {
+            row_laplacian(window[0], window[1], window[2], cols, lap_sum,
+                          lap_square_sum);
+            lap_count += cols - 2;
+        }
+    }
+
+    if (config.histogram)
+        for (auto i = 0u; i < 256; ++i)
+            stats.histogram[i] = histogram[0][i] + histogram[1][i] +
+                                 histogram[2][i] + histogram[3][i];
+
+    const auto count = static_cast<double>(cols) * rows;
+    const auto mean = sum / count;
+    stats.count = cols * rows;
+    stats.mean = static_cast<float>(mean);
+    stats.variance =
+        static_cast<float>(max(square_sum / count - mean * mean, 0.0));
+    if (lap_count) {
+        const auto lap_mean = lap_sum / static_cast<double>(lap_count);
+        stats.sharpness = static_cast<float>(
+            max(lap_square_sum / static_cast<double>(lap_count) -
+                    lap_mean * lap_mean,
+                0.0));
+    }
+}
+
+frame_statistics_t::frame_statistics_t(const stats_config_t& _config,
+                                       stats_callback_t _callback,
+                                       void* _context) noexcept
+    : config{_config}, callback{_callback}, user_context{_context} {
+}
+
+media_status_t frame_statistics_t::update(const AImage* image) noexcept {
+    frame_view_t frame{};
+    if (auto status = get_frame_view(image, frame))
+        return status;
+    if (frame.format != AIMAGE_FORMAT_YUV_420_888)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+
+    const auto& y = frame.planes[0];
+    scratch.resize(get_stats_scratch_size(config, y));
+    working.timestamp = frame.timestamp;
+    compute_frame_stats(y, config, scratch, working);
+
+    unique_lock lck{mtx};
+    latest = working;
+    auto& entry = find(working.timestamp);
+    entry.stats = working;
+    entry.has_stats = true;
+    if (entry.has_result == false)
+        return AMEDIA_OK;
+
+    const auto ready = entry;
+    entry.timestamp = 0;
+    lck.unlock();
+    publish(ready);
+    return AMEDIA_OK;
+}
+
+void frame_statistics_t::update(const capture_result_t& result) noexcept {
+    unique_lock lck{mtx};
+    auto& entry = find(result.timestamp);
+    entry.result = result;
+    entry.has_result = true;
+    if (entry.has_stats == false)
+        return;
+
+    const auto ready = entry;
+    entry.timestamp = 0;
+    lck.unlock();
+    publish(ready);
+}
+
+// use the oldest entry if there is no match
+auto frame_statistics_t::find(int64_t timestamp) noexcept -> entry_t& {
+    for (auto& entry : entries)
+        if (entry.timestamp == timestamp)
+            return entry;
+    auto& entry = entries[next];
+    next = (next + 1) % capacity;
+    entry.timestamp = timestamp;
+    entry.has_result = entry.has_stats = false;
+    return entry;
+}
+
+void frame_statistics_t::publish(const entry_t& entry) noexcept {
+    if (callback)
+        callback(user_context, entry.result, entry.stats);
+}
+
+auto frame_statistics_t::get_latest() const noexcept -> frame_stats_t {
+    unique_lock lck{mtx};
+    return latest;
+}
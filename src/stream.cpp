@@ -0,0 +1,487 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_stream.h>
+
+#include <algorithm>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+auto get_format_name(int32_t format) noexcept -> std::string {
+    switch (format) {
+    case AIMAGE_FORMAT_YUV_420_888:
+        return "YUV_420_888";
+    case AIMAGE_FORMAT_PRIVATE:
+        return "PRIVATE";
+    case AIMAGE_FORMAT_JPEG:
+        return "JPEG";
+    case AIMAGE_FORMAT_RAW16:
+        return "RAW16";
+    default:
+        return fmt::format("0x{:x}", format);
+    }
+}
+
+static auto get_level_name(uint8_t level) noexcept -> const char* {
+    switch (level) {
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LIMITED:
+        return "LIMITED";
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL:
+        return "FULL";
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_3:
+        return "LEVEL_3";
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_EXTERNAL:
+        return "EXTERNAL";
+    default:
+        return "LEGACY";
+    }
+}
+
+// durations of ACAMERA_SCALER_AVAILABLE_*_DURATIONS
+static void read_durations(const ACameraMetadata* metadata, uint32_t tag,
+                           int64_t stream_config_t::*field,
+                           vector<stream_config_t>& outputs) noexcept {
+    ACameraMetadata_const_entry entry{};
+    if (ACameraMetadata_getConstEntry(metadata, tag, &entry) != ACAMERA_OK)
+        return;
+    // format, width, height, duration
+    for (auto i = 0u; i + 3 < entry.count; i += 4) {
+        const auto* values = entry.data.i64 + i;
+        for (auto& output : outputs)
+            if (output.format == values[0] && output.size.width == values[1] &&
+                output.size.height == values[2])
+                output.*field = values[3];
+    }
+}
+
+auto read_stream_capability(const ACameraMetadata* metadata,
+                            stream_capability_t& capability) noexcept
+    -> camera_status_t {
+    capability.hardware_level = ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LEGACY;
+    capability.raw = false;
+    capability.outputs.clear();
+
+    ACameraMetadata_const_entry entry{};
+    if (ACameraMetadata_getConstEntry(metadata,
+                                      ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL,
+                                      &entry) == ACAMERA_OK &&
+        entry.count)
+        capability.hardware_level = entry.data.u8[0];
+    if (ACameraMetadata_getConstEntry(metadata,
+                                      ACAMERA_REQUEST_AVAILABLE_CAPABILITIES,
+                                      &entry) == ACAMERA_OK)
+        for (auto i = 0u; i < entry.count; ++i)
+            if (entry.data.u8[i] == ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_RAW)
+                capability.raw = true;
+
+    const auto status = ACameraMetadata_getConstEntry(
+        metadata, ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS, &entry);
+    if (status != ACAMERA_OK)
+        return status;
+    // format, width, height, direction
+    for (auto i = 0u; i + 3 < entry.count; i += 4) {
+        const auto* values = entry.data.i32 + i;
+        if (values[3] != ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT)
+            continue;
+        stream_config_t output{values[0],
+                               {static_cast<uint32_t>(values[1]),
+                                static_cast<uint32_t>(values[2])},
+                               0,
+                               0};
+        capability.outputs.emplace_back(output);
+    }
+    read_durations(metadata, ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS,
+                   &stream_config_t::min_frame_duration, capability.outputs);
+    read_durations(metadata, ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS,
+                   &stream_config_t::stall_duration, capability.outputs);
+    return ACAMERA_OK;
+}
+
+// ---- guaranteed stream combinations. see CameraDevice#createCaptureSession
+
+enum class stream_class_t : uint8_t { priv, yuv, jpeg, raw, other };
+enum class size_class_t : uint8_t { vga, preview, record, maximum };
+
+struct slot_t final {
+    stream_class_t type;
+    size_class_t size;
+};
+
+struct combination_t final {
+    uint8_t rank; // see `get_rank`
+    bool raw;     // needs the RAW capability
+    uint8_t count;
+    slot_t slots[4];
+};
+
+static constexpr auto P = stream_class_t::priv;
+static constexpr auto Y = stream_class_t::yuv;
+static constexpr auto J = stream_class_t::jpeg;
+static constexpr auto R = stream_class_t::raw;
+static constexpr auto VGA = size_class_t::vga;
+static constexpr auto PV = size_class_t::preview;
+static constexpr auto RC = size_class_t::record;
+static constexpr auto MX = size_class_t::maximum;
+
+static constexpr combination_t combinations[]{
+    // LEGACY
+    {0, false, 1, {{P, MX}}},
+    {0, false, 1, {{J, MX}}},
+    {0, false, 1, {{Y, MX}}},
+    {0, false, 2, {{P, PV}, {J, MX}}},
+    {0, false, 2, {{Y, PV}, {J, MX}}},
+    {0, false, 2, {{P, PV}, {P, PV}}},
+    {0, false, 2, {{P, PV}, {Y, PV}}},
+    {0, false, 3, {{P, PV}, {Y, PV}, {J, MX}}},
+    // LIMITED
+    {1, false, 2, {{P, PV}, {P, RC}}},
+    {1, false, 2, {{P, PV}, {Y, RC}}},
+    {1, false, 2, {{Y, PV}, {Y, RC}}},
+    {1, false, 3, {{P, PV}, {P, RC}, {J, RC}}},
+    {1, false, 3, {{P, PV}, {Y, RC}, {J, RC}}},
+    {1, false, 3, {{Y, PV}, {Y, PV}, {J, MX}}},
+    // FULL
+    {2, false, 2, {{P, PV}, {P, MX}}},
+    {2, false, 2, {{P, PV}, {Y, MX}}},
+    {2, false, 2, {{Y, PV}, {Y, MX}}},
+    {2, false, 3, {{P, PV}, {P, PV}, {J, MX}}},
+    {2, false, 3, {{Y, VGA}, {P, PV}, {Y, MX}}},
+    {2, false, 3, {{Y, VGA}, {Y, PV}, {Y, MX}}},
+    // RAW capability
+    {0, true, 1, {{R, MX}}},
+    {0, true, 2, {{P, PV}, {R, MX}}},
+    {0, true, 2, {{Y, PV}, {R, MX}}},
+    {0, true, 3, {{P, PV}, {P, PV}, {R, MX}}},
+    {0, true, 3, {{P, PV}, {Y, PV}, {R, MX}}},
+    {0, true, 3, {{Y, PV}, {Y, PV}, {R, MX}}},
+    {0, true, 3, {{P, PV}, {J, MX}, {R, MX}}},
+    {0, true, 3, {{Y, PV}, {J, MX}, {R, MX}}},
+    // LEVEL_3
+    {3, true, 4, {{P, PV}, {P, VGA}, {Y, MX}, {R, MX}}},
+    {3, true, 4, {{P, PV}, {P, VGA}, {J, MX}, {R, MX}}},
+};
+
+static constexpr auto max_stream_count = 4u;
+
+// LEGACY < LIMITED(EXTERNAL) < FULL < LEVEL_3
+static uint8_t get_rank(uint8_t level) noexcept {
+    switch (level) {
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LIMITED:
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_EXTERNAL:
+        return 1;
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL:
+        return 2;
+    case ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_3:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static auto get_class(int32_t format) noexcept -> stream_class_t {
+    switch (format) {
+    case AIMAGE_FORMAT_PRIVATE:
+        return P;
+    case AIMAGE_FORMAT_YUV_420_888:
+        return Y;
+    case AIMAGE_FORMAT_JPEG:
+        return J;
+    case AIMAGE_FORMAT_RAW16:
+        return R;
+    default:
+        return stream_class_t::other;
+    }
+}
+
+static bool fits(const stream_config_t& stream, slot_t slot) noexcept {
+    if (get_class(stream.format) != slot.type)
+        return false;
+    static constexpr stream_size_t bounds[]{
+        {640, 480}, {1920, 1080}, {3840, 2160}};
+    if (slot.size == MX) // the largest of the format
+        return true;
+    const auto& bound = bounds[static_cast<uint8_t>(slot.size)];
+    return stream.size.width <= bound.width &&
+           stream.size.height <= bound.height;
+}
+
+// assign the streams to the distinct slots
+static bool match(const combination_t& combination,
+                  const stream_config_t* const* streams, uint32_t count,
+                  uint32_t used) noexcept {
+    if (count == 0)
+        return true;
+    for (auto i = 0u; i < combination.count; ++i) {
+        if (used & (1u << i))
+            continue;
+        if (fits(*streams[0], combination.slots[i]) == false)
+            continue;
+        if (match(combination, streams + 1, count - 1, used | (1u << i)))
+            return true;
+    }
+    return false;
+}
+
+static bool is_guaranteed(const stream_capability_t& capability,
+                          const stream_config_t* const* streams,
+                          uint32_t count) noexcept {
+    const auto rank = get_rank(capability.hardware_level);
+    for (const auto& combination : combinations) {
+        if (combination.rank > rank || combination.count < count ||
+            (combination.raw && capability.raw == false))
+            continue;
+        if (match(combination, streams, count, 0))
+            return true;
+    }
+    return false;
+}
+
+// ---- planner
+
+static uint64_t get_pixels(const stream_config_t& stream) noexcept {
+    return uint64_t{stream.size.width} * stream.size.height;
+}
+
+struct durations_t final {
+    int64_t frame; // repeating request
+    int64_t still; // with the still streams
+    uint32_t frame_bottleneck, still_bottleneck;
+};
+
+static auto get_durations(gsl::span<const stream_requirement_t> requirements,
+                          const stream_config_t* const* streams) noexcept
+    -> durations_t {
+    durations_t result{};
+    int64_t frame = 0, frame_stall = 0, still = 0, still_stall = 0;
+    int64_t frame_max = -1, still_max = -1;
+    for (auto i = 0u; i < requirements.size(); ++i) {
+        const auto& stream = *streams[i];
+        const auto cost = stream.min_frame_duration + stream.stall_duration;
+        if (requirements[i].repeating) {
+            frame = max(frame, stream.min_frame_duration);
+            frame_stall = max(frame_stall, stream.stall_duration);
+            if (cost > frame_max) {
+                frame_max = cost;
+                result.frame_bottleneck = i;
+            }
+        }
+        still = max(still, stream.min_frame_duration);
+        still_stall = max(still_stall, stream.stall_duration);
+        if (cost > still_max) {
+            still_max = cost;
+            result.still_bottleneck = i;
+        }
+    }
+    result.frame = frame + frame_stall;
+    result.still = still + still_stall;
+    return result;
+}
+
+// the requirement which the durations can't meet. `requirements.size()` if
+// all of them are met
+static uint32_t
+find_violation(gsl::span<const stream_requirement_t> requirements,
+               const durations_t& durations) noexcept {
+    for (auto i = 0u; i < requirements.size(); ++i) {
+        const auto& requirement = requirements[i];
+        const auto duration =
+            requirement.repeating ? durations.frame : durations.still;
+        if (requirement.max_frame_duration &&
+            duration > requirement.max_frame_duration)
+            return i;
+    }
+    return static_cast<uint32_t>(requirements.size());
+}
+
+struct score_t final {
+    uint64_t largest; // pixels of the `largest` requirements
+    int64_t frame;
+    int64_t still;
+    uint64_t others;
+
+  public:
+    bool operator<(const score_t& rhs) const noexcept {
+        if (largest != rhs.largest)
+            return largest > rhs.largest;
+        if (frame != rhs.frame)
+            return frame < rhs.frame;
+        if (still != rhs.still)
+            return still < rhs.still;
+        return others < rhs.others;
+    }
+};
+
+struct search_t final {
+    bool guaranteed = false; // any combination of the table
+    bool feasible = false;
+    score_t best{};
+    array<const stream_config_t*, max_stream_count> plan{};
+    // the fastest guaranteed one which misses a frame duration
+    int64_t slow_frame = INT64_MAX, slow_still = INT64_MAX;
+    array<const stream_config_t*, max_stream_count> slow{};
+};
+
+// every choice of the sizes for the first `count` requirements
+static void search(const stream_capability_t& capability,
+                   gsl::span<const stream_requirement_t> requirements,
+                   const vector<vector<const stream_config_t*>>& candidates,
+                   search_t& result) noexcept {
+    const auto count = static_cast<uint32_t>(requirements.size());
+    array<uint32_t, max_stream_count> indices{};
+    array<const stream_config_t*, max_stream_count> streams{};
+    while (true) {
+        for (auto i = 0u; i < count; ++i)
+            streams[i] = candidates[i][indices[i]];
+
+        if (is_guaranteed(capability, streams.data(), count)) {
+            result.guaranteed = true;
+            const auto durations = get_durations(requirements, streams.data());
+            if (find_violation(requirements, durations) == count) {
+                score_t score{0, durations.frame, durations.still, 0};
+                for (auto i = 0u; i < count; ++i)
+                    (requirements[i].largest ? score.largest : score.others) +=
+                        get_pixels(*streams[i]);
+                if (result.feasible == false || score < result.best) {
+                    result.feasible = true;
+                    result.best = score;
+                    result.plan = streams;
+                }
+            } else if (durations.frame < result.slow_frame ||
+                       (durations.frame == result.slow_frame &&
+                        durations.still < result.slow_still)) {
+                result.slow_frame = durations.frame;
+                result.slow_still = durations.still;
+                result.slow = streams;
+            }
+        }
+        // next choice
+        auto i = 0u;
+        for (; i < count; ++i) {
+            if (++indices[i] < candidates[i].size())
+                break;
+            indices[i] = 0;
+        }
+        if (i == count)
+            return;
+    }
+}
+
+static auto describe(const stream_config_t& stream) noexcept -> std::string {
+    return fmt::format("{} {}x{}", get_format_name(stream.format),
+                       stream.size.width, stream.size.height);
+}
+
+static bool fail(stream_plan_t& plan, stream_plan_error_t error,
+                 uint32_t culprit, std::string&& reason) noexcept {
+    plan.error = error;
+    plan.culprit = culprit;
+    plan.reason = move(reason);
+    logger->debug("plan_streams: {}", plan.reason);
+    return false;
+}
+
+bool plan_streams(const stream_capability_t& capability,
+                  gsl::span<const stream_requirement_t> requirements,
+                  stream_plan_t& plan) noexcept {
+    plan.streams.clear();
+    plan.frame_duration = plan.still_duration = 0;
+    plan.error = stream_plan_error_t::none;
+    plan.culprit = 0;
+    plan.reason.clear();
+    const auto count = static_cast<uint32_t>(requirements.size());
+    if (count == 0)
+        return true;
+    if (count > max_stream_count)
+        return fail(plan, stream_plan_error_t::combination, max_stream_count,
+                    fmt::format("{} streams. no combination has more than {}",
+                                count, max_stream_count));
+
+    // the sizes which can meet the requirement alone
+    vector<vector<const stream_config_t*>> candidates(count);
+    for (auto i = 0u; i < count; ++i) {
+        const auto& requirement = requirements[i];
+        const auto name = get_format_name(requirement.format);
+        int64_t fastest = INT64_MAX;
+        for (const auto& output : capability.outputs) {
+            if (output.format != requirement.format ||
+                output.size.width < requirement.min_size.width ||
+                output.size.height < requirement.min_size.height)
+                continue;
+            const auto duration =
+                output.min_frame_duration + output.stall_duration;
+            fastest = min(fastest, duration);
+            if (requirement.max_frame_duration == 0 ||
+                duration <= requirement.max_frame_duration)
+                candidates[i].emplace_back(&output);
+        }
+        if (fastest == INT64_MAX)
+            return fail(plan, stream_plan_error_t::no_size, i,
+                        fmt::format("stream {}: no {} output of {}x{} or "
+                                    "larger",
+                                    i, name, requirement.min_size.width,
+                                    requirement.min_size.height));
+        if (candidates[i].empty())
+            return fail(plan, stream_plan_error_t::too_slow, i,
+                        fmt::format("stream {}: {} of {}x{} or larger takes "
+                                    "{} ns at least. {} ns is required",
+                                    i, name, requirement.min_size.width,
+                                    requirement.min_size.height, fastest,
+                                    requirement.max_frame_duration));
+    }
+
+    search_t result{};
+    search(capability, requirements, candidates, result);
+    if (result.feasible) {
+        for (auto i = 0u; i < count; ++i)
+            plan.streams.emplace_back(*result.plan[i]);
+        plan.frame_duration = result.best.frame;
+        plan.still_duration = result.best.still;
+        return true;
+    }
+
+    if (result.guaranteed == false) {
+        // the first requirement which can't be added to the others
+        auto culprit = count - 1;
+        for (auto n = 1u; n < count; ++n) {
+            search_t prefix{};
+            search(capability, requirements.subspan(0, n), candidates, prefix);
+            if (prefix.guaranteed == false) {
+                culprit = n - 1;
+                break;
+            }
+        }
+        std::string streams{};
+        for (auto i = 0u; i <= culprit; ++i)
+            streams += fmt::format("{}{} >= {}x{}", i ? ", " : "",
+                                   get_format_name(requirements[i].format),
+                                   requirements[i].min_size.width,
+                                   requirements[i].min_size.height);
+        return fail(plan, stream_plan_error_t::combination, culprit,
+                    fmt::format("stream {}: no guaranteed combination of {} "
+                                "for {}",
+                                culprit,
+                                get_level_name(capability.hardware_level),
+                                streams));
+    }
+
+    // guaranteed, but the streams slow down each other
+    const auto durations = get_durations(requirements, result.slow.data());
+    const auto culprit = find_violation(requirements, durations);
+    const auto& requirement = requirements[culprit];
+    const auto bottleneck = requirement.repeating ? durations.frame_bottleneck
+                                                  : durations.still_bottleneck;
+    return fail(
+        plan, stream_plan_error_t::too_slow, culprit,
+        fmt::format("stream {}: {} ns is required but the {} request takes "
+                    "{} ns at least. stream {}({}) needs {} ns with the stall",
+                    culprit, requirement.max_frame_duration,
+                    requirement.repeating ? "repeating" : "still",
+                    requirement.repeating ? durations.frame : durations.still,
+                    bottleneck, describe(*result.slow[bottleneck]),
+                    result.slow[bottleneck]->min_frame_duration +
+                        result.slow[bottleneck]->stall_duration));
+}
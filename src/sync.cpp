@@ -0,0 +1,168 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_sync.h>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+frame_synchronizer_t::frame_synchronizer_t(int64_t _tolerance, int64_t _window,
+                                           sync_callback_t _callback,
+                                           void* _context) noexcept
+    : tolerance{_tolerance}, window{_window}, callback{_callback},
+      user_context{_context} {
+    assert(tolerance >= 0);
+    assert(window > tolerance);
+}
+
+camera_status_t frame_synchronizer_t::add_stream(
+    uint16_t id, const ACameraMetadata* characteristics) noexcept {
+    if (id >= camera_group_t::max_camera_count)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+
+    ACameraMetadata_const_entry entry{};
+    auto status = ACameraMetadata_getConstEntry(
+        characteristics, ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, &entry);
+    if (status != ACAMERA_OK)
+        return status;
+
+    unique_lock lck{mtx};
+    auto& stream = streams[id];
+    if (stream.enabled)
+        return ACAMERA_OK;
+
+    stream.enabled = true;
+    // without the value, the timestamps are not comparable
+    stream.source = ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN;
+    if (entry.count)
+        stream.source = entry.data.u8[0];
+    stream.offset = 0;
+    stream.sequence = 0;
+    stream.head = stream.count = 0;
+    // the first stream becomes the reference time base.
+    // REALTIME sources share CLOCK_BOOTTIME. UNKNOWN is only comparable
+    // with itself
+    if (num_stream == 0) {
+        reference_source = stream.source;
+        stream.aligned = true;
+    } else
+        stream.aligned =
+            stream.source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME &&
+            reference_source == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME;
+
+    if (stream.aligned == false)
+        logger->warn("sync: timestamp of device {} is not comparable. "
+                     "set_offset is required",
+                     id);
+    ++num_stream;
+    return ACAMERA_OK;
+}
+
+void frame_synchronizer_t::set_offset(uint16_t id, int64_t offset) noexcept {
+    assert(id < camera_group_t::max_camera_count);
+    unique_lock lck{mtx};
+    auto& stream = streams[id];
+    // pending frames were measured with the old offset
+    while (stream.count)
+        pop_front(stream);
+    stream.offset = offset;
+    stream.aligned = true;
+}
+
+void frame_synchronizer_t::pop_front(stream_t& stream) noexcept {
+    stream.head = (stream.head + 1) % capacity;
+    --stream.count;
+}
+
+camera_status_t frame_synchronizer_t::push(uint16_t id,
+                                           int64_t timestamp) noexcept {
+    if (id >= camera_group_t::max_camera_count)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+
+    unique_lock lck{mtx};
+    auto& stream = streams[id];
+    if (stream.enabled == false)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    if (stream.aligned == false)
+        return ACAMERA_ERROR_INVALID_OPERATION;
+
+    const auto aligned_time = timestamp + stream.offset;
+    if (stream.count == capacity) { // overflow. the oldest must go
+        pop_front(stream);
+        ++stats.expired[id];
+    }
+    auto& frame = stream.frames[(stream.head + stream.count) % capacity];
+    frame.id = id;
+    frame.timestamp = aligned_time;
+    frame.sequence = stream.sequence++;
+    ++stream.count;
+
+    expire(aligned_time);
+    match();
+    return ACAMERA_OK;
+}
+
+// frames older than the window can't be paired in bounded latency
+void frame_synchronizer_t::expire(int64_t newest) noexcept {
+    for (uint16_t id = 0u; id < streams.size(); ++id) {
+        auto& stream = streams[id];
+        while (stream.count &&
+               stream.frames[stream.head].timestamp < newest - window) {
+            pop_front(stream);
+            ++stats.expired[id];
+        }
+    }
+}
+
+void frame_synchronizer_t::match() noexcept {
+    array<sync_frame_t, camera_group_t::max_camera_count> set{};
+    while (true) {
+        // all streams need a candidate
+        int64_t earliest = INT64_MAX, latest = INT64_MIN;
+        uint16_t earliest_id = 0, count = 0;
+        for (uint16_t id = 0u; id < streams.size(); ++id) {
+            const auto& stream = streams[id];
+            if (stream.enabled == false)
+                continue;
+            if (stream.count == 0)
+                return;
+            const auto& frame = stream.frames[stream.head];
+            if (frame.timestamp < earliest) {
+                earliest = frame.timestamp;
+                earliest_id = id;
+            }
+            latest = max(latest, frame.timestamp);
+            set[count++] = frame;
+        }
+        if (count == 0)
+            return;
+
+        // the earliest frame can't be paired with later frames. drop it
+        if (latest - earliest > tolerance) {
+            pop_front(streams[earliest_id]);
+            ++stats.unmatched[earliest_id];
+            continue;
+        }
+
+        for (auto& stream : streams)
+            if (stream.enabled)
+                pop_front(stream);
+        ++stats.matched;
+        if (callback)
+            callback(user_context, set.data(), count);
+    }
+}
+
+void frame_synchronizer_t::clear() noexcept {
+    unique_lock lck{mtx};
+    for (auto& stream : streams)
+        stream.head = stream.count = 0;
+}
+
+auto frame_synchronizer_t::get_stats() const noexcept -> sync_stats_t {
+    unique_lock lck{mtx};
+    return stats;
+}
@@ -0,0 +1,42 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Checks of the host tests. Each test counts the failures and returns
+//  non-zero from `main` if there is any
+//
+#pragma once
+#ifndef _NDCAM_TEST_CHECK_H_
+#define _NDCAM_TEST_CHECK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+inline uint32_t failures = 0;
+
+inline bool check(bool ok, const char* message) {
+    if (ok == false) {
+        fprintf(stderr, "failed: %s\n", message);
+        failures += 1;
+    }
+    return ok;
+}
+
+// poll the predicate until it's true. false if the time is out
+template <typename Predicate>
+bool wait_for(
+    Predicate&& predicate,
+    std::chrono::milliseconds timeout = std::chrono::seconds{3},
+    std::chrono::microseconds interval = std::chrono::milliseconds{1}) {
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (predicate() == false) {
+        if (std::chrono::steady_clock::now() > until)
+            return false;
+        std::this_thread::sleep_for(interval);
+    }
+    return true;
+}
+
+#endif // _NDCAM_TEST_CHECK_H_
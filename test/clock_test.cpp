@@ -0,0 +1,263 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `clock_model_t` with a simulated sensor clock, and with the capture
+//  callbacks of the host stand-in
+//
+#include <ndk_camera.h>
+#include <ndk_camera_clock.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+/**
+ * The sensor runs 50 ppm slow from 3.2 sec before the domain. Each frame has
+ * 3 callbacks. The earliest is 2 ~ 3 ms late
+ */
+struct sensor_clock_t final {
+    static constexpr int64_t frame_interval = 33'333'333;
+    static constexpr double rate = 1 - 50e-6;
+    static constexpr int64_t least_delay = 2'000'000;
+
+    int64_t domain = 10'000'000'000; // time of the next frame
+    int64_t base = 6'800'000'000;    // sensor timestamp at the domain 0
+    minstd_rand random{7};
+
+  public:
+    int64_t get_sensor(int64_t time) const {
+        return base + static_cast<int64_t>(static_cast<double>(time) * rate);
+    }
+
+    // the domain time of the frame
+    int64_t feed(clock_model_t& model) {
+        const auto time = domain;
+        const auto sensor = get_sensor(time);
+        uniform_int_distribution<int64_t> jitter{0, 1'000'000};
+        model.update(sensor, time + least_delay + jitter(random));
+        model.update(sensor, time + 12'000'000 + jitter(random) * 4);
+        model.update(sensor, time + 25'000'000 + jitter(random) * 8);
+        domain += frame_interval;
+        return time;
+    }
+};
+
+void estimation() {
+    clock_model_config_t config{};
+    config.block = 30; // 10 frames
+    config.points = 32;
+    clock_model_t model{config};
+    sensor_clock_t clock{};
+
+    float confidence = 1;
+    model.map(clock.get_sensor(clock.domain), confidence);
+    check(confidence == 0, "no estimation");
+
+    auto previous = 0.0f;
+    auto increasing = true;
+    for (auto i = 0; i < 10 * 32; ++i) {
+        clock.feed(model);
+        const auto state = model.get_state();
+        increasing = increasing && state.confidence >= previous - 0.1f;
+        previous = state.confidence;
+    }
+    check(increasing, "confidence grows with the points");
+
+    const auto state = model.get_state();
+    printf("offset %lld ns, drift %.2f ppm, residual %lld ns, latency %lld ns,"
+           " confidence %.2f\n",
+           static_cast<long long>(state.offset), state.drift * 1e6,
+           static_cast<long long>(state.residual),
+           static_cast<long long>(state.latency), state.confidence);
+    check(state.points == 32, "points");
+    check(state.confidence > 0.5f, "confidence of the full model");
+    check(abs(state.drift - 50e-6) < 10e-6, "drift");
+    check(state.latency > 5'000'000, "latency of the callbacks");
+
+    // the next frames. the least delay remains
+    for (auto i = 0; i < 30; ++i) {
+        const auto time = clock.domain + i * sensor_clock_t::frame_interval;
+        const auto mapped = model.map(clock.get_sensor(time), confidence);
+        const auto error = mapped - (time + sensor_clock_t::least_delay);
+        if (check(abs(error) < 500'000, "mapped timestamp") == false) {
+            printf("error %lld ns\n", static_cast<long long>(error));
+            break;
+        }
+    }
+    check(confidence == state.confidence, "confidence of the frame");
+}
+
+// a suspend moves the domain, and the new session restarts the sensor
+void jumps() {
+    clock_model_config_t config{};
+    clock_model_t model{config};
+    sensor_clock_t clock{};
+    for (auto i = 0; i < 100; ++i)
+        clock.feed(model);
+    check(model.get_state().resets == 0, "no reset");
+
+    // a block which is late is not a jump
+    const auto sensor = clock.get_sensor(clock.domain);
+    for (auto i = 0; i < 16; ++i)
+        model.update(sensor, clock.domain + 40'000'000);
+    for (auto i = 0; i < 10; ++i)
+        clock.feed(model);
+    check(model.get_state().resets == 0, "a stall");
+
+    clock.domain += 5'000'000'000;
+    clock.base -= 5'000'000'000;
+    for (auto i = 0; i < 10; ++i)
+        clock.feed(model);
+    auto state = model.get_state();
+    check(state.resets == 1, "domain jumped");
+    float confidence = 0;
+    const auto time = clock.domain;
+    auto mapped = model.map(clock.get_sensor(time), confidence);
+    check(abs(mapped - time - sensor_clock_t::least_delay) < 1'000'000,
+          "mapped after the jump");
+
+    clock.base -= 10'000'000'000;
+    clock.feed(model);
+    state = model.get_state();
+    check(state.resets == 2 && state.points == 0, "sensor went back");
+    model.reset();
+    check(model.get_state().observed == 0, "reset");
+}
+
+void realtime_source() {
+    ACameraManager* manager = ACameraManager_create();
+    ACameraIdList* id_list = nullptr;
+    ACameraManager_getCameraIdList(manager, &id_list);
+    ACameraMetadata* metadata = nullptr;
+    ACameraManager_getCameraCharacteristics(manager, id_list->cameraIds[0],
+                                            &metadata);
+
+    clock_model_config_t config{};
+    config.domain = clock_domain_t::boottime;
+    clock_model_t boottime{config};
+    check(boottime.set_source(metadata) == ACAMERA_OK, "set_source");
+    float confidence = 0;
+    check(boottime.map(123'456'789, confidence) == 123'456'789,
+          "REALTIME is CLOCK_BOOTTIME");
+    check(confidence == 1, "exact mapping");
+
+    config.domain = clock_domain_t::monotonic;
+    clock_model_t monotonic{config};
+    monotonic.set_source(metadata);
+    const auto sensor = get_clock_time(clock_domain_t::boottime);
+    const auto expected = get_clock_time(clock_domain_t::monotonic);
+    const auto mapped = monotonic.map(sensor, confidence);
+    check(abs(mapped - expected) < 1'000'000, "CLOCK_BOOTTIME to MONOTONIC");
+
+    ACameraMetadata_free(metadata);
+    ACameraManager_deleteCameraIdList(id_list);
+    ACameraManager_delete(manager);
+}
+
+struct frames_t final {
+    camera_group_t* context;
+    atomic<uint32_t> count{};
+    atomic<int64_t> error{};
+    atomic<float> confidence{};
+};
+
+static void on_image(void* ptr, AImage* image, const frame_info_t& info) {
+    auto& frames = *reinterpret_cast<frames_t*>(ptr);
+    frames.error = info.mapped_timestamp - info.timestamp;
+    frames.confidence = info.confidence;
+    frames.count += 1;
+    release_image(*frames.context, info.id, image);
+}
+
+static void on_capture_started(void* ptr, ACameraCaptureSession* session,
+                               const ACaptureRequest* request,
+                               int64_t timestamp) {
+    auto& context = *reinterpret_cast<camera_group_t*>(ptr);
+    context_on_capture_started(context, session, request,
+                               static_cast<uint64_t>(timestamp));
+}
+static void on_capture_completed(void* ptr, ACameraCaptureSession* session,
+                                 ACaptureRequest* request,
+                                 const ACameraMetadata* result) {
+    auto& context = *reinterpret_cast<camera_group_t*>(ptr);
+    context_on_capture_completed(context, session, request, result);
+}
+
+// the stand-in stamps the frames with CLOCK_MONOTONIC. the source is not set
+void camera_callbacks() {
+    stand_in_config_t stand_in{};
+    stand_in.frame_interval = 5ms;
+    stand_in_configure(stand_in);
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    frames_t frames{&context};
+    context.image_consumer = on_image;
+    context.image_consumer_context = &frames;
+    clock_model_config_t config{};
+    config.block = 4;
+    config.points = 8;
+    clock_model_t model{config};
+    context.clock_set[0] = &model;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    capture_callbacks.context = &context;
+    capture_callbacks.onCaptureStarted = on_capture_started;
+    capture_callbacks.onCaptureCompleted = on_capture_completed;
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&model]() { return model.get_state().points == 8; }),
+          "points of the callbacks");
+    const auto count = frames.count.load();
+    check(wait_for([&frames, count]() { return frames.count > count; }),
+          "images after the estimation");
+    context.close_reader(0);
+    context.close_device(0);
+    context.release();
+    ANativeWindow_release(window);
+
+    const auto state = model.get_state();
+    printf("stand-in: offset %lld ns, latency %lld ns, image %lld ns\n",
+           static_cast<long long>(state.offset),
+           static_cast<long long>(state.latency),
+           static_cast<long long>(frames.error.load()));
+    check(state.observed >= 32, "started and completed");
+    check(frames.confidence > 0, "confidence of the image");
+    // the same clock. only the delay of the callbacks
+    check(frames.error > -1'000'000 && frames.error < 50'000'000,
+          "image timestamp");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    estimation();
+    jumps();
+    realtime_source();
+    camera_callbacks();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Layout, order and drop count of `event_channel_t`, and the detach of the
+//  channel while the callbacks are pushing to it
+//
+#include <ndk_camera.h>
+#include <ndk_camera_event.h>
+#include <ndk_camera_log.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static capture_event_t make_event(uint16_t id, int64_t frame_number) {
+    capture_event_t event{};
+    event.type = static_cast<uint16_t>(capture_event_type_t::completed);
+    event.id = id;
+    event.frame_number = frame_number;
+    return event;
+}
+
+static uint32_t read_u32(const uint8_t* ptr) {
+    uint32_t value = 0;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+void layout() {
+    event_channel_t channel{20};
+    check(channel.get_capacity() == 32, "capacity is power of 2");
+    check(channel.size() ==
+              event_channel_t::header_size + 32 * sizeof(capture_event_t),
+          "size of the buffer");
+    check(event_channel_t{1}.get_capacity() == 16, "minimum capacity");
+    check(event_channel_t{100'000}.get_capacity() == 65536,
+          "maximum capacity");
+
+    channel.push(make_event(3, 7));
+    const auto* data = channel.data();
+    check(read_u32(data) == 1, "head");
+    check(read_u32(data + 4) == 32, "capacity");
+    check(read_u32(data + 64) == 0, "tail");
+
+    capture_event_t event{};
+    memcpy(&event, data + event_channel_t::header_size, sizeof(event));
+    check(event.id == 3 && event.frame_number == 7, "first record");
+    channel.poll(1);
+    check(read_u32(data + 64) == 1, "tail after the poll");
+}
+
+void order_and_drop() {
+    event_channel_t channel{16};
+    uint32_t pushed = 0;
+    for (auto i = 0; i < 20; ++i)
+        pushed += channel.push(make_event(0, i));
+    check(pushed == 16, "full ring rejects the push");
+    check(channel.get_dropped() == 4, "dropped count");
+    check(channel.poll(0) == 16, "readable records");
+    check(channel.poll(100) == 0, "release is limited to the written ones");
+
+    // the records wrap around the end
+    int64_t next = 0;
+    array<capture_event_t, 10> events{};
+    auto ordered = true;
+    for (auto round = 0; round < 5; ++round) {
+        for (auto i = 0; i < 10; ++i)
+            channel.push(make_event(0, next + i));
+        const auto count = channel.drain(events);
+        check(count == 10, "drain count");
+        for (auto i = 0u; i < count; ++i)
+            ordered &= events[i].frame_number == next + i;
+        next += count;
+    }
+    check(ordered, "records are drained in order");
+    check(channel.poll(0) == 0, "nothing left");
+    check(channel.get_dropped() == 4, "no more drop");
+}
+
+// the producers are the camera callbacks of the devices
+void concurrent_producers() {
+    constexpr uint16_t producer_count = 4;
+    constexpr int64_t event_count = 20'000;
+    event_channel_t channel{256};
+
+    vector<thread> producers{};
+    for (uint16_t id = 0; id < producer_count; ++id)
+        producers.emplace_back([&channel, id]() {
+            for (auto i = 0; i < event_count; ++i)
+                channel.push(make_event(id, i));
+        });
+
+    array<int64_t, producer_count> last{-1, -1, -1, -1};
+    uint64_t received = 0;
+    auto ordered = true;
+    array<capture_event_t, 64> events{};
+    const auto drain = [&]() {
+        const auto count = channel.drain(events);
+        for (auto i = 0u; i < count; ++i) {
+            auto& previous = last[events[i].id];
+            ordered &= events[i].frame_number > previous;
+            previous = events[i].frame_number;
+        }
+        received += count;
+        return count;
+    };
+    atomic<bool> done{};
+    thread consumer{[&]() {
+        while (done == false)
+            drain();
+    }};
+    for (auto& producer : producers)
+        producer.join();
+    done = true;
+    consumer.join();
+    while (drain())
+        continue;
+
+    check(ordered, "order of each producer");
+    check(received + channel.get_dropped() == producer_count * event_count,
+          "every event is received or dropped");
+}
+
+// like `EventChannel.destroy` while the devices are streaming
+void detach_while_pushing() {
+    camera_group_t context{};
+    atomic<bool> done{};
+    vector<thread> callbacks{};
+    for (uint16_t id = 0; id < 3; ++id)
+        callbacks.emplace_back([&context, &done, id]() {
+            for (auto i = 0; done == false; ++i)
+                push_capture_event(context, make_event(id, i));
+        });
+
+    uint32_t received = 0;
+    for (auto i = 0; i < 200; ++i) {
+        auto channel = make_unique<event_channel_t>(64);
+        context.event_channel = channel.get();
+        this_thread::sleep_for(50us);
+        // replaced, but the pushers might still hold it
+        event_channel_t other{16};
+        if (i % 2)
+            context.event_channel = &other;
+        detach_event_channel(context, channel.get());
+        received += channel->poll(0);
+        channel.reset();
+        detach_event_channel(context, &other);
+    }
+    done = true;
+    for (auto& callback : callbacks)
+        callback.join();
+    check(context.event_channel == nullptr, "detached");
+    check(context.event_pushers[0] == 0 && context.event_pushers[1] == 0,
+          "no pusher");
+    check(received > 0, "the channels received the events");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    layout();
+    order_and_drop();
+    concurrent_producers();
+    detach_while_pushing();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
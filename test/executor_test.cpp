@@ -0,0 +1,419 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  CPU topology from a sysfs tree, placement of `camera_executor_t` lanes and
+//  the image dispatch with the host stand-in
+//
+#include <ndk_camera.h>
+#include <ndk_camera_executor.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static void write_file(const string& path, const char* text) {
+    if (auto* stream = fopen(path.c_str(), "w")) {
+        fputs(text, stream);
+        fclose(stream);
+    }
+}
+
+// cpu0-3: little, cpu4-6: big, cpu7: prime without cpufreq
+static string make_sysfs(const char* present, uint32_t little_freq) {
+    char root[] = "/tmp/ndcam_sysfs_XXXXXX";
+    if (mkdtemp(root) == nullptr)
+        return {};
+    write_file(string{root} + "/present", present);
+    for (auto cpu = 0u; cpu < 7; ++cpu) {
+        const auto dir = string{root} + "/cpu" + to_string(cpu);
+        mkdir(dir.c_str(), 0755);
+        mkdir((dir + "/cpufreq").c_str(), 0755);
+        const auto freq = cpu < 4 ? little_freq : 2'400'000u;
+        write_file(dir + "/cpufreq/cpuinfo_max_freq",
+                   (to_string(freq) + "\n").c_str());
+    }
+    return root;
+}
+
+static void remove_sysfs(const string& root) {
+    for (auto cpu = 0u; cpu < 7; ++cpu) {
+        const auto dir = root + "/cpu" + to_string(cpu);
+        remove((dir + "/cpufreq/cpuinfo_max_freq").c_str());
+        remove((dir + "/cpufreq").c_str());
+        remove(dir.c_str());
+    }
+    remove((root + "/present").c_str());
+    remove(root.c_str());
+}
+
+void topology_from_sysfs() {
+    cpu_topology_t topology{};
+    const auto root = make_sysfs("0-7\n", 1'800'000);
+    check(read_cpu_topology(root.c_str(), topology), "read topology");
+    check(topology.cpus.size() == 8, "present cpus");
+    check(topology.get_mask(core_class_t::little) == 0x0f, "little cpus");
+    check(topology.get_mask(core_class_t::big) == 0xf0, "big cpus");
+    check(topology.cpus[7].max_freq == 0, "unknown frequency");
+
+    const auto same = make_sysfs("0-3,5\n", 2'400'000);
+    check(read_cpu_topology(same.c_str(), topology), "read topology");
+    check(topology.cpus.size() == 5, "cpu list with the comma");
+    check(topology.get_mask(core_class_t::little) == 0x2f,
+          "no little. all cpus");
+
+    check(read_cpu_topology("/no/such/directory", topology) == false,
+          "no topology");
+    remove_sysfs(root);
+    remove_sysfs(same);
+}
+
+// the first CPU this process can use
+static uint32_t get_allowed_cpu() {
+    cpu_set_t set{};
+    sched_getaffinity(0, sizeof(set), &set);
+    for (auto cpu = 0u; cpu < 64; ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            return cpu;
+    return 0;
+}
+
+static string get_thread_name() {
+    char name[16]{};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    return name;
+}
+
+void lane_placement() {
+    const auto cpu = get_allowed_cpu();
+    executor_config_t config{};
+    config.lanes[0] = {"test", 1, core_class_t::any, uint64_t{1} << cpu, 5};
+    config.lanes[1] = {"pool", 3, core_class_t::any, 0, 0};
+    config.lanes[2] = {"inline", 0, core_class_t::any, 0, 0};
+    camera_executor_t executor{config};
+    check(executor.get_mask(executor_lane_t::dispatch) == uint64_t{1} << cpu,
+          "lane mask");
+
+    // 1 thread. in order on the CPU
+    vector<uint32_t> order{}, cpus{};
+    string name{};
+    int nice = 0;
+    for (auto i = 0u; i < 100; ++i)
+        executor.submit(executor_lane_t::dispatch, [&, i]() {
+            order.emplace_back(i);
+            cpus.emplace_back(static_cast<uint32_t>(sched_getcpu()));
+            if (i == 0) {
+                name = get_thread_name();
+                nice = getpriority(PRIO_PROCESS,
+                                   static_cast<id_t>(syscall(SYS_gettid)));
+            }
+        });
+    executor.drain(executor_lane_t::dispatch);
+    auto ok = order.size() == 100;
+    for (auto i = 0u; i < order.size(); ++i)
+        ok &= order[i] == i && cpus[i] == cpu;
+    check(ok, "tasks are in order on the pinned cpu");
+    check(name == "test:0", "thread name");
+    check(nice == 5, "nice of the thread");
+
+    auto stats = executor.get_stats(executor_lane_t::dispatch);
+    check(stats.tasks == 100 && stats.queued == 0, "task count");
+    check(stats.migrations == 0, "no migration with 1 cpu");
+    check(stats.queue_delay_max >= stats.queue_delay_avg &&
+              stats.queue_delay_avg > 0,
+          "queue delay");
+
+    // the pool with the concurrent submitters
+    atomic<uint32_t> count{};
+    vector<thread> submitters{};
+    for (auto t = 0; t < 4; ++t)
+        submitters.emplace_back([&executor, &count]() {
+            for (auto i = 0; i < 250; ++i)
+                executor.submit(executor_lane_t::convert,
+                                [&count]() { count += 1; });
+        });
+    for (auto& submitter : submitters)
+        submitter.join();
+    executor.drain(executor_lane_t::convert);
+    check(count == 1000, "pool tasks");
+    stats = executor.get_stats(executor_lane_t::convert);
+    check(stats.tasks == 1000 && stats.queued == 0, "pool task count");
+
+    // no thread. in the caller
+    auto caller = false;
+    const auto self = this_thread::get_id();
+    check(executor.submit(executor_lane_t::io,
+                          [&]() { caller = this_thread::get_id() == self; }),
+          "inline submit");
+    check(caller, "inline lane runs in the caller");
+}
+
+void finish_before_exit() {
+    atomic<uint32_t> count{};
+    {
+        executor_config_t config{};
+        config.lanes[1].nice = config.lanes[0].nice = 0;
+        camera_executor_t executor{config};
+        for (auto i = 0; i < 50; ++i)
+            executor.submit(executor_lane_t::convert, [&count]() {
+                this_thread::sleep_for(100us);
+                count += 1;
+            });
+    }
+    check(count == 50, "queued tasks are finished");
+}
+
+// without the executor, the threads are created once and reused
+void parallel_for_shared() {
+    vector<atomic<uint32_t>> visits(64);
+    mutex mtx{};
+    set<long> tids{}; // the new threads have the new ids
+    const auto task = [&](uint32_t i) {
+        visits[i] += 1;
+        unique_lock lck{mtx};
+        tids.emplace(syscall(SYS_gettid));
+    };
+    for (auto i = 0; i < 101; ++i)
+        parallel_for(nullptr, 64, task);
+    check(tids.size() <= max(thread::hardware_concurrency(), 2u),
+          "no new thread for each call");
+
+    auto once = true;
+    for (auto& count : visits)
+        once &= count == 101;
+    check(once, "each index is called once in a call");
+
+    // the tasks of the shared threads can use it too
+    atomic<uint32_t> inner{};
+    parallel_for(nullptr, 8, [&inner](uint32_t) {
+        parallel_for(nullptr, 8, [&inner](uint32_t) { inner += 1; });
+    });
+    check(inner == 64, "nested calls");
+}
+
+struct probe_t final {
+    camera_group_t* context;
+    atomic<uint32_t> images{};
+    atomic<uint32_t> outside{}; // not in the dispatch lane
+};
+
+static void on_image(void* ptr, AImage* image, const frame_info_t& info) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    if (get_thread_name() != "disp:0")
+        probe.outside += 1;
+    probe.images += 1;
+    release_image(*probe.context, info.id, image);
+}
+
+void dispatch_images() {
+    executor_config_t config{};
+    config.lanes[0] = {"disp", 1, core_class_t::big, 0, 0};
+    camera_executor_t executor{config};
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    probe_t probe{&context};
+    context.executor = &executor;
+    context.image_consumer = on_image;
+    context.image_consumer_context = &probe;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&probe]() { return probe.images >= 10; }), "images");
+    context.close_reader(0);
+    context.close_device(0);
+    context.release();
+    ANativeWindow_release(window);
+
+    check(probe.outside == 0, "consumer in the dispatch lane");
+    check(executor.get_stats(executor_lane_t::dispatch).tasks ==
+              probe.images,
+          "image tasks");
+    check(stand_in_get_live_count(stand_in_object_t::image) == 0,
+          "images are freed");
+}
+
+struct closer_t final {
+    camera_group_t* context;
+    atomic<uint32_t> images{};
+    atomic<uint32_t> refused{};
+};
+
+// the consumer closes the reader, and then uses the device while the app
+// closes it too
+static void on_image_close(void* ptr, AImage* image,
+                           const frame_info_t& info) {
+    auto& closer = *reinterpret_cast<closer_t*>(ptr);
+    if (closer.images++ == 0) {
+        closer.context->close_reader(info.id);
+        if (closer.context->reader_set[info.id] != nullptr)
+            closer.refused += 1;
+    }
+    {
+        // like the operations of the device
+        unique_lock lck{closer.context->operation_mtx_set[info.id]};
+        this_thread::sleep_for(1ms);
+    }
+    release_image(*closer.context, info.id, image);
+}
+
+void close_reader_in_dispatch_lane() {
+    executor_config_t config{};
+    config.lanes[0] = {"disp", 1, core_class_t::big, 0, 0};
+    camera_executor_t executor{config};
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    closer_t closer{&context};
+    context.executor = &executor;
+    context.image_consumer = on_image_close;
+    context.image_consumer_context = &closer;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(1, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(1, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(1, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&closer]() { return closer.images >= 5; }), "images");
+    check(closer.refused == 1, "close_reader is refused in the lane");
+
+    // returns while the queued tasks take the lock of the device
+    context.close_reader(1);
+    check(context.reader_set[1] == nullptr, "reader is closed");
+    const auto images = closer.images.load();
+    this_thread::sleep_for(20ms);
+    check(closer.images == images, "no task after the close");
+    context.close_device(1);
+    context.release();
+    ANativeWindow_release(window);
+
+    check(executor.get_stats(executor_lane_t::dispatch).queued == 0,
+          "no queued task");
+    check(stand_in_get_live_count(stand_in_object_t::image) == 0,
+          "images are freed");
+}
+
+struct replacer_t final {
+    camera_group_t* context;
+    atomic<uint32_t> images{};
+    atomic<bool> replacing{};
+    atomic<uint32_t> operations{};
+};
+
+// the consumer uses the device while `open_reader` replaces the reader
+static void on_image_replace(void* ptr, AImage* image,
+                             const frame_info_t& info) {
+    auto& replacer = *reinterpret_cast<replacer_t*>(ptr);
+    replacer.images += 1;
+    this_thread::sleep_for(2ms);
+    if (replacer.replacing) {
+        replacer.context->stop_capture(info.id);
+        replacer.operations += 1;
+    }
+    release_image(*replacer.context, info.id, image);
+}
+
+void open_reader_while_dispatch() {
+    executor_config_t config{};
+    config.lanes[0] = {"disp", 1, core_class_t::big, 0, 0};
+    camera_executor_t executor{config};
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    replacer_t replacer{&context};
+    context.executor = &executor;
+    context.image_consumer = on_image_replace;
+    context.image_consumer_context = &replacer;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&replacer]() { return replacer.images >= 5; }),
+          "images");
+
+    // the drain must not hold the lock of the device
+    replacer.replacing = true;
+    atomic<bool> done{};
+    thread app{[&context, &done]() {
+        context.open_reader(0, 160, 120, AIMAGE_FORMAT_YUV_420_888, 4);
+        done = true;
+    }};
+    if (check(wait_for([&done]() { return done.load(); }),
+              "open_reader returns while the task uses the device") == false) {
+        printf("failures: %u\n", failures);
+        fflush(stdout);
+        _Exit(EXIT_FAILURE); // the app thread can't be joined
+    }
+    app.join();
+    check(replacer.operations > 0, "operation in the dispatch lane");
+    check(context.reader_set[0] != nullptr, "reader is replaced");
+    context.close_device(0);
+    context.release();
+    ANativeWindow_release(window);
+
+    check(stand_in_get_live_count(stand_in_object_t::image) == 0,
+          "images are freed");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    topology_from_sysfs();
+    lane_placement();
+    finish_before_exit();
+    parallel_for_shared();
+    dispatch_images();
+    close_reader_in_dispatch_lane();
+    open_reader_while_dispatch();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `fanout_hub_t` with the synthetic frames, and with the images of the
+//  host stand-in
+//
+#include <ndk_camera.h>
+#include <ndk_camera_fanout.h>
+#include <ndk_camera_log.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static constexpr int64_t fps30 = 33'333'333;
+
+// frames without the image. `release_image` ignores nullptr
+void rates_and_references() {
+    camera_group_t context{};
+    fanout_hub_t hub{context};
+    fanout_subscriber_config_t config{};
+    config.name = "tracker";
+    const auto tracker = hub.subscribe(config);
+    config.name = "classifier";
+    config.decimation = 6;
+    const auto classifier = hub.subscribe(config);
+    config.name = "uploader";
+    config.decimation = 1;
+    config.min_interval = 100'000'000;
+    config.depth = 4;
+    const auto uploader = hub.subscribe(config);
+    config = {};
+    config.name = "front";
+    config.camera_mask = 1 << 1;
+    const auto front = hub.subscribe(config);
+
+    // the tracker takes every frame. the others don't acquire
+    auto delivered = 0u;
+    for (auto i = 0; i < 60; ++i) {
+        const frame_info_t info{0, 1'000'000'000 + i * fps30, true, 0, 0};
+        hub.push(nullptr, info);
+        if (auto* frame = hub.acquire(tracker, 0ms)) {
+            delivered += frame->info.timestamp == info.timestamp;
+            hub.release(tracker, frame);
+        }
+    }
+    check(delivered == 60, "tracker has all");
+    auto stats = hub.get_stats(tracker);
+    check(stats.delivered == 60 && stats.dropped == 0 && stats.holding == 0,
+          "tracker stats");
+    check(stats.lag_max >= stats.lag_avg, "lag");
+
+    stats = hub.get_stats(classifier);
+    check(stats.offered == 60 && stats.decimated == 50, "1 of 6");
+    check(stats.pending == 1 && stats.dropped == 9, "latest only");
+
+    // 10 fps of 30 fps. the frames of 99.999999 ms are on the schedule
+    stats = hub.get_stats(uploader);
+    check(stats.decimated == 40, "1 of 3 by the interval");
+    check(stats.pending == 4 && stats.dropped == 16, "queue of 4");
+    check(hub.get_stats(front).offered == 0, "other camera");
+
+    // frame 48, 51, 54, 57 are shared by the classifier and the uploader
+    check(hub.get_held() == 4, "frames are shared");
+    auto* frame = hub.acquire(classifier, 0ms);
+    check(frame && frame->info.timestamp == 1'000'000'000 + 54 * fps30,
+          "the latest for the classifier");
+    hub.unsubscribe(uploader);
+    check(hub.get_held() == 1, "the acquired one is still held");
+    hub.release(classifier, frame);
+    check(hub.get_held() == 0, "the last release");
+
+    // the waiting subscriber wakes up
+    thread waiter{[&hub, tracker]() {
+        check(hub.acquire(tracker, 5s) == nullptr, "closed");
+    }};
+    this_thread::sleep_for(10ms);
+    const auto begin = steady_clock::now();
+    hub.close();
+    waiter.join();
+    check(steady_clock::now() - begin < 1s, "close wakes the waiter");
+}
+
+struct reader_t final {
+    fanout_hub_t* hub;
+    uint32_t subscriber;
+    atomic<bool> stop{};
+    atomic<uint32_t> frames{};
+};
+
+static void read_frames(reader_t* reader) {
+    while (reader->stop == false)
+        if (auto* frame = reader->hub->acquire(reader->subscriber, 10ms)) {
+            reader->frames += 1;
+            reader->hub->release(reader->subscriber, frame);
+        }
+}
+
+// a subscriber holds 1 image. the others still get the images of 4 buffers
+void camera_images() {
+    stand_in_config_t stand_in{};
+    stand_in.frame_interval = 5ms;
+    stand_in_configure(stand_in);
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    fanout_hub_t hub{context};
+    context.image_consumer = fanout_hub_t::consume;
+    context.image_consumer_context = &hub;
+
+    fanout_subscriber_config_t config{};
+    config.name = "holder";
+    const auto holder = hub.subscribe(config);
+    config.name = "tracker";
+    reader_t tracker{&hub, hub.subscribe(config)};
+    config.name = "classifier";
+    config.decimation = 5;
+    reader_t classifier{&hub, hub.subscribe(config)};
+    thread tracker_thread{read_frames, &tracker};
+    thread classifier_thread{read_frames, &classifier};
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    auto* held = hub.acquire(holder, 3s);
+    check(held != nullptr, "holder");
+    check(wait_for([&tracker]() { return tracker.frames >= 50; }),
+          "images while 1 is held");
+    check(wait_for([&classifier]() { return classifier.frames >= 5; }),
+          "decimated images");
+    hub.release(holder, held);
+    hub.unsubscribe(holder);
+
+    context.close_reader(0);
+    context.close_device(0);
+    tracker.stop = classifier.stop = true;
+    tracker_thread.join();
+    classifier_thread.join();
+    const auto stats = hub.get_stats(classifier.subscriber);
+    printf("classifier: offered %llu, delivered %llu, lag avg %lld ns\n",
+           static_cast<unsigned long long>(stats.offered),
+           static_cast<unsigned long long>(stats.delivered),
+           static_cast<long long>(stats.lag_avg));
+    check(stats.delivered + stats.dropped + stats.pending ==
+              stats.offered - stats.decimated,
+          "classifier accounting");
+    hub.close();
+    context.release();
+    ANativeWindow_release(window);
+
+    check(hub.get_held() == 0, "hub holds nothing");
+    check(stand_in_get_live_count(stand_in_object_t::image) == 0,
+          "images are freed");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    rates_and_references();
+    camera_images();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,432 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Crop/subsample of `frame_view_t` and the kernels with the strided views.
+//  The results must be same with the packed copies of the views.
+//  Rotation and mirroring of the conversion and the resize with the odd sizes
+//
+#include <ndk_camera_convert.h>
+#include <ndk_camera_frame.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_motion.h>
+#include <ndk_camera_stats.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// NV21 with the padding of the rows
+struct nv21_t final {
+    static constexpr uint32_t width = 64, height = 48, row_stride = 80;
+    vector<uint8_t> y = vector<uint8_t>(row_stride * height);
+    vector<uint8_t> vu = vector<uint8_t>(row_stride * height / 2);
+
+    static uint8_t luma(uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(x * 3 + y * 5 + (x * y) % 7);
+    }
+    static uint8_t u(uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(x + 2 * y + 64);
+    }
+    static uint8_t v(uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(3 * x + y + 128);
+    }
+
+    nv21_t() {
+        for (auto j = 0u; j < height; ++j)
+            for (auto i = 0u; i < width; ++i)
+                y[j * row_stride + i] = luma(i, j);
+        for (auto j = 0u; j < height / 2; ++j)
+            for (auto i = 0u; i < width / 2; ++i) {
+                vu[j * row_stride + 2 * i] = v(i, j);
+                vu[j * row_stride + 2 * i + 1] = u(i, j);
+            }
+    }
+
+    auto view() const -> frame_view_t {
+        frame_view_t frame{};
+        frame.format = AIMAGE_FORMAT_YUV_420_888;
+        frame.width = width;
+        frame.height = height;
+        frame.plane_count = 3;
+        frame.planes[0] = make_plane_view(y.data(), row_stride, width, height);
+        frame.planes[1] = make_plane_view(vu.data() + 1, row_stride,
+                                          width / 2, height / 2, 2);
+        frame.planes[2] = make_plane_view(vu.data(), row_stride, width / 2,
+                                          height / 2, 2);
+        return frame;
+    }
+};
+
+// planar(I420) copy of the view
+struct packed_t final {
+    vector<uint8_t> y{}, u{}, v{};
+    yuv_planes_t planes{};
+
+    explicit packed_t(const frame_view_t& frame) {
+        auto copy = [](const plane_view_t& plane, vector<uint8_t>& output) {
+            output.clear();
+            for (auto j = 0u; j < plane.height; ++j)
+                for (auto i = 0u; i < plane.width; ++i)
+                    output.emplace_back(plane.at(i, j));
+        };
+        copy(frame.planes[0], y);
+        copy(frame.planes[1], u);
+        copy(frame.planes[2], v);
+        planes = yuv_planes_t{y.data(),
+                              u.data(),
+                              v.data(),
+                              frame.planes[0].width,
+                              frame.planes[1].width,
+                              1,
+                              frame.width,
+                              frame.height};
+    }
+};
+
+void crop_keeps_chroma(const nv21_t& image) {
+    const auto frame = image.view();
+    const auto crop = frame.crop(image_roi_t{11, 7, 20, 10});
+    // the origin is aligned to (10, 6)
+    check(crop.width == 21 && crop.height == 11, "crop size");
+    check(crop.planes[0].data.data() == image.y.data() + 6 * 80 + 10,
+          "crop is not a copy");
+    check(crop.planes[0].at(0, 0) == nv21_t::luma(10, 6), "crop luma");
+    check(crop.planes[1].at(0, 0) == nv21_t::u(5, 3), "crop u");
+    check(crop.planes[2].at(1, 1) == nv21_t::v(6, 4), "crop v");
+    check(crop.planes[1].width == 11 && crop.planes[1].height == 6,
+          "crop chroma size");
+
+    const auto whole = frame.crop(image_roi_t{});
+    check(whole.width == frame.width && whole.height == frame.height,
+          "empty region is the whole frame");
+    const auto clamped = frame.crop(image_roi_t{60, 40, 100, 100});
+    check(clamped.width == 4 && clamped.height == 8, "crop is clamped");
+}
+
+void subsample_follows_luma(const nv21_t& image) {
+    const auto frame = image.view();
+    const auto sub = frame.subsample(4);
+    check(sub.width == 16 && sub.height == 12, "subsample size");
+    auto ok = true;
+    for (auto j = 0u; j < sub.height; ++j)
+        for (auto i = 0u; i < sub.width; ++i) {
+            ok &= sub.planes[0].at(i, j) == nv21_t::luma(4 * i, 4 * j);
+            // chroma of the top-left in the 2x2 block
+            const auto cx = 4 * (i / 2), cy = 4 * (j / 2);
+            ok &= sub.planes[1].at(i / 2, j / 2) == nv21_t::u(cx, cy);
+            ok &= sub.planes[2].at(i / 2, j / 2) == nv21_t::v(cx, cy);
+        }
+    check(ok, "subsample samples");
+
+    const auto odd = frame.subsample(3);
+    check(odd.width == 21 && odd.height == 16, "odd step size");
+    check(odd.planes[1].width == 11 && odd.planes[1].height == 8,
+          "odd step chroma size");
+    check(odd.planes[2].at(10, 7) == nv21_t::v(30, 21), "odd step chroma");
+
+    const auto roi = frame.crop(image_roi_t{8, 4, 32, 24}).subsample(2);
+    check(roi.width == 16 && roi.height == 12, "crop and subsample size");
+    check(roi.planes[0].at(3, 2) == nv21_t::luma(8 + 6, 4 + 4),
+          "crop and subsample luma");
+    check(roi.planes[1].at(3, 2) == nv21_t::u(4 + 6, 2 + 4),
+          "crop and subsample chroma");
+}
+
+void iterate_rows(const nv21_t& image) {
+    const auto plane = image.view().planes[1].crop(image_roi_t{2, 3, 5, 4});
+    uint32_t rows = 0;
+    auto ok = true;
+    for (auto row : plane) {
+        ok &= row.size() == 9; // (5 - 1) * 2 + 1
+        ok &= row[0] == plane.at(0, rows);
+        ok &= row[8] == plane.at(4, rows);
+        ++rows;
+    }
+    check(rows == plane.height, "row count");
+    check(ok, "row spans");
+}
+
+void kernels_with_views(const nv21_t& image) {
+    const auto frame = image.view().crop(image_roi_t{6, 2, 48, 40});
+    for (auto step : {1u, 2u, 3u}) {
+        const auto view = frame.subsample(step);
+        const packed_t copy{view};
+        const auto& y = view.planes[0];
+
+        stats_config_t config{};
+        config.step = 2;
+        config.roi = image_roi_t{1, 1, y.width - 2, y.height - 2};
+        vector<uint8_t> scratch(get_stats_scratch_size(config, y));
+        frame_stats_t expected{}, actual{};
+        vector<uint8_t> copy_scratch(
+            get_stats_scratch_size(config, copy.planes.width));
+        compute_frame_stats(copy.y.data(), y.width, y.width, y.height, config,
+                            copy_scratch, expected);
+        compute_frame_stats(y, config, scratch, actual);
+        check(expected.count == actual.count &&
+                  expected.histogram == actual.histogram &&
+                  expected.mean == actual.mean &&
+                  expected.sharpness == actual.sharpness,
+              "stats of the view");
+
+        // the chroma plane isn't packed
+        const auto& u = view.planes[1];
+        vector<uint8_t> lhs(u.width / 2 * (u.height / 2)), rhs(lhs.size());
+        subsample_plane(u, 2, lhs.data());
+        subsample_plane(copy.u.data(), u.width, u.width, u.height, 2,
+                        rhs.data());
+        check(lhs == rhs, "subsample of the view");
+
+        for (uint16_t rotation : {0, 90}) {
+            const frame_orientation_t orientation{rotation, false};
+            uint32_t width = 0, height = 0;
+            get_oriented_size(view.width, view.height, orientation, width,
+                              height);
+            vector<uint8_t> expected_rgba(width * height * 4),
+                actual_rgba(expected_rgba.size());
+            convert_yuv_to_rgba(copy.planes, expected_rgba.data(), width * 4,
+                                orientation);
+            convert_yuv_to_rgba(view, actual_rgba.data(), width * 4,
+                                orientation);
+            check(expected_rgba == actual_rgba, "conversion of the view");
+        }
+    }
+}
+
+// odd sized YUV_420_888 in NV21 or I420 layout. the rows are padded
+struct yuv_image_t final {
+    uint32_t width, height, row_stride;
+    uint32_t uv_width, uv_height, uv_row_stride, uv_pixel_stride;
+    vector<uint8_t> y{}, uv{};
+    const uint8_t* u = nullptr;
+    const uint8_t* v = nullptr;
+
+  public:
+    yuv_image_t(uint32_t _width, uint32_t _height, bool nv21)
+        : width{_width}, height{_height}, row_stride{_width + 3},
+          uv_width{(_width + 1) / 2}, uv_height{(_height + 1) / 2},
+          uv_row_stride{}, uv_pixel_stride{nv21 ? 2u : 1u} {
+        uv_row_stride = uv_width * uv_pixel_stride + 3;
+        y.resize(row_stride * height);
+        uv.resize(uv_row_stride * uv_height * (nv21 ? 1 : 2));
+        auto seed = width * 31 + height * 7 + uv_pixel_stride;
+        for (auto* values : {&y, &uv})
+            for (auto& value : *values) {
+                seed = seed * 1664525 + 1013904223;
+                value = static_cast<uint8_t>(seed >> 24);
+            }
+        v = nv21 ? uv.data() : uv.data() + uv_row_stride * uv_height;
+        u = nv21 ? uv.data() + 1 : uv.data();
+    }
+
+    auto planes() const -> yuv_planes_t {
+        return yuv_planes_t{y.data(),      u,     v,     row_stride,
+                            uv_row_stride, uv_pixel_stride, width, height};
+    }
+    auto view() const -> frame_view_t {
+        frame_view_t frame{};
+        frame.format = AIMAGE_FORMAT_YUV_420_888;
+        frame.width = width;
+        frame.height = height;
+        frame.plane_count = 3;
+        frame.planes[0] = make_plane_view(y.data(), row_stride, width, height);
+        frame.planes[1] = make_plane_view(u, uv_row_stride, uv_width,
+                                          uv_height, uv_pixel_stride);
+        frame.planes[2] = make_plane_view(v, uv_row_stride, uv_width,
+                                          uv_height, uv_pixel_stride);
+        return frame;
+    }
+};
+
+// BT.601 full range in 6 bit fixed point. R, G, B, A in memory
+static uint32_t reference_rgba(const frame_view_t& frame, uint32_t x,
+                               uint32_t y) {
+    const int32_t luma = frame.planes[0].at(x, y);
+    const int32_t u = frame.planes[1].at(x / 2, y / 2) - 128;
+    const int32_t v = frame.planes[2].at(x / 2, y / 2) - 128;
+    const auto clamp = [](int32_t value) -> uint32_t {
+        return static_cast<uint32_t>(min(max(value, 0), 255));
+    };
+    return clamp(luma + 90 * v / 64 - (90 * v % 64 < 0)) |
+           clamp(luma - (22 * u + 46 * v) / 64 +
+                 ((22 * u + 46 * v) % 64 < 0)) << 8 |
+           clamp(luma + 113 * u / 64 - (113 * u % 64 < 0)) << 16 |
+           0xFF000000u;
+}
+
+/**
+ * Rotate the source clockwise, mirror it, and then resize it with the
+ * nearest pixel. 1 pixel at a time. The padding of the rows is kept
+ */
+template <typename T, typename Sample>
+static auto reference_oriented(uint32_t width, uint32_t height,
+                               frame_orientation_t orientation,
+                               uint32_t dst_width, uint32_t dst_height,
+                               uint32_t dst_row_stride, Sample&& sample)
+    -> vector<uint8_t> {
+    const auto rotation = orientation.rotation;
+    const bool swapped = rotation == 90 || rotation == 270;
+    const uint64_t oriented_width = swapped ? height : width;
+    const uint64_t oriented_height = swapped ? width : height;
+
+    vector<uint8_t> dst(dst_row_stride * dst_height, 0xCD);
+    for (auto dy = 0u; dy < dst_height; ++dy)
+        for (auto dx = 0u; dx < dst_width; ++dx) {
+            auto ox = static_cast<uint32_t>((2 * dx + 1) * oriented_width /
+                                            (2 * dst_width));
+            const auto oy = static_cast<uint32_t>(
+                (2 * dy + 1) * oriented_height / (2 * dst_height));
+            if (orientation.mirror)
+                ox = static_cast<uint32_t>(oriented_width) - 1 - ox;
+            uint32_t x = ox, y = oy;
+            if (rotation == 90) // (x, y) -> (height - 1 - y, x)
+                x = oy, y = height - 1 - ox;
+            if (rotation == 180)
+                x = width - 1 - ox, y = height - 1 - oy;
+            if (rotation == 270) // (x, y) -> (y, width - 1 - x)
+                x = width - 1 - oy, y = ox;
+            const T value = sample(x, y);
+            memcpy(dst.data() + dy * dst_row_stride + dx * sizeof(T), &value,
+                   sizeof(T));
+        }
+    return dst;
+}
+
+// `planes` is for the packed frame
+static bool convert_as_reference(const frame_view_t& frame,
+                                 const yuv_planes_t* planes,
+                                 frame_orientation_t orientation) {
+    uint32_t width = 0, height = 0;
+    get_oriented_size(frame.width, frame.height, orientation, width, height);
+    const auto stride = (width + 3) * 4;
+    const auto expected = reference_oriented<uint32_t>(
+        frame.width, frame.height, orientation, width, height, stride,
+        [&frame](uint32_t x, uint32_t y) {
+            return reference_rgba(frame, x, y);
+        });
+    vector<uint8_t> actual(expected.size(), 0xCD);
+    convert_yuv_to_rgba(frame, actual.data(), stride, orientation);
+    auto ok = actual == expected;
+    if (planes) {
+        fill(actual.begin(), actual.end(), 0xCD);
+        convert_yuv_to_rgba(*planes, actual.data(), stride, orientation);
+        ok &= actual == expected;
+    }
+    return ok;
+}
+
+static bool resize_as_reference(const frame_view_t& frame,
+                                const yuv_planes_t* planes,
+                                frame_orientation_t orientation,
+                                uint32_t width, uint32_t height) {
+    const auto stride = (width + 3) * 4;
+    const auto expected = reference_oriented<uint32_t>(
+        frame.width, frame.height, orientation, width, height, stride,
+        [&frame](uint32_t x, uint32_t y) {
+            return reference_rgba(frame, x, y);
+        });
+    vector<uint8_t> actual(expected.size(), 0xCD);
+    resize_yuv_to_rgba(frame, actual.data(), width, height, stride,
+                       orientation);
+    auto ok = actual == expected;
+    if (planes) {
+        fill(actual.begin(), actual.end(), 0xCD);
+        resize_yuv_to_rgba(*planes, actual.data(), width, height, stride,
+                           orientation);
+        ok &= actual == expected;
+    }
+    return ok;
+}
+
+// `packed` is the same plane in the buffer with `row_stride`
+static bool resize_plane_as_reference(const plane_view_t& plane,
+                                      const uint8_t* packed,
+                                      uint32_t row_stride,
+                                      frame_orientation_t orientation,
+                                      uint32_t width, uint32_t height) {
+    const auto stride = width + 5;
+    const auto expected = reference_oriented<uint8_t>(
+        plane.width, plane.height, orientation, width, height, stride,
+        [&plane](uint32_t x, uint32_t y) { return plane.at(x, y); });
+    vector<uint8_t> actual(expected.size(), 0xCD);
+    resize_plane(plane, actual.data(), width, height, stride, orientation);
+    auto ok = actual == expected;
+    if (packed) {
+        fill(actual.begin(), actual.end(), 0xCD);
+        resize_plane(packed, row_stride, plane.width, plane.height,
+                     actual.data(), width, height, stride, orientation);
+        ok &= actual == expected;
+    }
+    return ok;
+}
+
+// every rotation and mirroring with the odd sizes. the tiles and the vector
+// loops have their tails. the strided frame is sampled 1 by 1
+void orientation_of_odd_sizes() {
+    const uint32_t sizes[][2] = {{67, 45}, {33, 71}, {5, 3}, {1, 1}};
+    auto convert_ok = true, resize_ok = true, plane_ok = true;
+    for (const auto& size : sizes)
+        for (auto nv21 : {true, false}) {
+            const yuv_image_t image{size[0], size[1], nv21};
+            const auto packed = image.view();
+            const auto planes = image.planes();
+            const auto strided = packed.subsample(3);
+            for (uint16_t rotation : {0, 90, 180, 270})
+                for (auto mirror : {false, true}) {
+                    const frame_orientation_t orientation{rotation, mirror};
+                    for (const auto* frame : {&packed, &strided}) {
+                        if (frame->width == 0 || frame->height == 0)
+                            continue;
+                        const auto* p = frame == &packed ? &planes : nullptr;
+                        convert_ok &=
+                            convert_as_reference(*frame, p, orientation);
+
+                        uint32_t width = 0, height = 0;
+                        get_oriented_size(frame->width, frame->height,
+                                          orientation, width, height);
+                        // shrink and enlarge
+                        const uint32_t targets[][2] = {
+                            {width / 2 + 1, height / 3 + 1},
+                            {width * 2 - 1, height + 7}};
+                        for (const auto& target : targets) {
+                            resize_ok &= resize_as_reference(
+                                *frame, p, orientation, target[0], target[1]);
+                            // the chroma plane isn't packed with NV21
+                            plane_ok &= resize_plane_as_reference(
+                                frame->planes[1], nullptr, 0, orientation,
+                                target[0], target[1]);
+                            plane_ok &= resize_plane_as_reference(
+                                frame->planes[0], p ? image.y.data() : nullptr,
+                                image.row_stride, orientation, target[0],
+                                target[1]);
+                        }
+                    }
+                }
+        }
+    check(convert_ok, "conversion is same with the rotated reference");
+    check(resize_ok, "resize is same with the rotated reference");
+    check(plane_ok, "resize of the plane is same with the rotated reference");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    const nv21_t image{};
+    crop_keeps_chroma(image);
+    subsample_follows_luma(image);
+    iterate_rows(image);
+    kernels_with_views(image);
+    orientation_of_odd_sizes();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
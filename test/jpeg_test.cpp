@@ -0,0 +1,423 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `jpeg_encoder_t` with the synthetic frames. The files are decoded with
+//  libjpeg if it is found, and its encoder is the reference of the throughput
+//
+#include <ndk_camera_executor.h>
+#include <ndk_camera_jpeg.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#if defined(NDCAM_TEST_LIBJPEG)
+#include <jpeglib.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// I420 and NV21 of the same picture. the rows have padding
+struct test_image_t final {
+    uint32_t width, height;
+    uint32_t stride, chroma_stride;
+    vector<uint8_t> y, u, v, vu;
+
+  public:
+    test_image_t(uint32_t _width, uint32_t _height)
+        : width{_width}, height{_height}, stride{_width + 24},
+          chroma_stride{(_width + 1) / 2 + 8} {
+        const auto cw = (width + 1) / 2, ch = (height + 1) / 2;
+        y.resize(stride * height);
+        u.resize(chroma_stride * ch);
+        v.resize(chroma_stride * ch);
+        vu.resize(stride * ch);
+        for (auto r = 0u; r < height; ++r)
+            for (auto c = 0u; c < width; ++c)
+                y[r * stride + c] = static_cast<uint8_t>(
+                    128 + 60 * sin(c / 13.0) + 40 * cos(r / 7.0) +
+                    20 * sin((c + r) / 3.0));
+        for (auto r = 0u; r < ch; ++r)
+            for (auto c = 0u; c < cw; ++c) {
+                const auto cb = static_cast<uint8_t>(128 + 50 * sin(c / 17.0));
+                const auto cr = static_cast<uint8_t>(128 + 50 * cos(r / 11.0));
+                u[r * chroma_stride + c] = cb;
+                v[r * chroma_stride + c] = cr;
+                vu[r * stride + c * 2] = cr;
+                vu[r * stride + c * 2 + 1] = cb;
+            }
+    }
+
+    auto planar() const -> yuv_planes_t {
+        return {y.data(), u.data(), v.data(), stride, chroma_stride, 1,
+                width,    height};
+    }
+    auto semi_planar() const -> yuv_planes_t {
+        return {y.data(), vu.data() + 1, vu.data(), stride, stride, 2,
+                width,    height};
+    }
+    auto view() const -> frame_view_t {
+        const auto cw = (width + 1) / 2, ch = (height + 1) / 2;
+        frame_view_t frame{};
+        frame.format = AIMAGE_FORMAT_YUV_420_888;
+        frame.width = width;
+        frame.height = height;
+        frame.plane_count = 3;
+        frame.planes[0] = make_plane_view(y.data(), stride, width, height);
+        frame.planes[1] = make_plane_view(vu.data() + 1, stride, cw, ch, 2);
+        frame.planes[2] = make_plane_view(vu.data(), stride, cw, ch, 2);
+        return frame;
+    }
+};
+
+static uint32_t read_u16(const vector<uint8_t>& file, size_t offset) {
+    return file[offset] << 8 | file[offset + 1];
+}
+
+struct file_layout_t final {
+    bool valid;
+    uint32_t width, height;
+    uint32_t interval; // 0 if there is no DRI
+    uint32_t restarts; // RSTn in the order
+};
+
+// walk the segments, then the entropy-coded data
+static auto get_layout(const vector<uint8_t>& file) -> file_layout_t {
+    file_layout_t layout{};
+    if (file.size() < 4 || file[0] != 0xFF || file[1] != 0xD8)
+        return layout;
+    size_t offset = 2;
+    while (offset + 4 <= file.size()) {
+        if (file[offset] != 0xFF)
+            return layout;
+        const auto marker = file[offset + 1];
+        const auto length = read_u16(file, offset + 2);
+        if (marker == 0xC0) {
+            layout.height = read_u16(file, offset + 5);
+            layout.width = read_u16(file, offset + 7);
+        }
+        if (marker == 0xDD)
+            layout.interval = read_u16(file, offset + 4);
+        offset += 2 + length;
+        if (marker == 0xDA)
+            break;
+    }
+    for (; offset + 1 < file.size(); ++offset) {
+        if (file[offset] != 0xFF)
+            continue;
+        const auto next = file[++offset];
+        if (next == 0x00)
+            continue;
+        if (next == 0xD0 + layout.restarts % 8) {
+            layout.restarts += 1;
+            continue;
+        }
+        layout.valid = next == 0xD9 && offset + 1 == file.size();
+        break;
+    }
+    return layout;
+}
+
+void markers() {
+    const test_image_t image{203, 157};
+    jpeg_config_t config{};
+    config.slices = 1;
+    jpeg_encoder_t single{config};
+    vector<uint8_t> file{};
+    check(single.encode(image.planar(), file) == AMEDIA_OK, "encode");
+    auto layout = get_layout(file);
+    check(layout.valid, "SOI ~ EOI");
+    check(layout.width == 203 && layout.height == 157, "size of SOF0");
+    check(layout.interval == 0 && layout.restarts == 0, "no restart");
+
+    // 10 rows of MCUs in 4 slices of 3 rows
+    config.slices = 4;
+    jpeg_encoder_t sliced{config};
+    check(sliced.encode(image.planar(), file) == AMEDIA_OK, "encode slices");
+    layout = get_layout(file);
+    check(layout.valid, "sliced SOI ~ EOI");
+    check(layout.interval == 13 * 3, "interval of the rows");
+    check(layout.restarts == 3, "RSTn between the slices");
+
+    // more than the rows
+    config.slices = 100;
+    jpeg_encoder_t many{config};
+    many.encode(image.planar(), file);
+    layout = get_layout(file);
+    check(layout.valid && layout.restarts == 9, "a row for each slice");
+
+    yuv_planes_t empty = image.planar();
+    empty.height = 0;
+    check(single.encode(empty, file) == AMEDIA_ERROR_INVALID_PARAMETER,
+          "empty frame");
+    auto frame = image.view();
+    frame.format = AIMAGE_FORMAT_JPEG;
+    check(single.encode(frame, file) == AMEDIA_ERROR_INVALID_PARAMETER,
+          "not YUV_420_888");
+}
+
+void pool() {
+    const test_image_t image{64, 48};
+    resource_tracker_t resources{};
+    jpeg_config_t config{};
+    config.pool_size = 1;
+    config.resources = &resources;
+    config.id = 1;
+    const auto pooled = [&resources]() {
+        return resources.get_stats(resource_type_t::frame_buffer, 1);
+    };
+    {
+        jpeg_encoder_t encoder{config};
+        auto buffer = encoder.acquire();
+        check(buffer.capacity() == 0, "new buffer");
+        encoder.encode(image.planar(), buffer);
+        const auto* data = buffer.data();
+        const auto capacity = static_cast<int64_t>(buffer.capacity());
+        encoder.recycle(move(buffer));
+        encoder.recycle(vector<uint8_t>(16));
+        check(pooled().live == 1 && pooled().bytes == capacity,
+              "the pool is accounted");
+        buffer = encoder.acquire();
+        check(buffer.data() == data, "the buffer is reused");
+        check(encoder.acquire().capacity() == 0, "the second one is dropped");
+        check(pooled().live == 0 && pooled().bytes == 0,
+              "the acquired one is released");
+        encoder.recycle(move(buffer));
+    }
+    check(pooled().live == 0, "the encoder releases the pool");
+}
+
+#if defined(NDCAM_TEST_LIBJPEG)
+// Y, Cb, Cr of each pixel. the chroma is not interpolated
+static auto decode(const vector<uint8_t>& file, uint32_t& width,
+                   uint32_t& height) -> vector<uint8_t> {
+    jpeg_decompress_struct info{};
+    jpeg_error_mgr error{};
+    info.err = jpeg_std_error(&error);
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, file.data(), file.size());
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_YCbCr;
+    info.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&info);
+    width = info.output_width;
+    height = info.output_height;
+    vector<uint8_t> pixels(width * height * 3);
+    while (info.output_scanline < height) {
+        auto* row = pixels.data() + info.output_scanline * width * 3;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return pixels;
+}
+
+static double get_psnr(double squared_sum, size_t count) {
+    const auto mse = squared_sum / static_cast<double>(count);
+    return mse > 0 ? 10 * log10(255.0 * 255 / mse) : 99;
+}
+
+// PSNR of Y and of the chroma
+static auto compare(const test_image_t& image, const vector<uint8_t>& pixels)
+    -> pair<double, double> {
+    auto luma = 0.0, chroma = 0.0;
+    for (auto r = 0u; r < image.height; ++r)
+        for (auto c = 0u; c < image.width; ++c) {
+            const auto* p = pixels.data() + (r * image.width + c) * 3;
+            const auto ci = r / 2 * image.chroma_stride + c / 2;
+            const double dy = p[0] - image.y[r * image.stride + c];
+            const double du = p[1] - image.u[ci];
+            const double dv = p[2] - image.v[ci];
+            luma += dy * dy;
+            chroma += du * du + dv * dv;
+        }
+    const size_t count = image.width * image.height;
+    return {get_psnr(luma, count), get_psnr(chroma, count * 2)};
+}
+
+// the decoded pixels are the same for the inputs, the slices and the threads
+void decoded() {
+    const test_image_t image{203, 157};
+    jpeg_config_t config{};
+    config.slices = 1;
+    jpeg_encoder_t single{config};
+    vector<uint8_t> file{};
+    single.encode(image.planar(), file);
+    uint32_t width = 0, height = 0;
+    const auto expected = decode(file, width, height);
+    check(width == 203 && height == 157, "decoded size");
+    const auto [luma, chroma] = compare(image, expected);
+    printf("PSNR of quality 90: Y %.1f dB, CbCr %.1f dB\n", luma, chroma);
+    check(luma > 38 && chroma > 38, "PSNR of quality 90");
+
+    single.encode(image.semi_planar(), file);
+    check(decode(file, width, height) == expected, "NV21 input");
+    check(single.encode(image.view(), file) == AMEDIA_OK, "frame view");
+    check(decode(file, width, height) == expected, "frame view input");
+
+    executor_config_t executor_config{};
+    executor_config.lanes[1].threads = 2;
+    camera_executor_t executor{executor_config};
+    config.slices = 4;
+    config.executor = &executor;
+    jpeg_encoder_t sliced{config};
+    sliced.encode(image.planar(), file);
+    check(decode(file, width, height) == expected, "slices in the executor");
+    config.executor = nullptr;
+    config.slices = 0;
+    jpeg_encoder_t threads{config};
+    threads.encode(image.planar(), file);
+    check(decode(file, width, height) == expected,
+          "slices in the shared threads");
+
+    config.quality = 30;
+    jpeg_encoder_t low{config};
+    vector<uint8_t> small{};
+    low.encode(image.planar(), small);
+    const auto low_psnr = compare(image, decode(small, width, height)).first;
+    check(small.size() < file.size() && low_psnr < luma && low_psnr > 28,
+          "quality 30");
+}
+
+// the crops and the thumbnails keep the even origin of the chroma
+void views() {
+    const test_image_t image{640, 480};
+    jpeg_encoder_t encoder{jpeg_config_t{}};
+    vector<uint8_t> file{};
+    const auto crop = image.view().crop({101, 51, 300, 200});
+    check(encoder.encode(crop, file) == AMEDIA_OK, "crop");
+    uint32_t width = 0, height = 0;
+    auto pixels = decode(file, width, height);
+    check(width == crop.width && height == crop.height, "size of the crop");
+    // the crop starts at (100, 50)
+    auto error = 0;
+    for (auto r = 0u; r < height; ++r)
+        for (auto c = 0u; c < width; ++c)
+            error = max(error, abs(pixels[(r * width + c) * 3] -
+                                   image.y[(r + 50) * image.stride + c + 100]));
+    check(error < 16, "pixels of the crop");
+
+    const auto thumbnail = image.view().subsample(4);
+    check(encoder.encode(thumbnail, file) == AMEDIA_OK, "thumbnail");
+    pixels = decode(file, width, height);
+    check(width == 160 && height == 120, "size of the thumbnail");
+    error = 0;
+    for (auto r = 0u; r < height; ++r)
+        for (auto c = 0u; c < width; ++c)
+            error = max(error, abs(pixels[(r * width + c) * 3] -
+                                   image.y[r * 4 * image.stride + c * 4]));
+    check(error < 40, "pixels of the thumbnail");
+}
+
+// libjpeg with the same input. no color conversion
+static void encode_reference(const test_image_t& image, int quality,
+                             vector<uint8_t>& file) {
+    jpeg_compress_struct info{};
+    jpeg_error_mgr error{};
+    info.err = jpeg_std_error(&error);
+    jpeg_create_compress(&info);
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&info, &buffer, &size);
+    info.image_width = image.width;
+    info.image_height = image.height;
+    info.input_components = 3;
+    info.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    info.raw_data_in = TRUE;
+    info.comp_info[0].h_samp_factor = info.comp_info[0].v_samp_factor = 2;
+    for (auto c = 1; c < 3; ++c)
+        info.comp_info[c].h_samp_factor = info.comp_info[c].v_samp_factor = 1;
+    jpeg_start_compress(&info, TRUE);
+    JSAMPROW y_rows[16], u_rows[8], v_rows[8];
+    JSAMPARRAY planes[3]{y_rows, u_rows, v_rows};
+    const auto last = image.height - 1, chroma_last = (image.height - 1) / 2;
+    while (info.next_scanline < image.height) {
+        const auto y0 = info.next_scanline;
+        for (auto i = 0u; i < 16; ++i)
+            y_rows[i] = const_cast<uint8_t*>(image.y.data()) +
+                        min(y0 + i, last) * image.stride;
+        for (auto i = 0u; i < 8; ++i) {
+            const auto offset = min(y0 / 2 + i, chroma_last) *
+                                image.chroma_stride;
+            u_rows[i] = const_cast<uint8_t*>(image.u.data()) + offset;
+            v_rows[i] = const_cast<uint8_t*>(image.v.data()) + offset;
+        }
+        jpeg_write_raw_data(&info, planes, 16);
+    }
+    jpeg_finish_compress(&info);
+    file.assign(buffer, buffer + size);
+    free(buffer);
+    jpeg_destroy_compress(&info);
+}
+
+void reference() {
+    const test_image_t image{203, 157};
+    vector<uint8_t> file{};
+    encode_reference(image, 90, file);
+    uint32_t width = 0, height = 0;
+    const auto psnr = compare(image, decode(file, width, height)).first;
+    jpeg_encoder_t encoder{jpeg_config_t{}};
+    encoder.encode(image.planar(), file);
+    const auto ours = compare(image, decode(file, width, height)).first;
+    printf("PSNR of Y: libjpeg %.1f dB, jpeg_encoder_t %.1f dB\n", psnr, ours);
+    check(ours > psnr - 0.5, "quality of libjpeg");
+}
+#endif
+
+// frames per second of the full frame and the thumbnail
+void throughput() {
+    for (auto [width, height] :
+         {pair{1920u, 1080u}, pair{640u, 480u}, pair{320u, 240u}}) {
+        const test_image_t image{width, height};
+        vector<uint8_t> file{};
+        for (auto slices : {1u, 0u}) {
+            jpeg_config_t config{};
+            config.slices = slices;
+            jpeg_encoder_t encoder{config};
+            constexpr auto repeat = 10;
+            const auto begin = steady_clock::now();
+            for (auto i = 0; i < repeat; ++i)
+                encoder.encode(image.planar(), file);
+            const duration<double> elapsed = steady_clock::now() - begin;
+            printf("%ux%u with %u slices: %.1f fps, %zu bytes\n", width,
+                   height, slices, repeat / elapsed.count(), file.size());
+        }
+#if defined(NDCAM_TEST_LIBJPEG)
+        constexpr auto repeat = 10;
+        const auto begin = steady_clock::now();
+        for (auto i = 0; i < repeat; ++i)
+            encode_reference(image, 90, file);
+        const duration<double> elapsed = steady_clock::now() - begin;
+        printf("%ux%u with libjpeg: %.1f fps, %zu bytes\n", width, height,
+               repeat / elapsed.count(), file.size());
+#endif
+    }
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    markers();
+    pool();
+#if defined(NDCAM_TEST_LIBJPEG)
+    decoded();
+    views();
+    reference();
+#endif
+    throughput();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
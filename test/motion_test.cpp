@@ -0,0 +1,225 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `subsample_plane`, `block_difference` and `motion_gate_t` against a scalar
+//  reference. Odd sizes for the tails of the vector loops and the partial
+//  blocks at the right/bottom edges
+//
+#include <ndk_camera_frame.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_motion.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// the plane in a buffer with the padding of the rows
+struct test_plane_t final {
+    uint32_t width, height, pixel_stride, row_stride;
+    vector<uint8_t> buffer;
+
+  public:
+    test_plane_t(uint32_t _width, uint32_t _height, uint32_t _pixel_stride = 1)
+        : width{_width}, height{_height}, pixel_stride{_pixel_stride},
+          row_stride{_width * _pixel_stride + 5},
+          buffer(row_stride * _height) {
+    }
+
+    uint8_t& at(uint32_t x, uint32_t y) {
+        return buffer[y * row_stride + x * pixel_stride];
+    }
+    auto view() const -> plane_view_t {
+        return make_plane_view(buffer.data(), row_stride, width, height,
+                               pixel_stride);
+    }
+};
+
+static void fill_random(vector<uint8_t>& values, uint32_t seed) {
+    for (auto& value : values) {
+        seed = seed * 1664525 + 1013904223;
+        value = static_cast<uint8_t>(seed >> 24);
+    }
+}
+
+// 1 pixel at a time
+static auto reference_subsample(test_plane_t& plane, uint32_t step)
+    -> vector<uint8_t> {
+    vector<uint8_t> output{};
+    for (auto y = 0u; y < plane.height / step; ++y)
+        for (auto x = 0u; x < plane.width / step; ++x)
+            output.emplace_back(plane.at(x * step, y * step));
+    return output;
+}
+
+static auto reference_difference(const vector<uint8_t>& lhs,
+                                 const vector<uint8_t>& rhs, uint32_t width,
+                                 uint32_t height, uint32_t block)
+    -> vector<uint8_t> {
+    vector<uint8_t> diffs{};
+    for (auto by = 0u; by * block < height; ++by)
+        for (auto bx = 0u; bx * block < width; ++bx) {
+            uint64_t sum = 0, area = 0;
+            for (auto y = by * block; y < min(by * block + block, height); ++y)
+                for (auto x = bx * block; x < min(bx * block + block, width);
+                     ++x, ++area)
+                    sum += abs(lhs[y * width + x] - rhs[y * width + x]);
+            diffs.emplace_back(static_cast<uint8_t>(min<uint64_t>(
+                sum / area, 255)));
+        }
+    return diffs;
+}
+
+void subsample_reference() {
+    const uint32_t sizes[][2] = {{97, 61}, {130, 9}, {257, 3}, {3, 2}};
+    auto ok = true;
+    for (const auto& size : sizes)
+        for (auto pixel_stride : {1u, 2u})
+            for (auto step = 1u; step <= 5; ++step) {
+                test_plane_t plane{size[0], size[1], pixel_stride};
+                fill_random(plane.buffer, size[0] * step + pixel_stride);
+                const auto expected = reference_subsample(plane, step);
+
+                vector<uint8_t> actual(expected.size() + 1, 0xCD);
+                subsample_plane(plane.view(), step, actual.data());
+                ok &= equal(expected.begin(), expected.end(), actual.begin());
+                ok &= actual.back() == 0xCD; // no write after the end
+                if (pixel_stride != 1)
+                    continue;
+
+                fill(actual.begin(), actual.end(), 0xCD);
+                subsample_plane(plane.buffer.data(), plane.row_stride,
+                                plane.width, plane.height, step,
+                                actual.data());
+                ok &= equal(expected.begin(), expected.end(), actual.begin());
+                ok &= actual.back() == 0xCD;
+            }
+    check(ok, "subsample is same with the scalar reference");
+}
+
+void difference_reference() {
+    // partial blocks in both directions. a block larger than the plane
+    const uint32_t sizes[][2] = {{97, 61}, {33, 17}, {16, 16}, {5, 3}};
+    auto ok = true;
+    for (const auto& size : sizes)
+        for (auto block : {1u, 7u, 8u, 16u, 24u, 64u}) {
+            const auto width = size[0], height = size[1];
+            const auto count = ((width + block - 1) / block) *
+                               ((height + block - 1) / block);
+            vector<uint8_t> lhs(width * height), rhs(lhs.size());
+            fill_random(lhs, width + block);
+            fill_random(rhs, height * block);
+            auto expected =
+                reference_difference(lhs, rhs, width, height, block);
+            vector<uint8_t> actual(count + 1, 0xCD);
+            block_difference(lhs.data(), rhs.data(), width, height, block,
+                             actual.data());
+            ok &= expected.size() == count;
+            ok &= equal(expected.begin(), expected.end(), actual.begin());
+            ok &= actual.back() == 0xCD;
+
+            // the largest difference for the accumulators
+            fill(lhs.begin(), lhs.end(), 0);
+            fill(rhs.begin(), rhs.end(), 255);
+            block_difference(lhs.data(), rhs.data(), width, height, block,
+                             actual.data());
+            ok &= all_of(actual.begin(), actual.begin() + count,
+                         [](uint8_t diff) { return diff == 255; });
+        }
+    check(ok, "difference is same with the scalar reference");
+}
+
+// the motion map is the difference with the reference frame
+void motion_map() {
+    motion_config_t config{};
+    config.step = 4;
+    config.block = 16;
+    config.min_blocks = 1;
+    motion_gate_t gate{config};
+
+    // 32x19 after the subsample. 2x2 blocks with the partial ones
+    test_plane_t plane{131, 77};
+    fill_random(plane.buffer, 7);
+    const auto reference = reference_subsample(plane, config.step);
+    check(gate.update(plane.view(), 1) == true, "first frame is reference");
+    uint32_t blocks_x = 0, blocks_y = 0;
+    gate.get_map_size(blocks_x, blocks_y);
+    check(blocks_x == 2 && blocks_y == 2, "partial blocks in the map");
+
+    // change in the bottom-right block only
+    for (auto y = 64u; y < 77; ++y)
+        for (auto x = 64u; x < 131; ++x)
+            plane.at(x, y) = static_cast<uint8_t>(plane.at(x, y) + 128);
+    const auto current = reference_subsample(plane, config.step);
+    check(gate.update(plane.buffer.data(), plane.row_stride, plane.width,
+                      plane.height, 2) == true,
+          "change of the edge block");
+
+    const auto expected = reference_difference(reference, current, 32, 19, 16);
+    vector<uint8_t> map(4);
+    check(gate.read_map(map) == 2, "timestamp of the map");
+    check(map == expected, "map is same with the scalar reference");
+    check(map[0] == 0 && map[1] == 0 && map[2] == 0 && map[3] > 12,
+          "only the edge block is moving");
+    vector<uint8_t> small(3);
+    check(gate.read_map(small) == 0, "too small for the map");
+
+    // moving frame became the reference
+    check(gate.update(plane.view(), 3) == false, "same with the reference");
+    gate.read_map(map);
+    check(map == vector<uint8_t>(4, 0), "no difference");
+
+    // the next one becomes the reference
+    gate.reset();
+    fill_random(plane.buffer, 11);
+    check(gate.update(plane.view(), 4) == true, "reference after the reset");
+    const auto stats = gate.get_stats();
+    check(stats.frames == 4 && stats.moving == 3, "stats of the frames");
+}
+
+// the light changes slowly. the reference follows it
+void refresh_reference() {
+    motion_config_t config{};
+    config.step = 1;
+    config.block = 8;
+    config.min_blocks = 1;
+    config.refresh_interval = 3;
+    motion_gate_t gate{config};
+
+    test_plane_t plane{21, 13};
+    auto moving = 0u;
+    for (auto i = 0u; i < 10; ++i) {
+        fill(plane.buffer.begin(), plane.buffer.end(), 100 + 4 * i);
+        moving += gate.update(plane.view(), i + 1);
+    }
+    // without the refresh, 4th frame is 16 away from the first one
+    check(moving == 1, "only the first one");
+
+    config.min_blocks = UINT32_MAX;
+    motion_gate_t never{config};
+    for (auto i = 0u; i < 5; ++i) {
+        fill_random(plane.buffer, i);
+        never.update(plane.view(), i + 1);
+    }
+    check(never.get_stats().moving == 1, "blocks under the min_blocks");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    subsample_reference();
+    difference_reference();
+    motion_map();
+    refresh_reference();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
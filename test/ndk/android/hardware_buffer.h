@@ -0,0 +1,10 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+#include <stdint.h>
+
+typedef struct AHardwareBuffer AHardwareBuffer;
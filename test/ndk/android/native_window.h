@@ -0,0 +1,24 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+#include <android/hardware_buffer.h>
+
+typedef struct ANativeWindow ANativeWindow;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ANativeWindow_acquire(ANativeWindow* window);
+void ANativeWindow_release(ANativeWindow* window);
+int32_t ANativeWindow_getWidth(ANativeWindow* window);
+int32_t ANativeWindow_getHeight(ANativeWindow* window);
+int32_t ANativeWindow_getFormat(ANativeWindow* window);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. There is no JNI in the host tests.
+//  Use `stand_in_create_window` instead of `ANativeWindow_fromSurface`
+//
+#pragma once
+#include <android/native_window.h>
@@ -0,0 +1,26 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+
+typedef enum {
+    ACAMERA_OK = 0,
+    ACAMERA_ERROR_BASE = -10000,
+    ACAMERA_ERROR_UNKNOWN = ACAMERA_ERROR_BASE,
+    ACAMERA_ERROR_INVALID_PARAMETER = ACAMERA_ERROR_BASE - 1,
+    ACAMERA_ERROR_CAMERA_DISCONNECTED = ACAMERA_ERROR_BASE - 2,
+    ACAMERA_ERROR_NOT_ENOUGH_MEMORY = ACAMERA_ERROR_BASE - 3,
+    ACAMERA_ERROR_METADATA_NOT_FOUND = ACAMERA_ERROR_BASE - 4,
+    ACAMERA_ERROR_CAMERA_DEVICE = ACAMERA_ERROR_BASE - 5,
+    ACAMERA_ERROR_CAMERA_SERVICE = ACAMERA_ERROR_BASE - 6,
+    ACAMERA_ERROR_SESSION_CLOSED = ACAMERA_ERROR_BASE - 7,
+    ACAMERA_ERROR_INVALID_OPERATION = ACAMERA_ERROR_BASE - 8,
+    ACAMERA_ERROR_STREAM_CONFIGURE_FAIL = ACAMERA_ERROR_BASE - 9,
+    ACAMERA_ERROR_CAMERA_IN_USE = ACAMERA_ERROR_BASE - 10,
+    ACAMERA_ERROR_MAX_CAMERA_IN_USE = ACAMERA_ERROR_BASE - 11,
+    ACAMERA_ERROR_CAMERA_DISABLED = ACAMERA_ERROR_BASE - 12,
+    ACAMERA_ERROR_PERMISSION_DENIED = ACAMERA_ERROR_BASE - 13,
+} camera_status_t;
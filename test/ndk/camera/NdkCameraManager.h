@@ -0,0 +1,39 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+#include <camera/NdkCameraDevice.h>
+#include <camera/NdkCameraError.h>
+#include <camera/NdkCameraMetadata.h>
+
+typedef struct ACameraManager ACameraManager;
+
+typedef struct ACameraIdList {
+    int numCameras;
+    const char** cameraIds;
+} ACameraIdList;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ACameraManager* ACameraManager_create();
+void ACameraManager_delete(ACameraManager* manager);
+camera_status_t ACameraManager_getCameraIdList(ACameraManager* manager,
+                                               ACameraIdList** cameraIdList);
+void ACameraManager_deleteCameraIdList(ACameraIdList* cameraIdList);
+camera_status_t
+ACameraManager_getCameraCharacteristics(ACameraManager* manager,
+                                        const char* cameraId,
+                                        ACameraMetadata** characteristics);
+camera_status_t
+ACameraManager_openCamera(ACameraManager* manager, const char* cameraId,
+                          ACameraDevice_StateCallbacks* callback,
+                          ACameraDevice** device);
+
+#ifdef __cplusplus
+}
+#endif
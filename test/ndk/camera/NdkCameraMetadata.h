@@ -0,0 +1,71 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+#include <camera/NdkCameraError.h>
+#include <camera/NdkCameraMetadataTags.h>
+
+typedef struct ACameraMetadata ACameraMetadata;
+
+enum {
+    ACAMERA_TYPE_BYTE = 0,
+    ACAMERA_TYPE_INT32 = 1,
+    ACAMERA_TYPE_FLOAT = 2,
+    ACAMERA_TYPE_INT64 = 3,
+    ACAMERA_TYPE_DOUBLE = 4,
+    ACAMERA_TYPE_RATIONAL = 5,
+    ACAMERA_NUM_TYPES
+};
+
+typedef struct ACameraMetadata_rational {
+    int32_t numerator;
+    int32_t denominator;
+} ACameraMetadata_rational;
+
+typedef struct ACameraMetadata_entry {
+    uint32_t tag;
+    uint8_t type;
+    uint32_t count;
+    union {
+        uint8_t* u8;
+        int32_t* i32;
+        float* f;
+        int64_t* i64;
+        double* d;
+        ACameraMetadata_rational* r;
+    } data;
+} ACameraMetadata_entry;
+
+typedef struct ACameraMetadata_const_entry {
+    uint32_t tag;
+    uint8_t type;
+    uint32_t count;
+    union {
+        const uint8_t* u8;
+        const int32_t* i32;
+        const float* f;
+        const int64_t* i64;
+        const double* d;
+        const ACameraMetadata_rational* r;
+    } data;
+} ACameraMetadata_const_entry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+camera_status_t ACameraMetadata_getConstEntry(const ACameraMetadata* metadata,
+                                              uint32_t tag,
+                                              ACameraMetadata_const_entry* entry);
+camera_status_t ACameraMetadata_getAllTags(const ACameraMetadata* metadata,
+                                           int32_t* numEntries,
+                                           const uint32_t** tags);
+ACameraMetadata* ACameraMetadata_copy(const ACameraMetadata* src);
+void ACameraMetadata_free(ACameraMetadata* metadata);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,115 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the tags used by the library.
+//  The values follow the NDK
+//
+#pragma once
+#include <stdint.h>
+
+typedef enum acamera_metadata_section {
+    ACAMERA_COLOR_CORRECTION,
+    ACAMERA_CONTROL,
+    ACAMERA_DEMOSAIC,
+    ACAMERA_EDGE,
+    ACAMERA_FLASH,
+    ACAMERA_FLASH_INFO,
+    ACAMERA_HOT_PIXEL,
+    ACAMERA_JPEG,
+    ACAMERA_LENS,
+    ACAMERA_LENS_INFO,
+    ACAMERA_NOISE_REDUCTION,
+    ACAMERA_QUIRKS,
+    ACAMERA_REQUEST,
+    ACAMERA_SCALER,
+    ACAMERA_SENSOR,
+    ACAMERA_SENSOR_INFO,
+    ACAMERA_SHADING,
+    ACAMERA_STATISTICS,
+    ACAMERA_STATISTICS_INFO,
+    ACAMERA_TONEMAP,
+    ACAMERA_LED,
+    ACAMERA_INFO,
+    ACAMERA_BLACK_LEVEL,
+    ACAMERA_SYNC,
+    ACAMERA_REPROCESS,
+    ACAMERA_DEPTH,
+    ACAMERA_SECTION_COUNT,
+} acamera_metadata_section_t;
+
+typedef enum acamera_metadata_section_start {
+    ACAMERA_COLOR_CORRECTION_START = ACAMERA_COLOR_CORRECTION << 16,
+    ACAMERA_LENS_START = ACAMERA_LENS << 16,
+    ACAMERA_LENS_INFO_START = ACAMERA_LENS_INFO << 16,
+    ACAMERA_REQUEST_START = ACAMERA_REQUEST << 16,
+    ACAMERA_SCALER_START = ACAMERA_SCALER << 16,
+    ACAMERA_SENSOR_START = ACAMERA_SENSOR << 16,
+    ACAMERA_SENSOR_INFO_START = ACAMERA_SENSOR_INFO << 16,
+    ACAMERA_STATISTICS_START = ACAMERA_STATISTICS << 16,
+    ACAMERA_INFO_START = ACAMERA_INFO << 16,
+    ACAMERA_SYNC_START = ACAMERA_SYNC << 16,
+} acamera_metadata_section_start_t;
+
+typedef enum acamera_metadata_tag {
+    ACAMERA_COLOR_CORRECTION_GAINS = ACAMERA_COLOR_CORRECTION_START + 2,
+    ACAMERA_LENS_FACING = ACAMERA_LENS_START + 5,
+    ACAMERA_LENS_INFO_SHADING_MAP_SIZE = ACAMERA_LENS_INFO_START + 6,
+    ACAMERA_REQUEST_AVAILABLE_CAPABILITIES = ACAMERA_REQUEST_START + 12,
+    ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS = ACAMERA_SCALER_START + 10,
+    ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS = ACAMERA_SCALER_START + 11,
+    ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS = ACAMERA_SCALER_START + 12,
+    ACAMERA_SENSOR_EXPOSURE_TIME = ACAMERA_SENSOR_START,
+    ACAMERA_SENSOR_FRAME_DURATION = ACAMERA_SENSOR_START + 1,
+    ACAMERA_SENSOR_SENSITIVITY = ACAMERA_SENSOR_START + 2,
+    ACAMERA_SENSOR_BLACK_LEVEL_PATTERN = ACAMERA_SENSOR_START + 12,
+    ACAMERA_SENSOR_ORIENTATION = ACAMERA_SENSOR_START + 14,
+    ACAMERA_SENSOR_TIMESTAMP = ACAMERA_SENSOR_START + 16,
+    ACAMERA_SENSOR_DYNAMIC_BLACK_LEVEL = ACAMERA_SENSOR_START + 28,
+    ACAMERA_SENSOR_DYNAMIC_WHITE_LEVEL = ACAMERA_SENSOR_START + 29,
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT = ACAMERA_SENSOR_INFO_START + 2,
+    ACAMERA_SENSOR_INFO_WHITE_LEVEL = ACAMERA_SENSOR_INFO_START + 7,
+    ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE = ACAMERA_SENSOR_INFO_START + 8,
+    ACAMERA_STATISTICS_LENS_SHADING_MAP = ACAMERA_STATISTICS_START + 11,
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL = ACAMERA_INFO_START,
+    ACAMERA_SYNC_FRAME_NUMBER = ACAMERA_SYNC_START,
+} acamera_metadata_tag_t;
+
+typedef enum acamera_metadata_enum_acamera_lens_facing {
+    ACAMERA_LENS_FACING_FRONT = 0,
+    ACAMERA_LENS_FACING_BACK = 1,
+    ACAMERA_LENS_FACING_EXTERNAL = 2,
+} acamera_metadata_enum_android_lens_facing_t;
+
+typedef enum acamera_metadata_enum_acamera_request_available_capabilities {
+    ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_BACKWARD_COMPATIBLE = 0,
+    ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_MANUAL_SENSOR = 1,
+    ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_MANUAL_POST_PROCESSING = 2,
+    ACAMERA_REQUEST_AVAILABLE_CAPABILITIES_RAW = 3,
+} acamera_metadata_enum_android_request_available_capabilities_t;
+
+typedef enum acamera_metadata_enum_acamera_scaler_available_stream_configurations {
+    ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT = 0,
+    ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_INPUT = 1,
+} acamera_metadata_enum_android_scaler_available_stream_configurations_t;
+
+typedef enum acamera_metadata_enum_acamera_sensor_info_color_filter_arrangement {
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_RGGB = 0,
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_GRBG = 1,
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_GBRG = 2,
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_BGGR = 3,
+    ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_RGB = 4,
+} acamera_metadata_enum_android_sensor_info_color_filter_arrangement_t;
+
+typedef enum acamera_metadata_enum_acamera_sensor_info_timestamp_source {
+    ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN = 0,
+    ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME = 1,
+} acamera_metadata_enum_android_sensor_info_timestamp_source_t;
+
+typedef enum acamera_metadata_enum_acamera_info_supported_hardware_level {
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LIMITED = 0,
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL = 1,
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LEGACY = 2,
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_3 = 3,
+    ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_EXTERNAL = 4,
+} acamera_metadata_enum_android_info_supported_hardware_level_t;
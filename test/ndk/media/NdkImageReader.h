@@ -0,0 +1,41 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+#include <android/native_window.h>
+#include <media/NdkImage.h>
+#include <media/NdkMediaError.h>
+
+typedef struct AImageReader AImageReader;
+
+typedef void (*AImageReader_ImageCallback)(void* context,
+                                           AImageReader* reader);
+
+typedef struct AImageReader_ImageListener {
+    void* context;
+    AImageReader_ImageCallback onImageAvailable;
+} AImageReader_ImageListener;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+media_status_t AImageReader_new(int32_t width, int32_t height, int32_t format,
+                                int32_t maxImages, AImageReader** reader);
+void AImageReader_delete(AImageReader* reader);
+media_status_t AImageReader_getWindow(AImageReader* reader,
+                                      ANativeWindow** window);
+media_status_t AImageReader_acquireNextImage(AImageReader* reader,
+                                             AImage** image);
+media_status_t AImageReader_acquireLatestImage(AImageReader* reader,
+                                               AImage** image);
+media_status_t
+AImageReader_setImageListener(AImageReader* reader,
+                              AImageReader_ImageListener* listener);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,21 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK header. Only the declarations used by the library
+//
+#pragma once
+
+typedef enum {
+    AMEDIA_OK = 0,
+    AMEDIA_ERROR_BASE = -10000,
+    AMEDIA_ERROR_UNKNOWN = AMEDIA_ERROR_BASE,
+    AMEDIA_ERROR_MALFORMED = AMEDIA_ERROR_BASE - 1,
+    AMEDIA_ERROR_UNSUPPORTED = AMEDIA_ERROR_BASE - 2,
+    AMEDIA_ERROR_INVALID_OBJECT = AMEDIA_ERROR_BASE - 3,
+    AMEDIA_ERROR_INVALID_PARAMETER = AMEDIA_ERROR_BASE - 4,
+    AMEDIA_ERROR_INVALID_OPERATION = AMEDIA_ERROR_BASE - 5,
+    AMEDIA_IMGREADER_ERROR_BASE = -30000,
+    AMEDIA_IMGREADER_NO_BUFFER_AVAILABLE = AMEDIA_IMGREADER_ERROR_BASE - 1,
+    AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED = AMEDIA_IMGREADER_ERROR_BASE - 2,
+} media_status_t;
@@ -0,0 +1,209 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `perf_profiler_t` with the scopes of the library. The counters are checked
+//  only if the host allows `perf_event_open`
+//
+#include <ndk_camera.h>
+#include <ndk_camera_convert.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_perf.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// the work which the compiler can't remove
+static uint64_t busy(uint32_t count) {
+    volatile uint64_t sum = 0;
+    for (auto i = 0u; i < count; ++i)
+        sum = sum + i * i;
+    return sum;
+}
+
+void no_profiler() {
+    set_perf_profiler(nullptr);
+    perf_profiler_t profiler{{}};
+    {
+        perf_scope_t scope{perf_stage_t::convert};
+        busy(1000);
+    }
+    check(profiler.get_summary(perf_stage_t::convert).count == 0,
+          "not attached");
+    check(profiler.to_json() == "{\"stages\":[]}", "no stage in the json");
+}
+
+void scopes_and_counters() {
+    const auto available = get_perf_counters();
+    printf("counters: %x\n", available);
+
+    perf_profiler_t profiler{{}};
+    set_perf_profiler(&profiler);
+    for (auto i = 0; i < 20; ++i) {
+        perf_scope_t scope{perf_stage_t::convert};
+        busy(100'000);
+    }
+    // the other threads have their own counters
+    vector<thread> threads{};
+    for (auto t = 0; t < 4; ++t)
+        threads.emplace_back([]() {
+            for (auto i = 0; i < 10; ++i) {
+                perf_scope_t scope{perf_stage_t::resize};
+                busy(10'000);
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    set_perf_profiler(nullptr);
+
+    auto summary = profiler.get_summary(perf_stage_t::convert);
+    check(summary.count == 20, "scope count");
+    check(summary.wall_time > 0 && summary.wall_time_max > 0 &&
+              summary.wall_time_max <= summary.wall_time,
+          "wall time");
+    check(profiler.get_summary(perf_stage_t::resize).count == 40,
+          "scopes of the threads");
+    check(profiler.get_summary(perf_stage_t::motion).count == 0,
+          "no scope of the stage");
+
+    const auto instructions = 1u << static_cast<uint8_t>(
+                                  perf_counter_t::instructions);
+    if (available & instructions) {
+        check(summary.counted > 0, "counted scopes");
+        check(summary.counter_mask == available, "counters of the scopes");
+        // 100'000 iterations are more than 100'000 instructions
+        check(summary.counters[1] / summary.counted > 100'000,
+              "instructions of the scope");
+    } else {
+        check(summary.counted == 0 && summary.counter_mask == 0,
+              "wall time only");
+    }
+
+    const auto json = profiler.to_json();
+    check(json.find("\"name\":\"convert\",\"count\":20") != string::npos,
+          "stage in the json");
+    check(json.find("\"name\":\"resize\"") != string::npos,
+          "stage of the threads in the json");
+    check(json.find("motion") == string::npos, "empty stage is omitted");
+    check((json.find("\"instructions\":") != string::npos) ==
+              ((available & instructions) != 0),
+          "counter in the json");
+    printf("%s\n", json.c_str());
+
+    profiler.reset();
+    check(profiler.get_summary(perf_stage_t::convert).count == 0, "reset");
+}
+
+void wall_time_only() {
+    perf_config_t config{};
+    config.counters = false;
+    perf_profiler_t profiler{config};
+    set_perf_profiler(&profiler);
+    {
+        perf_scope_t scope{perf_stage_t::statistics};
+        this_thread::sleep_for(2ms);
+    }
+    set_perf_profiler(nullptr);
+    const auto summary = profiler.get_summary(perf_stage_t::statistics);
+    check(summary.count == 1 && summary.counted == 0, "no counter");
+    check(summary.wall_time >= 2'000'000, "wall time of the sleep");
+}
+
+static void on_image(void* ptr, AImage* image, const frame_info_t& info) {
+    auto& context = *reinterpret_cast<camera_group_t*>(ptr);
+    yuv_planes_t planes{};
+    if (get_yuv_planes(image, planes) == AMEDIA_OK) {
+        vector<uint8_t> rgba(planes.width * planes.height * 4);
+        convert_yuv_to_rgba(planes, rgba.data(), planes.width * 4, {});
+    }
+    release_image(context, info.id, image);
+}
+
+static void on_capture_started(void* ptr, ACameraCaptureSession* session,
+                               const ACaptureRequest* request,
+                               int64_t timestamp) {
+    auto& context = *reinterpret_cast<camera_group_t*>(ptr);
+    context_on_capture_started(context, session, request,
+                               static_cast<uint64_t>(timestamp));
+}
+static void on_capture_completed(void* ptr, ACameraCaptureSession* session,
+                                 ACaptureRequest* request,
+                                 const ACameraMetadata* result) {
+    auto& context = *reinterpret_cast<camera_group_t*>(ptr);
+    context_on_capture_completed(context, session, request, result);
+}
+
+void stages_of_stream() {
+    perf_profiler_t profiler{{}};
+    set_perf_profiler(&profiler);
+
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    context.image_consumer = on_image;
+    context.image_consumer_context = &context;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    capture_callbacks.context = &context;
+    capture_callbacks.onCaptureStarted = on_capture_started;
+    capture_callbacks.onCaptureCompleted = on_capture_completed;
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 320, 240, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&profiler]() {
+              return profiler.get_summary(perf_stage_t::convert).count >= 10;
+          }),
+          "converted images");
+    context.close_reader(0);
+    context.close_device(0);
+    context.release();
+    ANativeWindow_release(window);
+    set_perf_profiler(nullptr);
+
+    check(profiler.get_summary(perf_stage_t::open_device).count == 1,
+          "open_device stage");
+    check(profiler.get_summary(perf_stage_t::start_repeat).count == 1,
+          "start_repeat stage");
+    check(profiler.get_summary(perf_stage_t::capture_started).count > 0,
+          "capture_started stage");
+    check(profiler.get_summary(perf_stage_t::capture_completed).count > 0,
+          "capture_completed stage");
+    const auto images = profiler.get_summary(perf_stage_t::image_available);
+    const auto consume = profiler.get_summary(perf_stage_t::consume);
+    check(images.count >= consume.count && consume.count >= 10,
+          "image stages");
+    // inclusive. the consumer runs in the listener
+    check(images.wall_time >= consume.wall_time, "nested scope");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    no_profiler();
+    scopes_and_counters();
+    wall_time_only();
+    stages_of_stream();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Lossless round trip, eviction and the concurrent snapshot of
+//  `preevent_ring_t`
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_preevent.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// NV21 with the padding of the rows. a moving disk on the gradient
+struct scene_t final {
+    uint32_t width, height, row_stride;
+    vector<uint8_t> y, vu;
+    uint32_t seed = 1;
+
+  public:
+    scene_t(uint32_t _width, uint32_t _height)
+        : width{_width}, height{_height}, row_stride{_width + 32},
+          y(row_stride * height), vu(row_stride * ((height + 1) / 2)) {
+    }
+
+    uint32_t noise() noexcept {
+        seed = seed * 1664525 + 1013904223;
+        return seed >> 24;
+    }
+    void draw(uint32_t frame, bool random = false) {
+        const auto cx = (frame * 7) % width, cy = (frame * 3) % height;
+        for (auto j = 0u; j < height; ++j)
+            for (auto i = 0u; i < width; ++i) {
+                const auto dx = int64_t{i} - cx, dy = int64_t{j} - cy;
+                const bool disk = dx * dx + dy * dy < 40 * 40;
+                const auto value = (i / 4 + j / 3 + (disk ? 96 : 0)) +
+                                   noise() % 3;
+                y[j * row_stride + i] =
+                    static_cast<uint8_t>(random ? noise() : value);
+            }
+        for (auto j = 0u; j < (height + 1) / 2; ++j)
+            for (auto i = 0u; i < (width + 1) / 2; ++i) {
+                vu[j * row_stride + 2 * i] =
+                    static_cast<uint8_t>(random ? noise() : 128 + i / 16);
+                vu[j * row_stride + 2 * i + 1] =
+                    static_cast<uint8_t>(random ? noise() : 128 - j / 16);
+            }
+    }
+    auto view(int64_t timestamp) const -> frame_view_t {
+        const auto cw = (width + 1) / 2, ch = (height + 1) / 2;
+        frame_view_t frame{};
+        frame.format = AIMAGE_FORMAT_YUV_420_888;
+        frame.width = width;
+        frame.height = height;
+        frame.timestamp = timestamp;
+        frame.plane_count = 3;
+        frame.planes[0] = make_plane_view(y.data(), row_stride, width, height);
+        frame.planes[1] =
+            make_plane_view(vu.data() + 1, row_stride, cw, ch, 2);
+        frame.planes[2] = make_plane_view(vu.data(), row_stride, cw, ch, 2);
+        return frame;
+    }
+};
+
+// planar(I420) copy of the view
+static auto get_i420(const frame_view_t& frame) -> vector<uint8_t> {
+    vector<uint8_t> output{};
+    for (auto p = 0u; p < 3; ++p) {
+        const auto& plane = frame.planes[p];
+        for (auto j = 0u; j < plane.height; ++j)
+            for (auto i = 0u; i < plane.width; ++i)
+                output.emplace_back(plane.at(i, j));
+    }
+    return output;
+}
+
+static bool round_trip(preevent_ring_t& ring, const frame_view_t& frame) {
+    ring.clear();
+    if (ring.push(frame) != AMEDIA_OK)
+        return false;
+    vector<encoded_frame_ptr> window{};
+    ring.snapshot(window);
+    if (window.size() != 1)
+        return false;
+    vector<uint8_t> decoded(get_decoded_size(*window[0]));
+    return decode_frame(*window[0], decoded) && decoded == get_i420(frame) &&
+           window[0]->timestamp == frame.timestamp;
+}
+
+void lossless_round_trip() {
+    for (auto tile_rows : {16u, 64u, 7u}) {
+        preevent_config_t config{};
+        config.tile_rows = tile_rows;
+        preevent_ring_t ring{config};
+        for (auto [width, height] : {pair{320u, 240u}, pair{641u, 363u},
+                                     pair{2u, 1u}, pair{17u, 130u}}) {
+            scene_t scene{width, height};
+            scene.draw(5);
+            const auto frame = scene.view(1'000);
+            check(round_trip(ring, frame), "round trip");
+            if (width < 8 || height < 8)
+                continue;
+            check(round_trip(ring, frame.crop(image_roi_t{3, 5, 101, 77})),
+                  "round trip of the crop");
+            check(round_trip(ring, frame.subsample(3)),
+                  "round trip of the subsample");
+        }
+    }
+}
+
+void compression(uint32_t width, uint32_t height) {
+    preevent_config_t config{};
+    preevent_ring_t ring{config};
+    scene_t scene{width, height};
+
+    scene.draw(1);
+    ring.push(scene.view(1));
+    auto stats = ring.get_stats();
+    const auto ratio = static_cast<double>(stats.bytes) / stats.raw_bytes;
+    printf("%ux%u: %.3f of raw, %.2f ms\n", width, height, ratio,
+           stats.encode_time / 1e6);
+    check(ratio < 0.6, "smooth scene is compressed");
+
+    // the tiles of noise are stored as raw
+    scene.draw(2, true);
+    ring.clear();
+    ring.push(scene.view(2));
+    stats = ring.get_stats();
+    check(stats.bytes <= stats.raw_bytes + get_tile_count(height, 64),
+          "noise is not expanded");
+    check(round_trip(ring, scene.view(3)), "round trip of the noise");
+}
+
+void eviction() {
+    scene_t scene{160, 120};
+    scene.draw(0);
+    const auto interval = nanoseconds{33'333'333};
+
+    preevent_config_t config{};
+    config.max_duration = 1s;
+    config.threads = 0;
+    preevent_ring_t ring{config};
+    for (auto i = 0; i < 60; ++i)
+        ring.push(scene.view(i * interval.count()));
+    auto stats = ring.get_stats();
+    check(stats.frames == 31, "evicted by the duration");
+    check(stats.pushed == 60 && stats.evicted == 29, "eviction count");
+
+    ring.clear();
+    ring.push(scene.view(0));
+    const auto frame_bytes = ring.get_stats().bytes;
+
+    resource_tracker_t resources{};
+    config.max_bytes = frame_bytes * 5 + frame_bytes / 2;
+    config.resources = &resources;
+    {
+        preevent_ring_t small{config};
+        for (auto i = 0; i < 20; ++i)
+            small.push(scene.view(i * interval.count()));
+        stats = small.get_stats();
+        check(stats.bytes <= config.max_bytes, "evicted by the bytes");
+        check(stats.frames == 5, "frames in the bytes");
+
+        const auto tracked = resources.get_stats(
+            resource_type_t::frame_buffer, resource_tracker_t::shared_id);
+        check(tracked.live == 5, "the ring is accounted");
+        check(tracked.bytes == static_cast<int64_t>(stats.bytes),
+              "bytes of the ring");
+        check(tracked.total == 20, "each push is accounted");
+    }
+    check(resources.get_stats(resource_type_t::frame_buffer).live == 0,
+          "the ring releases the frames");
+}
+
+void snapshot_while_pushing() {
+    preevent_config_t config{};
+    config.max_duration = 200ms;
+    preevent_ring_t ring{config};
+
+    atomic<bool> done{};
+    thread producer{[&ring, &done]() {
+        scene_t scene{320, 240};
+        for (auto i = 0u; i < 200; ++i) {
+            scene.draw(i);
+            ring.push(scene.view(int64_t{i} * 10'000'000));
+        }
+        done = true;
+    }};
+    uint32_t snapshots = 0;
+    auto ok = true;
+    vector<encoded_frame_ptr> window{};
+    vector<uint8_t> decoded{};
+    while (done == false) {
+        ring.snapshot(window);
+        if (window.empty())
+            continue;
+        decoded.resize(get_decoded_size(*window.front()));
+        ok &= decode_frame(*window.front(), decoded);
+        ++snapshots;
+    }
+    producer.join();
+    check(ok, "snapshot frames are valid while pushing");
+    check(snapshots > 0, "snapshot count");
+    check(ring.get_stats().frames <= 21, "window of 200 ms");
+
+    const char* path = "preevent_test.bin";
+    ring.snapshot(window);
+    check(ring.save(path) == 0, "save");
+    size_t expected = 12;
+    for (const auto& frame : window)
+        expected += 8 + 20 + 4 * frame->offsets.size() + frame->data.size();
+    if (auto* stream = fopen(path, "rb")) {
+        fseek(stream, 0, SEEK_END);
+        check(static_cast<size_t>(ftell(stream)) == expected, "file size");
+        fclose(stream);
+    }
+    remove(path);
+    check(ring.save("/no/such/directory/file") != 0, "error of the save");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    lossless_round_trip();
+    compression(1920, 1080);
+    eviction();
+    snapshot_while_pushing();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `develop_raw16` with the synthetic mosaics of known colors
+//
+#include <ndk_camera_executor.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_raw.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// linear RGB of a pixel. 0 ~ 1
+using color_t = array<double, 3>;
+using color_function_t = color_t (*)(uint32_t x, uint32_t y);
+
+static constexpr uint8_t colors[4][4]{
+    {0, 1, 1, 2}, {1, 0, 2, 1}, {1, 2, 0, 1}, {2, 1, 1, 0}};
+
+// sample the colors with the sensor's pattern and levels
+static auto make_mosaic(const raw_params_t& params, uint32_t width,
+                        uint32_t height, color_function_t color)
+    -> vector<uint16_t> {
+    vector<uint16_t> mosaic(width * height);
+    const auto* pattern = colors[static_cast<uint8_t>(params.pattern)];
+    for (auto y = 0u; y < height; ++y)
+        for (auto x = 0u; x < width; ++x) {
+            const auto pos = (y & 1) * 2 + (x & 1);
+            const auto black = params.black_level[pos];
+            const auto value = color(x, y)[pattern[pos]];
+            mosaic[y * width + x] = static_cast<uint16_t>(
+                lround(black + value * (params.white_level - black)));
+        }
+    return mosaic;
+}
+
+static auto make_params(bayer_pattern_t pattern) -> raw_params_t {
+    raw_params_t params{};
+    params.pattern = pattern;
+    params.black_level = {64, 64, 64, 64};
+    params.white_level = 1023;
+    return params;
+}
+
+static color_t flat(uint32_t, uint32_t) {
+    return {0.25, 0.5, 0.75};
+}
+static color_t gray_step(uint32_t x, uint32_t) {
+    const auto v = x < 33 ? 0.2 : 0.8;
+    return {v, v, v};
+}
+static color_t diagonal(uint32_t x, uint32_t y) {
+    return {(x % 97) / 97.0, (y % 89) / 89.0, ((x + y) % 61) / 61.0};
+}
+
+// max difference from the color, in 16 bit
+static auto get_max_error(const vector<uint16_t>& rgb, uint32_t width,
+                          uint32_t height, color_function_t color) -> double {
+    auto error = 0.0;
+    for (auto y = 0u; y < height; ++y)
+        for (auto x = 0u; x < width; ++x) {
+            const auto expected = color(x, y);
+            for (auto c = 0u; c < 3; ++c) {
+                const auto value = rgb[(y * width + x) * 3 + c] / 65535.0;
+                error = max(error, abs(value - expected[c]) * 65535);
+            }
+        }
+    return error;
+}
+
+void read_params() {
+    ACameraManager* manager = ACameraManager_create();
+    ACameraIdList* id_list = nullptr;
+    ACameraManager_getCameraIdList(manager, &id_list);
+    ACameraMetadata* metadata = nullptr;
+    ACameraManager_getCameraCharacteristics(manager, id_list->cameraIds[0],
+                                            &metadata);
+    raw_params_t params{};
+    params.gains = {2, 2, 2, 2};
+    check(read_raw_params(metadata, nullptr, params) == ACAMERA_OK,
+          "read_raw_params");
+    check(params.pattern == bayer_pattern_t::rggb, "pattern");
+    check(params.white_level == 1023, "white level");
+    check(params.black_level[3] == 64, "black level");
+    check(params.gains[0] == 1 && params.shading_map.empty(),
+          "no gains without the result");
+    ACameraMetadata_free(metadata);
+    ACameraManager_deleteCameraIdList(id_list);
+    ACameraManager_delete(manager);
+}
+
+// the levels are removed for each pattern and each output
+void flat_colors() {
+    constexpr uint32_t width = 64, height = 48;
+    raw_config_t config{};
+    config.bands = 1;
+    for (auto p = 0u; p < 4; ++p) {
+        const auto params = make_params(static_cast<bayer_pattern_t>(p));
+        const auto mosaic = make_mosaic(params, width, height, flat);
+        vector<uint16_t> rgb(width * height * 3);
+        for (auto demosaic :
+             {raw_demosaic_t::bilinear, raw_demosaic_t::edge_aware}) {
+            config.demosaic = demosaic;
+            develop_raw16(mosaic.data(), width * 2, width, height, params,
+                          config, rgb.data(), width * 6);
+            // 1 step of the 10 bit sensor is 68 in 16 bit
+            check(get_max_error(rgb, width, height, flat) < 70,
+                  "flat color in 16 bit");
+        }
+        vector<uint8_t> rgb8(width * height * 3);
+        develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                      rgb8.data(), width * 3);
+        // sRGB of 0.25, 0.5, 0.75
+        check(abs(rgb8[0] - 137) <= 1 && abs(rgb8[1] - 188) <= 1 &&
+                  abs(rgb8[2] - 225) <= 1,
+              "flat color in 8 bit sRGB");
+    }
+}
+
+void shading_and_gains() {
+    constexpr uint32_t width = 64, height = 48;
+    auto params = make_params(bayer_pattern_t::grbg);
+    const auto mosaic = make_mosaic(params, width, height, flat);
+    // 1 at the left, 1.5 at the right. the red is 2 more
+    params.shading_width = params.shading_height = 2;
+    params.shading_map = {
+        1, 1, 1, 1, 1.5f, 1.5f, 1.5f, 1.5f, //
+        1, 1, 1, 1, 1.5f, 1.5f, 1.5f, 1.5f, //
+    };
+    params.gains = {2, 1, 1, 1};
+    raw_config_t config{};
+    vector<uint16_t> rgb(width * height * 3);
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  rgb.data(), width * 6);
+
+    // the neighbors of the last column have a bit smaller gain
+    const auto* left = rgb.data() + (height / 2 * width) * 3;
+    const auto* right = left + (width - 1) * 3;
+    check(abs(left[0] - 0.5 * 65535) < 600, "red gain");
+    check(abs(left[2] - 0.75 * 65535) < 600, "blue at the left");
+    check(abs(right[0] - 0.75 * 65535) < 600, "shaded red at the right");
+    check(abs(right[1] - 0.75 * 65535) < 600, "shaded green at the right");
+    check(right[2] == 65535, "clipped blue");
+}
+
+// gray edge. the bilinear mixes the sides and makes false colors
+void edges() {
+    constexpr uint32_t width = 64, height = 32;
+    const auto params = make_params(bayer_pattern_t::rggb);
+    const auto mosaic = make_mosaic(params, width, height, gray_step);
+    vector<uint16_t> rgb(width * height * 3);
+    raw_config_t config{};
+    config.demosaic = raw_demosaic_t::bilinear;
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  rgb.data(), width * 6);
+    const auto bilinear = get_max_error(rgb, width, height, gray_step);
+    config.demosaic = raw_demosaic_t::edge_aware;
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  rgb.data(), width * 6);
+    const auto edge_aware = get_max_error(rgb, width, height, gray_step);
+    printf("error at the edge: bilinear %.0f, edge_aware %.0f\n", bilinear,
+           edge_aware);
+    check(bilinear > 10'000, "bilinear blurs the edge");
+    check(edge_aware < 70, "edge_aware keeps the edge");
+}
+
+// the bands and the SIMD/scalar columns must not change the result
+void bands() {
+    constexpr uint32_t width = 203, height = 157;
+    const auto params = make_params(bayer_pattern_t::bggr);
+    const auto mosaic = make_mosaic(params, width, height, diagonal);
+    vector<uint16_t> expected(width * height * 3), rgb(expected.size());
+    raw_config_t config{};
+    config.bands = 1;
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  expected.data(), width * 6);
+
+    config.bands = 4;
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  rgb.data(), width * 6);
+    check(rgb == expected, "bands in the threads");
+
+    executor_config_t executor_config{};
+    executor_config.lanes[1].threads = 2;
+    camera_executor_t executor{executor_config};
+    config.executor = &executor;
+    config.bands = 9;
+    rgb.assign(rgb.size(), 0);
+    develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                  rgb.data(), width * 6);
+    check(rgb == expected, "bands in the executor");
+}
+
+// noise over the whole range. the gradients and the clamps take every path
+static color_t noise(uint32_t x, uint32_t y) {
+    auto seed = x * 7919u + y * 104729u;
+    color_t color{};
+    for (auto& value : color) {
+        seed = seed * 1664525 + 1013904223;
+        value = (seed >> 8) / static_cast<double>(1 << 24);
+    }
+    return color;
+}
+
+// the vector kernels must be same with the scalar ones. odd widths for the
+// tails, and the row of 8 pixels
+void vector_and_scalar() {
+    const uint32_t sizes[][2] = {{203, 37}, {37, 11}, {9, 6}, {8, 5}, {3, 2}};
+    auto ok = true;
+    for (const auto& size : sizes)
+        for (auto p = 0u; p < 4; ++p) {
+            const auto width = size[0], height = size[1];
+            auto params = make_params(static_cast<bayer_pattern_t>(p));
+            params.gains = {1.7f, 1, 1, 2.3f}; // clipped highlights
+            const auto mosaic = make_mosaic(params, width, height, noise);
+            for (auto demosaic :
+                 {raw_demosaic_t::bilinear, raw_demosaic_t::edge_aware}) {
+                raw_config_t config{};
+                config.demosaic = demosaic;
+                config.bands = 1;
+                config.vectorize = false;
+                vector<uint16_t> expected(width * height * 3),
+                    rgb(expected.size());
+                develop_raw16(mosaic.data(), width * 2, width, height, params,
+                              config, expected.data(), width * 6);
+                vector<uint8_t> expected8(expected.size()), rgb8(rgb.size());
+                develop_raw16(mosaic.data(), width * 2, width, height, params,
+                              config, expected8.data(), width * 3);
+
+                config.vectorize = true;
+                develop_raw16(mosaic.data(), width * 2, width, height, params,
+                              config, rgb.data(), width * 6);
+                develop_raw16(mosaic.data(), width * 2, width, height, params,
+                              config, rgb8.data(), width * 3);
+                ok &= rgb == expected && rgb8 == expected8;
+            }
+        }
+    check(ok, "vector kernels are same with the scalar ones");
+}
+
+void frame_views() {
+    constexpr uint32_t width = 64, height = 48;
+    const auto params = make_params(bayer_pattern_t::rggb);
+    const auto mosaic = make_mosaic(params, width, height, flat);
+    const auto* data = reinterpret_cast<const uint8_t*>(mosaic.data());
+    frame_view_t frame{};
+    frame.format = AIMAGE_FORMAT_RAW16;
+    frame.width = width;
+    frame.height = height;
+    frame.plane_count = 1;
+    frame.planes[0] = make_plane_view(data, width * 2, width, height, 2);
+
+    vector<uint16_t> rgb(width * height * 3);
+    raw_config_t config{};
+    check(develop_raw16(frame, params, config, rgb.data(), width * 6) ==
+              AMEDIA_OK,
+          "RAW16 frame");
+    check(get_max_error(rgb, width, height, flat) < 70, "color of the frame");
+    check(develop_raw16(frame.subsample(2), params, config, rgb.data(),
+                        width * 6) == AMEDIA_ERROR_UNSUPPORTED,
+          "subsampled frame");
+    frame.format = AIMAGE_FORMAT_YUV_420_888;
+    check(develop_raw16(frame, params, config, rgb.data(), width * 6) ==
+              AMEDIA_ERROR_INVALID_PARAMETER,
+          "not RAW16");
+}
+
+// 12 MP of a burst
+void throughput() {
+    constexpr uint32_t width = 4000, height = 3000;
+    const auto params = make_params(bayer_pattern_t::rggb);
+    const auto mosaic = make_mosaic(params, width, height, diagonal);
+    vector<uint8_t> rgb(width * height * 3);
+    for (auto bands : {1u, 0u}) {
+        raw_config_t config{};
+        config.bands = bands;
+        const auto begin = steady_clock::now();
+        develop_raw16(mosaic.data(), width * 2, width, height, params, config,
+                      rgb.data(), width * 3);
+        const auto elapsed = steady_clock::now() - begin;
+        printf("%ux%u with %u bands: %lld ms\n", width, height, bands,
+               static_cast<long long>(
+                   duration_cast<milliseconds>(elapsed).count()));
+    }
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    read_params();
+    flat_colors();
+    shading_and_gains();
+    edges();
+    bands();
+    vector_and_scalar();
+    frame_views();
+    throughput();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
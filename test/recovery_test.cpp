@@ -0,0 +1,282 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Device disconnect/error on the host stand-in and the recovery of
+//  `recovery_engine_t`
+//
+#include <ndk_camera.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_recovery.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+struct probe_t final {
+    camera_group_t* context;
+    atomic<uint32_t> completed{};
+    atomic<uint32_t> finished{}; // incidents
+};
+
+static void on_device_disconnected(void* ptr, ACameraDevice* device) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    context_on_device_disconnected(*probe.context, device);
+}
+static void on_device_error(void* ptr, ACameraDevice* device, int error) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    context_on_device_error(*probe.context, device, error);
+}
+static void on_capture_completed(void* ptr, ACameraCaptureSession* session,
+                                 ACaptureRequest* request,
+                                 const ACameraMetadata* result) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    context_on_capture_completed(*probe.context, session, request, result);
+    probe.completed += 1;
+}
+static void on_incident(void* ptr, const recovery_incident_t&) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    probe.finished += 1;
+}
+
+struct fixture_t final {
+    camera_group_t context{};
+    probe_t probe{};
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    ANativeWindow* window = nullptr;
+
+  public:
+    fixture_t() {
+        context.manager = ACameraManager_create();
+        ACameraManager_getCameraIdList(context.manager, &context.id_list);
+        for (auto i = 0; i < context.id_list->numCameras; ++i)
+            ACameraManager_getCameraCharacteristics(
+                context.manager, context.id_list->cameraIds[i],
+                &context.metadata_set[i]);
+        probe.context = &context;
+        device_callbacks.context = &probe;
+        device_callbacks.onDisconnected = on_device_disconnected;
+        device_callbacks.onError = on_device_error;
+        session_callbacks.context = &probe;
+        capture_callbacks.context = &probe;
+        capture_callbacks.onCaptureCompleted = on_capture_completed;
+        window = stand_in_create_window(640, 480);
+    }
+    ~fixture_t() {
+        context.release();
+        ANativeWindow_release(window);
+    }
+
+    bool start(uint16_t id) {
+        return context.open_device(id, device_callbacks) == ACAMERA_OK &&
+               context.start_repeat(id, window, session_callbacks,
+                                    capture_callbacks) == ACAMERA_OK;
+    }
+    // wait for more frames of the repeating request
+    bool stream(uint32_t frames) {
+        const auto base = probe.completed.load();
+        return wait_for([&]() { return probe.completed >= base + frames; });
+    }
+    bool wait_incident(uint32_t count) {
+        return wait_for([&]() { return probe.finished >= count; });
+    }
+};
+
+static auto last_incident(recovery_engine_t& recovery, uint16_t id)
+    -> recovery_incident_t {
+    vector<recovery_incident_t> incidents{};
+    recovery.get_incidents(id, incidents);
+    return incidents.empty() ? recovery_incident_t{} : incidents.back();
+}
+
+void disconnect_restores_repeat(const recovery_config_t& config) {
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    recovery.set_listener(on_incident, &fixture.probe);
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(0), "start");
+    check(fixture.stream(3), "stream before the disconnect");
+    stand_in_raise_device_error(0, 0);
+    check(fixture.wait_incident(1), "incident is finished");
+    check(fixture.stream(3), "stream after the recovery");
+
+    const auto incident = last_incident(recovery, 0);
+    check(incident.recovered, "disconnect is recovered");
+    check(incident.error == 0, "disconnect has no error code");
+    check(incident.attempts == 1, "first attempt succeeds");
+    check(incident.end > incident.begin, "downtime is measured");
+    fixture.context.recovery = nullptr;
+}
+
+void error_retries_with_backoff(const recovery_config_t& config) {
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    recovery.set_listener(on_incident, &fixture.probe);
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(1), "start");
+    stand_in_fail_open(3, ACAMERA_ERROR_CAMERA_DISCONNECTED);
+    stand_in_raise_device_error(1, ERROR_CAMERA_SERVICE);
+    check(fixture.wait_incident(1), "incident is finished");
+    check(fixture.stream(3), "stream after the recovery");
+
+    const auto incident = last_incident(recovery, 1);
+    check(incident.recovered, "service error is recovered");
+    check(incident.error == ERROR_CAMERA_SERVICE, "error code is reported");
+    check(incident.attempts == 4, "3 failures and 1 success");
+    // 1x + 2x + 4x of the initial delay
+    const auto downtime = nanoseconds{incident.end - incident.begin};
+    check(downtime >= config.initial_delay * 7, "retries are delayed");
+    fixture.context.recovery = nullptr;
+}
+
+void disabled_is_fatal(const recovery_config_t& config) {
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    recovery.set_listener(on_incident, &fixture.probe);
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(0), "start");
+    stand_in_raise_device_error(0, ERROR_CAMERA_DISABLED);
+    check(fixture.wait_incident(1), "incident is finished");
+
+    const auto incident = last_incident(recovery, 0);
+    check(incident.fatal, "disabled is fatal");
+    check(incident.recovered == false, "fatal error is not recovered");
+    check(incident.attempts == 0, "no reopen for the fatal error");
+    check(fixture.context.device_set[0] == nullptr, "dead device is closed");
+    fixture.context.recovery = nullptr;
+}
+
+void gives_up_after_max_attempts(recovery_config_t config) {
+    config.max_attempts = 3;
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    recovery.set_listener(on_incident, &fixture.probe);
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(0), "start");
+    stand_in_fail_open(100, ACAMERA_ERROR_CAMERA_DISCONNECTED);
+    stand_in_raise_device_error(0, ERROR_CAMERA_DEVICE);
+    check(fixture.wait_incident(1), "incident is finished");
+    stand_in_fail_open(0, ACAMERA_OK);
+
+    const auto incident = last_incident(recovery, 0);
+    check(incident.recovered == false, "not recovered");
+    check(incident.attempts == 3, "limited attempts");
+    check(incident.end == 0, "no end for the failure");
+    check(fixture.context.device_set[0] == nullptr, "device is closed");
+    fixture.context.recovery = nullptr;
+}
+
+void close_cancels_recovery(const recovery_config_t& config) {
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(0), "start");
+    stand_in_fail_open(100, ACAMERA_ERROR_CAMERA_DISCONNECTED);
+    stand_in_raise_device_error(0, ERROR_CAMERA_DEVICE);
+    check(wait_for([&]() { return recovery.is_recovering(0); }),
+          "recovery starts");
+    fixture.context.close_device(0);
+    check(recovery.is_recovering(0) == false, "app's close cancels it");
+    stand_in_fail_open(0, ACAMERA_OK);
+    this_thread::sleep_for(config.initial_delay * 4);
+    check(fixture.context.device_set[0] == nullptr, "no reopen after close");
+    fixture.context.recovery = nullptr;
+}
+
+// the app stops the stream while the reopen is delayed
+void stop_refreshes_recovery(const recovery_config_t& config) {
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    recovery.set_listener(on_incident, &fixture.probe);
+    fixture.context.recovery = &recovery;
+
+    check(fixture.start(0), "start");
+    stand_in_fail_open(2, ACAMERA_ERROR_CAMERA_DISCONNECTED);
+    stand_in_raise_device_error(0, ERROR_CAMERA_DEVICE);
+    check(wait_for([&]() { return recovery.is_recovering(0); }),
+          "recovery starts");
+    fixture.context.stop_repeat(0);
+    check(recovery.is_recovering(0), "stop doesn't cancel it");
+    check(fixture.wait_incident(1), "incident is finished");
+
+    check(last_incident(recovery, 0).recovered, "device is reopened");
+    check(fixture.context.device_set[0] != nullptr, "device is opened");
+    check(fixture.context.session_set[0] == nullptr, "no stream is restored");
+    fixture.context.recovery = nullptr;
+}
+
+// the app's operations race with the reopen of the same device
+void operations_during_recovery(recovery_config_t config) {
+    config.initial_delay = 1ms;
+    fixture_t fixture{};
+    recovery_engine_t recovery{fixture.context, config};
+    fixture.context.recovery = &recovery;
+
+    for (auto i = 0u; i < 50; ++i) {
+        if (check(fixture.start(0), "start") == false)
+            break;
+        stand_in_raise_device_error(0, i % 2 ? ERROR_CAMERA_SERVICE : 0);
+        // the failure of the broken device is expected
+        fixture.context.stop_repeat(0);
+        fixture.context.start_repeat(0, fixture.window,
+                                     fixture.session_callbacks,
+                                     fixture.capture_callbacks);
+        if (i % 3 == 0)
+            this_thread::sleep_for(200us);
+        fixture.context.close_device(0);
+    }
+    check(recovery.is_recovering(0) == false, "close cancels it");
+    check(fixture.context.device_set[0] == nullptr, "device is closed");
+    check(fixture.context.session_set[0] == nullptr, "session is closed");
+    fixture.context.recovery = nullptr;
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    stand_in_config_t config{};
+    config.frame_interval = 1ms;
+    config.open_latency = 200us;
+    config.session_latency = 100us;
+    stand_in_configure(config);
+
+    recovery_config_t recovery{};
+    recovery.initial_delay = 10ms;
+    recovery.max_delay = 100ms;
+
+    disconnect_restores_repeat(recovery);
+    error_retries_with_backoff(recovery);
+    disabled_is_fatal(recovery);
+    gives_up_after_max_attempts(recovery);
+    close_cancels_recovery(recovery);
+    stop_refreshes_recovery(recovery);
+    operations_during_recovery(recovery);
+
+    for (auto i = 0u; i < static_cast<uint32_t>(stand_in_object_t::count);
+         ++i) {
+        const auto type = static_cast<stand_in_object_t>(i);
+        if (auto count = stand_in_get_live_count(type))
+            fprintf(stderr, "outstanding: %s %lld\n", stand_in_get_name(type),
+                    static_cast<long long>(count)),
+                failures += 1;
+    }
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,330 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `frame_publisher_t` and the subscribers in the forked processes.
+//  The subscribers verify the content of each frame they read in place
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_share.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// NV21 with the padding. the pixels are made from the frame number
+struct source_t final {
+    static constexpr uint32_t width = 160, height = 120, row_stride = 176;
+    vector<uint8_t> y = vector<uint8_t>(row_stride * height);
+    vector<uint8_t> vu = vector<uint8_t>(row_stride * height / 2);
+
+    static uint8_t luma(uint64_t n, uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(n * 7 + x + y * 3);
+    }
+    static uint8_t u(uint64_t n, uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(n * 5 + x * 2 + y);
+    }
+    static uint8_t v(uint64_t n, uint32_t x, uint32_t y) {
+        return static_cast<uint8_t>(n * 3 + x + y * 2 + 1);
+    }
+
+    auto draw(uint64_t n) -> frame_view_t {
+        for (auto j = 0u; j < height; ++j)
+            for (auto i = 0u; i < width; ++i)
+                y[j * row_stride + i] = luma(n, i, j);
+        for (auto j = 0u; j < height / 2; ++j)
+            for (auto i = 0u; i < width / 2; ++i) {
+                vu[j * row_stride + 2 * i] = v(n, i, j);
+                vu[j * row_stride + 2 * i + 1] = u(n, i, j);
+            }
+        frame_view_t frame{};
+        frame.format = AIMAGE_FORMAT_YUV_420_888;
+        frame.width = width;
+        frame.height = height;
+        frame.timestamp = static_cast<int64_t>(n + 1) * 1'000'000;
+        frame.plane_count = 3;
+        frame.planes[0] = make_plane_view(y.data(), row_stride, width, height);
+        frame.planes[1] = make_plane_view(vu.data() + 1, row_stride, width / 2,
+                                          height / 2, 2);
+        frame.planes[2] =
+            make_plane_view(vu.data(), row_stride, width / 2, height / 2, 2);
+        return frame;
+    }
+
+    // the view must be planar and same with `draw(n)`
+    static bool verify(const frame_view_t& frame, uint64_t n) {
+        if (frame.width != width || frame.height != height ||
+            frame.plane_count != 3 || frame.planes[1].pixel_stride != 1)
+            return false;
+        auto ok = true;
+        for (auto j = 0u; j < height; ++j)
+            for (auto i = 0u; i < width; ++i)
+                ok &= frame.planes[0].at(i, j) == luma(n, i, j);
+        for (auto j = 0u; j < height / 2; ++j)
+            for (auto i = 0u; i < width / 2; ++i) {
+                ok &= frame.planes[1].at(i, j) == u(n, i, j);
+                ok &= frame.planes[2].at(i, j) == v(n, i, j);
+            }
+        return ok;
+    }
+};
+
+// frame number is in the timestamp. see `source_t::draw`
+static uint64_t get_number(const shared_frame_t& frame) {
+    return static_cast<uint64_t>(frame.view.timestamp / 1'000'000 - 1);
+}
+
+/**
+ * Subscriber process. Read until the last frame and return the failures.
+ * `delay` is the work for each frame. The entry is kept until `hold` is closed
+ * so the parent can see its accounting
+ */
+static int subscribe(int fd, int hold, uint64_t last, microseconds delay) {
+    frame_subscriber_t subscriber{fd};
+    if (subscriber.is_valid() == false)
+        return 1;
+    int errors = 0;
+    uint64_t previous = 0;
+    auto first = true;
+    shared_frame_t frame{};
+    while (subscriber.wait(2s)) {
+        while (subscriber.acquire(frame)) {
+            const auto n = get_number(frame);
+            const auto content = source_t::verify(frame.view, n);
+            const auto result = frame.has_result == false ||
+                                frame.result.exposure_time ==
+                                    static_cast<int64_t>(n) * 100;
+            this_thread::sleep_for(delay);
+            // the content of the overwritten frame is not reliable
+            if (subscriber.release()) {
+                errors += content ? 0 : 1;
+                errors += result ? 0 : 1;
+                errors += frame.number == n ? 0 : 1;
+                // the frames are in order
+                errors += first || n > previous ? 0 : 1;
+                first = false;
+                previous = n;
+            }
+            if (frame.number == last) {
+                char token{};
+                errors += read(hold, &token, 1) == 0 ? 0 : 1;
+                return errors;
+            }
+        }
+    }
+    return errors + 100; // timeout
+}
+
+static pid_t fork_subscriber(int fd, const int (&hold)[2], uint64_t last,
+                             microseconds delay) {
+    const auto pid = fork();
+    if (pid == 0) {
+        close(hold[1]);
+        _exit(subscribe(fd, hold[0], last, delay));
+    }
+    return pid;
+}
+
+static void wait_subscribers(frame_publisher_t& publisher, size_t count) {
+    vector<share_subscriber_stats_t> subscribers{};
+    for (auto i = 0; i < 2000; ++i) {
+        publisher.get_subscribers(subscribers);
+        if (subscribers.size() == count)
+            return;
+        this_thread::sleep_for(1ms);
+    }
+    check(false, "subscribers are registered");
+}
+
+static bool join(pid_t pid) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || WIFEXITED(status) == false)
+        return false;
+    if (WEXITSTATUS(status) != 0)
+        fprintf(stderr, "subscriber %d: %d errors\n", pid, WEXITSTATUS(status));
+    return WEXITSTATUS(status) == 0;
+}
+
+void fast_and_slow_subscribers() {
+    share_config_t config{};
+    config.slot_count = 4;
+    config.max_frame_bytes = source_t::width * source_t::height * 3 / 2;
+    frame_publisher_t publisher{config};
+    if (check(publisher.get_fd() >= 0, "shared memory") == false)
+        return;
+
+    int hold[2]{};
+    if (check(pipe(hold) == 0, "pipe") == false)
+        return;
+    constexpr uint64_t count = 300;
+    const auto fast = fork_subscriber(publisher.get_fd(), hold, count - 1, 0us);
+    const auto slow = fork_subscriber(publisher.get_fd(), hold, count - 1, 1ms);
+    close(hold[0]);
+    wait_subscribers(publisher, 2);
+
+    source_t source{};
+    for (auto n = 0u; n < count; ++n) {
+        // the results arrive before and after the images
+        capture_result_t result{};
+        result.timestamp = static_cast<int64_t>(n + 1) * 1'000'000;
+        result.exposure_time = static_cast<int64_t>(n) * 100;
+        if (n % 2)
+            publisher.update(result);
+        check(publisher.publish(source.draw(n)) == AMEDIA_OK, "publish");
+        if (n % 2 == 0)
+            publisher.update(result);
+        this_thread::sleep_for(500us);
+    }
+    check(publisher.get_published() == count, "published count");
+
+    // the last values before they exit
+    vector<share_subscriber_stats_t> subscribers{};
+    for (auto i = 0; i < 5000; ++i) {
+        publisher.get_subscribers(subscribers);
+        auto done = true;
+        for (const auto& s : subscribers)
+            done &= s.lag == 0;
+        if (done)
+            break;
+        this_thread::sleep_for(1ms);
+    }
+    uint64_t dropped = 0;
+    for (const auto& s : subscribers) {
+        check(s.received + s.dropped == count, "every frame is accounted");
+        dropped += s.dropped;
+    }
+    check(subscribers.size() == 2, "2 subscribers");
+    close(hold[1]);
+    check(join(fast), "fast subscriber");
+    check(join(slow), "slow subscriber");
+
+    publisher.get_subscribers(subscribers);
+    check(subscribers.empty(), "entries are freed");
+    printf("published %llu, dropped %llu\n",
+           static_cast<unsigned long long>(count),
+           static_cast<unsigned long long>(dropped));
+}
+
+void lagging_subscriber() {
+    share_config_t config{};
+    config.max_frame_bytes = source_t::width * source_t::height * 3 / 2;
+    frame_publisher_t publisher{config};
+    frame_subscriber_t subscriber{publisher.get_fd()};
+    source_t source{};
+    for (auto n = 0u; n < 10; ++n)
+        publisher.publish(source.draw(n));
+
+    // skip to the latest
+    shared_frame_t frame{};
+    check(subscriber.wait(0ms), "frames to read");
+    check(subscriber.acquire(frame) && frame.number == 9, "latest frame");
+    check(source_t::verify(frame.view, 9), "content of the latest");
+    publisher.publish(source.draw(10)); // not the slot in use
+    check(subscriber.release(), "release");
+    auto stats = subscriber.get_stats();
+    check(stats.received == 1 && stats.dropped == 9 && stats.lag == 1,
+          "accounting of the lag");
+
+    // overwritten while it is read
+    check(subscriber.acquire(frame) && frame.number == 10, "next frame");
+    for (auto n = 11u; n < 11 + config.slot_count; ++n)
+        publisher.publish(source.draw(n));
+    check(subscriber.release() == false, "overwrite is detected");
+    stats = subscriber.get_stats();
+    check(stats.received == 1 && stats.dropped == 10, "overwrite is dropped");
+}
+
+void reject_and_invalid() {
+    share_config_t config{};
+    config.max_frame_bytes = 1024;
+    frame_publisher_t publisher{config};
+    source_t source{};
+    check(publisher.publish(source.draw(0)) != AMEDIA_OK, "too large frame");
+    check(publisher.get_rejected() == 1, "rejected count");
+
+    // not a ring
+    int pipes[2]{};
+    if (pipe(pipes) == 0) {
+        frame_subscriber_t subscriber{pipes[0]};
+        check(subscriber.is_valid() == false, "subscribe to a pipe");
+        close(pipes[0]);
+        close(pipes[1]);
+    }
+    // no entry after the max
+    vector<unique_ptr<frame_subscriber_t>> subscribers{};
+    for (auto i = 0; i <= share_header_t::max_subscribers; ++i)
+        subscribers.emplace_back(
+            make_unique<frame_subscriber_t>(publisher.get_fd()));
+    check(subscribers.back()->is_valid() == false, "subscriber limit");
+    shared_frame_t frame{};
+    check(subscribers.front()->wait(10ms) == false, "wait timeout");
+    check(subscribers.front()->acquire(frame) == false, "nothing to read");
+}
+
+// the header written by the other build of the publisher
+template <typename Edit>
+static void edit_header(int fd, Edit&& edit) {
+    auto* ptr = mmap(nullptr, sizeof(share_header_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    if (check(ptr != MAP_FAILED, "map the header") == false)
+        return;
+    edit(*static_cast<share_header_t*>(ptr));
+    munmap(ptr, sizeof(share_header_t));
+}
+
+void mismatched_layout() {
+    frame_publisher_t publisher{share_config_t{}};
+    const auto fd = publisher.get_fd();
+    edit_header(fd, [](share_header_t& header) { header.version = 1; });
+    frame_subscriber_t subscriber{fd};
+    check(subscriber.is_valid() == false, "subscribe to the old version");
+}
+
+void invalid_slots() {
+    frame_publisher_t publisher{share_config_t{}};
+    const auto fd = publisher.get_fd();
+    uint32_t slot_count = 0, slot_size = 0;
+    edit_header(fd, [&](share_header_t& header) {
+        slot_count = header.slot_count;
+        slot_size = header.slot_size;
+    });
+    const auto subscribe = [fd](uint32_t count, uint32_t size) {
+        edit_header(fd, [=](share_header_t& header) {
+            header.slot_count = count;
+            header.slot_size = size;
+        });
+        return frame_subscriber_t{fd}.is_valid();
+    };
+    check(subscribe(0, slot_size) == false, "zero slot");
+    check(subscribe(slot_count + 1, slot_size) == false, "more slots");
+    // the product of the counts wraps around in 32 bit
+    check(subscribe(0x8000'0001, 0x8000'0000) == false, "too large slots");
+    check(subscribe(slot_count * 2, 32) == false, "slot without the header");
+    check(subscribe(slot_count, slot_size) == true, "the original one");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    fast_and_slow_subscribers();
+    lagging_subscriber();
+    reject_and_invalid();
+    mismatched_layout();
+    invalid_slots();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1070 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+#include "stand_in.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static stand_in_config_t config{};
+
+static array<atomic<int64_t>, static_cast<size_t>(stand_in_object_t::count)>
+    live_counts{};
+
+static void track(stand_in_object_t type, int64_t delta) noexcept {
+    live_counts[static_cast<size_t>(type)].fetch_add(delta);
+}
+
+// count the instances of the NDK type
+template <stand_in_object_t Type>
+struct tracked_t {
+    tracked_t() noexcept {
+        track(Type, +1);
+    }
+    tracked_t(const tracked_t&) noexcept {
+        track(Type, +1);
+    }
+    ~tracked_t() noexcept {
+        track(Type, -1);
+    }
+};
+
+void stand_in_configure(const stand_in_config_t& _config) noexcept {
+    config = _config;
+}
+
+auto stand_in_get_live_count(stand_in_object_t type) noexcept -> int64_t {
+    return live_counts[static_cast<size_t>(type)].load();
+}
+
+auto stand_in_get_name(stand_in_object_t type) noexcept -> const char* {
+    switch (type) {
+    case stand_in_object_t::manager:
+        return "ACameraManager";
+    case stand_in_object_t::id_list:
+        return "ACameraIdList";
+    case stand_in_object_t::metadata:
+        return "ACameraMetadata";
+    case stand_in_object_t::device:
+        return "ACameraDevice";
+    case stand_in_object_t::request:
+        return "ACaptureRequest";
+    case stand_in_object_t::output_target:
+        return "ACameraOutputTarget";
+    case stand_in_object_t::output_container:
+        return "ACaptureSessionOutputContainer";
+    case stand_in_object_t::session_output:
+        return "ACaptureSessionOutput";
+    case stand_in_object_t::session:
+        return "ACameraCaptureSession";
+    case stand_in_object_t::reader:
+        return "AImageReader";
+    case stand_in_object_t::image:
+        return "AImage";
+    case stand_in_object_t::window:
+        return "ANativeWindow";
+    default:
+        return "unknown";
+    }
+}
+
+static int64_t now_ns() noexcept {
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// metadata
+
+struct metadata_table_t final {
+    struct entry_t final {
+        uint8_t type;
+        uint32_t count;
+        vector<uint8_t> bytes;
+    };
+    map<uint32_t, entry_t> entries{};
+    vector<uint32_t> tags{};
+
+    template <typename T>
+    void set(uint32_t tag, uint8_t type, const T* data, uint32_t count) {
+        auto& entry = entries[tag];
+        entry.type = type;
+        entry.count = count;
+        entry.bytes.resize(sizeof(T) * count);
+        memcpy(entry.bytes.data(), data, entry.bytes.size());
+        tags.clear();
+        for (const auto& [key, value] : entries)
+            tags.emplace_back(key);
+    }
+    template <typename T>
+    void set(uint32_t tag, uint8_t type, initializer_list<T> values) {
+        set(tag, type, values.begin(), static_cast<uint32_t>(values.size()));
+    }
+
+    camera_status_t get(uint32_t tag,
+                        ACameraMetadata_const_entry* output) const noexcept {
+        const auto it = entries.find(tag);
+        if (it == entries.end())
+            return ACAMERA_ERROR_METADATA_NOT_FOUND;
+        output->tag = tag;
+        output->type = it->second.type;
+        output->count = it->second.count;
+        output->data.u8 = it->second.bytes.data();
+        return ACAMERA_OK;
+    }
+};
+
+struct ACameraMetadata : tracked_t<stand_in_object_t::metadata> {
+    metadata_table_t table{};
+};
+
+static auto make_characteristics(uint16_t index) -> ACameraMetadata* {
+    auto metadata = new ACameraMetadata{};
+    auto& table = metadata->table;
+
+    const uint8_t facing = index == 0   ? ACAMERA_LENS_FACING_BACK
+                           : index == 1 ? ACAMERA_LENS_FACING_FRONT
+                                        : ACAMERA_LENS_FACING_EXTERNAL;
+    table.set<uint8_t>(ACAMERA_LENS_FACING, ACAMERA_TYPE_BYTE, {facing});
+    const int32_t orientation = index == 0 ? 90 : index == 1 ? 270 : 0;
+    table.set<int32_t>(ACAMERA_SENSOR_ORIENTATION, ACAMERA_TYPE_INT32,
+                       {orientation});
+    table.set<uint8_t>(ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, ACAMERA_TYPE_BYTE,
+                       {ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME});
+    table.set<uint8_t>(ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL,
+                       ACAMERA_TYPE_BYTE,
+                       {ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL});
+    table.set<uint8_t>(ACAMERA_REQUEST_AVAILABLE_CAPABILITIES,
+                       ACAMERA_TYPE_BYTE, {0}); // BACKWARD_COMPATIBLE
+    // 10 bit sensor
+    table.set<uint8_t>(ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT,
+                       ACAMERA_TYPE_BYTE,
+                       {ACAMERA_SENSOR_INFO_COLOR_FILTER_ARRANGEMENT_RGGB});
+    table.set<int32_t>(ACAMERA_SENSOR_INFO_WHITE_LEVEL, ACAMERA_TYPE_INT32,
+                       {1023});
+    table.set<int32_t>(ACAMERA_SENSOR_BLACK_LEVEL_PATTERN, ACAMERA_TYPE_INT32,
+                       {64, 64, 64, 64});
+
+    // format, width, height, direction
+    const auto output = ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT;
+    table.set<int32_t>(ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS,
+                       ACAMERA_TYPE_INT32,
+                       {
+                           AIMAGE_FORMAT_YUV_420_888, 1920, 1080, output, //
+                           AIMAGE_FORMAT_YUV_420_888, 1280, 720, output,  //
+                           AIMAGE_FORMAT_YUV_420_888, 640, 480, output,   //
+                           AIMAGE_FORMAT_YUV_420_888, 320, 240, output,   //
+                           AIMAGE_FORMAT_PRIVATE, 1920, 1080, output,     //
+                           AIMAGE_FORMAT_JPEG, 1920, 1080, output,        //
+                       });
+    // format, width, height, duration
+    table.set<int64_t>(ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS,
+                       ACAMERA_TYPE_INT64,
+                       {
+                           AIMAGE_FORMAT_YUV_420_888, 1920, 1080, 33'333'333, //
+                           AIMAGE_FORMAT_YUV_420_888, 1280, 720, 16'666'666,  //
+                           AIMAGE_FORMAT_YUV_420_888, 640, 480, 16'666'666,   //
+                           AIMAGE_FORMAT_YUV_420_888, 320, 240, 16'666'666,   //
+                           AIMAGE_FORMAT_PRIVATE, 1920, 1080, 33'333'333,     //
+                           AIMAGE_FORMAT_JPEG, 1920, 1080, 33'333'333,        //
+                       });
+    table.set<int64_t>(ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS,
+                       ACAMERA_TYPE_INT64,
+                       {AIMAGE_FORMAT_JPEG, 1920, 1080, 50'000'000});
+    return metadata;
+}
+
+camera_status_t
+ACameraMetadata_getConstEntry(const ACameraMetadata* metadata, uint32_t tag,
+                              ACameraMetadata_const_entry* entry) {
+    if (metadata == nullptr || entry == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    return metadata->table.get(tag, entry);
+}
+
+camera_status_t ACameraMetadata_getAllTags(const ACameraMetadata* metadata,
+                                           int32_t* count,
+                                           const uint32_t** tags) {
+    if (metadata == nullptr || count == nullptr || tags == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    *count = static_cast<int32_t>(metadata->table.tags.size());
+    *tags = metadata->table.tags.data();
+    return ACAMERA_OK;
+}
+
+auto stand_in_create_metadata(uint32_t tag, const uint8_t* data,
+                              uint32_t count) noexcept -> ACameraMetadata* {
+    auto metadata = new ACameraMetadata{};
+    metadata->table.set(tag, ACAMERA_TYPE_BYTE, data, count);
+    return metadata;
+}
+
+ACameraMetadata* ACameraMetadata_copy(const ACameraMetadata* src) {
+    return new ACameraMetadata{*src};
+}
+
+void ACameraMetadata_free(ACameraMetadata* metadata) {
+    delete metadata;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// window, image, reader
+
+// guards `ANativeWindow::reader` between the reader and the sessions
+static mutex reader_mtx{};
+
+struct ANativeWindow : tracked_t<stand_in_object_t::window> {
+    atomic<int32_t> references{1};
+    int32_t width, height, format;
+    AImageReader* reader = nullptr; // if null, frames are discarded
+
+    ANativeWindow(int32_t w, int32_t h, int32_t f) noexcept
+        : width{w}, height{h}, format{f} {
+    }
+};
+
+auto stand_in_create_window(int32_t width, int32_t height) noexcept
+    -> ANativeWindow* {
+    return new ANativeWindow{width, height, AIMAGE_FORMAT_PRIVATE};
+}
+
+void ANativeWindow_acquire(ANativeWindow* window) {
+    window->references.fetch_add(1);
+}
+
+void ANativeWindow_release(ANativeWindow* window) {
+    if (window->references.fetch_sub(1) == 1)
+        delete window;
+}
+
+int32_t ANativeWindow_getWidth(ANativeWindow* window) {
+    return window->width;
+}
+
+int32_t ANativeWindow_getHeight(ANativeWindow* window) {
+    return window->height;
+}
+
+int32_t ANativeWindow_getFormat(ANativeWindow* window) {
+    return window->format;
+}
+
+// shared by the reader and its images. images can outlive the reader
+struct image_pool_t final {
+    atomic<int32_t> acquired{};
+};
+
+struct AImage : tracked_t<stand_in_object_t::image> {
+    shared_ptr<image_pool_t> pool;
+    int32_t width, height, format;
+    int64_t timestamp;
+    vector<uint8_t> buffer{};
+    // Y, U, V. U/V are interleaved(NV21)
+    array<uint8_t*, 3> planes{};
+    array<int32_t, 3> row_strides{}, pixel_strides{}, lengths{};
+    int32_t plane_count = 0;
+    bool acquired = false;
+};
+
+struct AImageReader : tracked_t<stand_in_object_t::reader> {
+    int32_t width, height, format, max_images;
+    ANativeWindow* window;
+    AImageReader_ImageListener listener{};
+    shared_ptr<image_pool_t> pool = make_shared<image_pool_t>();
+    mutex mtx{};
+    deque<AImage*> queue{};
+};
+
+static auto make_image(const AImageReader& reader, int64_t timestamp,
+                       int64_t frame_number) -> AImage* {
+    auto image = new AImage{};
+    image->pool = reader.pool;
+    image->width = reader.width;
+    image->height = reader.height;
+    image->format = reader.format;
+    image->timestamp = timestamp;
+
+    const auto w = reader.width, h = reader.height;
+    if (reader.format == AIMAGE_FORMAT_YUV_420_888) {
+        image->buffer.resize(w * h + w * h / 2);
+        auto* y = image->buffer.data();
+        auto* vu = y + w * h;
+        // moving gradient. every frame is different from the previous one
+        const auto shift = static_cast<int32_t>(frame_number * 4);
+        for (auto row = 0; row < h; ++row)
+            for (auto col = 0; col < w; ++col)
+                y[row * w + col] = static_cast<uint8_t>(row + col + shift);
+        memset(vu, 128, w * h / 2);
+        image->plane_count = 3;
+        image->planes = {y, vu + 1, vu};
+        image->row_strides = {w, w, w};
+        image->pixel_strides = {1, 2, 2};
+        image->lengths = {w * h, w * h / 2 - 1, w * h / 2 - 1};
+        return image;
+    }
+    const auto bytes = reader.format == AIMAGE_FORMAT_RAW16 ? 2 : 1;
+    image->buffer.resize(w * h * bytes);
+    image->plane_count = 1;
+    image->planes[0] = image->buffer.data();
+    image->row_strides[0] = w * bytes;
+    image->pixel_strides[0] = bytes;
+    image->lengths[0] = w * h * bytes;
+    return image;
+}
+
+// @return false if the reader has no free buffer
+static bool deliver_image(ANativeWindow* window, int64_t timestamp,
+                          int64_t frame_number) {
+    unique_lock lck{reader_mtx};
+    auto reader = window->reader;
+    if (reader == nullptr)
+        return true;
+    {
+        unique_lock reader_lck{reader->mtx};
+        const auto used =
+            static_cast<int32_t>(reader->queue.size()) + reader->pool->acquired;
+        if (used >= reader->max_images)
+            return false;
+        reader->queue.emplace_back(
+            make_image(*reader, timestamp, frame_number));
+    }
+    if (reader->listener.onImageAvailable)
+        reader->listener.onImageAvailable(reader->listener.context, reader);
+    return true;
+}
+
+media_status_t AImageReader_new(int32_t width, int32_t height, int32_t format,
+                                int32_t max_images, AImageReader** output) {
+    if (width <= 0 || height <= 0 || max_images <= 0 || output == nullptr)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    auto reader = new AImageReader{};
+    reader->width = width;
+    reader->height = height;
+    reader->format = format;
+    reader->max_images = max_images;
+    reader->window = new ANativeWindow{width, height, format};
+    reader->window->reader = reader;
+    *output = reader;
+    return AMEDIA_OK;
+}
+
+void AImageReader_delete(AImageReader* reader) {
+    if (reader == nullptr)
+        return;
+    {
+        unique_lock lck{reader_mtx};
+        reader->window->reader = nullptr;
+    }
+    ANativeWindow_release(reader->window);
+    for (auto image : reader->queue)
+        delete image;
+    delete reader;
+}
+
+media_status_t AImageReader_getWindow(AImageReader* reader,
+                                      ANativeWindow** window) {
+    if (reader == nullptr || window == nullptr)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    *window = reader->window;
+    return AMEDIA_OK;
+}
+
+static media_status_t acquire_image(AImageReader* reader, AImage** output,
+                                    bool latest) {
+    if (reader == nullptr || output == nullptr)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    unique_lock lck{reader->mtx};
+    if (reader->pool->acquired >= reader->max_images)
+        return AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED;
+    if (reader->queue.empty())
+        return AMEDIA_IMGREADER_NO_BUFFER_AVAILABLE;
+    // older images are returned to the reader
+    while (latest && reader->queue.size() > 1) {
+        delete reader->queue.front();
+        reader->queue.pop_front();
+    }
+    auto image = reader->queue.front();
+    reader->queue.pop_front();
+    image->acquired = true;
+    reader->pool->acquired += 1;
+    *output = image;
+    return AMEDIA_OK;
+}
+
+media_status_t AImageReader_acquireNextImage(AImageReader* reader,
+                                             AImage** image) {
+    return acquire_image(reader, image, false);
+}
+
+media_status_t AImageReader_acquireLatestImage(AImageReader* reader,
+                                               AImage** image) {
+    return acquire_image(reader, image, true);
+}
+
+media_status_t
+AImageReader_setImageListener(AImageReader* reader,
+                              AImageReader_ImageListener* listener) {
+    if (reader == nullptr)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    unique_lock lck{reader_mtx};
+    reader->listener = listener ? *listener : AImageReader_ImageListener{};
+    return AMEDIA_OK;
+}
+
+void AImage_delete(AImage* image) {
+    if (image == nullptr)
+        return;
+    if (image->acquired)
+        image->pool->acquired -= 1;
+    delete image;
+}
+
+media_status_t AImage_getWidth(const AImage* image, int32_t* width) {
+    *width = image->width;
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getHeight(const AImage* image, int32_t* height) {
+    *height = image->height;
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getFormat(const AImage* image, int32_t* format) {
+    *format = image->format;
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getCropRect(const AImage* image, AImageCropRect* rect) {
+    *rect = AImageCropRect{0, 0, image->width, image->height};
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getTimestamp(const AImage* image, int64_t* timestamp) {
+    *timestamp = image->timestamp;
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getNumberOfPlanes(const AImage* image, int32_t* count) {
+    *count = image->plane_count;
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getPlanePixelStride(const AImage* image, int index,
+                                          int32_t* stride) {
+    if (index < 0 || index >= image->plane_count)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    *stride = image->pixel_strides[index];
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getPlaneRowStride(const AImage* image, int index,
+                                        int32_t* stride) {
+    if (index < 0 || index >= image->plane_count)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    *stride = image->row_strides[index];
+    return AMEDIA_OK;
+}
+
+media_status_t AImage_getPlaneData(const AImage* image, int index,
+                                   uint8_t** data, int* length) {
+    if (index < 0 || index >= image->plane_count)
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    *data = image->planes[index];
+    *length = image->lengths[index];
+    return AMEDIA_OK;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// request, output
+
+struct ACaptureRequest : tracked_t<stand_in_object_t::request> {
+    ACameraDevice_request_template template_id;
+    multiset<ANativeWindow*> targets{};
+    metadata_table_t settings{};
+};
+
+struct ACameraOutputTarget : tracked_t<stand_in_object_t::output_target> {
+    ANativeWindow* window;
+};
+
+struct ACaptureSessionOutput : tracked_t<stand_in_object_t::session_output> {
+    ANativeWindow* window;
+};
+
+struct ACaptureSessionOutputContainer
+    : tracked_t<stand_in_object_t::output_container> {
+    set<const ACaptureSessionOutput*> outputs{};
+};
+
+camera_status_t ACameraOutputTarget_create(ANativeWindow* window,
+                                           ACameraOutputTarget** output) {
+    if (window == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    ANativeWindow_acquire(window);
+    *output = new ACameraOutputTarget{{}, window};
+    return ACAMERA_OK;
+}
+
+void ACameraOutputTarget_free(ACameraOutputTarget* output) {
+    if (output == nullptr)
+        return;
+    ANativeWindow_release(output->window);
+    delete output;
+}
+
+camera_status_t ACaptureRequest_addTarget(ACaptureRequest* request,
+                                          const ACameraOutputTarget* output) {
+    if (request == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    request->targets.insert(output->window);
+    return ACAMERA_OK;
+}
+
+camera_status_t
+ACaptureRequest_removeTarget(ACaptureRequest* request,
+                             const ACameraOutputTarget* output) {
+    if (request == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    auto it = request->targets.find(output->window);
+    if (it != request->targets.end())
+        request->targets.erase(it);
+    return ACAMERA_OK;
+}
+
+camera_status_t
+ACaptureRequest_getConstEntry(const ACaptureRequest* request, uint32_t tag,
+                              ACameraMetadata_const_entry* entry) {
+    if (request == nullptr || entry == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    return request->settings.get(tag, entry);
+}
+
+camera_status_t ACaptureRequest_setEntry_u8(ACaptureRequest* request,
+                                            uint32_t tag, uint32_t count,
+                                            const uint8_t* data) {
+    request->settings.set(tag, ACAMERA_TYPE_BYTE, data, count);
+    return ACAMERA_OK;
+}
+
+camera_status_t ACaptureRequest_setEntry_i32(ACaptureRequest* request,
+                                             uint32_t tag, uint32_t count,
+                                             const int32_t* data) {
+    request->settings.set(tag, ACAMERA_TYPE_INT32, data, count);
+    return ACAMERA_OK;
+}
+
+camera_status_t ACaptureRequest_setEntry_i64(ACaptureRequest* request,
+                                             uint32_t tag, uint32_t count,
+                                             const int64_t* data) {
+    request->settings.set(tag, ACAMERA_TYPE_INT64, data, count);
+    return ACAMERA_OK;
+}
+
+void ACaptureRequest_free(ACaptureRequest* request) {
+    delete request;
+}
+
+camera_status_t ACaptureSessionOutputContainer_create(
+    ACaptureSessionOutputContainer** container) {
+    if (container == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    *container = new ACaptureSessionOutputContainer{};
+    return ACAMERA_OK;
+}
+
+void ACaptureSessionOutputContainer_free(
+    ACaptureSessionOutputContainer* container) {
+    delete container;
+}
+
+camera_status_t ACaptureSessionOutput_create(ANativeWindow* window,
+                                             ACaptureSessionOutput** output) {
+    if (window == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    ANativeWindow_acquire(window);
+    *output = new ACaptureSessionOutput{{}, window};
+    return ACAMERA_OK;
+}
+
+void ACaptureSessionOutput_free(ACaptureSessionOutput* output) {
+    if (output == nullptr)
+        return;
+    ANativeWindow_release(output->window);
+    delete output;
+}
+
+camera_status_t
+ACaptureSessionOutputContainer_add(ACaptureSessionOutputContainer* container,
+                                   const ACaptureSessionOutput* output) {
+    if (container == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    container->outputs.insert(output);
+    return ACAMERA_OK;
+}
+
+camera_status_t ACaptureSessionOutputContainer_remove(
+    ACaptureSessionOutputContainer* container,
+    const ACaptureSessionOutput* output) {
+    if (container == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    container->outputs.erase(output);
+    return ACAMERA_OK;
+}
+
+// ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- ----
+// manager, device, session
+
+struct ACameraManager : tracked_t<stand_in_object_t::manager> {};
+
+// `ACameraIdList` is a C struct. keep the storage with it
+struct id_list_t final {
+    ACameraIdList list;
+    const char* ids[8];
+};
+static const char* const camera_ids[8] = {"0", "1", "2", "3",
+                                          "4", "5", "6", "7"};
+
+struct ACameraDevice : tracked_t<stand_in_object_t::device> {
+    uint16_t index;
+    ACameraDevice_StateCallbacks callbacks;
+    ACameraCaptureSession* session = nullptr; // current one
+    // disconnected or error. the device can only be closed
+    atomic<bool> broken{};
+};
+
+// opened devices. `ACAMERA_ERROR_CAMERA_IN_USE` for the second open
+static mutex device_mtx{};
+static array<ACameraDevice*, 8> devices{};
+
+static atomic<uint32_t> open_failures{};
+static atomic<camera_status_t> open_failure_status{ACAMERA_OK};
+
+void stand_in_fail_open(uint32_t count, camera_status_t status) noexcept {
+    open_failure_status = status;
+    open_failures = count;
+}
+
+/**
+ * Frames are produced by the worker thread. The callbacks are invoked in the
+ * worker like the camera service's callback thread
+ */
+struct ACameraCaptureSession : tracked_t<stand_in_object_t::session> {
+    struct work_t final {
+        ACameraCaptureSession_captureCallbacks callbacks;
+        vector<unique_ptr<ACaptureRequest>> requests;
+        int sequence;
+    };
+
+    ACameraDevice* device;
+    ACameraCaptureSession_stateCallbacks state;
+    vector<ANativeWindow*> windows{};
+
+    mutex mtx{};
+    condition_variable cv{};
+    bool closing = false;
+    shared_ptr<work_t> repeating{};
+    deque<shared_ptr<work_t>> captures{};
+    // sequence end/abort. invoked in the worker
+    deque<function<void()>> notices{};
+    int next_sequence = 0;
+    atomic<int64_t> frame_number{};
+    thread worker{};
+
+    void run() noexcept;
+    void produce(work_t& work) noexcept;
+    void shutdown() noexcept;
+};
+
+void ACameraCaptureSession::produce(work_t& work) noexcept {
+    auto& callbacks = work.callbacks;
+    for (auto& request : work.requests) {
+        const auto number = frame_number++;
+        const auto timestamp = now_ns();
+        if (callbacks.onCaptureStarted)
+            callbacks.onCaptureStarted(callbacks.context, this, request.get(),
+                                       timestamp);
+
+        for (auto window : request->targets)
+            if (deliver_image(window, timestamp, number) == false &&
+                callbacks.onCaptureBufferLost)
+                callbacks.onCaptureBufferLost(callbacks.context, this,
+                                              request.get(), window, number);
+
+        ACameraMetadata result{};
+        const int64_t exposure = 10'000'000;
+        const int64_t duration =
+            duration_cast<nanoseconds>(config.frame_interval).count();
+        result.table.set<int64_t>(ACAMERA_SENSOR_TIMESTAMP, ACAMERA_TYPE_INT64,
+                                  {timestamp});
+        result.table.set<int64_t>(ACAMERA_SENSOR_EXPOSURE_TIME,
+                                  ACAMERA_TYPE_INT64, {exposure});
+        result.table.set<int64_t>(ACAMERA_SENSOR_FRAME_DURATION,
+                                  ACAMERA_TYPE_INT64, {duration});
+        result.table.set<int32_t>(ACAMERA_SENSOR_SENSITIVITY,
+                                  ACAMERA_TYPE_INT32, {100});
+        result.table.set<int64_t>(ACAMERA_SYNC_FRAME_NUMBER, ACAMERA_TYPE_INT64,
+                                  {number});
+        if (callbacks.onCaptureCompleted)
+            callbacks.onCaptureCompleted(callbacks.context, this,
+                                         request.get(), &result);
+    }
+}
+
+void ACameraCaptureSession::run() noexcept {
+    bool active = false;
+    unique_lock lck{mtx};
+    while (true) {
+        while (notices.empty() == false) {
+            auto notice = move(notices.front());
+            notices.pop_front();
+            lck.unlock();
+            notice();
+            lck.lock();
+        }
+        if (closing)
+            break;
+
+        shared_ptr<work_t> work{};
+        bool single = false;
+        if (captures.empty() == false) {
+            work = move(captures.front());
+            captures.pop_front();
+            single = true;
+        } else
+            work = repeating;
+
+        if (work == nullptr) {
+            if (active && state.onReady)
+                state.onReady(state.context, this);
+            active = false;
+            cv.wait(lck);
+            continue;
+        }
+        if (active == false && state.onActive)
+            state.onActive(state.context, this);
+        active = true;
+
+        // exposure. `closing` can interrupt
+        cv.wait_for(lck, config.frame_interval, [this]() { return closing; });
+        if (closing)
+            break;
+        lck.unlock();
+        produce(*work);
+        if (single && work->callbacks.onCaptureSequenceCompleted)
+            work->callbacks.onCaptureSequenceCompleted(
+                work->callbacks.context, this, work->sequence,
+                frame_number - 1);
+        lck.lock();
+    }
+}
+
+void ACameraCaptureSession::shutdown() noexcept {
+    {
+        unique_lock lck{mtx};
+        closing = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        // closing in its callback is not supported
+        assert(worker.get_id() != this_thread::get_id());
+        worker.join();
+    }
+}
+
+static void push_notice(ACameraCaptureSession* session,
+                        function<void()> notice) {
+    session->notices.emplace_back(move(notice));
+    session->cv.notify_all();
+}
+
+ACameraManager* ACameraManager_create() {
+    return new ACameraManager{};
+}
+
+void ACameraManager_delete(ACameraManager* manager) {
+    delete manager;
+}
+
+camera_status_t ACameraManager_getCameraIdList(ACameraManager* manager,
+                                               ACameraIdList** output) {
+    if (manager == nullptr || output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    auto storage = new id_list_t{};
+    track(stand_in_object_t::id_list, +1);
+    storage->list.numCameras = min<int>(config.camera_count, 8);
+    for (auto i = 0; i < storage->list.numCameras; ++i)
+        storage->ids[i] = camera_ids[i];
+    storage->list.cameraIds = storage->ids;
+    *output = &storage->list;
+    return ACAMERA_OK;
+}
+
+void ACameraManager_deleteCameraIdList(ACameraIdList* list) {
+    if (list == nullptr)
+        return;
+    track(stand_in_object_t::id_list, -1);
+    delete reinterpret_cast<id_list_t*>(list);
+}
+
+static int32_t find_index(const char* id) noexcept {
+    for (auto i = 0; i < min<int>(config.camera_count, 8); ++i)
+        if (id && strcmp(id, camera_ids[i]) == 0)
+            return i;
+    return -1;
+}
+
+camera_status_t ACameraManager_getCameraCharacteristics(
+    ACameraManager* manager, const char* id, ACameraMetadata** output) {
+    const auto index = find_index(id);
+    if (manager == nullptr || output == nullptr || index < 0)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    *output = make_characteristics(static_cast<uint16_t>(index));
+    return ACAMERA_OK;
+}
+
+camera_status_t ACameraManager_openCamera(
+    ACameraManager* manager, const char* id,
+    ACameraDevice_StateCallbacks* callbacks, ACameraDevice** output) {
+    const auto index = find_index(id);
+    if (manager == nullptr || callbacks == nullptr || output == nullptr ||
+        index < 0)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    if (auto count = open_failures.load())
+        if (open_failures.compare_exchange_strong(count, count - 1))
+            return open_failure_status.load();
+
+    auto device = new ACameraDevice{};
+    device->index = static_cast<uint16_t>(index);
+    device->callbacks = *callbacks;
+    {
+        unique_lock lck{device_mtx};
+        if (devices[index] != nullptr) {
+            delete device;
+            return ACAMERA_ERROR_CAMERA_IN_USE;
+        }
+        devices[index] = device;
+    }
+    this_thread::sleep_for(config.open_latency);
+    *output = device;
+    return ACAMERA_OK;
+}
+
+camera_status_t ACameraDevice_close(ACameraDevice* device) {
+    if (device == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    // the session can't be used after its device is closed
+    if (auto session = device->session) {
+        session->shutdown();
+        session->device = nullptr;
+    }
+    {
+        unique_lock lck{device_mtx};
+        devices[device->index] = nullptr;
+    }
+    delete device;
+    return ACAMERA_OK;
+}
+
+const char* ACameraDevice_getId(const ACameraDevice* device) {
+    return camera_ids[device->index];
+}
+
+camera_status_t
+ACameraDevice_createCaptureRequest(const ACameraDevice* device,
+                                   ACameraDevice_request_template template_id,
+                                   ACaptureRequest** request) {
+    if (device == nullptr || request == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    auto output = new ACaptureRequest{};
+    output->template_id = template_id;
+    *request = output;
+    return ACAMERA_OK;
+}
+
+camera_status_t ACameraDevice_createCaptureSession(
+    ACameraDevice* device, const ACaptureSessionOutputContainer* outputs,
+    const ACameraCaptureSession_stateCallbacks* callbacks,
+    ACameraCaptureSession** output) {
+    if (device == nullptr || outputs == nullptr || callbacks == nullptr ||
+        output == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    if (device->broken)
+        return ACAMERA_ERROR_CAMERA_DEVICE;
+
+    // the previous session is closed by the new one
+    if (auto previous = device->session) {
+        previous->shutdown();
+        previous->device = nullptr;
+        if (previous->state.onClosed)
+            previous->state.onClosed(previous->state.context, previous);
+    }
+    this_thread::sleep_for(config.session_latency);
+
+    auto session = new ACameraCaptureSession{};
+    session->device = device;
+    session->state = *callbacks;
+    for (auto item : outputs->outputs) {
+        ANativeWindow_acquire(item->window);
+        session->windows.emplace_back(item->window);
+    }
+    if (session->state.onReady)
+        push_notice(session, [session]() {
+            session->state.onReady(session->state.context, session);
+        });
+    session->worker = thread{&ACameraCaptureSession::run, session};
+    device->session = session;
+    *output = session;
+    return ACAMERA_OK;
+}
+
+void ACameraCaptureSession_close(ACameraCaptureSession* session) {
+    if (session == nullptr)
+        return;
+    session->shutdown();
+    if (auto device = session->device)
+        device->session = nullptr;
+    if (session->state.onClosed)
+        session->state.onClosed(session->state.context, session);
+    for (auto window : session->windows)
+        ANativeWindow_release(window);
+    delete session;
+}
+
+static camera_status_t
+submit(ACameraCaptureSession* session,
+       ACameraCaptureSession_captureCallbacks* callbacks, int count,
+       ACaptureRequest** requests, int* sequence, bool repeating) {
+    if (session == nullptr || count <= 0 || requests == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+
+    auto work = make_shared<ACameraCaptureSession::work_t>();
+    work->callbacks =
+        callbacks ? *callbacks : ACameraCaptureSession_captureCallbacks{};
+    for (auto i = 0; i < count; ++i) {
+        // the targets must be configured in the session
+        for (auto window : requests[i]->targets)
+            if (find(session->windows.begin(), session->windows.end(),
+                     window) == session->windows.end())
+                return ACAMERA_ERROR_INVALID_PARAMETER;
+        // the request is copied. the user can free it after the return
+        work->requests.emplace_back(make_unique<ACaptureRequest>(*requests[i]));
+    }
+
+    unique_lock lck{session->mtx};
+    if (session->closing || session->device == nullptr)
+        return ACAMERA_ERROR_SESSION_CLOSED;
+    work->sequence = session->next_sequence++;
+    if (sequence)
+        *sequence = work->sequence;
+    if (repeating == false) {
+        session->captures.emplace_back(move(work));
+        session->cv.notify_all();
+        return ACAMERA_OK;
+    }
+    // the previous repeating request ends with its last frame
+    if (auto previous = move(session->repeating)) {
+        auto number = session->frame_number - 1;
+        push_notice(session, [session, previous, number]() {
+            auto& cb = previous->callbacks;
+            if (cb.onCaptureSequenceCompleted)
+                cb.onCaptureSequenceCompleted(cb.context, session,
+                                              previous->sequence, number);
+        });
+    }
+    session->repeating = move(work);
+    session->cv.notify_all();
+    return ACAMERA_OK;
+}
+
+camera_status_t ACameraCaptureSession_capture(
+    ACameraCaptureSession* session,
+    ACameraCaptureSession_captureCallbacks* callbacks, int count,
+    ACaptureRequest** requests, int* sequence) {
+    return submit(session, callbacks, count, requests, sequence, false);
+}
+
+camera_status_t ACameraCaptureSession_setRepeatingRequest(
+    ACameraCaptureSession* session,
+    ACameraCaptureSession_captureCallbacks* callbacks, int count,
+    ACaptureRequest** requests, int* sequence) {
+    return submit(session, callbacks, count, requests, sequence, true);
+}
+
+camera_status_t
+ACameraCaptureSession_stopRepeating(ACameraCaptureSession* session) {
+    if (session == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    unique_lock lck{session->mtx};
+    if (session->closing || session->device == nullptr)
+        return ACAMERA_ERROR_SESSION_CLOSED;
+    if (auto previous = move(session->repeating)) {
+        auto number = session->frame_number - 1;
+        push_notice(session, [session, previous, number]() {
+            auto& cb = previous->callbacks;
+            if (cb.onCaptureSequenceCompleted)
+                cb.onCaptureSequenceCompleted(cb.context, session,
+                                              previous->sequence, number);
+        });
+    }
+    return ACAMERA_OK;
+}
+
+camera_status_t
+ACameraCaptureSession_abortCaptures(ACameraCaptureSession* session) {
+    if (session == nullptr)
+        return ACAMERA_ERROR_INVALID_PARAMETER;
+    unique_lock lck{session->mtx};
+    if (session->closing || session->device == nullptr)
+        return ACAMERA_ERROR_SESSION_CLOSED;
+
+    auto aborted = move(session->captures);
+    session->captures.clear();
+    if (session->repeating)
+        aborted.emplace_back(move(session->repeating));
+    for (auto& work : aborted)
+        push_notice(session, [session, work]() {
+            auto& cb = work->callbacks;
+            if (cb.onCaptureSequenceAborted)
+                cb.onCaptureSequenceAborted(cb.context, session,
+                                            work->sequence);
+        });
+    return ACAMERA_OK;
+}
+
+void stand_in_raise_device_error(uint16_t index, int error) noexcept {
+    ACameraDevice* device = nullptr;
+    {
+        unique_lock lck{device_mtx};
+        device = devices[index];
+        if (device == nullptr || device->broken)
+            return;
+        device->broken = true;
+        // no more frames. the session is closed by the user
+        if (auto session = device->session)
+            session->shutdown();
+    }
+    auto& callbacks = device->callbacks;
+    if (error == 0) {
+        if (callbacks.onDisconnected)
+            callbacks.onDisconnected(callbacks.context, device);
+        return;
+    }
+    if (callbacks.onError)
+        callbacks.onError(callbacks.context, device, error);
+}
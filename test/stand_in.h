@@ -0,0 +1,71 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Host stand-in of the NDK camera API. Devices are simulated with a thread
+//  per session which produces frames, results and images at a fixed interval.
+//  Every object the user creates is counted so the tests can find the leaks
+//
+#pragma once
+#ifndef _NDCAM_TEST_STAND_IN_H_
+#define _NDCAM_TEST_STAND_IN_H_
+
+#include <camera/NdkCameraManager.h>
+#include <media/NdkImageReader.h>
+
+#include <chrono>
+#include <cstdint>
+
+// follow `stand_in_get_name`
+enum class stand_in_object_t : uint32_t {
+    manager,
+    id_list,
+    metadata,
+    device,
+    request,
+    output_target,
+    output_container,
+    session_output,
+    session,
+    reader,
+    image,
+    window,
+    count
+};
+
+struct stand_in_config_t final {
+    // "0" is back, "1" is front, and the others are external
+    uint16_t camera_count = 2;
+    std::chrono::microseconds frame_interval{33'333};
+    // delay of ACameraManager_openCamera
+    std::chrono::microseconds open_latency{2'000};
+    // delay of ACameraDevice_createCaptureSession
+    std::chrono::microseconds session_latency{1'000};
+};
+
+// apply before `ACameraManager_create`
+void stand_in_configure(const stand_in_config_t& config) noexcept;
+
+// number of the objects which are not freed yet
+auto stand_in_get_live_count(stand_in_object_t type) noexcept -> int64_t;
+auto stand_in_get_name(stand_in_object_t type) noexcept -> const char*;
+
+// metadata with 1 entry of bytes. `count` can be 0 for the entry without
+// data. `ACameraMetadata_free` to free
+auto stand_in_create_metadata(uint32_t tag, const uint8_t* data,
+                              uint32_t count) noexcept -> ACameraMetadata*;
+
+// output surface which is not a reader. `ANativeWindow_release` to free
+auto stand_in_create_window(int32_t width, int32_t height) noexcept
+    -> ANativeWindow*;
+
+/**
+ * Invoke `onError` of the opened device. `onDisconnected` if `error` is 0.
+ * The device and its session stop working. The user must close them
+ */
+void stand_in_raise_device_error(uint16_t index, int error) noexcept;
+
+// the next `count` ACameraManager_openCamera will return the status
+void stand_in_fail_open(uint32_t count, camera_status_t status) noexcept;
+
+#endif // _NDCAM_TEST_STAND_IN_H_
@@ -0,0 +1,225 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `compute_frame_stats` against a scalar reference, and the statistics of
+//  the frames which are dropped by the motion gate
+//
+#include <ndk_camera.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_motion.h>
+#include <ndk_camera_stats.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// the plane in a buffer with the padding of the rows
+struct test_plane_t final {
+    uint32_t width, height, pixel_stride, row_stride;
+    vector<uint8_t> buffer;
+
+  public:
+    test_plane_t(uint32_t _width, uint32_t _height, uint32_t _pixel_stride)
+        : width{_width}, height{_height}, pixel_stride{_pixel_stride},
+          row_stride{_width * _pixel_stride + 7},
+          buffer(row_stride * _height) {
+    }
+
+    uint8_t& at(uint32_t x, uint32_t y) {
+        return buffer[y * row_stride + x * pixel_stride];
+    }
+    auto view() const -> plane_view_t {
+        return make_plane_view(buffer.data(), row_stride, width, height,
+                               pixel_stride);
+    }
+};
+
+static void fill_random(test_plane_t& plane, uint32_t seed) {
+    for (auto& value : plane.buffer) {
+        seed = seed * 1664525 + 1013904223;
+        value = static_cast<uint8_t>(seed >> 24);
+    }
+}
+
+// the largest Laplacian(+-1020) for the accumulators
+static void fill_checker(test_plane_t& plane) {
+    for (auto y = 0u; y < plane.height; ++y)
+        for (auto x = 0u; x < plane.width; ++x)
+            plane.at(x, y) = (x + y) % 2 ? 255 : 0;
+}
+
+// 1 pixel at a time. the Laplacian is of the sampled grid
+static auto reference_stats(test_plane_t& plane, const stats_config_t& config)
+    -> frame_stats_t {
+    auto roi = config.roi;
+    if (roi.width == 0 || roi.height == 0)
+        roi = {0, 0, plane.width, plane.height};
+    const auto step = max(config.step, 1u);
+    const auto cols = roi.width / step, rows = roi.height / step;
+
+    vector<double> grid{};
+    frame_stats_t stats{};
+    for (auto r = 0u; r < rows; ++r)
+        for (auto c = 0u; c < cols; ++c) {
+            const auto value = plane.at(roi.x + c * step, roi.y + r * step);
+            grid.emplace_back(value);
+            if (config.histogram)
+                stats.histogram[value] += 1;
+        }
+    stats.count = cols * rows;
+    if (grid.empty())
+        return stats;
+
+    const auto variance = [](const vector<double>& values) {
+        auto mean = 0.0, sum = 0.0;
+        for (auto v : values)
+            mean += v;
+        mean /= values.size();
+        for (auto v : values)
+            sum += (v - mean) * (v - mean);
+        return make_pair(mean, sum / values.size());
+    };
+    const auto moments = variance(grid);
+    stats.mean = static_cast<float>(moments.first);
+    stats.variance = static_cast<float>(moments.second);
+
+    vector<double> laplacian{};
+    for (auto r = 1u; config.sharpness && r + 1 < rows; ++r)
+        for (auto c = 1u; c + 1 < cols; ++c) {
+            const auto at = [&](uint32_t y, uint32_t x) {
+                return grid[y * cols + x];
+            };
+            laplacian.emplace_back(4 * at(r, c) - at(r, c - 1) -
+                                   at(r, c + 1) - at(r - 1, c) -
+                                   at(r + 1, c));
+        }
+    if (laplacian.size())
+        stats.sharpness = static_cast<float>(variance(laplacian).second);
+    return stats;
+}
+
+static bool near(float value, float expected) {
+    return fabs(value - expected) <= 1e-4 * max(1.0f, fabs(expected));
+}
+
+static bool compare(test_plane_t& plane, const stats_config_t& config) {
+    vector<uint8_t> scratch(get_stats_scratch_size(config, plane.view()));
+    frame_stats_t stats{};
+    compute_frame_stats(plane.view(), config, scratch, stats);
+    const auto expected = reference_stats(plane, config);
+    return stats.count == expected.count &&
+           stats.histogram == expected.histogram &&
+           near(stats.mean, expected.mean) &&
+           near(stats.variance, expected.variance) &&
+           near(stats.sharpness, expected.sharpness);
+}
+
+// odd sizes for the tails of the vector loops. wide one for the flush of
+// the Laplacian's lanes
+void scalar_reference() {
+    const uint32_t sizes[][2] = {{97, 61}, {33, 17}, {4101, 9}, {2, 2}};
+    auto ok = true;
+    for (const auto& size : sizes)
+        for (auto pixel_stride : {1u, 2u})
+            for (auto step : {1u, 2u, 3u, 4u}) {
+                test_plane_t plane{size[0], size[1], pixel_stride};
+                fill_random(plane, size[0] * step);
+                stats_config_t config{};
+                config.step = step;
+                ok &= compare(plane, config);
+
+                config.roi = {size[0] / 4, size[1] / 3, size[0] / 2 + 1,
+                              size[1] / 2 + 1};
+                ok &= compare(plane, config);
+                config.histogram = config.sharpness = false;
+                ok &= compare(plane, config);
+
+                fill_checker(plane);
+                config = stats_config_t{};
+                config.step = step;
+                ok &= compare(plane, config);
+            }
+    check(ok, "same with the scalar reference");
+}
+
+struct probe_t final {
+    camera_group_t* context;
+    atomic<uint32_t> published{};
+};
+
+static void on_capture_completed(void* ptr, ACameraCaptureSession* session,
+                                 ACaptureRequest* request,
+                                 const ACameraMetadata* result) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    context_on_capture_completed(*probe.context, session, request, result);
+}
+static void on_stats(void* ptr, const capture_result_t&,
+                     const frame_stats_t& stats) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    if (stats.count)
+        probe.published += 1;
+}
+
+// the capture results are published with the stats of the dropped frames
+void stats_of_dropped_frames() {
+    camera_group_t context{};
+    context.manager = ACameraManager_create();
+    ACameraManager_getCameraIdList(context.manager, &context.id_list);
+    probe_t probe{&context};
+
+    motion_config_t motion{};
+    motion.min_blocks = UINT32_MAX; // every frame is static
+    motion_gate_t gate{motion};
+    frame_statistics_t statistics{stats_config_t{}, on_stats, &probe};
+    context.motion_gate_set[0] = &gate;
+    context.statistics_set[0] = &statistics;
+
+    ACameraDevice_StateCallbacks device_callbacks{};
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    capture_callbacks.context = &probe;
+    capture_callbacks.onCaptureCompleted = on_capture_completed;
+    auto* window = stand_in_create_window(640, 480);
+    check(context.open_device(0, device_callbacks) == ACAMERA_OK, "open");
+    check(context.open_reader(0, 64, 48, AIMAGE_FORMAT_YUV_420_888, 4) ==
+              AMEDIA_OK,
+          "open_reader");
+    check(context.start_repeat(0, window, session_callbacks,
+                               capture_callbacks) == ACAMERA_OK,
+          "start_repeat");
+    check(wait_for([&probe]() { return probe.published >= 10; }),
+          "stats are published");
+    context.close_reader(0);
+    context.close_device(0);
+    context.release();
+    ANativeWindow_release(window);
+
+    const auto frames = gate.get_stats();
+    // the first one is the reference
+    check(frames.frames >= 10 && frames.moving == 1, "frames are dropped");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    stand_in_config_t config{};
+    config.frame_interval = 1ms;
+    stand_in_configure(config);
+
+    scalar_reference();
+    stats_of_dropped_frames();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  `plan_streams` with the characteristics of the stand-in and the made up
+//  devices of each hardware level
+//
+#include <ndk_camera_log.h>
+#include <ndk_camera_stream.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+
+#include <cstdio>
+
+using namespace std;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static constexpr int64_t fps30 = 33'333'333;
+static constexpr int64_t fps60 = 16'666'666;
+
+static bool is_size(const stream_config_t& stream, uint32_t width,
+                    uint32_t height) {
+    return stream.size.width == width && stream.size.height == height;
+}
+
+void read_capability(stream_capability_t& capability) {
+    ACameraManager* manager = ACameraManager_create();
+    ACameraIdList* id_list = nullptr;
+    ACameraManager_getCameraIdList(manager, &id_list);
+    ACameraMetadata* metadata = nullptr;
+    ACameraManager_getCameraCharacteristics(manager, id_list->cameraIds[0],
+                                            &metadata);
+    check(read_stream_capability(metadata, capability) == ACAMERA_OK,
+          "read_stream_capability");
+    ACameraMetadata_free(metadata);
+    ACameraManager_deleteCameraIdList(id_list);
+    ACameraManager_delete(manager);
+
+    check(capability.hardware_level ==
+              ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL,
+          "hardware level");
+    check(capability.raw == false, "no raw capability");
+    check(capability.outputs.size() == 6, "outputs");
+    auto jpeg = false;
+    for (const auto& output : capability.outputs) {
+        if (output.format != AIMAGE_FORMAT_JPEG)
+            continue;
+        jpeg = output.min_frame_duration == fps30 &&
+               output.stall_duration == 50'000'000;
+    }
+    check(jpeg, "durations of the jpeg");
+}
+
+// preview >= 720p at 30 fps + YUV analysis >= VGA + JPEG of the max size
+void preview_analysis_still(const stream_capability_t& capability) {
+    stream_requirement_t requirements[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps30, true, false},
+        {AIMAGE_FORMAT_YUV_420_888, {640, 480}, 0, true, false},
+        {AIMAGE_FORMAT_JPEG, {0, 0}, 0, false, true},
+    };
+    stream_plan_t plan{};
+    check(plan_streams(capability, requirements, plan), "feasible");
+    if (check(plan.streams.size() == 3, "streams of the plan") == false)
+        return;
+    check(is_size(plan.streams[0], 1920, 1080), "the only PRIVATE");
+    check(is_size(plan.streams[1], 640, 480), "the smallest analysis");
+    check(is_size(plan.streams[2], 1920, 1080), "the largest JPEG");
+    check(plan.frame_duration == fps30, "30 fps");
+    check(plan.still_duration == fps30 + 50'000'000, "still with the stall");
+    check(plan.error == stream_plan_error_t::none && plan.reason.empty(),
+          "no error");
+}
+
+void too_slow(const stream_capability_t& capability) {
+    stream_plan_t plan{};
+    // no PRIVATE for 60 fps
+    stream_requirement_t preview[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps60, true, false},
+    };
+    check(plan_streams(capability, preview, plan) == false, "60 fps preview");
+    check(plan.error == stream_plan_error_t::too_slow && plan.culprit == 0,
+          "preview is too slow");
+    printf("%s\n", plan.reason.c_str());
+
+    // the analysis can run at 60 fps alone, but the preview slows it
+    stream_requirement_t analysis[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps30, true, false},
+        {AIMAGE_FORMAT_YUV_420_888, {640, 480}, fps60, true, false},
+    };
+    check(plan_streams(capability, analysis, plan) == false,
+          "60 fps analysis with the preview");
+    check(plan.error == stream_plan_error_t::too_slow && plan.culprit == 1,
+          "analysis is too slow");
+    check(plan.reason.find("stream 0(PRIVATE 1920x1080)") != string::npos,
+          "bottleneck in the reason");
+    printf("%s\n", plan.reason.c_str());
+
+    // the stall of JPEG blocks the preview for longer than 2 frames
+    stream_requirement_t still[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps30, true, false},
+        {AIMAGE_FORMAT_JPEG, {0, 0}, 2 * fps30, false, true},
+    };
+    check(plan_streams(capability, still, plan) == false, "stalling JPEG");
+    check(plan.error == stream_plan_error_t::too_slow && plan.culprit == 1,
+          "JPEG is too slow");
+}
+
+// sensor of 4000x3000. the full size is 10 fps
+static auto make_capability(uint8_t level) -> stream_capability_t {
+    stream_capability_t capability{level, false, {}};
+    capability.outputs = {
+        {AIMAGE_FORMAT_YUV_420_888, {4000, 3000}, 100'000'000, 0},
+        {AIMAGE_FORMAT_YUV_420_888, {1920, 1080}, fps30, 0},
+        {AIMAGE_FORMAT_YUV_420_888, {1280, 720}, fps60, 0},
+        {AIMAGE_FORMAT_YUV_420_888, {640, 480}, fps60, 0},
+        {AIMAGE_FORMAT_PRIVATE, {1920, 1080}, fps30, 0},
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps60, 0},
+        {AIMAGE_FORMAT_JPEG, {4000, 3000}, 100'000'000, 200'000'000},
+        {AIMAGE_FORMAT_JPEG, {1920, 1080}, fps30, 50'000'000},
+        {AIMAGE_FORMAT_RAW16, {4000, 3000}, 100'000'000, 100'000'000},
+    };
+    return capability;
+}
+
+void hardware_levels() {
+    stream_requirement_t requirements[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, 0, true, false},
+        {AIMAGE_FORMAT_YUV_420_888, {2000, 1500}, 0, true, false},
+    };
+    stream_plan_t plan{};
+    auto capability =
+        make_capability(ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LEGACY);
+    check(plan_streams(capability, requirements, plan) == false,
+          "YUV MAXIMUM with the preview on LEGACY");
+    check(plan.error == stream_plan_error_t::combination && plan.culprit == 1,
+          "not a combination of LEGACY");
+    check(plan.reason.find("LEGACY") != string::npos, "level in the reason");
+    printf("%s\n", plan.reason.c_str());
+
+    capability.hardware_level = ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL;
+    check(plan_streams(capability, requirements, plan), "FULL");
+    check(is_size(plan.streams[0], 1280, 720) &&
+              is_size(plan.streams[1], 4000, 3000),
+          "PRIV PREVIEW + YUV MAXIMUM");
+    check(plan.frame_duration == 100'000'000, "10 fps");
+
+    // RAW needs its capability
+    stream_requirement_t raw[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, 0, true, false},
+        {AIMAGE_FORMAT_RAW16, {0, 0}, 0, false, true},
+    };
+    check(plan_streams(capability, raw, plan) == false, "no RAW capability");
+    check(plan.error == stream_plan_error_t::combination, "RAW combination");
+    capability.raw = true;
+    check(plan_streams(capability, raw, plan), "RAW capability");
+    check(plan.still_duration == 200'000'000, "RAW with the stall");
+}
+
+void largest_and_no_size() {
+    const auto capability =
+        make_capability(ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_FULL);
+    stream_plan_t plan{};
+    // the largest which keeps 30 fps. not the full size
+    stream_requirement_t requirements[]{
+        {AIMAGE_FORMAT_PRIVATE, {1280, 720}, fps30, true, false},
+        {AIMAGE_FORMAT_YUV_420_888, {640, 480}, fps30, true, true},
+        {AIMAGE_FORMAT_JPEG, {0, 0}, 0, false, true},
+    };
+    check(plan_streams(capability, requirements, plan), "feasible");
+    check(is_size(plan.streams[0], 1280, 720), "the smallest preview");
+    check(is_size(plan.streams[1], 1920, 1080), "the largest at 30 fps");
+    check(is_size(plan.streams[2], 4000, 3000), "the largest JPEG");
+    check(plan.frame_duration == fps30, "30 fps with the largest");
+
+    // faster without `largest`
+    requirements[1].largest = false;
+    check(plan_streams(capability, requirements, plan), "feasible");
+    check(is_size(plan.streams[1], 640, 480) && plan.frame_duration == fps60,
+          "60 fps with the smaller ones");
+
+    stream_requirement_t huge[]{
+        {AIMAGE_FORMAT_YUV_420_888, {8000, 6000}, 0, true, false},
+    };
+    check(plan_streams(capability, huge, plan) == false, "too large");
+    check(plan.error == stream_plan_error_t::no_size && plan.culprit == 0,
+          "no size");
+    check(plan_streams(capability, {}, plan), "nothing to plan");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    stream_capability_t capability{};
+    read_capability(capability);
+    preview_analysis_still(capability);
+    too_slow(capability);
+    hardware_levels();
+    largest_and_no_size();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
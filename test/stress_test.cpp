@@ -0,0 +1,401 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Session churn of multiple devices on the host stand-in.
+//  Each device runs open/stream/close and repeat<->capture cycles in its own
+//  thread and the suite reports the latency of the operations, growth of the
+//  resident memory and the NDK objects which are not freed.
+//
+//  Usage
+//      ndk_camera_stress [--devices 2] [--iterations 1000] [--frames 3]
+//                        [--switches 2] [--rss-limit 8192(KB)]
+//
+#include <ndk_camera.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_motion.h>
+#include <ndk_camera_resource.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+// follow `operation_names`
+enum operation_t : uint32_t {
+    op_open,
+    op_prewarm,
+    op_start_repeat,
+    op_first_frame, // start_repeat ~ onCaptureCompleted
+    op_stop_repeat,
+    op_start_capture,
+    op_capture, // start_capture ~ onCaptureSequenceCompleted
+    op_stop_capture,
+    op_close,
+    op_count
+};
+
+static constexpr const char* operation_names[op_count] = {
+    "open_device",   "prewarm",       "start_repeat",
+    "first_frame",   "stop_repeat",   "start_capture",
+    "capture",       "stop_capture",  "close_device",
+};
+
+struct options_t final {
+    uint16_t devices = 2;
+    uint32_t iterations = 1000;
+    uint32_t frames = 3;   // completed frames of each repeating request
+    uint32_t switches = 2; // repeat<->capture switches of each open
+    size_t rss_limit = 8 * 1024; // KB
+};
+
+// forward the callbacks to the library and count them for the waits
+struct probe_t final {
+    camera_group_t* context;
+    atomic<uint32_t> completed{};
+    atomic<uint32_t> sequences{};
+};
+
+static auto get_probe(void* ptr) -> probe_t& {
+    return *reinterpret_cast<probe_t*>(ptr);
+}
+
+static void on_device_disconnected(void* ptr, ACameraDevice* device) {
+    context_on_device_disconnected(*get_probe(ptr).context, device);
+}
+static void on_device_error(void* ptr, ACameraDevice* device, int error) {
+    context_on_device_error(*get_probe(ptr).context, device, error);
+}
+static void on_session_active(void* ptr, ACameraCaptureSession* session) {
+    context_on_session_active(*get_probe(ptr).context, session);
+}
+static void on_session_closed(void* ptr, ACameraCaptureSession* session) {
+    context_on_session_closed(*get_probe(ptr).context, session);
+}
+static void on_session_ready(void* ptr, ACameraCaptureSession* session) {
+    context_on_session_ready(*get_probe(ptr).context, session);
+}
+static void on_capture_started(void* ptr, ACameraCaptureSession* session,
+                               const ACaptureRequest* request,
+                               int64_t time_point) {
+    context_on_capture_started(*get_probe(ptr).context, session, request,
+                               time_point);
+}
+static void on_capture_completed(void* ptr, ACameraCaptureSession* session,
+                                 ACaptureRequest* request,
+                                 const ACameraMetadata* result) {
+    auto& probe = get_probe(ptr);
+    context_on_capture_completed(*probe.context, session, request, result);
+    probe.completed += 1;
+}
+static void on_capture_failed(void* ptr, ACameraCaptureSession* session,
+                              ACaptureRequest* request,
+                              ACameraCaptureFailure* failure) {
+    context_on_capture_failed(*get_probe(ptr).context, session, request,
+                              failure);
+}
+static void on_capture_buffer_lost(void* ptr, ACameraCaptureSession* session,
+                                   ACaptureRequest* request,
+                                   ANativeWindow* window,
+                                   int64_t frame_number) {
+    context_on_capture_buffer_lost(*get_probe(ptr).context, session, request,
+                                   window, frame_number);
+}
+static void on_sequence_completed(void* ptr, ACameraCaptureSession* session,
+                                  int sequence_id, int64_t frame_number) {
+    auto& probe = get_probe(ptr);
+    context_on_capture_sequence_complete(*probe.context, session, sequence_id,
+                                         frame_number);
+    probe.sequences += 1;
+}
+static void on_sequence_aborted(void* ptr, ACameraCaptureSession* session,
+                                int sequence_id) {
+    auto& probe = get_probe(ptr);
+    context_on_capture_sequence_abort(*probe.context, session, sequence_id);
+    probe.sequences += 1;
+}
+
+static size_t get_resident_kb() noexcept {
+    FILE* fin = fopen("/proc/self/statm", "r");
+    if (fin == nullptr)
+        return 0;
+    size_t total = 0, resident = 0;
+    if (fscanf(fin, "%zu %zu", &total, &resident) != 2)
+        resident = 0;
+    fclose(fin);
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+struct worker_result_t final {
+    array<vector<int64_t>, op_count> latencies{}; // nanosecond
+    uint32_t failures = 0;
+};
+
+void churn(camera_group_t& context, uint16_t id, const options_t& options,
+           worker_result_t& result) {
+    probe_t probe{};
+    probe.context = &context;
+    ACameraDevice_StateCallbacks device_callbacks{};
+    device_callbacks.context = &probe;
+    device_callbacks.onDisconnected = on_device_disconnected;
+    device_callbacks.onError = on_device_error;
+    ACameraCaptureSession_stateCallbacks session_callbacks{};
+    session_callbacks.context = &probe;
+    session_callbacks.onActive = on_session_active;
+    session_callbacks.onClosed = on_session_closed;
+    session_callbacks.onReady = on_session_ready;
+    ACameraCaptureSession_captureCallbacks capture_callbacks{};
+    capture_callbacks.context = &probe;
+    capture_callbacks.onCaptureStarted = on_capture_started;
+    capture_callbacks.onCaptureCompleted = on_capture_completed;
+    capture_callbacks.onCaptureFailed = on_capture_failed;
+    capture_callbacks.onCaptureBufferLost = on_capture_buffer_lost;
+    capture_callbacks.onCaptureSequenceCompleted = on_sequence_completed;
+    capture_callbacks.onCaptureSequenceAborted = on_sequence_aborted;
+
+    motion_gate_t gate{motion_config_t{}};
+    auto window = stand_in_create_window(640, 480);
+
+    auto measure = [&result](operation_t op, auto&& fn) {
+        const auto begin = steady_clock::now();
+        fn();
+        result.latencies[op].emplace_back(
+            duration_cast<nanoseconds>(steady_clock::now() - begin).count());
+    };
+    auto check = [&result, id](bool ok, const char* step) {
+        if (ok)
+            return true;
+        fprintf(stderr, "device %u: %s failed\n", id, step);
+        result.failures += 1;
+        return false;
+    };
+
+    for (auto i = 0u; i < options.iterations && result.failures == 0; ++i) {
+        camera_status_t status = ACAMERA_OK;
+        // odd iterations prepare the request before the surface
+        if (i % 2)
+            measure(op_prewarm, [&]() {
+                status = context.prewarm(id, device_callbacks);
+            });
+        else
+            measure(op_open, [&]() {
+                status = context.open_device(id, device_callbacks);
+            });
+        if (check(status == ACAMERA_OK, "open") == false)
+            break;
+
+        // every 4th open streams to the analysis reader too
+        const bool analysis = (i % 4) == 0;
+        if (analysis) {
+            check(context.open_reader(id, 320, 240, AIMAGE_FORMAT_YUV_420_888,
+                                      4) == AMEDIA_OK,
+                  "open_reader");
+            context.motion_gate_set[id] = &gate;
+        }
+
+        for (auto s = 0u; s < options.switches; ++s) {
+            const auto base = probe.completed.load();
+            const auto begin = steady_clock::now();
+            measure(op_start_repeat, [&]() {
+                status = context.start_repeat(id, window, session_callbacks,
+                                              capture_callbacks);
+            });
+            if (check(status == ACAMERA_OK, "start_repeat") == false)
+                break;
+            const auto streaming = [&]() {
+                return probe.completed.load() >= base + options.frames;
+            };
+            const bool streamed = wait_for(streaming, 2s, 50us);
+            result.latencies[op_first_frame].emplace_back(
+                duration_cast<nanoseconds>(steady_clock::now() - begin)
+                    .count());
+            check(streamed, "repeat frames");
+            // the odd ones are replaced by the capture session
+            if (s % 2 == 0)
+                measure(op_stop_repeat, [&]() { context.stop_repeat(id); });
+
+            const auto sequences = probe.sequences.load();
+            const auto capture_begin = steady_clock::now();
+            measure(op_start_capture, [&]() {
+                status = context.start_capture(id, window, session_callbacks,
+                                               capture_callbacks);
+            });
+            if (check(status == ACAMERA_OK, "start_capture") == false)
+                break;
+            // the sequence of the repeating request might end here too
+            const auto capturing = [&]() {
+                return probe.sequences.load() > sequences &&
+                       probe.completed.load() > base + options.frames;
+            };
+            const bool captured = wait_for(capturing, 2s, 50us);
+            result.latencies[op_capture].emplace_back(
+                duration_cast<nanoseconds>(steady_clock::now() -
+                                           capture_begin)
+                    .count());
+            check(captured, "capture");
+            measure(op_stop_capture, [&]() { context.stop_capture(id); });
+        }
+
+        if (analysis) {
+            context.close_reader(id);
+            context.motion_gate_set[id] = nullptr;
+        }
+        measure(op_close, [&]() { context.close_device(id); });
+    }
+    ANativeWindow_release(window);
+}
+
+static int64_t percentile(vector<int64_t>& values, double rank) noexcept {
+    if (values.empty())
+        return 0;
+    sort(values.begin(), values.end());
+    const auto index = static_cast<size_t>(rank * (values.size() - 1));
+    return values[index];
+}
+
+static bool parse(int argc, char* argv[], options_t& options) {
+    for (auto i = 1; i + 1 < argc; i += 2) {
+        const string key = argv[i];
+        const auto value = strtoull(argv[i + 1], nullptr, 10);
+        if (key == "--devices")
+            options.devices = static_cast<uint16_t>(value);
+        else if (key == "--iterations")
+            options.iterations = static_cast<uint32_t>(value);
+        else if (key == "--frames")
+            options.frames = static_cast<uint32_t>(value);
+        else if (key == "--switches")
+            options.switches = static_cast<uint32_t>(value);
+        else if (key == "--rss-limit")
+            options.rss_limit = value;
+        else
+            return false;
+    }
+    return options.devices > 0 &&
+           options.devices <= camera_group_t::max_camera_count;
+}
+
+int main(int argc, char* argv[]) {
+    options_t options{};
+    if (parse(argc, argv, options) == false) {
+        fprintf(stderr, "usage: %s [--devices N] [--iterations N] "
+                        "[--frames N] [--switches N] [--rss-limit KB]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    stand_in_config_t config{};
+    config.camera_count = options.devices;
+    config.frame_interval = 1ms;
+    config.open_latency = 200us;
+    config.session_latency = 100us;
+    stand_in_configure(config);
+
+    auto failures = 0u;
+    size_t rss_begin = 0, rss_end = 0;
+    array<vector<int64_t>, op_count> latencies{};
+    resource_tracker_t resources{};
+    resources.enable_sites(true);
+    {
+        camera_group_t context{};
+        context.resources = &resources;
+        context.manager = ACameraManager_create();
+        if (ACameraManager_getCameraIdList(context.manager,
+                                           &context.id_list) != ACAMERA_OK)
+            return EXIT_FAILURE;
+        for (auto i = 0; i < context.id_list->numCameras; ++i)
+            ACameraManager_getCameraCharacteristics(
+                context.manager, context.id_list->cameraIds[i],
+                &context.metadata_set[i]);
+
+        // warm up the allocators before the baseline
+        worker_result_t warmup{};
+        options_t once = options;
+        once.iterations = 4;
+        churn(context, 0, once, warmup);
+        rss_begin = get_resident_kb();
+
+        vector<worker_result_t> results(options.devices);
+        vector<thread> workers{};
+        for (uint16_t id = 0; id < options.devices; ++id)
+            workers.emplace_back(churn, ref(context), id, cref(options),
+                                 ref(results[id]));
+        for (auto& worker : workers)
+            worker.join();
+
+        rss_end = get_resident_kb();
+        failures += warmup.failures;
+        for (auto& result : results) {
+            failures += result.failures;
+            for (auto op = 0u; op < op_count; ++op)
+                latencies[op].insert(latencies[op].end(),
+                                     result.latencies[op].begin(),
+                                     result.latencies[op].end());
+        }
+        context.release();
+    }
+
+    printf("%-16s %8s %10s %10s\n", "operation", "count", "p50(us)",
+           "p99(us)");
+    for (auto op = 0u; op < op_count; ++op) {
+        auto& values = latencies[op];
+        const auto count = values.size();
+        printf("%-16s %8zu %10.1f %10.1f\n", operation_names[op], count,
+               percentile(values, 0.50) / 1000.0,
+               percentile(values, 0.99) / 1000.0);
+    }
+
+    const auto growth = rss_end > rss_begin ? rss_end - rss_begin : 0;
+    printf("resident: %zu KB -> %zu KB (+%zu KB, limit %zu KB)\n", rss_begin,
+           rss_end, growth, options.rss_limit);
+    if (growth > options.rss_limit)
+        failures += 1;
+
+    // accounting of the library must agree with the stand-in
+    for (auto i = 0u; i < resource_type_count; ++i) {
+        const auto stats = resources.get_stats(static_cast<resource_type_t>(i));
+        printf("resource %u: total %lld peak %lld peak bytes %lld\n", i,
+               static_cast<long long>(stats.total),
+               static_cast<long long>(stats.peak_live),
+               static_cast<long long>(stats.peak_bytes));
+        if (stats.live == 0 && stats.bytes == 0)
+            continue;
+        printf("outstanding: resource %u %lld (%lld bytes)\n", i,
+               static_cast<long long>(stats.live),
+               static_cast<long long>(stats.bytes));
+        failures += 1;
+    }
+    vector<resource_site_stats_t> sites{};
+    resources.get_sites(sites);
+    for (const auto& item : sites)
+        printf("outstanding: %s:%u %lld\n", item.site.file, item.site.line,
+               static_cast<long long>(item.live));
+    failures += static_cast<uint32_t>(sites.size());
+
+    for (auto i = 0u; i < static_cast<uint32_t>(stand_in_object_t::count);
+         ++i) {
+        const auto type = static_cast<stand_in_object_t>(i);
+        const auto count = stand_in_get_live_count(type);
+        if (count == 0)
+            continue;
+        printf("outstanding: %s %lld\n", stand_in_get_name(type),
+               static_cast<long long>(count));
+        failures += 1;
+    }
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
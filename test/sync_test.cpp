@@ -0,0 +1,225 @@
+//
+//  Author
+//      luncliff@gmail.com
+//
+//  Pairing, expiry and overflow of `frame_synchronizer_t`, and the streams
+//  which are not comparable until `set_offset`
+//
+#include <ndk_camera.h>
+#include <ndk_camera_log.h>
+#include <ndk_camera_sync.h>
+
+#include <spdlog/sinks/null_sink.h>
+
+#include "check.h"
+#include "stand_in.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+extern shared_ptr<spdlog::logger> logger;
+
+static constexpr int64_t ms = 1'000'000;
+
+// characteristics with ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE
+struct source_t final {
+    ACameraMetadata* metadata;
+
+  public:
+    explicit source_t(uint8_t source)
+        : metadata{stand_in_create_metadata(
+              ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, &source, 1)} {
+    }
+    source_t(const uint8_t* data, uint32_t count)
+        : metadata{stand_in_create_metadata(
+              ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE, data, count)} {
+    }
+    ~source_t() {
+        ACameraMetadata_free(metadata);
+    }
+};
+static const source_t realtime{ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME};
+static const source_t unknown{ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_UNKNOWN};
+
+// the sets from the callback
+struct probe_t final {
+    vector<vector<sync_frame_t>> sets{};
+};
+
+static void on_sync(void* ptr, const sync_frame_t* frames, uint16_t count) {
+    auto& probe = *reinterpret_cast<probe_t*>(ptr);
+    probe.sets.emplace_back(frames, frames + count);
+}
+
+void pair_in_tolerance() {
+    probe_t probe{};
+    frame_synchronizer_t sync{1 * ms, 100 * ms, on_sync, &probe};
+    // registered in the reverse order. the set is ordered by id
+    check(sync.add_stream(3, realtime.metadata) == ACAMERA_OK, "add 3");
+    check(sync.add_stream(0, realtime.metadata) == ACAMERA_OK, "add 0");
+
+    sync.push(3, 1000 * ms);
+    check(probe.sets.empty(), "wait for the other device");
+    sync.push(0, 1000 * ms + ms / 2);
+    if (check(probe.sets.size() == 1, "pair in the tolerance")) {
+        const auto& set = probe.sets[0];
+        check(set.size() == 2 && set[0].id == 0 && set[1].id == 3,
+              "frames are ordered by id");
+        check(set[0].timestamp == 1000 * ms + ms / 2 &&
+                  set[1].timestamp == 1000 * ms,
+              "timestamps of the set");
+        check(set[0].sequence == 0 && set[1].sequence == 0, "sequences");
+    }
+
+    // 2 ms apart. the earlier one can't be paired
+    sync.push(0, 1033 * ms);
+    sync.push(3, 1035 * ms);
+    check(probe.sets.size() == 1, "no pair out of the tolerance");
+    auto stats = sync.get_stats();
+    check(stats.unmatched[0] == 1 && stats.unmatched[3] == 0,
+          "the earlier frame is unmatched");
+    sync.push(0, 1035 * ms + ms);
+    check(probe.sets.size() == 2, "the later frame is paired");
+    check(probe.sets.back()[0].sequence == 2, "sequence counts every frame");
+
+    // at the edge of the tolerance
+    sync.push(0, 1068 * ms);
+    sync.push(3, 1069 * ms);
+    stats = sync.get_stats();
+    check(stats.matched == 3 && probe.sets.size() == 3, "tolerance is closed");
+    check(stats.unmatched[3] == 0 && stats.expired[0] == 0,
+          "no drop for the pairs");
+}
+
+void expire_with_window() {
+    probe_t probe{};
+    frame_synchronizer_t sync{1 * ms, 100 * ms, on_sync, &probe};
+    sync.add_stream(0, realtime.metadata);
+    sync.add_stream(1, realtime.metadata);
+
+    // the other device is late. the frames older than the window go
+    for (auto i = 0; i < 7; ++i)
+        sync.push(0, i * 33 * ms);
+    auto stats = sync.get_stats();
+    // 0, 33, 66 are older than (198 - 100)
+    check(stats.expired[0] == 3, "expired by the window");
+    check(stats.expired[1] == 0, "nothing to expire");
+
+    // the pending ones are still paired
+    sync.push(1, 99 * ms);
+    check(probe.sets.size() == 1 && probe.sets[0][0].timestamp == 99 * ms,
+          "pair with the pending frame");
+    // the late one can't be paired with the pending frames
+    sync.push(1, 10 * ms);
+    check(sync.get_stats().unmatched[1] == 1, "late frame is unmatched");
+
+    // the other device is stale when the device is back
+    sync.push(1, 240 * ms);
+    sync.push(1, 250 * ms);
+    check(probe.sets.size() == 1, "no pair with the stale frames");
+    sync.push(0, 400 * ms);
+    stats = sync.get_stats();
+    check(stats.expired[1] == 2, "stale frames are expired");
+}
+
+void overflow() {
+    probe_t probe{};
+    const auto count = frame_synchronizer_t::capacity + 4;
+    frame_synchronizer_t sync{1 * ms, 10'000 * ms, on_sync, &probe};
+    sync.add_stream(0, realtime.metadata);
+    sync.add_stream(1, realtime.metadata);
+    for (auto i = 0; i < count; ++i)
+        sync.push(0, i * ms);
+    check(sync.get_stats().expired[0] == 4, "the oldest ones are dropped");
+
+    // the ring has the latest frames
+    sync.push(1, 4 * ms);
+    check(probe.sets.size() == 1 && probe.sets[0][0].sequence == 4,
+          "the oldest one in the ring");
+    check(sync.get_stats().unmatched[0] == 0, "no unmatched in the ring");
+
+    sync.clear();
+    sync.push(1, 100 * ms);
+    sync.push(0, 100 * ms);
+    check(probe.sets.size() == 2, "pair after the clear");
+}
+
+// the other streams wait until the stream is aligned
+void unknown_source() {
+    probe_t probe{};
+    frame_synchronizer_t sync{1 * ms, 100 * ms, on_sync, &probe};
+    sync.add_stream(0, realtime.metadata);
+    sync.add_stream(1, unknown.metadata);
+    check(sync.push(1, 5 * ms) == ACAMERA_ERROR_INVALID_OPERATION,
+          "not aligned");
+    for (auto i = 0; i < 5; ++i)
+        sync.push(0, (1000 + i * 33) * ms);
+    auto stats = sync.get_stats();
+    check(stats.matched == 0, "no set without the aligned stream");
+    check(stats.expired[0] == 1, "the waiting frames are expired");
+
+    // the stream's clock is 1 second behind
+    sync.set_offset(1, 1000 * ms);
+    check(sync.push(1, 132 * ms) == ACAMERA_OK, "aligned");
+    check(probe.sets.size() == 1 &&
+              probe.sets[0][1].timestamp == 1132 * ms,
+          "offset is applied");
+    sync.push(0, 1165 * ms);
+    sync.push(1, 165 * ms);
+    check(sync.get_stats().matched == 2, "pairs after the alignment");
+
+    // the new offset drops the pending frames
+    sync.push(1, 198 * ms);
+    sync.set_offset(1, 1001 * ms);
+    sync.push(0, 1199 * ms);
+    check(probe.sets.size() == 2, "pending frame is dropped");
+    sync.push(1, 198 * ms);
+    check(probe.sets.size() == 3, "pair with the new offset");
+
+    // the first stream is the reference. others are compared with it
+    frame_synchronizer_t other{1 * ms, 100 * ms, on_sync, &probe};
+    other.add_stream(2, unknown.metadata);
+    other.add_stream(0, realtime.metadata);
+    check(other.push(2, 0) == ACAMERA_OK, "reference is aligned");
+    check(other.push(0, 0) == ACAMERA_ERROR_INVALID_OPERATION,
+          "realtime is not comparable with unknown");
+}
+
+void stream_registration() {
+    frame_synchronizer_t sync{1 * ms, 100 * ms, nullptr, nullptr};
+    check(sync.push(0, 0) == ACAMERA_ERROR_INVALID_PARAMETER,
+          "not registered");
+    check(sync.add_stream(camera_group_t::max_camera_count,
+                          realtime.metadata) ==
+              ACAMERA_ERROR_INVALID_PARAMETER,
+          "id out of range");
+
+    const uint8_t back = ACAMERA_LENS_FACING_BACK;
+    auto* facing = stand_in_create_metadata(ACAMERA_LENS_FACING, &back, 1);
+    check(sync.add_stream(0, facing) == ACAMERA_ERROR_METADATA_NOT_FOUND,
+          "no timestamp source");
+    ACameraMetadata_free(facing);
+
+    // the entry without the value is not comparable
+    const source_t empty{nullptr, 0};
+    check(sync.add_stream(0, realtime.metadata) == ACAMERA_OK, "add 0");
+    check(sync.add_stream(1, empty.metadata) == ACAMERA_OK, "empty entry");
+    check(sync.push(1, 0) == ACAMERA_ERROR_INVALID_OPERATION,
+          "empty entry is unknown");
+}
+
+int main(int, char*[]) {
+    logger = spdlog::null_logger_mt(tag_ndk_camera);
+
+    pair_in_tolerance();
+    expire_with_window();
+    overflow();
+    unknown_source();
+    stream_registration();
+
+    printf("failures: %u\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}